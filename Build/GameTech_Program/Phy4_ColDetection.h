@@ -4,12 +4,14 @@
 #include <nclgl\OBJMesh.h>
 #include <ncltech\Scene.h>
 #include <ncltech\SceneManager.h>
+#include <ncltech\AssetManager.h>
 #include <ncltech\PhysicsEngine.h>
 #include <ncltech\NCLDebug.h>
 #include <ncltech\ObjectMesh.h>
 #include <ncltech\SphereCollisionShape.h>
 #include <ncltech\CuboidCollisionShape.h>
 #include <ncltech\CommonUtils.h>
+#include <ncltech\CommonMeshes.h>
 #include "ObjectPlayer.h"
 
 
@@ -18,34 +20,24 @@ class Phy4_ColDetection : public Scene
 public:
 	Phy4_ColDetection(const std::string& friendly_name)
 		: Scene(friendly_name)
-		, m_MeshHouse(NULL)
-		, m_MeshGarden(NULL)
 	{
 		glGenTextures(1, &m_whiteTexture);
 		glBindTexture(GL_TEXTURE_2D, m_whiteTexture);
 		int white_pixel = 0xFFFFFFFF;
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, &white_pixel);
 
-		m_MeshHouse = new OBJMesh(MESHDIR"house.obj");
-		m_MeshGarden = new OBJMesh(MESHDIR"garden.obj");
-
-		m_MeshPlayer = new OBJMesh(MESHDIR"raptor.obj");
-		m_MeshPlayer->GenerateNormals();
-		GLuint dTex, nTex;
-
-		dTex = SOIL_load_OGL_texture(
+		//These load in the background, and the SceneManager won't switch to this scene until they're ready
+		m_MeshHouse = AssetManager::Instance()->LoadMesh(MESHDIR"house.obj");
+		m_MeshGarden = AssetManager::Instance()->LoadMesh(MESHDIR"garden.obj");
+		m_MeshPlayer = AssetManager::Instance()->LoadMesh(MESHDIR"raptor.obj");
+		m_TexPlayer = AssetManager::Instance()->LoadTexture(
 			TEXTUREDIR"raptor.jpg",
-			SOIL_LOAD_AUTO,
-			SOIL_CREATE_NEW_ID,
-			SOIL_FLAG_MIPMAPS | SOIL_FLAG_INVERT_Y | SOIL_FLAG_NTSC_SAFE_RGB | SOIL_FLAG_COMPRESS_TO_DXT);
-		glBindTexture(GL_TEXTURE_2D, dTex);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glBindTexture(GL_TEXTURE_2D, 0);
-
-		m_MeshPlayer->SetTexture(dTex);
+			SOIL_FLAG_MIPMAPS | SOIL_FLAG_INVERT_Y | SOIL_FLAG_NTSC_SAFE_RGB | SOIL_FLAG_COMPRESS_TO_DXT | SOIL_FLAG_TEXTURE_REPEATS);
+
+		RequireAsset(m_MeshHouse.Get());
+		RequireAsset(m_MeshGarden.Get());
+		RequireAsset(m_MeshPlayer.Get());
+		RequireAsset(m_TexPlayer.Get());
 	}
 
 	virtual ~Phy4_ColDetection()
@@ -55,27 +47,6 @@ public:
 			glDeleteTextures(1, &m_whiteTexture);
 			m_whiteTexture = NULL;
 		}
-
-		if (m_MeshHouse)
-		{
-			m_MeshHouse->SetTexture(NULL);
-			delete m_MeshHouse;
-			m_MeshHouse = NULL;
-		}
-
-		if (m_MeshGarden)
-		{
-			m_MeshGarden->SetTexture(NULL);
-			delete m_MeshGarden;
-			m_MeshGarden = NULL;
-		}
-
-		if (m_MeshPlayer)
-		{
-			delete m_MeshPlayer;
-			m_MeshPlayer = NULL;
-		}
-
 	}
 
 	virtual void OnInitializeScene() override
@@ -86,6 +57,20 @@ public:
 		SceneManager::Instance()->GetCamera()->SetYaw(-10.f);
 		SceneManager::Instance()->GetCamera()->SetPitch(-30.f);
 
+		//Assets that failed to load (already reported by the AssetManager) are left out, or replaced by a cube for the player
+		OBJMesh* mesh_house = m_MeshHouse.IsReady() ? m_MeshHouse->GetMesh() : NULL;
+		OBJMesh* mesh_garden = m_MeshGarden.IsReady() ? m_MeshGarden->GetMesh() : NULL;
+		OBJMesh* mesh_player = m_MeshPlayer.IsReady() ? m_MeshPlayer->GetMesh() : NULL;
+
+		//The texture is shared, so it's repeating/filtering comes from it's flags rather than being set here
+		// - The mesh takes it's own reference to it, giving back the one from Raptor.mtl
+		if (mesh_player && m_TexPlayer.IsReady())
+			mesh_player->ShareTexture(m_TexPlayer->GetTexture());
+
+		const ResourceRegistryStats& stats = ResourceRegistry::GetStats();
+		NCLDebug::Log(Vector3(0.6f, 0.6f, 0.6f), "Shared resources: %d textures, %d meshes (%5.2fMB in use, %5.2fMB saved by sharing)",
+			stats.numTextures, stats.numMeshes, stats.bytesUsed / (1024.0f * 1024.0f), stats.bytesSaved / (1024.0f * 1024.0f));
+
 		//Create Ground
 		this->AddGameObject(CommonUtils::BuildCuboidObject(
 			"Ground",
@@ -100,7 +85,7 @@ public:
 
 		//Create Player
 		ObjectPlayer* player = new ObjectPlayer("Player1");
-		player->SetMesh(m_MeshPlayer, false);
+		player->SetMesh(mesh_player ? (Mesh*)mesh_player : CommonMeshes::Cube(), false);
 		player->CreatePhysicsNode();
 		player->Physics()->SetPosition(Vector3(0.0f, 0.5f, 0.0f));
 		player->Physics()->SetCollisionShape(new CuboidCollisionShape(Vector3(0.5f, 0.5f, 1.0f)));
@@ -110,11 +95,12 @@ public:
 
 
 		//Create Some Objects
+		if (mesh_house)
 		{
 			const Vector3 col_size = Vector3(2.0f, 2.f, 2.f);
 			ObjectMesh* obj = new ObjectMesh("House");
 			obj->SetLocalTransform(Matrix4::Translation(Vector3(0.0f, -0.71f, 0.0f)) * Matrix4::Scale(Vector3(2.0f, 2.0f, 2.f)));	//Translation here to move the mesh down, as it not centred on the origin
-			obj->SetMesh(m_MeshHouse, false);
+			obj->SetMesh(mesh_house, false);
 			obj->SetTexture(m_whiteTexture, false);
 			obj->SetColour(Vector4(0.8f, 0.3f, 0.1f, 1.0f));
 			obj->SetBoundingRadius(col_size.Length());
@@ -129,11 +115,12 @@ public:
 			this->AddGameObject(obj);
 		}
 
+		if (mesh_garden)
 		{
 			const Vector3 col_size = Vector3(2.0f, 0.5f, 2.f);
 			ObjectMesh* obj = new ObjectMesh("Garden");
 			obj->SetLocalTransform(Matrix4::Translation(Vector3(0.0f, -0.5f, 0.0f)) *Matrix4::Scale(Vector3(2.0f, 1.0f, 2.f)));//Translation here to move the mesh down, as it not centred on the origin
-			obj->SetMesh(m_MeshGarden, false);
+			obj->SetMesh(mesh_garden, false);
 			obj->SetTexture(m_whiteTexture, false);
 			obj->SetColour(Vector4(0.5f, 1.0f, 0.5f, 1.0f));
 			obj->SetBoundingRadius(col_size.Length());
@@ -188,7 +175,8 @@ public:
 	}
 
 private:
-	OBJMesh *m_MeshHouse, *m_MeshGarden;
-	GLuint	m_whiteTexture;
-	OBJMesh* m_MeshPlayer;
+	MeshHandle		m_MeshHouse, m_MeshGarden;
+	GLuint			m_whiteTexture;
+	MeshHandle		m_MeshPlayer;
+	TextureHandle	m_TexPlayer;
 };
\ No newline at end of file
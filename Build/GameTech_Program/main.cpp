@@ -74,7 +74,23 @@ void PrintStatusEntries()
 	timer_total.PrintOutputToStatusEntry(status_colour, "     Total Time     :");
 	timer_update.PrintOutputToStatusEntry(status_colour, "     Scene Update   :");
 	timer_physics.PrintOutputToStatusEntry(status_colour, "     Physics Update :");
+	PhysicsEngine::Instance()->PrintOverloadStatus(status_colour);
 	timer_render.PrintOutputToStatusEntry(status_colour, "     Render Scene   :");
+
+	const SceneBVHCullStats& cull_stats = SceneManager::Instance()->GetFrameCullStats();
+	NCLDebug::AddStatusEntry(status_colour, "     Culling        : %d nodes, %d tested, %d visible (of %d)",
+		cull_stats.nodesVisited, cull_stats.objectsTested, cull_stats.objectsAccepted,
+		(int)SceneManager::Instance()->GetCurrentScene()->GetBVH().GetNumObjects());
+	NCLDebug::AddStatusEntry(status_colour, "     Transforms     : %d updated",
+		SceneManager::Instance()->GetCurrentScene()->GetNumWorldMatricesUpdated());
+
+	const RenderQueue& render_queue = SceneManager::Instance()->GetOpaqueRenderQueue();
+	NCLDebug::AddStatusEntry(status_colour, "     Opaque Draws   : %d (%d texture / %d mesh changes)",
+		(int)render_queue.GetCommands().size(), render_queue.GetNumTextureChanges(), render_queue.GetNumMeshChanges());
+	NCLDebug::AddStatusEntry(status_colour, "     Draw Calls     : %d (%d instanced)",
+		SceneManager::Instance()->GetNumDrawCalls(), SceneManager::Instance()->GetNumInstancedDrawCalls());
+	NCLDebug::AddStatusEntry(status_colour, "     Shadow Maps    : %d / %d re-rendered",
+		SceneManager::Instance()->GetNumShadowMapsRendered(), SceneManager::Instance()->GetShadowMapNum());
 	NCLDebug::AddStatusEntry(status_colour, "");
 }
 
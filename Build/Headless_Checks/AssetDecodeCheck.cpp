@@ -0,0 +1,76 @@
+#include "HeadlessChecks.h"
+#include <nclgl\OBJMesh.h>
+#include <nclgl\MD5FileData.h>
+#include <nclgl\TextureData.h>
+#include <thread>
+
+/*
+Runs the decode half of each asset type on a worker thread, exactly as the
+AssetManager's workers do. There is no OpenGL context in this program (and
+GLEW is never initialised), so any OpenGL call made while decoding would crash
+rather than pass.
+*/
+
+bool SameOBJ(const OBJDecodedMesh& a, const OBJDecodedMesh& b)
+{
+	CHECK(a.subMeshes.size() == b.subMeshes.size());
+	for (size_t i = 0; i < a.subMeshes.size(); ++i)
+	{
+		const OBJSubMeshData& sa = a.subMeshes[i];
+		const OBJSubMeshData& sb = b.subMeshes[i];
+		CHECK(sa.numVertices == sb.numVertices && sa.numIndices == sb.numIndices);
+		CHECK(memcmp(sa.vertices, sb.vertices, sa.numVertices * sizeof(Vector3)) == 0);
+		CHECK(memcmp(sa.indices, sb.indices, sa.numIndices * sizeof(uint)) == 0);
+		CHECK(sa.material.diffuse == sb.material.diffuse && sa.material.bump == sb.material.bump);
+	}
+	return true;
+}
+
+bool Check_AssetDecode()
+{
+	OBJDecodedMesh parsed, cached;
+	bool parsedOK = false, cachedOK = false, missingOK = true, md5MissingOK = true, textureOK = false;
+	TextureData texture;
+
+	//The first decode parses the OBJ (writing the cache), and the second reads the cache back in
+	std::thread worker([&]() {
+		parsedOK	= OBJMesh::DecodeOBJMesh(MESHDIR"Raptor.obj", false, parsed);
+		OBJDecodedMesh warm;
+		OBJMesh::DecodeOBJMesh(MESHDIR"Raptor.obj", true, warm);
+		cachedOK	= OBJMesh::DecodeOBJMesh(MESHDIR"Raptor.obj", true, cached);
+
+		OBJDecodedMesh missing;
+		missingOK	= !OBJMesh::DecodeOBJMesh(MESHDIR"no_such_file.obj", true, missing);
+
+		MD5FileData* md5 = MD5FileData::Decode(MESHDIR"no_such_file.md5mesh");
+		md5MissingOK = (md5 == NULL);
+		delete md5;
+
+		textureOK	= texture.Load(TEXTUREDIR"checkerboard.tga", SOIL_FLAG_MIPMAPS | SOIL_FLAG_NTSC_SAFE_RGB | SOIL_FLAG_COMPRESS_TO_DXT);
+	});
+	worker.join();
+
+	CHECK(parsedOK && cachedOK);
+	CHECK(!parsed.fromCache && cached.fromCache);
+	printf("    Raptor.obj: %u submeshes, parsed in %5.2fms, read from the cache in %5.2fms\n",
+		(uint)parsed.subMeshes.size(), parsed.decodeTime, cached.decodeTime);
+
+	if (!SameOBJ(parsed, cached))
+		return false;
+
+	//Everything the main thread needs has been decoded, so Upload only has to create the OpenGL objects
+	for (size_t i = 0; i < cached.subMeshes.size(); ++i)
+	{
+		CHECK(cached.subMeshes[i].normals != NULL);
+		CHECK(cached.subMeshes[i].material.diffuse == "raptor.jpg");
+	}
+
+	CHECK(textureOK && texture.GetNumLevels() > 1);
+	printf("    checkerboard.tga: %ux%u, %u levels, %s in %5.2fms\n", texture.GetWidth(), texture.GetHeight(),
+		texture.GetNumLevels(), texture.IsFromCache() ? "read from the cache" : "baked", texture.GetLoadTime());
+
+	//Missing files fail cleanly, rather than crashing or producing empty assets
+	CHECK(missingOK);
+	CHECK(md5MissingOK);
+	return true;
+}
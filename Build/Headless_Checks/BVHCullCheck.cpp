@@ -0,0 +1,196 @@
+#include "HeadlessChecks.h"
+#include <ncltech\SceneBVH.h>
+#include <nclgl\GameTimer.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cfloat>
+#include <vector>
+
+/*
+Compares culling a scene through SceneBVH against testing every object's
+bounding sphere against the frustum (one at a time, and with the SIMD
+InsideFrustumBatch RenderList uses), from several camera views. Both must
+find exactly the same objects, other than spheres lying exactly on a plane
+which may round either way (as in the frustum_cull check). Then moves some of
+the objects and checks the refitted tree still agrees, and times each.
+*/
+
+#define BVH_BENCH_OBJECTS		100000
+#define BVH_BENCH_RUNS			20
+#define BVH_BENCH_EXTENT		1000.0f		//Objects are scattered within +-this of the origin (the far plane is at 1000)
+#define BVH_BENCH_MOVED			1000		//Objects moved before checking the refitted tree
+#define BVH_BENCH_EDGE			1e-3f		//How close to a plane a sphere must be for the two to disagree
+
+class BVHCheckObject : public Object
+{
+public:
+	BVHCheckObject(const Vector3& position, float radius, int idx)
+		: index(idx)
+	{
+		SetPosition(position);
+		m_BoundingRadius = radius;
+	}
+
+	void SetPosition(const Vector3& position)	{ m_WorldTransform = Matrix4::Translation(position); }
+
+	int index;
+};
+
+static float RandomRange(float min_val, float max_val)
+{
+	return min_val + (max_val - min_val) * (rand() / (float)RAND_MAX);
+}
+
+static bool OnPlane(const Frustum& frustum, Object* obj)
+{
+	const Vector3 position = obj->GetWorldTransform().GetPositionVector();
+	for (int p = 0; p < 6; ++p)
+	{
+		const Plane& plane = frustum.GetPlane(p);
+		if (fabs(Vector3::Dot(position, plane.GetNormal()) + plane.GetDistance() + obj->GetBoundingRadius()) < BVH_BENCH_EDGE)
+			return true;
+	}
+	return false;
+}
+
+//Culls every frustum through the tree and object by object, the two must agree on every object
+static bool CompareCulling(const SceneBVH& bvh, const std::vector<Object*>& objects, const std::vector<Frustum>& frustums, int& out_visible)
+{
+	out_visible = 0;
+	std::vector<int> found(objects.size());
+	for (size_t f = 0; f < frustums.size(); ++f)
+	{
+		const int stamp = (int)f + 1;
+		int numFound = 0;
+		SceneBVHCullStats stats = bvh.ForEachVisible(frustums[f], [&](Object* obj)
+		{
+			found[((BVHCheckObject*)obj)->index] = stamp;
+			numFound++;
+		});
+		CHECK(stats.objectsAccepted == numFound);
+
+		for (Object* obj : objects)
+		{
+			const bool inBVH = found[((BVHCheckObject*)obj)->index] == stamp;
+			const bool inFrustum = frustums[f].InsideFrustum(obj->GetWorldTransform().GetPositionVector(), obj->GetBoundingRadius());
+			CHECK(inBVH == inFrustum || OnPlane(frustums[f], obj));
+			out_visible += inFrustum ? 1 : 0;
+		}
+	}
+	return true;
+}
+
+bool Check_BVHCull()
+{
+	srand(31);
+
+	//Looking across the middle of the scene, out from the edge of it, down from above, and a narrow view into the distance
+	std::vector<Frustum> frustums(4);
+	frustums[0].FromMatrix(Matrix4::Perspective(1.0f, 1000.0f, 16.0f / 9.0f, 45.0f)
+		* Matrix4::BuildViewMatrix(Vector3(0.0f, 10.0f, 0.0f), Vector3(30.0f, 0.0f, -100.0f)));
+	frustums[1].FromMatrix(Matrix4::Perspective(1.0f, 1000.0f, 16.0f / 9.0f, 45.0f)
+		* Matrix4::BuildViewMatrix(Vector3(900.0f, 0.0f, 900.0f), Vector3(2000.0f, 0.0f, 2000.0f)));
+	frustums[2].FromMatrix(Matrix4::Perspective(1.0f, 1000.0f, 1.0f, 90.0f)
+		* Matrix4::BuildViewMatrix(Vector3(0.0f, 900.0f, 0.0f), Vector3(0.0f, 0.0f, 1.0f)));
+	frustums[3].FromMatrix(Matrix4::Perspective(1.0f, 1000.0f, 16.0f / 9.0f, 10.0f)
+		* Matrix4::BuildViewMatrix(Vector3(-500.0f, 0.0f, -500.0f), Vector3(0.0f, 0.0f, 0.0f)));
+
+	std::vector<Object*> objects;
+	for (int i = 0; i < BVH_BENCH_OBJECTS; ++i)
+	{
+		const Vector3 position(
+			RandomRange(-BVH_BENCH_EXTENT, BVH_BENCH_EXTENT),
+			RandomRange(-BVH_BENCH_EXTENT * 0.1f, BVH_BENCH_EXTENT * 0.1f),
+			RandomRange(-BVH_BENCH_EXTENT, BVH_BENCH_EXTENT));
+		objects.push_back(new BVHCheckObject(position, RandomRange(0.1f, 5.0f), i));
+	}
+	SceneBVH bvh;
+	bvh.Update(objects);
+	CHECK(bvh.GetNumObjects() == objects.size() && bvh.GetNumRebuilds() == 1);
+
+	int numVisible = 0;
+	CHECK(CompareCulling(bvh, objects, frustums, numVisible));
+
+	//Move some of the objects a little - the tree should only be refitted, and still find the same objects
+	for (int i = 0; i < BVH_BENCH_MOVED; ++i)
+	{
+		BVHCheckObject* obj = (BVHCheckObject*)objects[rand() % objects.size()];
+		obj->SetPosition(obj->GetWorldTransform().GetPositionVector() + Vector3(RandomRange(-20.0f, 20.0f), 0.0f, RandomRange(-20.0f, 20.0f)));
+	}
+	bvh.Update(objects);
+	CHECK(bvh.GetNumRebuilds() == 1 && bvh.GetNumRefittedLastUpdate() > 0);
+
+	CHECK(CompareCulling(bvh, objects, frustums, numVisible));
+
+	//Fewer objects and the tree has to be rebuilt
+	std::vector<Object*> half(objects.begin(), objects.begin() + objects.size() / 2);
+	bvh.Update(half);
+	CHECK(bvh.GetNumRebuilds() == 2 && bvh.GetNumObjects() == half.size());
+	int numVisibleHalf = 0;
+	CHECK(CompareCulling(bvh, half, frustums, numVisibleHalf));
+	CHECK(numVisibleHalf < numVisible);
+	bvh.Update(objects);
+
+	//Timings - all four views each run
+	std::vector<float> xs(objects.size()), ys(objects.size()), zs(objects.size()), radii(objects.size());
+	for (size_t i = 0; i < objects.size(); ++i)
+	{
+		const Vector3 position = objects[i]->GetWorldTransform().GetPositionVector();
+		xs[i] = position.x;
+		ys[i] = position.y;
+		zs[i] = position.z;
+		radii[i] = objects[i]->GetBoundingRadius();
+	}
+	std::vector<uint> visible((objects.size() + 31) / 32);
+
+	float bvhMs = FLT_MAX, bruteMs = FLT_MAX, batchMs = FLT_MAX;
+	int bvhCount = 0, bruteCount = 0;
+	SceneBVHCullStats totalStats;
+	for (int run = 0; run < BVH_BENCH_RUNS; ++run)
+	{
+		memset(&totalStats, 0, sizeof(SceneBVHCullStats));
+		bvhCount = 0;
+		bruteCount = 0;
+
+		GameTimer timer;
+		for (const Frustum& frustum : frustums)
+		{
+			SceneBVHCullStats stats = bvh.ForEachVisible(frustum, [&](Object*) { bvhCount++; });
+			totalStats.nodesVisited += stats.nodesVisited;
+			totalStats.objectsTested += stats.objectsTested;
+		}
+		const float ms = timer.GetTimedMS();		//min is a macro, so can't be given GetTimedMS directly
+		bvhMs = min(bvhMs, ms);
+
+		for (const Frustum& frustum : frustums)
+		{
+			for (Object* obj : objects)
+			{
+				if (frustum.InsideFrustum(obj->GetWorldTransform().GetPositionVector(), obj->GetBoundingRadius()))
+					bruteCount++;
+			}
+		}
+		const float bruteRunMs = timer.GetTimedMS();
+		bruteMs = min(bruteMs, bruteRunMs);
+
+		for (const Frustum& frustum : frustums)
+		{
+			frustum.InsideFrustumBatch(&xs[0], &ys[0], &zs[0], &radii[0], (uint)objects.size(), &visible[0]);
+		}
+		const float batchRunMs = timer.GetTimedMS();
+		batchMs = min(batchMs, batchRunMs);
+	}
+
+	printf("    %d objects, %d views (%d objects visible in total), fastest of %d runs:\n",
+		BVH_BENCH_OBJECTS, (int)frustums.size(), bvhCount, BVH_BENCH_RUNS);
+	printf("    SceneBVH::ForEachVisible:     %7.3fms (%d nodes visited, %d spheres tested)\n",
+		bvhMs, totalStats.nodesVisited, totalStats.objectsTested);
+	printf("    Frustum::InsideFrustum:       %7.3fms (%4.1fx the BVH time, %d visible)\n", bruteMs, bruteMs / max(bvhMs, 0.001f), bruteCount);
+	printf("    Frustum::InsideFrustumBatch:  %7.3fms (%4.1fx the BVH time)\n", batchMs, batchMs / max(bvhMs, 0.001f));
+
+	CHECK(numVisible > 0 && numVisible < BVH_BENCH_OBJECTS * (int)frustums.size());
+
+	for (Object* obj : objects)
+		delete obj;
+	return true;
+}
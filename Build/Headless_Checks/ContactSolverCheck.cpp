@@ -0,0 +1,369 @@
+#include "HeadlessChecks.h"
+#include <ncltech\ContactSolver.h>
+#include <ncltech\PhysicsEngine.h>
+#include <nclgl\GameTimer.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cfloat>
+#include <vector>
+
+/*
+Solves the same contacts through the batched SSE ContactSolver and through
+each Manifold's own Manifold::ApplyImpulse (one SolveContactPoint at a time),
+starting from the same velocities each time:
+
+ - Boxes hitting the ground with a single frictionless contact each. Every
+   contact has a body to itself, so the order they're solved in doesn't
+   matter and both must give the same normal impulses and velocities.
+ - The same, sliding with friction. The two handle friction differently: the
+   ContactSolver uses two fixed directions, each clamped to the friction
+   coefficient times the normal impulse, while Manifold follows the current
+   sliding direction and isn't held to that limit (so stops more of the
+   sliding). Only the ContactSolver's limit is checked, along with both
+   slowing the sliding down; how far each goes is printed.
+ - Stacks of boxes, four contacts per manifold, solved until they converge.
+   Both must bring every box to rest.
+
+Then times both on a large number of stacks, including each solver's
+PreSolverStep.
+*/
+
+#define CONTACT_CHECK_BODIES		64			//Boxes for the single contact cases
+#define CONTACT_CHECK_ITERATIONS	SOLVER_ITERATIONS
+#define CONTACT_CHECK_CONVERGE		500			//Iterations to solve the stacks until they are at rest
+#define CONTACT_CHECK_TOLERANCE		1e-4f		//Relative
+#define CONTACT_CHECK_FRICTION		0.5f		//Friction coefficient of the boxes (the ground's is 1)
+#define CONTACT_BENCH_STACKS		2500
+#define CONTACT_BENCH_HEIGHT		4			//Boxes per stack, 10000 manifolds with 4 contacts each
+#define CONTACT_BENCH_RUNS			5
+#define CONTACT_CHECK_TIMESTEP		(1.0f / 60.0f)
+
+//Gives access to each contact's accumulated impulses
+class CheckManifold : public Manifold
+{
+public:
+	const std::vector<ContactPoint>& GetContacts() const { return m_Contacts; }
+};
+
+class CheckContactSolver : public ContactSolver
+{
+public:
+	//Accumulated impulses of the lane solving the contact between 'objA' and 'objB', or false if there isn't exactly one
+	bool FindImpulses(const PhysicsObject* objA, const PhysicsObject* objB, float& out_normal, float& out_tangent1, float& out_tangent2) const
+	{
+		int found = 0;
+		for (const ContactBatch& batch : m_Batches)
+		{
+			for (int lane = 0; lane < batch.numLanes; ++lane)
+			{
+				if (batch.objA[lane] == objA && batch.objB[lane] == objB)
+				{
+					out_normal = batch.normal.impulse[lane];
+					out_tangent1 = batch.tangent1.impulse[lane];
+					out_tangent2 = batch.tangent2.impulse[lane];
+					found++;
+				}
+			}
+		}
+		return found == 1;
+	}
+
+	//True if no friction impulse is outside of it's lane's friction cone
+	bool FrictionWithinCone() const
+	{
+		for (const ContactBatch& batch : m_Batches)
+		{
+			for (int lane = 0; lane < batch.numLanes; ++lane)
+			{
+				const float limit = batch.friction[lane] * batch.normal.impulse[lane] * (1.0f + CONTACT_CHECK_TOLERANCE);
+				if (fabs(batch.tangent1.impulse[lane]) > limit || fabs(batch.tangent2.impulse[lane]) > limit)
+					return false;
+			}
+		}
+		return true;
+	}
+};
+
+struct ContactScene
+{
+	PhysicsObject ground;
+	std::vector<PhysicsObject*> bodies;
+	std::vector<CheckManifold*> manifolds;
+	std::vector<Manifold*> manifoldList;		//As ContactSolver takes them
+
+	//Starting velocities, restored before each solve
+	std::vector<Vector3> linear, angular;
+
+	~ContactScene()
+	{
+		for (PhysicsObject* body : bodies)
+			delete body;
+		for (CheckManifold* m : manifolds)
+			delete m;
+	}
+
+	PhysicsObject* AddBox(const Vector3& position, float friction, float elasticity)
+	{
+		//Unit cube of mass 1
+		PhysicsObject* body = new PhysicsObject();
+		body->SetPosition(position);
+		body->SetInverseMass(1.0f);
+		body->SetInverseInertia(Matrix3(6.0f, 0.0f, 0.0f, 0.0f, 6.0f, 0.0f, 0.0f, 0.0f, 6.0f));
+		body->SetFriction(friction);
+		body->SetElasticity(elasticity);
+		bodies.push_back(body);
+		return body;
+	}
+
+	CheckManifold* AddManifold(PhysicsObject* objA, PhysicsObject* objB)
+	{
+		CheckManifold* m = new CheckManifold();
+		m->Initiate(objA, objB);
+		manifolds.push_back(m);
+		manifoldList.push_back(m);
+		return m;
+	}
+
+	void SaveVelocities()
+	{
+		linear.clear();
+		angular.clear();
+		for (PhysicsObject* body : bodies)
+		{
+			linear.push_back(body->GetLinearVelocity());
+			angular.push_back(body->GetAngularVelocity());
+		}
+	}
+
+	void RestoreVelocities()
+	{
+		for (size_t i = 0; i < bodies.size(); ++i)
+		{
+			bodies[i]->SetLinearVelocity(linear[i]);
+			bodies[i]->SetAngularVelocity(angular[i]);
+		}
+	}
+
+	void SolveManifolds(int iterations)
+	{
+		RestoreVelocities();
+		for (Manifold* m : manifoldList)
+			m->PreSolverStep(CONTACT_CHECK_TIMESTEP);
+		for (int i = 0; i < iterations; ++i)
+		{
+			for (Manifold* m : manifoldList)
+				m->ApplyImpulse();
+		}
+	}
+
+	void SolveBatched(CheckContactSolver& solver, int iterations)
+	{
+		RestoreVelocities();
+		for (Manifold* m : manifoldList)
+			m->PreSolverStep(CONTACT_CHECK_TIMESTEP);
+		solver.PreSolverStep(manifoldList, CONTACT_CHECK_TIMESTEP);
+		for (int i = 0; i < iterations; ++i)
+			solver.ApplyImpulses();
+	}
+};
+
+static float RandomRange(float min_val, float max_val)
+{
+	return min_val + (max_val - min_val) * (rand() / (float)RAND_MAX);
+}
+
+static bool NearlyEqual(float a, float b, float scale)
+{
+	return fabs(a - b) <= CONTACT_CHECK_TOLERANCE * max(scale, 1.0f);
+}
+
+static bool NearlyEqual(const Vector3& a, const Vector3& b, float scale)
+{
+	return NearlyEqual(a.x, b.x, scale) && NearlyEqual(a.y, b.y, scale) && NearlyEqual(a.z, b.z, scale);
+}
+
+//Boxes falling onto the ground, each touching it at a single point somewhere on it's bottom face
+static void BuildSingleContacts(ContactScene& scene, float friction)
+{
+	scene.ground.SetFriction(1.0f);
+	scene.ground.SetElasticity(1.0f);
+	for (int i = 0; i < CONTACT_CHECK_BODIES; ++i)
+	{
+		PhysicsObject* box = scene.AddBox(Vector3((float)i * 2.0f, 0.5f, 0.0f), friction, RandomRange(0.0f, 0.8f));
+		box->SetLinearVelocity(Vector3(RandomRange(-2.0f, 2.0f), RandomRange(-5.0f, -0.5f), RandomRange(-2.0f, 2.0f)));
+		box->SetAngularVelocity(Vector3(RandomRange(-1.0f, 1.0f), RandomRange(-1.0f, 1.0f), RandomRange(-1.0f, 1.0f)));
+
+		const Vector3 point = box->GetPosition() + Vector3(RandomRange(-0.5f, 0.5f), -0.5f, RandomRange(-0.5f, 0.5f));
+		scene.AddManifold(&scene.ground, box)->AddContact(point, point, Vector3(0.0f, 1.0f, 0.0f), RandomRange(-0.1f, 0.0f));
+	}
+	scene.SaveVelocities();
+}
+
+//Columns of boxes resting on the ground and each other, touching at the four corners of each face
+static void BuildStacks(ContactScene& scene, int numStacks, int height)
+{
+	scene.ground.SetFriction(0.0f);
+	scene.ground.SetElasticity(0.0f);
+	for (int s = 0; s < numStacks; ++s)
+	{
+		PhysicsObject* below = &scene.ground;
+		for (int h = 0; h < height; ++h)
+		{
+			const Vector3 base((float)(s % 64) * 2.0f, (float)h, (float)(s / 64) * 2.0f);
+			PhysicsObject* box = scene.AddBox(base + Vector3(0.0f, 0.5f, 0.0f), 0.0f, 0.0f);
+			box->SetLinearVelocity(Vector3(0.0f, RandomRange(-2.0f, 0.0f), 0.0f));
+
+			CheckManifold* m = scene.AddManifold(below, box);
+			for (int c = 0; c < 4; ++c)
+			{
+				const Vector3 corner = base + Vector3((c & 1) ? 0.5f : -0.5f, 0.0f, (c & 2) ? 0.5f : -0.5f);
+				m->AddContact(corner, corner, Vector3(0.0f, 1.0f, 0.0f), 0.0f);
+			}
+			below = box;
+		}
+	}
+	scene.SaveVelocities();
+}
+
+//Relative sliding speed at each manifold's (only) contact
+static float SlidingSpeed(const CheckManifold* m)
+{
+	const ContactPoint& c = m->GetContacts()[0];
+	PhysicsObject* a = ((CheckManifold*)m)->NodeA();
+	PhysicsObject* b = ((CheckManifold*)m)->NodeB();
+	const Vector3 dv = b->GetLinearVelocity() + Vector3::Cross(b->GetAngularVelocity(), c.relPosB)
+		- a->GetLinearVelocity() - Vector3::Cross(a->GetAngularVelocity(), c.relPosA);
+	return (dv - c.collisionNormal * Vector3::Dot(dv, c.collisionNormal)).Length();
+}
+
+bool Check_ContactSolver()
+{
+	PhysicsEngine* engine = PhysicsEngine::Instance();
+	const float oldTimestep = engine->GetUpdateTimestep();
+	engine->SetUpdateTimestep(CONTACT_CHECK_TIMESTEP);		//Manifold::SolveContactPoint takes it from the engine
+	srand(29);
+
+	//Single frictionless contacts - both must give the same answer
+	{
+		ContactScene scene;
+		BuildSingleContacts(scene, 0.0f);
+
+		//Manifold accumulates it's impulse as a negative number
+		scene.SolveManifolds(CONTACT_CHECK_ITERATIONS);
+		std::vector<Vector3> linear, angular;
+		std::vector<float> impulses;
+		for (size_t i = 0; i < scene.bodies.size(); ++i)
+		{
+			linear.push_back(scene.bodies[i]->GetLinearVelocity());
+			angular.push_back(scene.bodies[i]->GetAngularVelocity());
+			impulses.push_back(-scene.manifolds[i]->GetContacts()[0].sumImpulseContact);
+		}
+
+		CheckContactSolver solver;
+		scene.SolveBatched(solver, CONTACT_CHECK_ITERATIONS);
+		CHECK(solver.GetNumContacts() == CONTACT_CHECK_BODIES);
+
+		for (size_t i = 0; i < scene.bodies.size(); ++i)
+		{
+			PhysicsObject* box = scene.bodies[i];
+
+			float normal, tangent1, tangent2;
+			CHECK(solver.FindImpulses(&scene.ground, box, normal, tangent1, tangent2));
+			const float manifoldNormal = impulses[i];
+			CHECK(NearlyEqual(normal, manifoldNormal, manifoldNormal));
+			CHECK(normal > 0.0f && tangent1 == 0.0f && tangent2 == 0.0f);
+
+			CHECK(NearlyEqual(box->GetLinearVelocity(), linear[i], manifoldNormal));
+			CHECK(NearlyEqual(box->GetAngularVelocity(), angular[i], manifoldNormal * 6.0f));
+		}
+	}
+
+	//Single contacts with friction
+	{
+		ContactScene scene;
+		BuildSingleContacts(scene, CONTACT_CHECK_FRICTION);
+
+		float initialSliding = 0.0f, manifoldSliding = 0.0f, batchedSliding = 0.0f;
+		scene.RestoreVelocities();
+		for (const CheckManifold* m : scene.manifolds)
+			initialSliding += SlidingSpeed(m);
+
+		//The ground never moves and the boxes have a mass of 1, so the friction impulse is just the change in each box's sideways velocity
+		float manifoldFriction = 0.0f, batchedFriction = 0.0f;
+		scene.SolveManifolds(CONTACT_CHECK_ITERATIONS);
+		for (size_t i = 0; i < scene.bodies.size(); ++i)
+		{
+			manifoldSliding += SlidingSpeed(scene.manifolds[i]);
+			const Vector3 dv = scene.bodies[i]->GetLinearVelocity() - scene.linear[i];
+			manifoldFriction = max(manifoldFriction, Vector3(dv.x, 0.0f, dv.z).Length() / -scene.manifolds[i]->GetContacts()[0].sumImpulseContact);
+		}
+
+		CheckContactSolver solver;
+		scene.SolveBatched(solver, CONTACT_CHECK_ITERATIONS);
+		for (size_t i = 0; i < scene.bodies.size(); ++i)
+		{
+			batchedSliding += SlidingSpeed(scene.manifolds[i]);
+			const Vector3 dv = scene.bodies[i]->GetLinearVelocity() - scene.linear[i];
+			float normal, tangent1, tangent2;
+			CHECK(solver.FindImpulses(&scene.ground, scene.bodies[i], normal, tangent1, tangent2));
+			batchedFriction = max(batchedFriction, Vector3(dv.x, 0.0f, dv.z).Length() / normal);
+		}
+		CHECK(solver.FrictionWithinCone());
+		CHECK(batchedFriction <= CONTACT_CHECK_FRICTION * sqrtf(2.0f) * (1.0f + CONTACT_CHECK_TOLERANCE));	//Both directions at their limit
+
+		printf("    Largest friction / normal impulse (coefficient %.2f): Manifold %.3f, ContactSolver %.3f\n",
+			CONTACT_CHECK_FRICTION, manifoldFriction, batchedFriction);
+		printf("    Average sliding speed %.3f, after Manifold %.3f, after ContactSolver %.3f\n",
+			initialSliding / CONTACT_CHECK_BODIES, manifoldSliding / CONTACT_CHECK_BODIES, batchedSliding / CONTACT_CHECK_BODIES);
+		CHECK(manifoldSliding < initialSliding && batchedSliding < initialSliding);
+	}
+
+	//Stacks - contacts share bodies so are solved in a different order, but both must bring the stacks to rest
+	{
+		ContactScene scene;
+		BuildStacks(scene, 16, CONTACT_BENCH_HEIGHT);
+
+		scene.SolveManifolds(CONTACT_CHECK_CONVERGE);
+		for (PhysicsObject* body : scene.bodies)
+		{
+			CHECK(NearlyEqual(body->GetLinearVelocity(), Vector3(0.0f, 0.0f, 0.0f), 1.0f));
+			CHECK(NearlyEqual(body->GetAngularVelocity(), Vector3(0.0f, 0.0f, 0.0f), 1.0f));
+		}
+
+		CheckContactSolver solver;
+		scene.SolveBatched(solver, CONTACT_CHECK_CONVERGE);
+		for (PhysicsObject* body : scene.bodies)
+		{
+			CHECK(NearlyEqual(body->GetLinearVelocity(), Vector3(0.0f, 0.0f, 0.0f), 1.0f));
+			CHECK(NearlyEqual(body->GetAngularVelocity(), Vector3(0.0f, 0.0f, 0.0f), 1.0f));
+		}
+	}
+
+	//Timings
+	{
+		ContactScene scene;
+		BuildStacks(scene, CONTACT_BENCH_STACKS, CONTACT_BENCH_HEIGHT);
+
+		CheckContactSolver solver;
+		float manifoldMs = FLT_MAX, batchedMs = FLT_MAX;
+		for (int run = 0; run < CONTACT_BENCH_RUNS; ++run)
+		{
+			GameTimer timer;
+			scene.SolveManifolds(CONTACT_CHECK_ITERATIONS);
+			const float ms = timer.GetTimedMS();		//min is a macro, so can't be given GetTimedMS directly
+			manifoldMs = min(manifoldMs, ms);
+
+			scene.SolveBatched(solver, CONTACT_CHECK_ITERATIONS);
+			const float batchRunMs = timer.GetTimedMS();
+			batchedMs = min(batchedMs, batchRunMs);
+		}
+
+		printf("    %d manifolds, %d contacts in %d batches, %d iterations, fastest of %d runs:\n",
+			(int)scene.manifolds.size(), (int)solver.GetNumContacts(), (int)solver.GetNumBatches(), CONTACT_CHECK_ITERATIONS, CONTACT_BENCH_RUNS);
+		printf("    Manifold::ApplyImpulse:       %7.2fms\n", manifoldMs);
+		printf("    ContactSolver::ApplyImpulses: %7.2fms (%4.1fx faster)\n", batchedMs, manifoldMs / max(batchedMs, 0.001f));
+	}
+
+	engine->SetUpdateTimestep(oldTimestep);
+	return true;
+}
@@ -0,0 +1,90 @@
+#include "HeadlessChecks.h"
+#include <nclgl\Frustum.h>
+#include <nclgl\GameTimer.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cfloat>
+#include <vector>
+
+/*
+Times Frustum::InsideFrustumBatch (the SSE/AVX culling RenderList uses) against
+InsideFrustumBatchScalar on a scene of bounding spheres scattered around a
+camera, and checks they agree on every sphere. The two sum the plane distance
+in a different order, so a sphere lying exactly on a plane may round either
+way - any disagreement must be one of those.
+*/
+
+#define CULL_BENCH_SPHERES		100000
+#define CULL_BENCH_RUNS			20
+#define CULL_BENCH_EXTENT		200.0f		//Spheres are scattered within +-this of the origin
+#define CULL_BENCH_EDGE			1e-3f		//How close to a plane a sphere must be for the versions to disagree
+
+static float RandomRange(float min_val, float max_val)
+{
+	return min_val + (max_val - min_val) * (rand() / (float)RAND_MAX);
+}
+
+bool Check_FrustumCullBench()
+{
+	srand(32);
+
+	//Roughly half the spheres are in front of the camera, and a fraction of those inside the frustum
+	Frustum frustum;
+	frustum.FromMatrix(Matrix4::Perspective(1.0f, 1000.0f, 16.0f / 9.0f, 45.0f)
+		* Matrix4::BuildViewMatrix(Vector3(0.0f, 10.0f, 0.0f), Vector3(30.0f, 0.0f, -100.0f)));
+
+	std::vector<float> xs(CULL_BENCH_SPHERES), ys(CULL_BENCH_SPHERES), zs(CULL_BENCH_SPHERES), radii(CULL_BENCH_SPHERES);
+	for (int i = 0; i < CULL_BENCH_SPHERES; ++i)
+	{
+		xs[i]		= RandomRange(-CULL_BENCH_EXTENT, CULL_BENCH_EXTENT);
+		ys[i]		= RandomRange(-CULL_BENCH_EXTENT, CULL_BENCH_EXTENT);
+		zs[i]		= RandomRange(-CULL_BENCH_EXTENT, CULL_BENCH_EXTENT);
+		radii[i]	= RandomRange(0.1f, 5.0f);
+	}
+
+	const int numWords = (CULL_BENCH_SPHERES + 31) / 32;
+	std::vector<uint> scalar(numWords), batch(numWords);
+
+	float scalarMs = FLT_MAX, batchMs = FLT_MAX;
+	for (int run = 0; run < CULL_BENCH_RUNS; ++run)
+	{
+		GameTimer timer;
+		frustum.InsideFrustumBatchScalar(&xs[0], &ys[0], &zs[0], &radii[0], CULL_BENCH_SPHERES, &scalar[0]);
+		const float ms = timer.GetTimedMS();		//min is a macro, so can't be given GetTimedMS directly
+		scalarMs = min(scalarMs, ms);
+
+		frustum.InsideFrustumBatch(&xs[0], &ys[0], &zs[0], &radii[0], CULL_BENCH_SPHERES, &batch[0]);
+		const float simdMs = timer.GetTimedMS();
+		batchMs = min(batchMs, simdMs);
+	}
+
+	int numVisible = 0, numDiffering = 0;
+	for (int i = 0; i < CULL_BENCH_SPHERES; ++i)
+	{
+		const bool inScalar	= (scalar[i / 32] & (1u << (i % 32))) != 0;
+		const bool inBatch	= (batch[i / 32] & (1u << (i % 32))) != 0;
+		numVisible += inScalar ? 1 : 0;
+
+		if (inScalar != inBatch)
+		{
+			++numDiffering;
+
+			float closest = FLT_MAX;
+			for (int p = 0; p < 6; ++p)
+			{
+				const Plane& plane = frustum.GetPlane(p);
+				const float d = Vector3::Dot(Vector3(xs[i], ys[i], zs[i]), plane.GetNormal()) + plane.GetDistance() + radii[i];
+				closest = min(closest, (float)fabs(d));
+			}
+			CHECK(closest < CULL_BENCH_EDGE);
+		}
+	}
+
+	printf("    %d spheres, %d inside the frustum, fastest of %d runs:\n", CULL_BENCH_SPHERES, numVisible, CULL_BENCH_RUNS);
+	printf("    InsideFrustumBatchScalar: %6.3fms\n", scalarMs);
+	printf("    InsideFrustumBatch:       %6.3fms (%4.1fx faster)\n", batchMs, scalarMs / max(batchMs, 0.001f));
+	printf("    %d spheres on a plane culled differently\n", numDiffering);
+
+	CHECK(numVisible > 0 && numVisible < CULL_BENCH_SPHERES);
+	return true;
+}
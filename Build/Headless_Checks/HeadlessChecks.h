@@ -0,0 +1,45 @@
+#pragma once
+
+/*
+Checks and benchmarks of the engine's CPU code that don't need a window or an
+OpenGL context, so they can be run on any machine (e.g. a build server) from
+the MyGame_Output directory:-
+
+	Headless_Checks.exe				- Runs every check
+	Headless_Checks.exe <name>...	- Runs only the named checks
+
+Each check prints what it measured, and returns false if anything it checked
+didn't match what was expected. The program returns the number of checks
+that failed.
+*/
+
+#include <cstdio>
+
+typedef bool(*HeadlessCheckFunc)();
+
+struct HeadlessCheck
+{
+	const char*			name;
+	const char*			description;
+	HeadlessCheckFunc	func;
+};
+
+//Prints a failure (with the file and line it came from) and returns false from the check if 'condition' isn't true
+#define CHECK(condition) \
+	if (!(condition)) { printf("    FAILED: %s (%s:%d)\n", #condition, __FILE__, __LINE__); return false; }
+
+//Compares two decodes of the same OBJ file, e.g. parsed and read back from the cache
+class OBJDecodedMesh;
+bool SameOBJ(const OBJDecodedMesh& a, const OBJDecodedMesh& b);
+
+bool Check_AssetDecode();
+bool Check_OBJLoadBench();
+bool Check_MeshProcessing();
+bool Check_MD5Skinning();
+bool Check_MD5AnimCompression();
+bool Check_FrustumCullBench();
+bool Check_BVHCull();
+bool Check_ContactSolver();
+bool Check_InstanceBatch();
+bool Check_RenderQueue();
+bool Check_TextureCache();
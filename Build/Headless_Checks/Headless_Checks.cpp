@@ -0,0 +1,46 @@
+#include "HeadlessChecks.h"
+#include <nclgl\GameTimer.h>
+#include <cstring>
+
+static const HeadlessCheck g_Checks[] = {
+	{ "asset_decode",	"Decodes OBJ/MD5/texture assets on worker threads, as AssetManager does",	Check_AssetDecode },
+	{ "obj_load",		"Times parsing a large OBJ against reading it back from the binary cache",	Check_OBJLoadBench },
+	{ "mesh_processing",	"Compares normal generation against the original version, and reports ACMR",	Check_MeshProcessing },
+	{ "md5_skinning",	"Compares the SIMD MD5 software skinning against the reference version",	Check_MD5Skinning },
+	{ "md5_anim",		"Checks MD5Anim keyframe compression stays within its tolerances",			Check_MD5AnimCompression },
+	{ "frustum_cull",	"Times SIMD frustum culling against the scalar version, and compares them",	Check_FrustumCullBench },
+	{ "bvh_cull",		"Compares SceneBVH culling against testing every object, and times both",		Check_BVHCull },
+	{ "contact_solver",	"Compares the batched ContactSolver against solving each Manifold, and times both",	Check_ContactSolver },
+	{ "instance_batch",	"Checks InstanceBatcher's grouping, small batch fallback and capacity limit",	Check_InstanceBatch },
+	{ "render_queue",	"Checks RenderQueue's sort order and times it, counting state changes",		Check_RenderQueue },
+	{ "texture_cache",	"Checks texture mip chains, and that stale or broken texture caches are rebaked",	Check_TextureCache },
+};
+
+static const int g_NumChecks = sizeof(g_Checks) / sizeof(g_Checks[0]);
+
+int main(int argc, char** argv)
+{
+	int numRun = 0, numFailed = 0;
+	for (int i = 0; i < g_NumChecks; ++i)
+	{
+		bool selected = (argc <= 1);
+		for (int j = 1; j < argc; ++j)
+			selected |= (strcmp(argv[j], g_Checks[i].name) == 0);
+
+		if (!selected)
+			continue;
+
+		printf("%s - %s\n", g_Checks[i].name, g_Checks[i].description);
+
+		GameTimer timer;
+		const bool passed = g_Checks[i].func();
+		printf("  %s (%5.2fms)\n\n", passed ? "Passed" : "FAILED", timer.GetMS());
+
+		++numRun;
+		if (!passed)
+			++numFailed;
+	}
+
+	printf("%d of %d checks passed\n", numRun - numFailed, numRun);
+	return numFailed;
+}
@@ -0,0 +1,188 @@
+#include "HeadlessChecks.h"
+#include <ncltech\InstanceBatcher.h>
+#include <nclgl\GameTimer.h>
+#include <cstdio>
+#include <cfloat>
+#include <vector>
+
+/*
+Checks InstanceBatcher::Build on a hand made (already sorted) command list:
+runs of the same mesh/texture become batches, runs with fewer than
+INSTANCE_MIN_BATCH_SIZE instanceable objects (and objects that render
+themselves) are drawn on their own, and no more than 'max_instances' are ever
+packed. Also times packing a large queue.
+
+The batcher only compares mesh pointers, so the meshes here are just distinct
+addresses and are never dereferenced (creating a real Mesh needs OpenGL).
+*/
+
+#define BATCH_BENCH_OBJECTS		100000
+#define BATCH_BENCH_RUN			50			//Objects sharing each mesh in the benchmark queue
+#define BATCH_BENCH_RUNS		20
+
+static char g_FakeMeshes[4];
+
+class BatchCheckObject : public Object
+{
+public:
+	BatchCheckObject(uint mesh, uint texture, bool instancing, int idx)
+		: m_Mesh((Mesh*)&g_FakeMeshes[mesh]), m_Texture(texture), m_Instancing(instancing)
+	{
+		m_WorldTransform = Matrix4::Translation(Vector3((float)idx, 0.0f, 0.0f));
+		m_Colour = Vector4(1.0f, 1.0f, 1.0f, (float)idx);
+	}
+
+protected:
+	Mesh*	GetRenderMesh() override		{ return m_Mesh; }
+	uint	GetRenderTexture() override		{ return m_Texture; }
+	bool	SupportsInstancing() override	{ return m_Instancing; }
+
+	Mesh*	m_Mesh;
+	uint	m_Texture;
+	bool	m_Instancing;
+};
+
+//Appends 'count' commands using the given mesh/texture, every object supporting instancing except the last 'num_custom'
+static void AddRun(std::vector<RenderCommand>& commands, std::vector<Object*>& objects, uint mesh, uint texture, int count, int num_custom)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		Object* obj = new BatchCheckObject(mesh, texture, i < count - num_custom, (int)objects.size());
+		objects.push_back(obj);
+
+		RenderCommand cmd;
+		cmd.key = objects.size();
+		cmd.obj = obj;
+		cmd.meshID = (uint16_t)mesh;
+		cmd.textureID = (uint16_t)texture;
+		commands.push_back(cmd);
+	}
+}
+
+static bool SameInstance(const InstanceData& inst, const Object* obj)
+{
+	const float idx = ((BatchCheckObject*)obj)->GetColour().w;
+	return inst.colour.w == idx && inst.modelMatrix.GetPositionVector().x == idx;
+}
+
+static bool CheckBatches(const std::vector<RenderCommand>& commands, uint max_instances)
+{
+	InstanceBatcher batcher;
+	std::vector<InstanceData> instances(max_instances + 1);
+	instances[max_instances].colour = Vector4(-1.0f, -1.0f, -1.0f, -1.0f);	//Guard, must never be written
+
+	const uint numPacked = batcher.Build(commands, &instances[0], max_instances);
+	const std::vector<InstanceBatch>& batches = batcher.GetBatches();
+	const std::vector<Object*>& singles = batcher.GetSingleObjects();
+
+	CHECK(numPacked <= max_instances);
+	CHECK(instances[max_instances].colour.w == -1.0f);
+
+	//Every object is drawn exactly once, either instanced or on it's own
+	uint numInBatches = 0;
+	for (const InstanceBatch& batch : batches)
+	{
+		CHECK(batch.firstInstance == numInBatches);
+		CHECK(batch.numInstances >= INSTANCE_MIN_BATCH_SIZE);
+		numInBatches += batch.numInstances;
+	}
+	CHECK(numInBatches == numPacked);
+	CHECK(numPacked + singles.size() == commands.size());
+
+	//Batches follow the command order, and only contain instanceable objects of the same mesh/texture
+	size_t cmd = 0;
+	for (const InstanceBatch& batch : batches)
+	{
+		for (uint i = 0; i < batch.numInstances; ++i)
+		{
+			while (cmd < commands.size() && !SameInstance(instances[batch.firstInstance + i], commands[cmd].obj))
+				++cmd;
+			CHECK(cmd < commands.size());
+
+			CHECK(batch.mesh == (Mesh*)&g_FakeMeshes[commands[cmd].meshID] && batch.texture == commands[cmd].textureID);
+		}
+	}
+	return true;
+}
+
+bool Check_InstanceBatch()
+{
+	std::vector<RenderCommand> commands;
+	std::vector<Object*> objects;
+
+	//Mesh 0: a batch of 10
+	//Mesh 1 (texture 0): only 3 copies, not worth instancing
+	//Mesh 1 (texture 1): 6 copies, 2 of which render themselves, leaving a batch of 4
+	//Mesh 2: 5 copies that all render themselves
+	AddRun(commands, objects, 0, 0, 10, 0);
+	AddRun(commands, objects, 1, 0, 3, 0);
+	AddRun(commands, objects, 1, 1, 6, 2);
+	AddRun(commands, objects, 2, 0, 5, 5);
+
+	{
+		InstanceBatcher batcher;
+		std::vector<InstanceData> instances(commands.size());
+		const uint numPacked = batcher.Build(commands, &instances[0], (uint)instances.size());
+		const std::vector<InstanceBatch>& batches = batcher.GetBatches();
+
+		CHECK(numPacked == 14);
+		CHECK(batches.size() == 2);
+		CHECK(batches[0].mesh == (Mesh*)&g_FakeMeshes[0] && batches[0].firstInstance == 0 && batches[0].numInstances == 10);
+		CHECK(batches[1].mesh == (Mesh*)&g_FakeMeshes[1] && batches[1].texture == 1);
+		CHECK(batches[1].firstInstance == 10 && batches[1].numInstances == 4);
+		CHECK(batcher.GetSingleObjects().size() == 3 + 2 + 5);
+		for (uint i = 0; i < numPacked; ++i)
+		{
+			//The first 10 objects, then objects 13-16 (the instanceable part of the third run)
+			CHECK(SameInstance(instances[i], objects[(i < 10) ? i : i + 3]));
+		}
+	}
+
+	//Clamped part way through each run - anything that no longer fits is drawn on it's own,
+	// and a run cut below INSTANCE_MIN_BATCH_SIZE hands it's instances back
+	for (uint max_instances = 1; max_instances <= commands.size(); ++max_instances)
+	{
+		if (!CheckBatches(commands, max_instances))
+		{
+			printf("    (with max_instances = %u)\n", max_instances);
+			return false;
+		}
+	}
+	{
+		InstanceBatcher batcher;
+		std::vector<InstanceData> instances(12);
+		CHECK(batcher.Build(commands, &instances[0], 12) == 10);
+		CHECK(batcher.GetBatches().size() == 1 && batcher.GetSingleObjects().size() == commands.size() - 10);
+	}
+
+	for (Object* obj : objects)
+		delete obj;
+	commands.clear();
+	objects.clear();
+
+	//Benchmark - a large queue of small batches, as a scene of many props would produce
+	for (int i = 0; i < BATCH_BENCH_OBJECTS / BATCH_BENCH_RUN; ++i)
+	{
+		AddRun(commands, objects, i % 3, i, BATCH_BENCH_RUN, i % 2);
+	}
+
+	InstanceBatcher batcher;
+	std::vector<InstanceData> instances(commands.size());
+	float bestMs = FLT_MAX;
+	uint numPacked = 0;
+	for (int run = 0; run < BATCH_BENCH_RUNS; ++run)
+	{
+		GameTimer timer;
+		numPacked = batcher.Build(commands, &instances[0], (uint)instances.size());
+		const float ms = timer.GetTimedMS();
+		bestMs = min(bestMs, ms);
+	}
+
+	printf("    %d commands packed into %d batches (%u instances, %d drawn alone) in %.3fms (fastest of %d runs)\n",
+		(int)commands.size(), (int)batcher.GetBatches().size(), numPacked, (int)batcher.GetSingleObjects().size(), bestMs, BATCH_BENCH_RUNS);
+	CHECK(batcher.GetBatches().size() == commands.size() / BATCH_BENCH_RUN);
+
+	for (Object* obj : objects)
+		delete obj;
+	return true;
+}
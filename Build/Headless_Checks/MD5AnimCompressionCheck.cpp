@@ -0,0 +1,181 @@
+#include "HeadlessChecks.h"
+#include <nclgl\MD5Anim.h>
+#include <nclgl\MD5FileData.h>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+/*
+Checks MD5Anim's keyframe compression. A text MD5Anim is generated, with joints
+that move and turn by different amounts (and some that are flagged as animated
+but never actually change), then loaded in, which compresses it and writes the
+binary version, and loaded again from the binary. Every frame sampled from
+either must be within MD5_ANIM_POSITION_TOLERANCE/MD5_ANIM_ORIENTATION_TOLERANCE
+of the values in the text file. Also prints how much smaller the compressed
+keyframes are than the text file's floats.
+*/
+
+#define ANIM_CHECK_FILE			"md5_anim_check.md5anim"
+#define ANIM_CHECK_JOINTS		48
+#define ANIM_CHECK_FRAMES		240
+#define ANIM_CHECK_SLACK		1e-5f		//Allowance for float rounding on top of the tolerances
+
+static float RandomRange(float min_val, float max_val)
+{
+	return min_val + (max_val - min_val) * (rand() / (float)RAND_MAX);
+}
+
+//The value a float will have once it's been written to the file and read back in
+static float Printed(FILE* f, float value)
+{
+	char buffer[32];
+	sprintf(buffer, "%f", value);
+	fprintf(f, " %s", buffer);
+	return (float)atof(buffer);
+}
+
+//Writes the animation, keeping the (as read back) position and orientation x/y/z of every joint in every frame
+static bool WriteCheckAnim(const char* filename, std::vector<float>& out_values)
+{
+	FILE* f = fopen(filename, "wb");
+	if (!f)
+		return false;
+
+	//Every 4th joint only turns, and every 4th (offset by one) has positions flagged that never change
+	int flags[ANIM_CHECK_JOINTS], frameIndex[ANIM_CHECK_JOINTS], numComponents = 0;
+	for (int i = 0; i < ANIM_CHECK_JOINTS; ++i)
+	{
+		flags[i]		= (i % 4 == 3) ? (MD5_ANIM_XQUAT | MD5_ANIM_YQUAT | MD5_ANIM_ZQUAT) : 63;
+		frameIndex[i]	= numComponents;
+		numComponents	+= (flags[i] == 63) ? 6 : 3;
+	}
+
+	fprintf(f, "MD5Version 10\ncommandline \"\"\n\nnumFrames %d\nnumJoints %d\nframeRate 24\nnumAnimatedComponents %d\n\nhierarchy {\n",
+		ANIM_CHECK_FRAMES, ANIM_CHECK_JOINTS, numComponents);
+	for (int i = 0; i < ANIM_CHECK_JOINTS; ++i)
+	{
+		fprintf(f, "\t\"joint%d\" %d %d %d\n", i, (i == 0) ? -1 : rand() % i, flags[i], frameIndex[i]);
+	}
+
+	fprintf(f, "}\n\nbounds {\n");
+	for (int i = 0; i < ANIM_CHECK_FRAMES; ++i)
+	{
+		fprintf(f, "\t( -50 -50 -50 ) ( 50 50 50 )\n");
+	}
+
+	//Each component is a sine wave, the root travels a long way, other joints only a little
+	float base[ANIM_CHECK_JOINTS][6], amplitude[ANIM_CHECK_JOINTS][6], phase[ANIM_CHECK_JOINTS][6];
+	fprintf(f, "}\n\nbaseframe {\n");
+	for (int i = 0; i < ANIM_CHECK_JOINTS; ++i)
+	{
+		const float travel = (i == 0) ? 40.0f : ((i % 4 == 1) ? 0.0f : RandomRange(0.01f, 1.0f));
+		for (int c = 0; c < 6; ++c)
+		{
+			amplitude[i][c]	= (c < 3) ? travel : RandomRange(0.01f, 0.5f);
+			phase[i][c]		= RandomRange(0.0f, 6.28f);
+		}
+
+		fprintf(f, "\t(");
+		for (int c = 0; c < 6; ++c)
+		{
+			base[i][c] = Printed(f, (c < 3) ? RandomRange(-10.0f, 10.0f) : 0.0f);
+			if (c == 2)
+				fprintf(f, " ) (");
+		}
+		fprintf(f, " )\n");
+	}
+	fprintf(f, "}\n\n");
+
+	out_values.resize(ANIM_CHECK_FRAMES * ANIM_CHECK_JOINTS * 6);
+	for (int frame = 0; frame < ANIM_CHECK_FRAMES; ++frame)
+	{
+		const float t = frame * 6.28f / ANIM_CHECK_FRAMES;
+
+		fprintf(f, "frame %d {\n", frame);
+		for (int i = 0; i < ANIM_CHECK_JOINTS; ++i)
+		{
+			fprintf(f, "\t");
+			for (int c = 0; c < 6; ++c)
+			{
+				float& value = out_values[(frame * ANIM_CHECK_JOINTS + i) * 6 + c];
+				value = base[i][c];
+				if (flags[i] & (1 << c))
+					value = Printed(f, value + amplitude[i][c] * sinf(t * (1 + c) + phase[i][c]));
+			}
+			fprintf(f, "\n");
+		}
+		fprintf(f, "}\n\n");
+	}
+
+	return fclose(f) == 0;
+}
+
+//Samples every frame of the animation, and finds the largest error in any position or orientation component
+static void MeasureErrors(const MD5Anim& anim, const std::vector<float>& values, float& out_position, float& out_orientation)
+{
+	out_position	= 0.0f;
+	out_orientation = 0.0f;
+
+	std::vector<MD5JointPose> pose(anim.GetNumJoints());
+	for (unsigned int frame = 0; frame < anim.GetNumFrames(); ++frame)
+	{
+		anim.SamplePose((float)frame, &pose[0]);
+		for (unsigned int i = 0; i < anim.GetNumJoints(); ++i)
+		{
+			const float* v = &values[(frame * ANIM_CHECK_JOINTS + i) * 6];
+
+			Quaternion expected(v[3], v[4], v[5], 0.0f);
+			expected.GenerateW();
+			expected.Normalise();
+
+			const Vector3		dp = pose[i].position - Vector3(v[0], v[1], v[2]);
+			const Quaternion&	q  = pose[i].orientation;
+			out_position	= max(out_position, max(fabs(dp.x), max(fabs(dp.y), fabs(dp.z))));
+			out_orientation	= max(out_orientation, max(fabs(q.x - expected.x), max(fabs(q.y - expected.y), fabs(q.z - expected.z))));
+		}
+	}
+}
+
+bool Check_MD5AnimCompression()
+{
+	srand(44);
+	std::vector<float> values;
+	CHECK(WriteCheckAnim(ANIM_CHECK_FILE, values));
+
+	//The first load compresses the text file and compiles it, the second reads the compiled file
+	remove(ANIM_CHECK_FILE MD5_BINARY_EXTENSION);
+	MD5Anim* parsed		= new MD5Anim(ANIM_CHECK_FILE);
+	MD5Anim* compiled	= new MD5Anim(ANIM_CHECK_FILE);
+	remove(ANIM_CHECK_FILE);
+	remove(ANIM_CHECK_FILE MD5_BINARY_EXTENSION);
+
+	CHECK(parsed->GetNumFrames() == ANIM_CHECK_FRAMES && parsed->GetNumJoints() == ANIM_CHECK_JOINTS);
+	CHECK(compiled->GetNumFrames() == ANIM_CHECK_FRAMES && compiled->GetNumJoints() == ANIM_CHECK_JOINTS);
+	CHECK(compiled->GetKeyframeMemory() == parsed->GetKeyframeMemory());
+
+	float parsedPosition, parsedOrientation, compiledPosition, compiledOrientation;
+	MeasureErrors(*parsed, values, parsedPosition, parsedOrientation);
+	MeasureErrors(*compiled, values, compiledPosition, compiledOrientation);
+
+	//What the frames took as floats, as the text file stores them, along with the base frame
+	int numComponents = 0;
+	for (int i = 0; i < ANIM_CHECK_JOINTS; ++i)
+		numComponents += (i % 4 == 3) ? 3 : 6;
+	const size_t uncompressed	= (numComponents * ANIM_CHECK_FRAMES + ANIM_CHECK_JOINTS * 6) * sizeof(float);
+	const size_t compressed		= parsed->GetKeyframeMemory();
+
+	printf("    %d joints, %d frames\n", ANIM_CHECK_JOINTS, ANIM_CHECK_FRAMES);
+	printf("    Keyframes: %.1fKB as floats, %.1fKB compressed (%.1fx smaller)\n",
+		uncompressed / 1024.0f, compressed / 1024.0f, uncompressed / (float)compressed);
+	printf("    Largest position error %g (tolerance %g), orientation error %g (tolerance %g)\n",
+		max(parsedPosition, compiledPosition), MD5_ANIM_POSITION_TOLERANCE,
+		max(parsedOrientation, compiledOrientation), MD5_ANIM_ORIENTATION_TOLERANCE);
+
+	delete parsed;
+	delete compiled;
+
+	CHECK(parsedPosition == compiledPosition && parsedOrientation == compiledOrientation);
+	CHECK(parsedPosition <= MD5_ANIM_POSITION_TOLERANCE + ANIM_CHECK_SLACK);
+	CHECK(parsedOrientation <= MD5_ANIM_ORIENTATION_TOLERANCE + ANIM_CHECK_SLACK);
+	return true;
+}
@@ -0,0 +1,152 @@
+#include "HeadlessChecks.h"
+#include <nclgl\MD5Mesh.h>
+#include <nclgl\GameTimer.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cfloat>
+
+/*
+Checks MD5Mesh::SkinSubMesh (the SIMD, multithreaded skinning used when
+MD5_USE_HARDWARE_SKINNING is turned off) against SkinSubMeshReference, the
+original one weight at a time version. The mesh is generated: a random joint
+hierarchy, and submeshes whose vertices each have 1-4 weights summing to one.
+Both versions skin it into the same random pose, and every vertex must match.
+*/
+
+#define MD5_CHECK_FILE			"md5_skinning_check.md5mesh"
+#define MD5_CHECK_JOINTS		64
+#define MD5_CHECK_SUBMESHES		3
+#define MD5_CHECK_VERTICES		20000		//Per submesh
+#define MD5_CHECK_RUNS			10
+#define MD5_CHECK_TOLERANCE		1e-4f		//Relative to the size of the mesh
+
+static float RandomRange(float min_val, float max_val)
+{
+	return min_val + (max_val - min_val) * (rand() / (float)RAND_MAX);
+}
+
+static bool WriteCheckMD5(const char* filename)
+{
+	FILE* f = fopen(filename, "wb");
+	if (!f)
+		return false;
+
+	fprintf(f, "MD5Version 10\ncommandline \"\"\n\nnumJoints %d\nnumMeshes %d\n\njoints {\n", MD5_CHECK_JOINTS, MD5_CHECK_SUBMESHES);
+	for (int i = 0; i < MD5_CHECK_JOINTS; ++i)
+	{
+		//Every joint's parent comes before it, as in a real skeleton
+		const int parent = (i == 0) ? -1 : rand() % i;
+		Quaternion q(RandomRange(-1.0f, 1.0f), RandomRange(-1.0f, 1.0f), RandomRange(-1.0f, 1.0f), RandomRange(0.1f, 1.0f));
+		q.Normalise();
+		fprintf(f, "\t\"joint%d\" %d ( %f %f %f ) ( %f %f %f )\n", i, parent,
+			RandomRange(-10.0f, 10.0f), RandomRange(-10.0f, 10.0f), RandomRange(-10.0f, 10.0f), q.x, q.y, q.z);
+	}
+	fprintf(f, "}\n\n");
+
+	for (int m = 0; m < MD5_CHECK_SUBMESHES; ++m)
+	{
+		std::vector<int> numWeights(MD5_CHECK_VERTICES);
+		int totalWeights = 0;
+		for (int v = 0; v < MD5_CHECK_VERTICES; ++v)
+		{
+			numWeights[v] = 1 + rand() % 4;
+			totalWeights += numWeights[v];
+		}
+
+		fprintf(f, "mesh {\n\tnumverts %d\n", MD5_CHECK_VERTICES);
+		for (int v = 0, w = 0; v < MD5_CHECK_VERTICES; w += numWeights[v], ++v)
+		{
+			fprintf(f, "\tvert %d ( %f %f ) %d %d\n", v, RandomRange(0.0f, 1.0f), RandomRange(0.0f, 1.0f), w, numWeights[v]);
+		}
+
+		fprintf(f, "\tnumtris %d\n", MD5_CHECK_VERTICES - 2);
+		for (int t = 0; t < MD5_CHECK_VERTICES - 2; ++t)
+		{
+			fprintf(f, "\ttri %d %d %d %d\n", t, t, t + 1, t + 2);
+		}
+
+		fprintf(f, "\tnumweights %d\n", totalWeights);
+		for (int v = 0, w = 0; v < MD5_CHECK_VERTICES; ++v)
+		{
+			float remaining = 1.0f;
+			for (int k = 0; k < numWeights[v]; ++k, ++w)
+			{
+				const float bias = (k == numWeights[v] - 1) ? remaining : RandomRange(0.0f, remaining);
+				remaining -= bias;
+				fprintf(f, "\tweight %d %d %f ( %f %f %f )\n", w, rand() % MD5_CHECK_JOINTS, bias,
+					RandomRange(-5.0f, 5.0f), RandomRange(-5.0f, 5.0f), RandomRange(-5.0f, 5.0f));
+			}
+		}
+		fprintf(f, "}\n\n");
+	}
+
+	return fclose(f) == 0;
+}
+
+bool Check_MD5Skinning()
+{
+	srand(43);
+	CHECK(WriteCheckMD5(MD5_CHECK_FILE));
+
+	MD5FileData* data = MD5FileData::Decode(MD5_CHECK_FILE);
+	remove(MD5_CHECK_FILE);
+	remove(MD5_CHECK_FILE MD5_BINARY_EXTENSION);
+	CHECK(data != NULL);
+	CHECK(data->GetNumSubMeshes() == MD5_CHECK_SUBMESHES);
+
+	//Move every joint away from the bind pose, building the world transforms down the hierarchy as MD5Anim does
+	MD5Skeleton pose;
+	data->CloneSkeleton(pose);
+	for (int i = 0; i < pose.numJoints; ++i)
+	{
+		MD5Joint& joint = pose.joints[i];
+		Quaternion q(RandomRange(-1.0f, 1.0f), RandomRange(-1.0f, 1.0f), RandomRange(-1.0f, 1.0f), RandomRange(-1.0f, 1.0f));
+		q.Normalise();
+		const Matrix4 local = Matrix4::Translation(Vector3(RandomRange(-2.0f, 2.0f), RandomRange(-2.0f, 2.0f), RandomRange(-2.0f, 2.0f))) * q.ToMatrix4();
+		joint.transform = (joint.parent < 0) ? local : pose.joints[joint.parent].transform * local;
+	}
+
+	std::vector<Matrix4> jointTransforms(pose.numJoints);
+	for (int i = 0; i < pose.numJoints; ++i)
+	{
+		jointTransforms[i] = pose.joints[i].transform;
+	}
+
+	float referenceMs = FLT_MAX, skinMs = FLT_MAX, maxError = 0.0f, maxExtent = 0.0f;
+	std::vector<Vector3> reference(MD5_CHECK_VERTICES), skinned(MD5_CHECK_VERTICES);
+	for (unsigned int m = 0; m < data->GetNumSubMeshes(); ++m)
+	{
+		const MD5SubMesh& subMesh = data->GetSubMesh(m);
+		CHECK(subMesh.numverts == MD5_CHECK_VERTICES);
+
+		for (int run = 0; run < MD5_CHECK_RUNS; ++run)
+		{
+			GameTimer timer;
+			MD5Mesh::SkinSubMeshReference(subMesh, pose, &reference[0]);
+			const float ms = timer.GetTimedMS();		//min is a macro, so can't be given GetTimedMS directly
+			referenceMs = min(referenceMs, ms);
+
+			MD5Mesh::SkinSubMesh(subMesh, &jointTransforms[0], &skinned[0]);
+			const float simdMs = timer.GetTimedMS();
+			skinMs = min(skinMs, simdMs);
+		}
+
+		for (int v = 0; v < subMesh.numverts; ++v)
+		{
+			const Vector3 diff = skinned[v] - reference[v];
+			maxError	= max(maxError, max(fabs(diff.x), max(fabs(diff.y), fabs(diff.z))));
+			maxExtent	= max(maxExtent, max(fabs(reference[v].x), max(fabs(reference[v].y), fabs(reference[v].z))));
+		}
+	}
+
+	delete data;
+
+	printf("    %d submeshes of %d vertices, fastest of %d runs per submesh:\n", MD5_CHECK_SUBMESHES, MD5_CHECK_VERTICES, MD5_CHECK_RUNS);
+	printf("    SkinSubMeshReference: %6.3fms\n", referenceMs);
+	printf("    SkinSubMesh:          %6.3fms (%4.1fx faster)\n", skinMs, referenceMs / max(skinMs, 0.001f));
+	printf("    Largest difference %g, in a mesh %g across\n", maxError, maxExtent * 2.0f);
+
+	CHECK(maxExtent > 0.0f);
+	CHECK(maxError <= maxExtent * MD5_CHECK_TOLERANCE);
+	return true;
+}
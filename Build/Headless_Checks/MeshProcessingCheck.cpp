@@ -0,0 +1,207 @@
+#include "HeadlessChecks.h"
+#include <nclgl\MeshProcessing.h>
+#include <nclgl\common.h>
+#include <nclgl\GameTimer.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cfloat>
+#include <vector>
+
+/*
+Checks MeshProcessing's normal/tangent generation (each vertex gathering it's
+faces from a MeshAdjacency) gives exactly the same results as the original
+version in Mesh, which added each face onto it's three vertices in turn, and
+times the two. Then shuffles the triangles and vertices, as an exporter that
+doesn't care about vertex caches might, and reports the ACMR (see
+MeshProcessing::CalculateACMR) before and after OptimiseVertexCache, checking
+the triangles themselves are left untouched.
+
+The mesh is a bumpy torus, generated each run so that the results are
+repeatable on any machine.
+*/
+
+#define MESH_CHECK_SEGMENTS		700			//700x700 quads = 490k vertices, 980k triangles
+#define MESH_CHECK_RUNS			10
+
+static float RandomRange(float min_val, float max_val)
+{
+	return min_val + (max_val - min_val) * (rand() / (float)RAND_MAX);
+}
+
+//Fisher-Yates, with enough random bits for large arrays (RAND_MAX may be as small as 32767)
+static void Shuffle(std::vector<unsigned int>& values)
+{
+	for (size_t i = values.size() - 1; i > 0; --i)
+	{
+		const size_t j = (((size_t)rand() << 15) ^ (size_t)rand()) % (i + 1);
+		std::swap(values[i], values[j]);
+	}
+}
+
+//Fills in a (segments x segments) grid wrapped around a torus, with two triangles per quad
+static void BuildTorus(int segments, std::vector<Vector3>& vertices, std::vector<Vector2>& texCoords, std::vector<unsigned int>& indices)
+{
+	for (int y = 0; y < segments; ++y)
+	{
+		const float theta = 2.0f * PI * y / segments;
+		for (int x = 0; x < segments; ++x)
+		{
+			const float phi = 2.0f * PI * x / segments;
+			const float r = 0.3f + RandomRange(-0.02f, 0.02f);
+			vertices.push_back(Vector3((1.0f + r * cosf(theta)) * cosf(phi), r * sinf(theta), (1.0f + r * cosf(theta)) * sinf(phi)));
+			texCoords.push_back(Vector2((float)x / segments, (float)y / segments));
+		}
+	}
+
+	for (int y = 0; y < segments; ++y)
+	{
+		for (int x = 0; x < segments; ++x)
+		{
+			const unsigned int a = y * segments + x;
+			const unsigned int b = y * segments + (x + 1) % segments;
+			const unsigned int c = ((y + 1) % segments) * segments + x;
+			const unsigned int d = ((y + 1) % segments) * segments + (x + 1) % segments;
+			indices.push_back(a); indices.push_back(c); indices.push_back(b);
+			indices.push_back(b); indices.push_back(c); indices.push_back(d);
+		}
+	}
+}
+
+//The original Mesh::GenerateNormals/GenerateTangents, adding each face onto it's vertices in index order
+static void ScatterNormals(const std::vector<Vector3>& vertices, const std::vector<unsigned int>& indices, std::vector<Vector3>& normals)
+{
+	normals.assign(vertices.size(), Vector3());
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		const unsigned int a = indices[i], b = indices[i + 1], c = indices[i + 2];
+		const Vector3 normal = Vector3::Cross(vertices[b] - vertices[a], vertices[c] - vertices[a]);
+		normals[a] += normal;
+		normals[b] += normal;
+		normals[c] += normal;
+	}
+	for (Vector3& normal : normals)
+		normal.Normalise();
+}
+
+static void ScatterTangents(const std::vector<Vector3>& vertices, const std::vector<Vector2>& texCoords, const std::vector<unsigned int>& indices, std::vector<Vector3>& tangents)
+{
+	tangents.assign(vertices.size(), Vector3());
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		const unsigned int a = indices[i], b = indices[i + 1], c = indices[i + 2];
+		const Vector3 tangent = MeshProcessing::FaceTangent(vertices[a], vertices[b], vertices[c], texCoords[a], texCoords[b], texCoords[c]);
+		tangents[a] += tangent;
+		tangents[b] += tangent;
+		tangents[c] += tangent;
+	}
+	for (Vector3& tangent : tangents)
+		tangent.Normalise();
+}
+
+static bool SameVectors(const std::vector<Vector3>& a, const std::vector<Vector3>& b)
+{
+	return a.size() == b.size() && memcmp(&a[0], &b[0], a.size() * sizeof(Vector3)) == 0;
+}
+
+//Each triangle, rotated so it starts with it's smallest index (keeping the winding), in sorted order
+static std::vector<unsigned long long> SortedTriangles(const std::vector<unsigned int>& indices)
+{
+	std::vector<unsigned long long> tris;
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		unsigned int t[3] = { indices[i], indices[i + 1], indices[i + 2] };
+		while (t[0] > t[1] || t[0] > t[2])
+			std::rotate(t, t + 1, t + 3);
+		tris.push_back(((unsigned long long)t[0] << 42) | ((unsigned long long)t[1] << 21) | t[2]);
+	}
+	std::sort(tris.begin(), tris.end());
+	return tris;
+}
+
+bool Check_MeshProcessing()
+{
+	std::vector<Vector3> vertices;
+	std::vector<Vector2> texCoords;
+	std::vector<unsigned int> indices;
+	srand(46);
+	BuildTorus(MESH_CHECK_SEGMENTS, vertices, texCoords, indices);
+	const unsigned int numVertices = (unsigned int)vertices.size();
+	const unsigned int numIndices = (unsigned int)indices.size();
+
+	//Normals and tangents, timed with the adjacency already built (as MD5Mesh regenerates them every frame)
+	MeshAdjacency adjacency;
+	std::vector<Vector3> scatter(numVertices), gather(numVertices);
+	std::vector<Vector3> scatterTangents(numVertices), gatherTangents(numVertices);
+
+	GameTimer timer;
+	adjacency.Build(&indices[0], numIndices, numVertices);
+	const float adjacencyMs = timer.GetTimedMS();
+
+	float scatterMs = FLT_MAX, gatherMs = FLT_MAX;
+	for (int run = 0; run < MESH_CHECK_RUNS; ++run)
+	{
+		timer.GetTimedMS();
+		ScatterNormals(vertices, indices, scatter);
+		ScatterTangents(vertices, texCoords, indices, scatterTangents);
+		const float ms = timer.GetTimedMS();		//min is a macro, so can't be given GetTimedMS directly
+		scatterMs = min(scatterMs, ms);
+
+		MeshProcessing::GenerateNormals(&vertices[0], numVertices, &indices[0], numIndices, &adjacency, &gather[0]);
+		MeshProcessing::GenerateTangents(&vertices[0], &texCoords[0], numVertices, &indices[0], numIndices, &adjacency, &gatherTangents[0]);
+		const float gatherRunMs = timer.GetTimedMS();
+		gatherMs = min(gatherMs, gatherRunMs);
+	}
+	CHECK(SameVectors(scatter, gather));
+	CHECK(SameVectors(scatterTangents, gatherTangents));
+
+	printf("    %u vertices, %u triangles, normals + tangents, fastest of %d runs:\n", numVertices, numIndices / 3, MESH_CHECK_RUNS);
+	printf("    Scatter (original):  %7.2fms\n", scatterMs);
+	printf("    Gather:              %7.2fms (+%.2fms to build the adjacency once)\n", gatherMs, adjacencyMs);
+
+	//Shuffle the triangles, and renumber the vertices randomly
+	std::vector<unsigned int> triOrder(numIndices / 3), vertexOrder(numVertices);
+	for (unsigned int i = 0; i < triOrder.size(); ++i)
+		triOrder[i] = i;
+	for (unsigned int i = 0; i < numVertices; ++i)
+		vertexOrder[i] = i;
+	Shuffle(triOrder);
+	Shuffle(vertexOrder);
+
+	std::vector<unsigned int> shuffled(numIndices);
+	for (unsigned int i = 0; i < triOrder.size(); ++i)
+	{
+		for (unsigned int j = 0; j < 3; ++j)
+			shuffled[i * 3 + j] = vertexOrder[indices[triOrder[i] * 3 + j]];
+	}
+
+	const float gridACMR = MeshProcessing::CalculateACMR(&indices[0], numIndices, numVertices);
+	const float shuffledACMR = MeshProcessing::CalculateACMR(&shuffled[0], numIndices, numVertices);
+
+	std::vector<unsigned int> optimised = shuffled;
+	timer.GetTimedMS();
+	MeshProcessing::OptimiseVertexCache(&optimised[0], numIndices, numVertices);
+	const float optimiseMs = timer.GetTimedMS();
+	const float optimisedACMR = MeshProcessing::CalculateACMR(&optimised[0], numIndices, numVertices);
+
+	//Only the order of the triangles may change
+	CHECK(SortedTriangles(optimised) == SortedTriangles(shuffled));
+
+	//After renumbering, each vertex is first used straight after the one before it
+	std::vector<unsigned int> remap(numVertices);
+	CHECK(MeshProcessing::OptimiseVertexFetch(&optimised[0], numIndices, numVertices, &remap[0]) == numVertices);
+	unsigned int nextVertex = 0;
+	for (unsigned int i = 0; i < numIndices; ++i)
+	{
+		CHECK(optimised[i] <= nextVertex);
+		if (optimised[i] == nextVertex)
+			nextVertex++;
+	}
+	CHECK(MeshProcessing::CalculateACMR(&optimised[0], numIndices, numVertices) == optimisedACMR);
+
+	printf("    ACMR (%d entry FIFO): grid order %.3f, shuffled %.3f, optimised %.3f (%.2fms)\n",
+		MESH_VERTEX_CACHE_SIZE, gridACMR, shuffledACMR, optimisedACMR, optimiseMs);
+	CHECK(optimisedACMR < gridACMR && optimisedACMR < shuffledACMR);
+	return true;
+}
@@ -0,0 +1,127 @@
+#include "HeadlessChecks.h"
+#include <nclgl\OBJMesh.h>
+#include <nclgl\GameTimer.h>
+#include <cstdio>
+#include <cfloat>
+
+/*
+Compares loading a large OBJ file through the parser against loading it back
+in from the binary cache. The OBJ is generated each run (a sphere with
+positions, texture coordinates and normals, written with a fixed precision)
+so the results are repeatable on any machine. Each path is timed over several
+runs and the fastest is reported, so the OS file cache is warm for both. The
+timings include reading through all of the decoded vertices and indices, but
+not uploading them (there is no OpenGL context here).
+*/
+
+#define OBJ_BENCH_FILE		"obj_load_bench.obj"
+#define OBJ_BENCH_SEGMENTS	708			//708x708 quads = ~1M triangles, ~85MB of text
+#define OBJ_BENCH_RUNS		3
+
+static bool WriteBenchOBJ(const char* filename, int segments)
+{
+	FILE* f = fopen(filename, "wb");
+	if (!f)
+		return false;
+
+	const int rows = segments + 1;
+	for (int y = 0; y < rows; ++y)
+	{
+		const float theta = PI * y / segments;
+		for (int x = 0; x < rows; ++x)
+		{
+			const float phi = 2.0f * PI * x / segments;
+			const Vector3 n(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+			fprintf(f, "v %.6f %.6f %.6f\n", n.x * 10.0f, n.y * 10.0f, n.z * 10.0f);
+			fprintf(f, "vt %.6f %.6f\n", (float)x / segments, (float)y / segments);
+			fprintf(f, "vn %.6f %.6f %.6f\n", n.x, n.y, n.z);
+		}
+	}
+
+	for (int y = 0; y < segments; ++y)
+	{
+		for (int x = 0; x < segments; ++x)
+		{
+			const int a = y * rows + x + 1, b = a + 1, c = a + rows, d = c + 1;
+			fprintf(f, "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, c, c, c, d, d, d, b, b, b);
+		}
+	}
+
+	return fclose(f) == 0;
+}
+
+//Reads every vertex and index, as uploading the mesh would. Without this the cache would only be timed
+// mapping the file, and not reading any of it in.
+static uint TouchDecoded(const OBJDecodedMesh& decoded)
+{
+	uint sum = 0;
+	for (const OBJSubMeshData& sm : decoded.subMeshes)
+	{
+		const uint* words = (const uint*)sm.vertices;
+		for (uint i = 0; i < sm.numVertices * 3; ++i)
+			sum += words[i];
+		for (uint i = 0; i < sm.numIndices; ++i)
+			sum += sm.indices[i];
+	}
+	return sum;
+}
+
+//Decodes the file OBJ_BENCH_RUNS times, returning the fastest time in milliseconds
+static float TimeDecode(const char* filename, bool useCache, OBJDecodedMesh& out, bool& success, uint& checksum)
+{
+	float best = FLT_MAX;
+	success = true;
+	for (int i = 0; i < OBJ_BENCH_RUNS; ++i)
+	{
+		out.Clear();
+		GameTimer timer;
+		success &= OBJMesh::DecodeOBJMesh(filename, useCache, out);
+		checksum = TouchDecoded(out);
+
+		const float ms = timer.GetMS();		//min is a macro, so would call GetMS twice
+		best = min(best, ms);
+	}
+	return best;
+}
+
+bool Check_OBJLoadBench()
+{
+	GameTimer timer;
+	CHECK(WriteBenchOBJ(OBJ_BENCH_FILE, OBJ_BENCH_SEGMENTS));
+	printf("    Generated %s (%d triangles) in %5.2fms\n", OBJ_BENCH_FILE, OBJ_BENCH_SEGMENTS * OBJ_BENCH_SEGMENTS * 2, timer.GetMS());
+
+	OBJDecodedMesh parsed, cached;
+	bool parsedOK, cachedOK;
+	uint parsedSum, cachedSum;
+	const float parseMs = TimeDecode(OBJ_BENCH_FILE, false, parsed, parsedOK, parsedSum);
+
+	//The first decode with the cache enabled writes it, any after that read it back in
+	OBJDecodedMesh warm;
+	timer.GetTimedMS();
+	const bool writeOK = OBJMesh::DecodeOBJMesh(OBJ_BENCH_FILE, true, warm);
+	const float writeMs = timer.GetTimedMS();
+	warm.Clear();
+
+	const float cacheMs = TimeDecode(OBJ_BENCH_FILE, true, cached, cachedOK, cachedSum);
+
+	printf("    Parsed OBJ:          %8.2fms\n", parseMs);
+	printf("    Parse + write cache: %8.2fms\n", writeMs);
+	printf("    Read from cache:     %8.2fms (%5.1fx faster)\n", cacheMs, parseMs / max(cacheMs, 0.001f));
+
+	bool same = parsedOK && writeOK && cachedOK && cached.fromCache && parsedSum == cachedSum && SameOBJ(parsed, cached);
+	if (same)
+	{
+		//Every quad's four corners are shared with it's neighbours, apart from the seam and poles
+		const OBJSubMeshData& sm = cached.subMeshes[0];
+		printf("    %u unique vertices, %u indices\n", sm.numVertices, sm.numIndices);
+		same = (sm.numIndices == OBJ_BENCH_SEGMENTS * OBJ_BENCH_SEGMENTS * 6);
+	}
+
+	parsed.Clear();
+	cached.Clear();
+	remove(OBJ_BENCH_FILE);
+	remove(OBJ_BENCH_FILE OBJ_CACHE_EXTENSION);
+
+	CHECK(same);
+	return true;
+}
@@ -0,0 +1,177 @@
+#include "HeadlessChecks.h"
+#include <ncltech\RenderQueue.h>
+#include <nclgl\GameTimer.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cfloat>
+#include <set>
+#include <vector>
+
+/*
+Checks RenderQueue's sort keys put commands in the intended order: by pass, then
+texture, then mesh (objects that render themselves last), then front to back -
+or back to front, ahead of any state, for transparent objects. Then times the
+radix sort against std::sort on a large random queue, and prints how many
+texture/mesh changes drawing it takes before and after sorting.
+
+As with the instance_batch check, meshes are only compared by address so are
+never created.
+*/
+
+#define QUEUE_BENCH_OBJECTS		100000
+#define QUEUE_BENCH_TEXTURES	64
+#define QUEUE_BENCH_MESHES		32
+#define QUEUE_BENCH_RUNS		20
+#define QUEUE_DEPTH_PRECISION	(1.0f / (1 << 18))	//Relative difference in depth that is always given a different sort key
+
+static char g_QueueMeshes[QUEUE_BENCH_MESHES];
+
+class QueueCheckObject : public Object
+{
+public:
+	QueueCheckObject(int mesh, uint texture, int idx)
+		: m_Mesh((mesh < 0) ? NULL : (Mesh*)&g_QueueMeshes[mesh]), m_Texture(texture), index(idx) {}
+
+	int		index;
+
+protected:
+	Mesh*	GetRenderMesh() override		{ return m_Mesh; }
+	uint	GetRenderTexture() override		{ return m_Texture; }
+
+	Mesh*	m_Mesh;
+	uint	m_Texture;
+};
+
+//State changes needed to draw the commands in their current order
+static void CountChanges(const std::vector<RenderCommand>& commands, uint& out_textures, uint& out_meshes)
+{
+	out_textures = 0;
+	out_meshes = 0;
+	for (size_t i = 0; i < commands.size(); ++i)
+	{
+		if (i == 0 || commands[i].textureID != commands[i - 1].textureID)	out_textures++;
+		if (i == 0 || commands[i].meshID != commands[i - 1].meshID)			out_meshes++;
+	}
+}
+
+bool Check_RenderQueue()
+{
+	//Hand made queue with a known order
+	// - Objects 0-5 are opaque, sorted by texture then mesh (custom rendering last) then front to back
+	// - Objects 6-8 are transparent, sorted back to front regardless of state
+	// - Object 9 is in the shadow pass, which comes before both
+	{
+		const int meshes[]		= { 1, 0, -1, 0, 0, 1, 0, 1, 0, 1 };
+		const uint textures[]	= { 20, 20, 10, 10, 10, 20, 10, 20, 10, 20 };
+		const float depths[]	= { 5.0f, 9.0f, 1.0f, 7.0f, 3.0f, 2.0f, 4.0f, 8.0f, 6.0f, 1.0f };
+
+		RenderQueue queue;
+		QueueCheckObject* objs[10];
+		for (int i = 0; i < 10; ++i)
+		{
+			const uint pass = (i < 6) ? RENDERPASS_OPAQUE : ((i < 9) ? RENDERPASS_TRANSPARENT : RENDERPASS_SHADOW);
+			objs[i] = new QueueCheckObject(meshes[i], textures[i], i);
+			queue.Record(objs[i], pass, depths[i], pass == RENDERPASS_TRANSPARENT);
+		}
+		queue.Sort();
+
+		//IDs are given out in the order textures/meshes are first seen, so texture 20 and mesh 1 come first
+		const int expected[] = { 9, 5, 0, 1, 4, 3, 2, 7, 8, 6 };
+		const std::vector<RenderCommand>& commands = queue.GetCommands();
+		CHECK(commands.size() == 10);
+		for (int i = 0; i < 10; ++i)
+		{
+			CHECK(((QueueCheckObject*)commands[i].obj)->index == expected[i]);
+		}
+		CHECK(queue.GetNumTextureChanges() == 4 && queue.GetNumMeshChanges() == 5);
+
+		for (int i = 0; i < 10; ++i)
+			delete objs[i];
+	}
+
+	//Large random queue - after sorting every texture, and every mesh within it, must be drawn in one contiguous run
+	srand(35);
+	std::vector<Object*> objects;
+	std::vector<float> depths;
+	std::set<uint> textures, pairs;
+	for (int i = 0; i < QUEUE_BENCH_OBJECTS; ++i)
+	{
+		const uint texture = rand() % QUEUE_BENCH_TEXTURES;
+		const int mesh = (rand() % (QUEUE_BENCH_MESHES + 1)) - 1;
+		objects.push_back(new QueueCheckObject(mesh, texture, i));
+		depths.push_back((rand() / (float)RAND_MAX) * 1000.0f);
+		textures.insert(texture);
+		pairs.insert(texture * (QUEUE_BENCH_MESHES + 1) + (mesh + 1));
+	}
+
+	RenderQueue queue;
+	auto record = [&]()
+	{
+		queue.Clear();
+		for (int i = 0; i < QUEUE_BENCH_OBJECTS; ++i)
+			queue.Record(objects[i], RENDERPASS_OPAQUE, depths[i]);
+	};
+
+	record();
+	uint unsortedTextures, unsortedMeshes;
+	CountChanges(queue.GetCommands(), unsortedTextures, unsortedMeshes);
+
+	float radixMs = FLT_MAX, stdMs = FLT_MAX;
+	for (int run = 0; run < QUEUE_BENCH_RUNS; ++run)
+	{
+		record();
+		std::vector<RenderCommand> copy = queue.GetCommands();
+
+		GameTimer timer;
+		queue.Sort();
+		const float ms = timer.GetTimedMS();
+		radixMs = min(radixMs, ms);
+
+		std::stable_sort(copy.begin(), copy.end(), [](const RenderCommand& a, const RenderCommand& b) { return a.key < b.key; });
+		const float sortMs = timer.GetTimedMS();
+		stdMs = min(stdMs, sortMs);
+
+		//Both stable, so must agree exactly
+		const std::vector<RenderCommand>& commands = queue.GetCommands();
+		for (size_t i = 0; i < copy.size(); ++i)
+		{
+			CHECK(commands[i].obj == copy[i].obj);
+		}
+	}
+
+	const std::vector<RenderCommand>& commands = queue.GetCommands();
+	uint numRuns = 0;
+	for (size_t i = 0; i < commands.size(); ++i)
+	{
+		if (i > 0)
+		{
+			CHECK(commands[i - 1].key <= commands[i].key);
+
+			//Front to back within each run (keys only keep the top bits of the depth, so very close depths may tie)
+			if (commands[i].textureID == commands[i - 1].textureID && commands[i].meshID == commands[i - 1].meshID)
+			{
+				const float depth = depths[((QueueCheckObject*)commands[i].obj)->index];
+				const float prevDepth = depths[((QueueCheckObject*)commands[i - 1].obj)->index];
+				CHECK(depth >= prevDepth * (1.0f - QUEUE_DEPTH_PRECISION));
+			}
+		}
+
+		if (i == 0 || commands[i].textureID != commands[i - 1].textureID || commands[i].meshID != commands[i - 1].meshID)
+			numRuns++;
+	}
+	CHECK(queue.GetNumTextureChanges() == textures.size());
+	CHECK(numRuns == pairs.size());
+	CHECK(queue.GetNumMeshChanges() <= pairs.size());
+
+	printf("    %d commands, %d textures, %d meshes (+ custom rendering), fastest of %d runs:\n",
+		QUEUE_BENCH_OBJECTS, QUEUE_BENCH_TEXTURES, QUEUE_BENCH_MESHES, QUEUE_BENCH_RUNS);
+	printf("    RenderQueue::Sort: %6.3fms\n", radixMs);
+	printf("    std::stable_sort:  %6.3fms\n", stdMs);
+	printf("    Texture changes %u -> %u, mesh changes %u -> %u\n",
+		unsortedTextures, queue.GetNumTextureChanges(), unsortedMeshes, queue.GetNumMeshChanges());
+
+	for (Object* obj : objects)
+		delete obj;
+	return true;
+}
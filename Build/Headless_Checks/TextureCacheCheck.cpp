@@ -0,0 +1,220 @@
+#include "HeadlessChecks.h"
+#include <nclgl\TextureData.h>
+#include <nclgl\GameTimer.h>
+#include <Simple OpenGL Image Library/src/image_helper.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cfloat>
+#include <vector>
+
+/*
+Checks TextureData's mip chain matches SOIL's way of building one level at a
+time from the level before (done serially here), then checks the baked cache:
+a second load must come from the cache with exactly the same levels, and a
+truncated or corrupted cache, one baked with different flags, or one left
+over from an older version of the image must all be thrown away and the image
+baked again.
+
+The images are generated each run (smooth gradients with some noise, so that
+rounding differences between the mip filters would show up), and removed
+again afterwards along with their caches.
+*/
+
+#define TEXCACHE_CHECK_FILE		"texture_cache_check.tga"
+#define TEXCACHE_CHECK_FLAGS	(SOIL_FLAG_MIPMAPS | SOIL_FLAG_INVERT_Y)
+#define TEXCACHE_BENCH_WIDTH	2048
+#define TEXCACHE_BENCH_HEIGHT	1024
+#define TEXCACHE_BENCH_RUNS		5
+
+static std::vector<unsigned char> MakeImage(int width, int height, int channels, int seed)
+{
+	srand(seed);
+	std::vector<unsigned char> pixels((size_t)width * height * channels);
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			unsigned char* p = &pixels[((size_t)y * width + x) * channels];
+			for (int c = 0; c < channels; ++c)
+			{
+				p[c] = (unsigned char)(((x * (c + 1) * 255) / width + (y * 255) / height + rand() % 16) & 0xFF);
+			}
+		}
+	}
+	return pixels;
+}
+
+static std::string CacheFilename(unsigned int flags)
+{
+	return std::string(TEXCACHE_CHECK_FILE) + "_" + std::to_string(flags & TEXTURE_BAKE_FLAGS) + TEXTURE_CACHE_EXTENSION;
+}
+
+static bool ReadWholeFile(const std::string& filename, std::vector<char>& out)
+{
+	FILE* f = fopen(filename.c_str(), "rb");
+	if (!f)
+		return false;
+
+	fseek(f, 0, SEEK_END);
+	out.resize(ftell(f));
+	fseek(f, 0, SEEK_SET);
+	const bool ok = out.empty() || fread(&out[0], 1, out.size(), f) == out.size();
+	fclose(f);
+	return ok;
+}
+
+//Copies every level of the texture, so it can still be compared once the texture has been cleared
+static std::vector<std::vector<unsigned char>> CopyLevels(const TextureData& texture)
+{
+	std::vector<std::vector<unsigned char>> levels(texture.GetNumLevels());
+	for (unsigned int i = 0; i < texture.GetNumLevels(); ++i)
+	{
+		const TextureLevel& level = texture.GetLevel(i);
+		levels[i].assign(level.data, level.data + level.size);
+	}
+	return levels;
+}
+
+static bool SameLevels(const TextureData& texture, const std::vector<std::vector<unsigned char>>& levels)
+{
+	if (texture.GetNumLevels() != levels.size())
+		return false;
+
+	for (unsigned int i = 0; i < texture.GetNumLevels(); ++i)
+	{
+		const TextureLevel& level = texture.GetLevel(i);
+		if (level.size != levels[i].size() || memcmp(level.data, &levels[i][0], level.size) != 0)
+			return false;
+	}
+	return true;
+}
+
+//Builds the mip chain one level at a time on a single thread, as SOIL does when making mipmaps itself
+static std::vector<std::vector<unsigned char>> ReferenceMips(const std::vector<unsigned char>& pixels, int width, int height, int channels)
+{
+	std::vector<std::vector<unsigned char>> levels(1, pixels);
+	while (width > 1 || height > 1)
+	{
+		const int mipWidth = max(width / 2, 1), mipHeight = max(height / 2, 1);
+		levels.push_back(std::vector<unsigned char>((size_t)mipWidth * mipHeight * channels));
+		mipmap_image(&levels[levels.size() - 2][0], width, height, channels, &levels.back()[0], 2, 2);
+		width = mipWidth;
+		height = mipHeight;
+	}
+	return levels;
+}
+
+//Compares the mip chain Bake makes for the given image against the reference, levels must match exactly
+static bool CheckMips(int width, int height, int channels)
+{
+	const std::vector<unsigned char> pixels = MakeImage(width, height, channels, width + height);
+	const std::vector<std::vector<unsigned char>> reference = ReferenceMips(pixels, width, height, channels);
+
+	TextureData texture;
+	CHECK(texture.Bake(&pixels[0], width, height, channels, SOIL_FLAG_MIPMAPS));
+	CHECK(texture.GetWidth() == width && texture.GetHeight() == height);
+	CHECK(SameLevels(texture, reference));
+	return true;
+}
+
+bool Check_TextureCache()
+{
+	//Mip chains - square, wider than tall, taller than wide (down to a single row/column), and small enough to be done on one thread
+	if (!CheckMips(TEXCACHE_BENCH_WIDTH, TEXCACHE_BENCH_HEIGHT, 4)
+		|| !CheckMips(512, 512, 3)
+		|| !CheckMips(1024, 8, 4)
+		|| !CheckMips(4, 1024, 1)
+		|| !CheckMips(64, 32, 2))
+	{
+		return false;
+	}
+
+	//Time building the mip chain against the reference
+	{
+		const int width = TEXCACHE_BENCH_WIDTH, height = TEXCACHE_BENCH_HEIGHT;
+		const std::vector<unsigned char> pixels = MakeImage(width, height, 4, 1);
+
+		float bakeMs = FLT_MAX, referenceMs = FLT_MAX;
+		for (int run = 0; run < TEXCACHE_BENCH_RUNS; ++run)
+		{
+			TextureData texture;
+			GameTimer timer;
+			texture.Bake(&pixels[0], width, height, 4, SOIL_FLAG_MIPMAPS);
+			const float ms = timer.GetTimedMS();
+			bakeMs = min(bakeMs, ms);
+
+			ReferenceMips(pixels, width, height, 4);
+			const float refMs = timer.GetTimedMS();
+			referenceMs = min(referenceMs, refMs);
+		}
+		printf("    %dx%d RGBA mip chain, fastest of %d runs:\n", width, height, TEXCACHE_BENCH_RUNS);
+		printf("    TextureData::Bake:         %7.2fms\n", bakeMs);
+		printf("    Serial reference (SOIL):   %7.2fms\n", referenceMs);
+	}
+
+	//Caching
+	const unsigned int flags = TEXCACHE_CHECK_FLAGS;
+	const std::string cacheFilename = CacheFilename(flags);
+	std::vector<unsigned char> pixels = MakeImage(512, 256, 3, 2);
+	CHECK(SOIL_save_image(TEXCACHE_CHECK_FILE, SOIL_SAVE_TYPE_TGA, 512, 256, 3, &pixels[0]));
+	remove(cacheFilename.c_str());
+
+	TextureData texture;
+	CHECK(texture.Load(TEXCACHE_CHECK_FILE, flags) && !texture.IsFromCache());
+	const std::vector<std::vector<unsigned char>> baked = CopyLevels(texture);
+	const float bakeMs = texture.GetLoadTime();
+
+	CHECK(texture.Load(TEXCACHE_CHECK_FILE, flags) && texture.IsFromCache());
+	CHECK(SameLevels(texture, baked));
+	const float cacheMs = texture.GetLoadTime();
+
+	CHECK(texture.Load(TEXCACHE_CHECK_FILE, flags, false) && !texture.IsFromCache());
+	CHECK(SameLevels(texture, baked));
+	texture.Clear();	//The cache file stays mapped until then
+
+	printf("    Loading a 512x256 RGB image: %.2fms to bake, %.2fms from the cache\n", bakeMs, cacheMs);
+
+	std::vector<char> cacheData;
+	CHECK(ReadWholeFile(cacheFilename, cacheData));
+
+	//Cut short
+	CHECK(MappedFile::WriteFile(cacheFilename, &cacheData[0], cacheData.size() - 16));
+	CHECK(texture.Load(TEXCACHE_CHECK_FILE, flags) && !texture.IsFromCache());
+	CHECK(SameLevels(texture, baked));
+
+	//The rebaked cache replaces the broken one
+	CHECK(texture.Load(TEXCACHE_CHECK_FILE, flags) && texture.IsFromCache());
+	texture.Clear();
+
+	//Not a texture cache
+	std::vector<char> corrupt = cacheData;
+	corrupt[0] ^= 0xFF;
+	CHECK(MappedFile::WriteFile(cacheFilename, &corrupt[0], corrupt.size()));
+	CHECK(texture.Load(TEXCACHE_CHECK_FILE, flags) && !texture.IsFromCache());
+	CHECK(SameLevels(texture, baked));
+	texture.Clear();
+
+	//Baked with different flags (the flags are part of the cache's filename, so this would only happen if it was renamed)
+	const unsigned int dxtFlags = flags | SOIL_FLAG_COMPRESS_TO_DXT;
+	const std::string dxtCacheFilename = CacheFilename(dxtFlags);
+	CHECK(MappedFile::WriteFile(dxtCacheFilename, &cacheData[0], cacheData.size()));
+	CHECK(texture.Load(TEXCACHE_CHECK_FILE, dxtFlags) && !texture.IsFromCache());
+	CHECK(texture.IsCompressed());
+	CHECK(texture.Load(TEXCACHE_CHECK_FILE, dxtFlags) && texture.IsFromCache() && texture.IsCompressed());
+	texture.Clear();
+
+	//The image has changed since the cache was baked
+	pixels = MakeImage(256, 256, 3, 3);
+	CHECK(SOIL_save_image(TEXCACHE_CHECK_FILE, SOIL_SAVE_TYPE_TGA, 256, 256, 3, &pixels[0]));
+	CHECK(texture.Load(TEXCACHE_CHECK_FILE, flags) && !texture.IsFromCache());
+	CHECK(texture.GetWidth() == 256 && texture.GetNumLevels() == 9);
+	CHECK(texture.Load(TEXCACHE_CHECK_FILE, flags) && texture.IsFromCache());
+	CHECK(texture.GetWidth() == 256);
+	texture.Clear();
+
+	remove(TEXCACHE_CHECK_FILE);
+	remove(cacheFilename.c_str());
+	remove(dxtCacheFilename.c_str());
+	return true;
+}
@@ -1,5 +1,15 @@
 #include "Frustum.h"
 
+#if defined(__AVX__)
+#include <immintrin.h>
+#define FRUSTUM_SIMD_WIDTH 8
+#elif defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define FRUSTUM_SIMD_WIDTH 4
+#else
+#define FRUSTUM_SIMD_WIDTH 1
+#endif
+
 void Frustum::FromMatrix(const Matrix4 &mat) {
 	Vector3 xaxis = Vector3(mat.values[0],mat.values[4],mat.values[8]);
 	Vector3 yaxis = Vector3(mat.values[1],mat.values[5],mat.values[9]);
@@ -60,6 +70,88 @@ bool Frustum::InsideFrustum(const Vector3& position, float radius) const {
 	return true;
 }
 
+void Frustum::InsideFrustumBatchScalar(const float* xs, const float* ys, const float* zs, const float* radii, uint count, uint* out_visible) const {
+	memset(out_visible, 0, ((count + 31) / 32) * sizeof(uint));
+
+	for (uint i = 0; i < count; ++i) {
+		if (InsideFrustum(Vector3(xs[i], ys[i], zs[i]), radii[i])) {
+			out_visible[i / 32] |= 1u << (i % 32);
+		}
+	}
+}
+
+void Frustum::InsideFrustumBatch(const float* xs, const float* ys, const float* zs, const float* radii, uint count, uint* out_visible) const {
+#if FRUSTUM_SIMD_WIDTH == 1
+	InsideFrustumBatchScalar(xs, ys, zs, radii, count, out_visible);
+#else
+	memset(out_visible, 0, ((count + 31) / 32) * sizeof(uint));
+
+	//Every SIMD block is aligned to 32 spheres, so always writes to a single mask word
+	const uint simd_count = count - (count % FRUSTUM_SIMD_WIDTH);
+
+#if FRUSTUM_SIMD_WIDTH == 8
+	__m256 nx[6], ny[6], nz[6], nd[6];
+	for (int p = 0; p < 6; ++p) {
+		nx[p] = _mm256_set1_ps(planes[p].GetNormal().x);
+		ny[p] = _mm256_set1_ps(planes[p].GetNormal().y);
+		nz[p] = _mm256_set1_ps(planes[p].GetNormal().z);
+		nd[p] = _mm256_set1_ps(planes[p].GetDistance());
+	}
+	const __m256 zero = _mm256_setzero_ps();
+
+	for (uint i = 0; i < simd_count; i += 8) {
+		__m256 x = _mm256_loadu_ps(xs + i);
+		__m256 y = _mm256_loadu_ps(ys + i);
+		__m256 z = _mm256_loadu_ps(zs + i);
+		__m256 r = _mm256_loadu_ps(radii + i);
+
+		//Sphere is inside if (dot(pos, normal) + distance + radius > 0) for all planes
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; ++p) {
+			__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, nx[p]), _mm256_mul_ps(y, ny[p])),
+									 _mm256_add_ps(_mm256_mul_ps(z, nz[p]), _mm256_add_ps(nd[p], r)));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, zero, _CMP_GT_OQ));
+		}
+
+		out_visible[i / 32] |= (uint)_mm256_movemask_ps(inside) << (i % 32);
+	}
+#else
+	__m128 nx[6], ny[6], nz[6], nd[6];
+	for (int p = 0; p < 6; ++p) {
+		nx[p] = _mm_set1_ps(planes[p].GetNormal().x);
+		ny[p] = _mm_set1_ps(planes[p].GetNormal().y);
+		nz[p] = _mm_set1_ps(planes[p].GetNormal().z);
+		nd[p] = _mm_set1_ps(planes[p].GetDistance());
+	}
+	const __m128 zero = _mm_setzero_ps();
+
+	for (uint i = 0; i < simd_count; i += 4) {
+		__m128 x = _mm_loadu_ps(xs + i);
+		__m128 y = _mm_loadu_ps(ys + i);
+		__m128 z = _mm_loadu_ps(zs + i);
+		__m128 r = _mm_loadu_ps(radii + i);
+
+		//Sphere is inside if (dot(pos, normal) + distance + radius > 0) for all planes
+		__m128 inside = _mm_cmpeq_ps(zero, zero);
+		for (int p = 0; p < 6; ++p) {
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, nx[p]), _mm_mul_ps(y, ny[p])),
+								  _mm_add_ps(_mm_mul_ps(z, nz[p]), _mm_add_ps(nd[p], r)));
+			inside = _mm_and_ps(inside, _mm_cmpgt_ps(d, zero));
+		}
+
+		out_visible[i / 32] |= (uint)_mm_movemask_ps(inside) << (i % 32);
+	}
+#endif
+
+	//Remaining spheres that don't fill an entire SIMD register
+	for (uint i = simd_count; i < count; ++i) {
+		if (InsideFrustum(Vector3(xs[i], ys[i], zs[i]), radii[i])) {
+			out_visible[i / 32] |= 1u << (i % 32);
+		}
+	}
+#endif
+}
+
 bool Frustum::InsideFrustum(SceneNode&n) const	{
 	for(int p = 0; p < 6; p++ )	{
 		//if(!planes[p].PointInPlane(n.GetWorldTransform().GetPositionVector())) {
@@ -44,9 +44,17 @@ public:
 	bool InsideFrustum(const Vector3& position, float radius) const;
 	bool InsideFrustum(SceneNode&n) const;
 
+	//Batched version of InsideFrustum, testing 'count' spheres given as seperate arrays of x/y/z/radius.
+	//Bit (i % 32) of out_visible[i / 32] is set if sphere i is inside the frustum, so out_visible
+	//must have room for at least (count + 31) / 32 entries. Uses AVX/SSE to test 8/4 spheres at a time
+	//where available, falling back to InsideFrustumBatchScalar otherwise.
+	void InsideFrustumBatch(const float* xs, const float* ys, const float* zs, const float* radii, uint count, uint* out_visible) const;
+	void InsideFrustumBatchScalar(const float* xs, const float* ys, const float* zs, const float* radii, uint count, uint* out_visible) const;
+
 	bool	AABBInsideFrustum(Vector3 &position, const Vector3 &size) const;
 
 	Plane& GetPlane(int idx) { return planes[idx]; }
+	const Plane& GetPlane(int idx) const { return planes[idx]; }
 
 protected:
 	Plane planes[6];
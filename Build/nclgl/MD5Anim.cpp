@@ -1,6 +1,43 @@
 #include "MD5Anim.h"
 #ifdef WEEK_2_CODE
-MD5Anim::MD5Anim(std::string filename)	{
+#include "MappedFile.h"
+#include <cstring>
+
+/*
+Layout of the compiled binary MD5Anim file: an MD5BinaryAnimHeader, followed
+by the blocks of data it points to. All offsets are in bytes from the start of
+the file.
+*/
+struct MD5BinaryAnimHeader {
+	char		magic[4];
+	uint32_t	version;
+	uint64_t	srcSize;				//Size and modification time of the text file this was compiled from
+	uint64_t	srcTimestamp;
+	uint32_t	frameRate;
+	uint32_t	numJoints;
+	uint32_t	numFrames;
+	uint32_t	numAnimatedComponents;
+	uint32_t	numChannels;
+	uint32_t	frameBits;
+	uint64_t	jointsOffset;			//MD5BinaryAnimJoint[numJoints]
+	uint64_t	boundsOffset;			//MD5Bounds[numFrames]
+	uint64_t	basePoseOffset;			//float[numJoints * 6]
+	uint64_t	jointChannelsOffset;	//uint32_t[numJoints + 1]
+	uint64_t	channelsOffset;			//MD5AnimChannel[numChannels]
+	uint64_t	keysOffset;				//Packed keys, GetKeyBytes() bytes
+};
+
+struct MD5BinaryAnimJoint {
+	uint64_t	nameOffset;
+	uint32_t	nameLength;
+	int32_t		parent;
+	int32_t		flags;
+	int32_t		frameIndex;
+};
+
+static const char MD5_BINARY_ANIM_MAGIC[4] = { 'N', 'M', 'D', 'A' };
+
+MD5Anim::MD5Anim(void)	{
 	numAnimatedComponents = 0;
 	frameRate	= 0;
 	numJoints	= 0;
@@ -8,7 +45,17 @@ MD5Anim::MD5Anim(std::string filename)	{
 	joints		= NULL;
 	bounds		= NULL;
 	frames		= NULL;
+	frameComponents = NULL;
+
+	numChannels		= 0;
+	channels		= NULL;
+	jointChannels	= NULL;
+	frameBits		= 0;
+	keys			= NULL;
+	basePose		= NULL;
+}
 
+MD5Anim::MD5Anim(std::string filename) : MD5Anim()	{
 	LoadMD5Anim(filename);
 }
 
@@ -19,17 +66,42 @@ MD5Anim::~MD5Anim(void)	{
 	delete[] joints;
 	delete[] bounds;
 	delete[] frames;
+	delete[] frameComponents;
+
+	delete[] channels;
+	delete[] jointChannels;
+	delete[] keys;
+	delete[] basePose;
 }
+
+bool MD5Anim::CompileBinary(const std::string &filename)	{
+	MD5Anim anim;
+	return anim.LoadTextMD5Anim(filename)
+		&& anim.SaveBinaryMD5Anim(filename + MD5_BINARY_EXTENSION, filename);
+}
+
+void MD5Anim::LoadMD5Anim( std::string filename )	{
+	//Use the compiled version of the file if it's up to date, otherwise load the text
+	//file and compile it, so it'll be quicker next time
+	const std::string binaryFilename = filename + MD5_BINARY_EXTENSION;
+
+	if(!LoadBinaryMD5Anim(binaryFilename, filename)) {
+		if(LoadTextMD5Anim(filename)) {
+			SaveBinaryMD5Anim(binaryFilename, filename);
+		}
+	}
+}
+
 /************************************************************************/
 /*                                                                      */
 /************************************************************************/
-void MD5Anim::LoadMD5Anim( std::string filename )	{
+bool MD5Anim::LoadTextMD5Anim( const std::string &filename )	{
 	//The MD5Anim is human readable, and stores its data in an easily
 	//traversable way, so we can simply stream data from the file
 	std::ifstream f(filename,std::ios::in);	
 
 	if(!f) {	//Opening the file has failed :(
-		return;
+		return false;
 	}
 
 	//We have our MD5 file handle!
@@ -57,18 +129,15 @@ void MD5Anim::LoadMD5Anim( std::string filename )	{
 
 			//ifstream allows us to stream ints,floats etc into variables
 			f >> md5Version;
-			std::cout << "MD5 File version is: " << md5Version << std::endl;
 		}
 		else if(currentLine.find(MD5_COMMANDLINE_TAG) != std::string::npos) {
 			/*
 			MD5Anim files sometimes have a 'command line' value, used by the game
 			toolchain to generate some data. We don't care about it!
 			*/
-			std::cout << "Ignoring commandline value" << std::endl;
 		}
 		else if(currentLine.find(MD5_ANIM_NUMFRAMES) != std::string::npos) {
 			f >> numFrames;	//Loading in the number of frames held in this MD5Anim file
-			std::cout << "Expecting file to have " << numFrames << " frames" << std::endl;
 
 			//If we have an incorrectly generated MD5Anim file, this might go wrong, as
 			//there might be more frames than we've generated space for...
@@ -77,7 +146,6 @@ void MD5Anim::LoadMD5Anim( std::string filename )	{
 		}
 		else if(currentLine.find(MD5_NUMJOINTS_TAG) != std::string::npos) {
 			f >> numJoints;	//Loading in the number of joints in this MD5Anim file
-			std::cout << "Expecting file to have " << numJoints << " joints" << std::endl;
 
 			joints = new MD5AnimJoint[numJoints];
 		}
@@ -106,9 +174,269 @@ void MD5Anim::LoadMD5Anim( std::string filename )	{
 
 	//If what we've loaded in does not equal what we /should/ have loaded in, we'll output an error
 	//
-	if(numLoadedFrames != numFrames || numLoadedJoints != numJoints || numLoadedBounds != numFrames) {
+	if(numLoadedFrames != numFrames || numLoadedJoints != numJoints || numLoadedBounds != numFrames
+		|| !baseFrame.positions) {
 		std::cout << "MD5Anim file has incorrect data..." << std::endl;
+		return false;
 	}
+
+	CompressFrames();
+	return true;
+}
+
+/*
+Converts the loaded frames into channels. Every component which changes during
+the animation gets its own channel, and is quantised within the range of values
+it takes, to as few bits as keep it within MD5_ANIM_POSITION_TOLERANCE or
+MD5_ANIM_ORIENTATION_TOLERANCE. Channels that would need more than
+MD5_ANIM_MAX_KEY_BITS are clamped to it, and so may exceed their tolerance.
+Components that don't change are written straight into the base pose instead.
+Once done, the uncompressed frames are thrown away.
+*/
+void MD5Anim::CompressFrames()	{
+	basePose		= new float[numJoints * 6];
+	jointChannels	= new unsigned int[numJoints + 1];
+
+	std::vector<MD5AnimChannel>	newChannels;
+	std::vector<unsigned int>	channelSources;	//Which of the frame components each channel comes from
+
+	for(unsigned int i = 0; i < numJoints; ++i) {
+		float* pose = &basePose[i * 6];
+		pose[0] = baseFrame.positions[i].x;
+		pose[1] = baseFrame.positions[i].y;
+		pose[2] = baseFrame.positions[i].z;
+		pose[3] = baseFrame.orientations[i].x;
+		pose[4] = baseFrame.orientations[i].y;
+		pose[5] = baseFrame.orientations[i].z;
+
+		jointChannels[i] = (unsigned int)newChannels.size();
+
+		//The flags bits are in the same order as our components, and the joint uses
+		//one frame component for each bit that is set
+		unsigned int source = joints[i].frameIndex;
+		for(unsigned int c = 0; c < 6; ++c) {
+			if(!(joints[i].flags & (1 << c))) {
+				continue;
+			}
+			if(source >= numAnimatedComponents) {
+				break;	//Broken file!
+			}
+
+			float minValue = frames[0].components[source];
+			float maxValue = minValue;
+			for(unsigned int f = 1; f < numFrames; ++f) {
+				const float v = frames[f].components[source];
+				minValue = min(minValue, v);
+				maxValue = max(maxValue, v);
+			}
+
+			if(maxValue - minValue <= MD5_ANIM_CONSTANT_EPSILON) {
+				pose[c] = frames[0].components[source];
+			}
+			else {
+				//Rounding to the nearest key puts each value at most half a step out
+				const float range		= maxValue - minValue;
+				const float tolerance	= (c < 3) ? MD5_ANIM_POSITION_TOLERANCE : MD5_ANIM_ORIENTATION_TOLERANCE;
+				unsigned int bits = 1;
+				while(bits < MD5_ANIM_MAX_KEY_BITS && range / ((1 << bits) - 1) * 0.5f > tolerance) {
+					++bits;
+				}
+
+				MD5AnimChannel channel;
+				channel.min			= minValue;
+				channel.scale		= range / ((1 << bits) - 1);
+				channel.component	= c;
+				channel.bits		= bits;
+				channel.bitOffset	= 0;
+
+				newChannels.push_back(channel);
+				channelSources.push_back(source);
+			}
+			++source;
+		}
+	}
+	numChannels = (unsigned int)newChannels.size();
+	jointChannels[numJoints] = numChannels;
+
+	frameBits = 0;
+	for(unsigned int c = 0; c < numChannels; ++c) {
+		newChannels[c].bitOffset = frameBits;
+		frameBits += newChannels[c].bits;
+	}
+
+	channels	= new MD5AnimChannel[numChannels];
+	keys		= new unsigned char[GetKeyBytes()];
+	memset(keys, 0, GetKeyBytes());
+	if(numChannels > 0) {
+		memcpy(channels, &newChannels[0], numChannels * sizeof(MD5AnimChannel));
+	}
+
+	for(unsigned int f = 0; f < numFrames; ++f) {
+		for(unsigned int c = 0; c < numChannels; ++c) {
+			const float			maxKey	= (float)((1 << channels[c].bits) - 1);
+			const float			v		= (frames[f].components[channelSources[c]] - channels[c].min) / channels[c].scale;
+			const unsigned int	key		= (unsigned int)min(max(v + 0.5f, 0.0f), maxKey);
+
+			size_t bit = (size_t)f * frameBits + channels[c].bitOffset;
+			for(unsigned int i = 0; i < channels[c].bits; ++i, ++bit) {
+				if(key & (1 << i)) {
+					keys[bit >> 3] |= (unsigned char)(1 << (bit & 7));
+				}
+			}
+		}
+	}
+
+	//Everything we need is in the channels now
+	delete[] frames;
+	delete[] frameComponents;
+	delete[] baseFrame.positions;
+	delete[] baseFrame.orientations;
+
+	frames					= NULL;
+	frameComponents			= NULL;
+	baseFrame.positions		= NULL;
+	baseFrame.orientations	= NULL;
+}
+
+bool MD5Anim::LoadBinaryMD5Anim(const std::string &filename, const std::string &textFilename)	{
+	MappedFile file;
+	if(!file.Open(filename) || file.GetSize() < sizeof(MD5BinaryAnimHeader)) {
+		return false;
+	}
+
+	const char* base = file.GetData();
+	const MD5BinaryAnimHeader* header = (const MD5BinaryAnimHeader*)base;
+
+	if(memcmp(header->magic, MD5_BINARY_ANIM_MAGIC, sizeof(MD5_BINARY_ANIM_MAGIC)) != 0
+		|| header->version != MD5_BINARY_VERSION) {
+		return false;
+	}
+
+	//If the text file has been changed since it was compiled, the binary file is out of date. If there
+	//is no text file at all, we'll just have to trust it!
+	uint64_t srcSize, srcTimestamp;
+	if(MappedFile::GetFileInfo(textFilename, &srcSize, &srcTimestamp)
+		&& (header->srcSize != srcSize || header->srcTimestamp != srcTimestamp)) {
+		return false;
+	}
+
+	const uint64_t keyBytes = ((uint64_t)header->numFrames * header->frameBits + 7) / 8 + 2;
+	if(!file.Contains(header->jointsOffset, (uint64_t)header->numJoints * sizeof(MD5BinaryAnimJoint))
+		|| !file.Contains(header->boundsOffset, (uint64_t)header->numFrames * sizeof(MD5Bounds))
+		|| !file.Contains(header->basePoseOffset, (uint64_t)header->numJoints * 6 * sizeof(float))
+		|| !file.Contains(header->jointChannelsOffset, ((uint64_t)header->numJoints + 1) * sizeof(uint32_t))
+		|| !file.Contains(header->channelsOffset, (uint64_t)header->numChannels * sizeof(MD5AnimChannel))
+		|| header->frameBits > (uint64_t)header->numChannels * MD5_ANIM_MAX_KEY_BITS
+		|| !file.Contains(header->keysOffset, keyBytes)) {
+		return false;
+	}
+
+	//Each joint's flags select which of it's 6 components are animated, and those components must
+	//all be inside each frame's numAnimatedComponents floats
+	const MD5BinaryAnimJoint* fileJoints = (const MD5BinaryAnimJoint*)(base + header->jointsOffset);
+	for(unsigned int i = 0; i < header->numJoints; ++i) {
+		const MD5BinaryAnimJoint &joint = fileJoints[i];
+		if(!file.Contains(joint.nameOffset, joint.nameLength)
+			|| joint.parent < -1 || joint.parent >= (int32_t)header->numJoints
+			|| (joint.flags & ~63) != 0 || joint.frameIndex < 0) {
+			return false;
+		}
+
+		unsigned int numFlagged = 0;
+		for(int bit = 0; bit < 6; ++bit) {
+			numFlagged += (joint.flags >> bit) & 1;
+		}
+		if((uint64_t)joint.frameIndex + numFlagged > header->numAnimatedComponents) {
+			return false;
+		}
+	}
+
+	//Every joint's channels must follow on from the previous joint's, and every channel
+	//must target one of the 6 components of the joint, with its keys inside each frame's bits
+	const uint32_t* fileJointChannels = (const uint32_t*)(base + header->jointChannelsOffset);
+	if(fileJointChannels[0] != 0 || fileJointChannels[header->numJoints] != header->numChannels) {
+		return false;
+	}
+	for(unsigned int i = 0; i < header->numJoints; ++i) {
+		if(fileJointChannels[i] > fileJointChannels[i + 1]) {
+			return false;
+		}
+	}
+	const MD5AnimChannel* fileChannels = (const MD5AnimChannel*)(base + header->channelsOffset);
+	for(unsigned int i = 0; i < header->numChannels; ++i) {
+		if(fileChannels[i].component >= 6
+			|| fileChannels[i].bits == 0 || fileChannels[i].bits > MD5_ANIM_MAX_KEY_BITS
+			|| (uint64_t)fileChannels[i].bitOffset + fileChannels[i].bits > header->frameBits) {
+			return false;
+		}
+	}
+
+	frameRate				= header->frameRate;
+	numJoints				= header->numJoints;
+	numFrames				= header->numFrames;
+	numAnimatedComponents	= header->numAnimatedComponents;
+	numChannels				= header->numChannels;
+	frameBits				= header->frameBits;
+
+	joints = new MD5AnimJoint[numJoints];
+	for(unsigned int i = 0; i < numJoints; ++i) {
+		joints[i].name.assign(base + fileJoints[i].nameOffset, fileJoints[i].nameLength);
+		joints[i].parent		= fileJoints[i].parent;
+		joints[i].flags			= fileJoints[i].flags;
+		joints[i].frameIndex	= fileJoints[i].frameIndex;
+	}
+
+	bounds			= new MD5Bounds[numFrames];
+	basePose		= new float[numJoints * 6];
+	jointChannels	= new unsigned int[numJoints + 1];
+	channels		= new MD5AnimChannel[numChannels];
+	keys			= new unsigned char[(size_t)keyBytes];
+
+	memcpy(bounds,			base + header->boundsOffset,		numFrames * sizeof(MD5Bounds));
+	memcpy(basePose,		base + header->basePoseOffset,		numJoints * 6 * sizeof(float));
+	memcpy(jointChannels,	fileJointChannels,					(numJoints + 1) * sizeof(unsigned int));
+	memcpy(channels,		fileChannels,						numChannels * sizeof(MD5AnimChannel));
+	memcpy(keys,			base + header->keysOffset,			(size_t)keyBytes);
+
+	return true;
+}
+
+bool MD5Anim::SaveBinaryMD5Anim(const std::string &filename, const std::string &textFilename) const	{
+	MD5BinaryAnimHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MD5_BINARY_ANIM_MAGIC, sizeof(MD5_BINARY_ANIM_MAGIC));
+	header.version					= MD5_BINARY_VERSION;
+	header.frameRate				= frameRate;
+	header.numJoints				= numJoints;
+	header.numFrames				= numFrames;
+	header.numAnimatedComponents	= numAnimatedComponents;
+	header.numChannels				= numChannels;
+	header.frameBits				= frameBits;
+
+	if(!MappedFile::GetFileInfo(textFilename, &header.srcSize, &header.srcTimestamp)) {
+		return false;
+	}
+
+	BinaryFileBuilder builder(sizeof(MD5BinaryAnimHeader));
+
+	std::vector<MD5BinaryAnimJoint> fileJoints(numJoints);
+	for(unsigned int i = 0; i < numJoints; ++i) {
+		fileJoints[i].nameOffset	= builder.Append(joints[i].name.data(), joints[i].name.size());
+		fileJoints[i].nameLength	= (uint32_t)joints[i].name.size();
+		fileJoints[i].parent		= joints[i].parent;
+		fileJoints[i].flags			= joints[i].flags;
+		fileJoints[i].frameIndex	= joints[i].frameIndex;
+	}
+
+	header.jointsOffset			= fileJoints.empty() ? 0 : builder.Append(&fileJoints[0], numJoints * sizeof(MD5BinaryAnimJoint));
+	header.boundsOffset			= builder.Append(bounds, numFrames * sizeof(MD5Bounds));
+	header.basePoseOffset		= builder.Append(basePose, numJoints * 6 * sizeof(float));
+	header.jointChannelsOffset	= builder.Append(jointChannels, (numJoints + 1) * sizeof(unsigned int));
+	header.channelsOffset		= builder.Append(channels, numChannels * sizeof(MD5AnimChannel));
+	header.keysOffset			= builder.Append(keys, GetKeyBytes());
+	builder.Write(0, &header, sizeof(header));
+
+	return builder.SaveToFile(filename);
 }
 
 /*
@@ -278,12 +606,19 @@ void MD5Anim::LoadMD5AnimFrame( std::ifstream &from, unsigned int &count)	{
 	int frameNum;
 	from >> frameNum;	//Stream in the current frame number
 
+	if(frameNum < 0 || frameNum >= (int)numFrames) {
+		return;			//There are more frames than the file said there'd be!
+	}
+
 	/*
 	Every frame has the same number of 'delta' floats - so even if a joint
 	is only modified in a single frame, it will have a delta value in every
-	frame.
+	frame. This means we can keep every frame's floats in the same array.
 	*/
-	frames[frameNum].components = new float[numAnimatedComponents];
+	if(!frameComponents) {
+		frameComponents = new float[numFrames * numAnimatedComponents];
+	}
+	frames[frameNum].components = &frameComponents[frameNum * numAnimatedComponents];
 
 	from >> tempLine;	//Load in the next line, which /should/ be "{"
 
@@ -307,105 +642,169 @@ void	MD5Anim::TransformSkeleton(MD5Skeleton &skel, unsigned int frameNum) {
 	to the required transforms to represent the desired frame of animation
 	*/
 
-	if(frameNum > numFrames) {	//This probably shouldn't ever happen!
+	if(frameNum >= numFrames) {	//This probably shouldn't ever happen!
 		return;
 	}
 
-	//Grab a reference to the frame data for the relevant frame
-	MD5Frame&frame = frames[frameNum];
-
 	//For each joint in the animation
 	for(unsigned int i = 0; i < numJoints; ++i) {
-		//Grab COPIES of the position and orientation of the baseframe joint
-		Vector3		animPos	 = baseFrame.positions[i];
-		Quaternion  animQuat = baseFrame.orientations[i];
+		Vector3		animPos;
+		Quaternion	animQuat;
+		SampleJoint(i, frameNum, frameNum, 0.0f, animPos, animQuat);
 
-		/*
-		Each frame has a number of 'delta' components, and each joint
-		uses a number of these components to update its position and
-		orientation. Whether or not each value is updated or not is
-		determined by the joints flags variable. The starting
-		component for each joint is determined by the frameIndex value
-		of the joint.
-
-		For each value of the joint (ie its 3 position values and its 3
-		orientation components (we don't bother with the 4th as we can 
-		reconstruct it) we check the flags to see if it should be updated,
-		update it if necessary, and increment a counter so we access the
-		next component.
+		SetSkeletonJoint(skel, i, animPos, animQuat);
+	}
+}
 
-		*/
+void	MD5Anim::SamplePose(float frame, MD5JointPose* out_pose) const {
+	if(numFrames == 0) {
+		return;
+	}
 
-		int j = 0;
+	unsigned int frameA = (unsigned int)max(frame, 0.0f);
+	if(frameA >= numFrames) {
+		frameA = numFrames - 1;
+	}
+	const unsigned int	frameB = (frameA + 1) % numFrames;
+	const float			factor = min(max(frame - (float)frameA, 0.0f), 1.0f);
 
-		if (joints[i].flags & MD5_ANIM_XPOS) {//X component of Position
-			animPos.x = frame.components[joints[i].frameIndex+j];
-			++j;
-		}
-	
-		if (joints[i].flags & MD5_ANIM_YPOS) {//Y component of Position
-			animPos.y = frame.components[joints[i].frameIndex+j];
-			++j;
-		}
-	
-		if (joints[i].flags & MD5_ANIM_ZPOS) {//Z component of Position
-			animPos.z = frame.components[joints[i].frameIndex+j];
-			++j;
-		}
-		
-		if (joints[i].flags & MD5_ANIM_XQUAT) {//X component of Orientation
-			animQuat.x = frame.components[joints[i].frameIndex+j];
-			++j;
-		}
-		
-		if (joints[i].flags & MD5_ANIM_YQUAT) {//Y component of Orientation
-			animQuat.y = frame.components[joints[i].frameIndex+j];
-			++j;
-		}
-		
-		if (joints[i].flags & MD5_ANIM_ZQUAT) {//Z component of Orientation
-			animQuat.z = frame.components[joints[i].frameIndex+j];
-			++j;
-		}
+	for(unsigned int i = 0; i < numJoints; ++i) {
+		SampleJoint(i, frameA, frameB, factor, out_pose[i].position, out_pose[i].orientation);
+	}
+}
 
-		animQuat.GenerateW(); //We only get updated x,y,z so must generate W again...
-		animQuat.Normalise(); //And we should probably normalise it, too, to keep to unit length
+void	MD5Anim::ApplyPose(const MD5JointPose* pose, MD5Skeleton &skel) const {
+	for(unsigned int i = 0; i < numJoints; ++i) {
+		SetSkeletonJoint(skel, i, pose[i].position, pose[i].orientation);
+	}
+}
 
-		//now we have a copy of the baseframe joint transformed to the animation pose, we can start
-		//applying it to the input skeleton.
+void	MD5Anim::BlendPoses(const MD5JointPose* a, const MD5JointPose* b, float factor, unsigned int numJoints, MD5JointPose* out_pose) {
+	for(unsigned int i = 0; i < numJoints; ++i) {
+		const Vector3		position	= a[i].position + (b[i].position - a[i].position) * factor;
+		Quaternion			orientation = Quaternion::Interpolate(a[i].orientation, b[i].orientation, factor);
+		orientation.Normalise();
 
-		//First, let's get a reference to the skeleton joint equating to the current baseframe joint
-		MD5Joint &skelJoint = skel.joints[i];
+		out_pose[i].position	= position;
+		out_pose[i].orientation = orientation;
+	}
+}
 
-		//I'm fairly sure this doesn't ever actually change...
-		skelJoint.parent	= joints[i].parent;
-		skelJoint.forceWorld = false;
+float	MD5Anim::GetFrameAtTime(float msec) const {
+	if(numFrames == 0 || frameRate == 0) {
+		return 0.0f;
+	}
 
-		//We'll set its position and orientation to the transformed baseframe variables
+	float frame = fmod(msec * frameRate / 1000.0f, (float)numFrames);
+	if(frame < 0.0f) {
+		frame += numFrames;
+	}
+	return frame;
+}
 
-		skelJoint.position		= animPos;
-		skelJoint.orientation	= animQuat;	
+size_t	MD5Anim::GetKeyframeMemory() const {
+	return GetKeyBytes()
+		+ numChannels * sizeof(MD5AnimChannel)
+		+ (numJoints + 1) * sizeof(unsigned int)
+		+ numJoints * 6 * sizeof(float);
+}
 
-		//Now to set the local transform of the current joint. We start by turning the orientation
-		//quaternion into a Matrix4, then we set the resulting matrix translation to the
-		//transformed baseframe position
+//Every key is at most 16 bits wide and starts somewhere within its first byte, so
+//it always fits in the 3 bytes from there; 2 bytes of padding keep that in bounds
+size_t	MD5Anim::GetKeyBytes() const {
+	return ((size_t)numFrames * frameBits + 7) / 8 + 2;
+}
 
-		skelJoint.localTransform		= animQuat.ToMatrix4();
-		skelJoint.localTransform.SetPositionVector(animPos);
+float	MD5Anim::ReadKey(unsigned int channel, unsigned int frame) const {
+	const MD5AnimChannel &c		= channels[channel];
+	const size_t			bit		= (size_t)frame * frameBits + c.bitOffset;
+	const unsigned char*	bytes	= &keys[bit >> 3];
+	const unsigned int		word	= bytes[0] | (bytes[1] << 8) | (bytes[2] << 16);
+	const unsigned int		key		= (word >> (bit & 7)) & ((1 << c.bits) - 1);
 
-		//If the joint has no parent (determined by a negative parent variable) we need to 
-		//transform the joint's transform to the correct rotation, using the conversion matrix
-		if(skelJoint.parent < 0) {	//Base Joint, so we're done
-			skelJoint.transform = MD5FileData::conversionMatrix * skelJoint.localTransform;
-		}
-		else{	
-			//If this joint /does/ have a parent, we transform the joint's transform by its
-			//parent transform. Note that we don't have to transform it by the conversion matrix
-			//again, as the parent node will already contain it, due to being propagated from 
-			//the root node. Matrices are fun!
-			MD5Joint &parent = skel.joints[skelJoint.parent];
-			skelJoint.transform = parent.transform * skelJoint.localTransform;
-		}
+	return c.min + key * c.scale;
+}
+
+/*
+Each joint takes the base frame's position and orientation, and then replaces
+whichever components have channels with the decoded channel values. Unlike the
+original per frame 'delta' components, there's no need to check the flags of
+each joint, as each channel knows which component it replaces. We only get the
+x, y and z values of the orientation, so its w must be regenerated.
+
+If we're between two frames, we do the same for the next frame, and then 
+interpolate the positions, and slerp the orientations.
+*/
+void	MD5Anim::SampleJoint(unsigned int joint, unsigned int frameA, unsigned int frameB, float factor, Vector3 &position, Quaternion &orientation) const {
+	float a[6];
+	memcpy(a, &basePose[joint * 6], sizeof(a));
+
+	const unsigned int firstChannel = jointChannels[joint];
+	const unsigned int lastChannel	= jointChannels[joint + 1];
+
+	for(unsigned int c = firstChannel; c < lastChannel; ++c) {
+		a[channels[c].component] = ReadKey(c, frameA);
+	}
+
+	position	= Vector3(a[0], a[1], a[2]);
+	orientation = Quaternion(a[3], a[4], a[5], 0.0f);
+	orientation.GenerateW(); //We only get updated x,y,z so must generate W again...
+	orientation.Normalise(); //And we should probably normalise it, too, to keep to unit length
+
+	if(factor <= 0.0f || frameA == frameB || firstChannel == lastChannel) {
+		return;
+	}
+
+	float b[6];
+	memcpy(b, a, sizeof(b));
+	for(unsigned int c = firstChannel; c < lastChannel; ++c) {
+		b[channels[c].component] = ReadKey(c, frameB);
+	}
+
+	Quaternion orientationB(b[3], b[4], b[5], 0.0f);
+	orientationB.GenerateW();
+	orientationB.Normalise();
+
+	position	= position + (Vector3(b[0], b[1], b[2]) - position) * factor;
+	orientation = Quaternion::Interpolate(orientation, orientationB, factor);
+	orientation.Normalise();
+}
+
+void	MD5Anim::SetSkeletonJoint(MD5Skeleton &skel, unsigned int joint, const Vector3 &animPos, const Quaternion &animQuat) const {
+	//now we have a copy of the baseframe joint transformed to the animation pose, we can start
+	//applying it to the input skeleton.
+
+	//First, let's get a reference to the skeleton joint equating to the current baseframe joint
+	MD5Joint &skelJoint = skel.joints[joint];
+
+	//I'm fairly sure this doesn't ever actually change...
+	skelJoint.parent	= joints[joint].parent;
+	skelJoint.forceWorld = false;
+
+	//We'll set its position and orientation to the transformed baseframe variables
+
+	skelJoint.position		= animPos;
+	skelJoint.orientation	= animQuat;	
+
+	//Now to set the local transform of the current joint. We start by turning the orientation
+	//quaternion into a Matrix4, then we set the resulting matrix translation to the
+	//transformed baseframe position
+
+	skelJoint.localTransform		= animQuat.ToMatrix4();
+	skelJoint.localTransform.SetPositionVector(animPos);
+
+	//If the joint has no parent (determined by a negative parent variable) we need to 
+	//transform the joint's transform to the correct rotation, using the conversion matrix
+	if(skelJoint.parent < 0) {	//Base Joint, so we're done
+		skelJoint.transform = MD5FileData::conversionMatrix * skelJoint.localTransform;
+	}
+	else{	
+		//If this joint /does/ have a parent, we transform the joint's transform by its
+		//parent transform. Note that we don't have to transform it by the conversion matrix
+		//again, as the parent node will already contain it, due to being propagated from 
+		//the root node. Matrices are fun!
+		MD5Joint &parent = skel.joints[skelJoint.parent];
+		skelJoint.transform = parent.transform * skelJoint.localTransform;
 	}
 }
 #endif
\ No newline at end of file
@@ -11,6 +11,18 @@ differences between this frame of animation and the base frame. Depending on
 the software used to export the MD5Anim, the baseframe might be 'empty',
 meaning each frame consist of every transform for every joint.
 
+Once loaded, the 'delta' components are compressed. Components that never
+actually change are folded into the base frame, and the rest are quantised
+to 16 bits within their own range, roughly halving the memory of each
+keyframe (or better, as plenty of exported components are constant). Sampling
+an animation can interpolate between frames (slerping the orientations), and
+poses from several animations can be blended together (see MD5Node).
+
+Just like MD5FileData, the first load of a text MD5Anim file compiles it into
+a packed binary file alongside it (MD5_BINARY_EXTENSION), holding the already
+compressed keyframes, so later loads are just a handful of memcpys out of the
+mapped binary file.
+
 -_-_-_-_-_-_-_,------,   
 _-_-_-_-_-_-_-|   /\_/\   NYANYANYAN
 -_-_-_-_-_-_-~|__( ^ .^) /
@@ -64,6 +76,22 @@ means the component changes.
 #define MD5_ANIM_YQUAT			16
 #define MD5_ANIM_ZQUAT			32
 
+/*
+Components whose values vary by less than this over the whole animation are
+treated as constant, and folded into the base frame rather than being stored
+for every frame.
+*/
+#define MD5_ANIM_CONSTANT_EPSILON	1e-6f
+
+/*
+Every other component is quantised to the fewest bits (at most MD5_ANIM_MAX_KEY_BITS)
+that keep the error of each key within these tolerances - in the file's units for
+positions, and per quaternion x/y/z component for orientations.
+*/
+#define MD5_ANIM_MAX_KEY_BITS			16
+#define MD5_ANIM_POSITION_TOLERANCE		1e-3f
+#define MD5_ANIM_ORIENTATION_TOLERANCE	5e-5f
+
 /*
 Every MD5Anim has a number of MD5AnimJoints. These are essentially the
 same as MD5Mesh joints, with an added bitmask, which determines which
@@ -111,7 +139,11 @@ Every MD5Anim is made up of a number of MD5Frame structs - one for each
 frame of the animation. It consists of an array of floats, which equate
 to the orientation and position changes from the baseframe for the current
 animation frame. Which component equates to each frame 'delta' is determined
-by the flags variable of the MD5AnimJoint
+by the flags variable of the MD5AnimJoint. The floats themselves are owned
+by the MD5Anim, which keeps every frame's components in a single array.
+
+The frames (and base frame) are only kept while loading in a text MD5Anim, 
+after which they are compressed into MD5AnimChannels.
 */
 struct MD5Frame {
 	float* components;
@@ -119,10 +151,30 @@ struct MD5Frame {
 	MD5Frame::MD5Frame() {
 		components = NULL;
 	}
+};
 
-	~MD5Frame() {
-		delete[] components;
-	};
+/*
+Each animated component (e.g. the y position of a joint) that changes during
+the animation becomes a channel. Every frame stores a key of 'bits' bits for
+each channel, which is decoded as min + key * scale. A channel's width depends
+on how far its values range, so a joint that barely moves needs few bits.
+*/
+struct MD5AnimChannel {
+	float			min;
+	float			scale;
+	unsigned int	component;	//0-2 are position x/y/z, 3-5 are orientation x/y/z
+	unsigned int	bits;		//Width of this channel's keys (1 - MD5_ANIM_MAX_KEY_BITS)
+	unsigned int	bitOffset;	//Where this channel's key starts within each frame's keys
+};
+
+/*
+The local position and orientation of a joint, as sampled from an MD5Anim.
+MD5Nodes sample a pose from each animation they are playing, blend them
+together, and then apply the result to their skeleton.
+*/
+struct MD5JointPose {
+	Vector3		position;
+	Quaternion	orientation;
 };
 
 //Tell the compiler that we need the MD5Skeleton structure compiled
@@ -140,20 +192,53 @@ public:
 	MD5Anim(std::string filename);
 	~MD5Anim(void);
 
+	//Compiles the given text MD5Anim file into the binary format, for loading in quickly later on
+	static bool		CompileBinary(const std::string &filename);
+
 	//Transforms the passed in skeleton to the correct positions and
 	//orientations for the desired frame
 	void	TransformSkeleton(MD5Skeleton &skel,  unsigned int frame);
 
+	//Samples the local pose of every joint at the given (fractional) frame, 
+	//interpolating between the two nearest frames. As all animations are
+	//assumed to be looping, the last frame is interpolated back to the first.
+	void	SamplePose(float frame, MD5JointPose* out_pose) const;
+
+	//Transforms the passed in skeleton to the given pose of this animation
+	void	ApplyPose(const MD5JointPose* pose, MD5Skeleton &skel) const;
+
+	//Blends from pose a (factor 0) to pose b (factor 1), out_pose can be the same as either
+	static void	BlendPoses(const MD5JointPose* a, const MD5JointPose* b, float factor, unsigned int numJoints, MD5JointPose* out_pose);
+
+	//Returns the (fractional) frame the animation will be at after the given time, wrapping around at the end
+	float	GetFrameAtTime(float msec) const;
+
 	//Returns the framerate
-	unsigned int	GetFrameRate() {return frameRate;}
+	unsigned int	GetFrameRate() const {return frameRate;}
 	//Returns the number of frames of animation
-	unsigned int	GetNumFrames() {return numFrames;}
+	unsigned int	GetNumFrames() const {return numFrames;}
+	//Returns the number of joints this animation moves
+	unsigned int	GetNumJoints() const {return numJoints;}
+
+	//Returns the size in bytes of the compressed keyframes
+	size_t			GetKeyframeMemory() const;
 
 protected:
+	//Creates an empty MD5Anim, used by CompileBinary
+	MD5Anim(void);
+
 	//Helper function used by the constructor to load in an MD5Anim from the 
-	//relevent file
+	//relevent file (or its compiled binary version)
 	void	LoadMD5Anim(std::string filename);
 
+	//Helper function for LoadMD5Anim to load in the text MD5Anim file
+	bool	LoadTextMD5Anim(const std::string &filename);
+
+	//Helper functions for LoadMD5Anim to load or save the compiled binary version, which
+	//is only used if it is up to date with the text file (if there is one)
+	bool	LoadBinaryMD5Anim(const std::string &filename, const std::string &textFilename);
+	bool	SaveBinaryMD5Anim(const std::string &filename, const std::string &textFilename) const;
+
 	//Helper function for LoadMD5Anim to load in the joints
 	void	LoadMD5AnimHierarchy(std::ifstream &from, unsigned int &count);
 
@@ -166,6 +251,21 @@ protected:
 	//Helper function for LoadMD5Anim to load in animation frames
 	void	LoadMD5AnimFrame(std::ifstream &from, unsigned int &count);
 
+	//Helper function for LoadTextMD5Anim to compress the loaded frames into channels
+	void	CompressFrames();
+
+	//Size of the packed keys, including the padding ReadKey may read past the last key
+	size_t	GetKeyBytes() const;
+
+	//Decodes the value of a channel at the given frame
+	float	ReadKey(unsigned int channel, unsigned int frame) const;
+
+	//Decodes the local position and orientation of a joint, 'factor' of the way from frameA to frameB
+	void	SampleJoint(unsigned int joint, unsigned int frameA, unsigned int frameB, float factor, Vector3 &position, Quaternion &orientation) const;
+
+	//Sets the local and world transforms of a joint of the skeleton
+	void	SetSkeletonJoint(MD5Skeleton &skel, unsigned int joint, const Vector3 &position, const Quaternion &orientation) const;
+
 	unsigned int	frameRate;		//Required framerate of this animation
 	unsigned int	numJoints;		//Number of joints in this animation
 	unsigned int	numFrames;		//Number of frames in this animation
@@ -173,7 +273,19 @@ protected:
 
 	MD5AnimJoint*	joints;			//Array of joints for this animation
 	MD5Bounds*		bounds;			//Array of bounding boxes for this animation
-	MD5Frame*		frames;			//Array of individual frames for this animation
-	MD5BaseFrame	baseFrame;		//BaseFrame for this animation
+	MD5Frame*		frames;			//Array of individual frames for this animation (only while loading)
+	float*			frameComponents;//Delta components of every frame (numFrames * numAnimatedComponents, only while loading)
+	MD5BaseFrame	baseFrame;		//BaseFrame for this animation (only while loading)
+
+	/*
+	The compressed keyframes. Channels are sorted by joint, so the channels of
+	joint i are jointChannels[i] up to jointChannels[i+1].
+	*/
+	unsigned int	numChannels;	//Number of components that change during the animation
+	MD5AnimChannel*	channels;		//Range of each channel
+	unsigned int*	jointChannels;	//First channel of each joint (numJoints + 1)
+	unsigned int	frameBits;		//Total width of every channel's key, so frame f's keys start at bit f * frameBits
+	unsigned char*	keys;			//Quantised channel values, packed together bit by bit (GetKeyBytes() bytes)
+	float*			basePose;		//Position and orientation x/y/z of each joint (numJoints * 6), with any constant components applied
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,192 @@
+#include "MD5Crowd.h"
+#ifdef WEEK_2_CODE
+#include <algorithm>
+#include <cstring>
+
+MD5Crowd::MD5Crowd(void)	{
+	fullRateDistance	= MD5_CROWD_FULL_RATE_DISTANCE;
+	updateCount			= 0;
+	numUsedPoses		= 0;
+	numPosedNodes		= 0;
+	numEvaluatedPoses	= 0;
+}
+
+MD5Crowd::~MD5Crowd(void)	{
+	for(unsigned int i = 0; i < nodes.size(); ++i) {
+		nodes[i]->crowd		= NULL;
+		nodes[i]->poseStamp = 0;
+	}
+
+	for(unsigned int i = 0; i < sharedPoses.size(); ++i) {
+		delete sharedPoses[i];
+	}
+}
+
+void	MD5Crowd::AddNode(MD5Node* node)	{
+	if(node->crowd == this) {
+		return;
+	}
+	if(node->crowd) {
+		node->crowd->RemoveNode(node);
+	}
+
+	node->crowd = this;
+	nodes.push_back(node);
+#ifdef MD5_USE_HARDWARE_SKINNING
+	node->skinTransforms.clear();	//Built again when the crowd first poses it
+#endif
+}
+
+bool	MD5Crowd::RemoveNode(MD5Node* node)	{
+	std::vector<MD5Node*>::iterator i = std::find(nodes.begin(), nodes.end(), node);
+	if(i == nodes.end()) {
+		return false;
+	}
+
+	node->crowd		= NULL;
+	node->poseStamp = 0;
+	nodes.erase(i);
+	return true;
+}
+
+unsigned int	MD5Crowd::NextPoseStamp()	{
+	static unsigned int stamp = 0;
+	if(++stamp == 0) {
+		++stamp;	//0 means 'not shared'
+	}
+	return stamp;
+}
+
+void	MD5Crowd::Update(float msec, const Vector3 &cameraPos, const Frustum* frustum)	{
+	++updateCount;
+
+	posedNodes.clear();
+	sharedPoseLookup.clear();
+	numUsedPoses = 0;
+
+	const float fullRateDistanceSq = fullRateDistance * fullRateDistance;
+
+	/*
+	First, move on every node's animation, and work out which of them need posing
+	this update. Those that can share a pose are grouped together by animation and
+	(rounded) frame.
+	*/
+	for(unsigned int i = 0; i < nodes.size(); ++i) {
+		MD5Node* node = nodes[i];
+		node->AdvanceAnim(msec);
+
+		if(!node->GetCurrentAnim()) {
+			continue;
+		}
+
+		unsigned int interval = 1;
+		if(frustum && !frustum->InsideFrustum(*node)) {
+			interval = MD5_CROWD_OFFSCREEN_INTERVAL;
+		}
+		else {
+			//Each doubling of the distance halves the update rate
+			const float distanceSq = (node->GetWorldTransform().GetPositionVector() - cameraPos).LengthSquared();
+			float bandDistanceSq = fullRateDistanceSq * 4.0f;
+			while(distanceSq > fullRateDistanceSq && interval < MD5_CROWD_MAX_INTERVAL) {
+				interval *= 2;
+				if(distanceSq <= bandDistanceSq) {
+					break;
+				}
+				bandDistanceSq *= 4.0f;
+			}
+		}
+
+		//Using the node index staggers the updates of nodes with the same interval
+		if((updateCount + i) % interval != 0) {
+			continue;
+		}
+
+		PosedNode posed;
+		posed.node			= node;
+		posed.sharedPose	= -1;
+
+		if(node->IsPoseShareable()) {
+			MD5Anim* anim	= node->GetCurrentAnim();
+			const int step	= (int)(anim->GetFrameAtTime(node->GetCurrentAnimTime()) * MD5_CROWD_FRAME_STEPS);
+
+			std::pair<std::map<std::pair<MD5Anim*, int>, int>::iterator, bool> result =
+				sharedPoseLookup.insert(std::make_pair(std::make_pair(anim, step), (int)numUsedPoses));
+
+			if(result.second) {
+				if(numUsedPoses == sharedPoses.size()) {
+					sharedPoses.push_back(new SharedPose());
+				}
+				SharedPose* shared	= sharedPoses[numUsedPoses++];
+				shared->anim		= anim;
+				shared->frame		= step / (float)MD5_CROWD_FRAME_STEPS;
+				shared->stamp		= NextPoseStamp();
+
+				if(shared->skeleton.numJoints != node->currentSkeleton.numJoints) {
+					delete[] shared->skeleton.joints;
+					shared->skeleton.numJoints	= node->currentSkeleton.numJoints;
+					shared->skeleton.joints		= new MD5Joint[shared->skeleton.numJoints];
+				}
+				//Copy the names etc over, so the skeleton matches the nodes' skeletons
+				memcpy((void*)shared->skeleton.joints, (void*)node->currentSkeleton.joints, sizeof(MD5Joint) * shared->skeleton.numJoints);
+				shared->pose.resize(anim->GetNumJoints());
+#ifdef MD5_USE_HARDWARE_SKINNING
+				shared->data = &node->sourceData;
+#endif
+			}
+			posed.sharedPose = result.first->second;
+		}
+
+		posedNodes.push_back(posed);
+	}
+
+	/*
+	Now sample each shared pose once...
+	*/
+	const int numShared = (int)numUsedPoses;
+#pragma omp parallel for
+	for(int i = 0; i < numShared; ++i) {
+		SharedPose* shared = sharedPoses[i];
+		shared->anim->SamplePose(shared->frame, &shared->pose[0]);
+		shared->anim->ApplyPose(&shared->pose[0], shared->skeleton);
+#ifdef MD5_USE_HARDWARE_SKINNING
+		shared->skinTransforms.resize(shared->data->GetNumSkinTransforms());
+		shared->data->BuildSkinTransforms(shared->skeleton, &shared->skinTransforms[0]);
+#endif
+	}
+
+	/*
+	...and then either copy it over to each of the nodes using it, or have the
+	node pose itself if it couldn't share one.
+	*/
+	const int numPosed = (int)posedNodes.size();
+#pragma omp parallel for
+	for(int i = 0; i < numPosed; ++i) {
+		MD5Node* node = posedNodes[i].node;
+
+		if(posedNodes[i].sharedPose < 0) {
+			node->UpdatePose();
+#ifdef MD5_USE_HARDWARE_SKINNING
+			node->skinTransforms.resize(node->sourceData.GetNumSkinTransforms());
+			node->sourceData.BuildSkinTransforms(node->currentSkeleton, &node->skinTransforms[0]);
+#endif
+		}
+		else {
+			const SharedPose* shared = sharedPoses[posedNodes[i].sharedPose];
+			memcpy((void*)node->currentSkeleton.joints, (void*)shared->skeleton.joints, sizeof(MD5Joint) * shared->skeleton.numJoints);
+			node->poseStamp = shared->stamp;
+#ifdef MD5_USE_HARDWARE_SKINNING
+			//Copied, as the shared pose will be reused for something else next update, while this node may not be
+			node->skinTransforms = shared->skinTransforms;
+#endif
+		}
+	}
+
+	numPosedNodes		= numPosed;
+	numEvaluatedPoses	= numShared;
+	for(int i = 0; i < numPosed; ++i) {
+		if(posedNodes[i].sharedPose < 0) {
+			++numEvaluatedPoses;
+		}
+	}
+}
+#endif
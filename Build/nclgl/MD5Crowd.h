@@ -0,0 +1,115 @@
+/******************************************************************************
+Class:MD5Crowd
+Implements:
+Author:Pieran Marris <p.marris@newcastle.ac.uk>
+Description: Animates a large number of MD5Nodes together, for crowds of
+characters.
+
+Every MD5Node animating itself means posing every skeleton every frame, even
+when lots of them are playing the same animation at the same point, or are so
+far away (or off screen) that nobody would notice them being a bit choppy.
+Once a node has been added to a crowd, the crowd takes over its animation:
+
+ - Every node's animation time moves on every update, but nodes further from
+   the camera than MD5_CROWD_FULL_RATE_DISTANCE only have their pose updated
+   every 2nd, 4th or 8th update, and nodes outside of the frustum only every
+   MD5_CROWD_OFFSCREEN_INTERVAL updates. Updates are staggered, so the nodes
+   with the same rate don't all update on the same frame.
+
+ - Nodes that are just playing a single animation (no blending or crossfades)
+   at the same point of the same animation (to within 1/MD5_CROWD_FRAME_STEPS
+   of a frame) share one skeleton, which is only posed once, and copied over.
+   In software skinning mode, nodes with a shared pose also don't have to skin
+   their mesh again if it was last skinned with the same pose.
+
+ - The shared poses, and then every node that needs updating, are handled in
+   parallel.
+
+ - With hardware skinning, the skinning transforms each node sends to the
+   shader are built along with its pose (once for each shared pose), so the
+   only skinning work left for each node when it is drawn is uploading them,
+   which is skipped if the last node drawn with the same mesh had the same
+   shared pose. Software skinning can't be split up like this, as every node
+   of a mesh skins into the same vertex buffers when it is drawn.
+
+-_-_-_-_-_-_-_,------,
+_-_-_-_-_-_-_-|   /\_/\   NYANYANYAN
+-_-_-_-_-_-_-~|__( ^ .^) /
+_-_-_-_-_-_-_-""  ""
+
+*//////////////////////////////////////////////////////////////////////////////
+#include "common.h"
+#ifdef WEEK_2_CODE
+#pragma once
+
+#include "MD5Node.h"
+#include "Frustum.h"
+#include <vector>
+#include <map>
+
+#define MD5_CROWD_FULL_RATE_DISTANCE	30.0f	//Nodes closer than this to the camera are posed every update
+#define MD5_CROWD_MAX_INTERVAL			8		//Furthest nodes are posed every this many updates
+#define MD5_CROWD_OFFSCREEN_INTERVAL	16		//Nodes outside of the frustum are posed every this many updates
+#define MD5_CROWD_FRAME_STEPS			4		//Nodes within 1/this of a frame of each other share a pose
+
+class MD5Crowd	{
+public:
+	MD5Crowd(void);
+	~MD5Crowd(void);
+
+	//Adds a node to the crowd, which will then animate it rather than the node animating itself
+	void	AddNode(MD5Node* node);
+	bool	RemoveNode(MD5Node* node);
+
+	/*
+	Moves on the animation of every node, and poses those that need it. Should
+	be called before the scene graph is updated. The frustum is optional, if
+	not given all nodes are treated as being on screen.
+	*/
+	void	Update(float msec, const Vector3 &cameraPos, const Frustum* frustum = NULL);
+
+	//Distance within which nodes are posed every update, scaling all of the other distances with it
+	void	SetFullRateDistance(float distance) { fullRateDistance = distance; }
+
+	//Stats for the last update
+	unsigned int	GetNumNodes()			const { return (unsigned int)nodes.size(); }
+	unsigned int	GetNumPosedNodes()		const { return numPosedNodes; }		//Nodes that had their pose updated
+	unsigned int	GetNumEvaluatedPoses()	const { return numEvaluatedPoses; }	//Poses actually sampled, including each shared pose once
+
+protected:
+	//A pose shared between all nodes at the same point of the same animation
+	struct SharedPose {
+		MD5Anim*					anim;
+		float						frame;
+		unsigned int				stamp;
+		std::vector<MD5JointPose>	pose;
+		MD5Skeleton					skeleton;
+#ifdef MD5_USE_HARDWARE_SKINNING
+		const MD5FileData*			data;
+		std::vector<Matrix4>		skinTransforms;
+#endif
+	};
+
+	//The node, and which shared pose it uses (or -1 if it has its own pose)
+	struct PosedNode {
+		MD5Node*	node;
+		int			sharedPose;
+	};
+
+	//Gets the next stamp to identify a shared pose with, unique between every crowd
+	static unsigned int		NextPoseStamp();
+
+	std::vector<MD5Node*>		nodes;
+	float						fullRateDistance;
+	unsigned int				updateCount;
+
+	//Working space for each update, kept around so we're not allocating every frame
+	std::vector<SharedPose*>	sharedPoses;		//Only the first numUsedPoses are used this update
+	unsigned int				numUsedPoses;
+	std::vector<PosedNode>		posedNodes;
+	std::map<std::pair<MD5Anim*, int>, int>	sharedPoseLookup;
+
+	unsigned int				numPosedNodes;
+	unsigned int				numEvaluatedPoses;
+};
+#endif
\ No newline at end of file
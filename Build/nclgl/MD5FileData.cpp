@@ -1,5 +1,9 @@
 #include "MD5FileData.h"
 #ifdef WEEK_2_CODE
+#include "MappedFile.h"
+#include "ResourceRegistry.h"
+#include "MeshProcessing.h"
+#include <cstring>
 /*
 http://www.modwiki.net/wiki/MD5MESH_%28file_format%29
 */
@@ -21,11 +25,152 @@ static class variables must still be instantiated somewhere!!!
 */
 const Matrix4 MD5FileData::conversionMatrix			= Matrix4(matrixElements);
 
-MD5FileData::MD5FileData(const std::string &filename)	{
+/*
+Layout of the compiled binary MD5Mesh file: an MD5BinaryMeshHeader, followed
+by the blocks of data it points to. All offsets are in bytes from the start of
+the file.
+*/
+struct MD5BinaryMeshHeader {
+	char		magic[4];
+	uint32_t	version;
+	uint64_t	srcSize;			//Size and modification time of the text file this was compiled from
+	uint64_t	srcTimestamp;
+	uint32_t	numJoints;
+	uint32_t	numSubMeshes;
+	uint64_t	jointsOffset;		//MD5BinaryJoint[numJoints]
+	uint64_t	subMeshesOffset;	//MD5BinarySubMesh[numSubMeshes]
+};
+
+struct MD5BinaryJoint {
+	uint64_t	nameOffset;
+	uint32_t	nameLength;
+	int32_t		parent;
+	float		position[3];
+	float		orientation[4];
+};
+
+struct MD5BinarySubMesh {
+	uint32_t	numVerts;
+	uint32_t	numTris;
+	uint32_t	numWeights;
+	uint32_t	shaderLength;
+	uint64_t	vertsOffset;		//MD5Vert[numVerts]
+	uint64_t	trisOffset;			//MD5Tri[numTris]
+	uint64_t	weightsOffset;		//MD5Weight[numWeights]
+	uint64_t	shaderOffset;
+};
+
+static const char MD5_BINARY_MESH_MAGIC[4] = { 'N', 'M', 'D', '5' };
+
+/*
+Builds the bind pose transform of a joint from its position and orientation.
+We need to further transform this matrix by the conversionmatrix so that the
+rotation is in OpenGL space.
+*/
+static void BuildJointTransform(MD5Joint &joint) {
+	joint.transform = joint.orientation.ToMatrix4();
+	joint.transform.SetPositionVector(joint.position);
+
+	joint.transform = MD5FileData::conversionMatrix * joint.transform;
+
+	joint.localTransform = joint.transform;
+}
+
+MD5FileData::MD5FileData(void)	{
+	rootMesh		= NULL;
+	subMeshes		= NULL;
+	numSubMeshes	= 0;
+
+#ifdef MD5_USE_HARDWARE_SKINNING 
+	weightBuffer		= 0;
+	transformBuffer		= 0;
+	weightTexture		= 0;
+	transformTexture	= 0;
+	transforms			= NULL;
+	weightings			= NULL;
+	uploadedPoseStamp	= 0;
+#endif
+}
+
+MD5FileData::MD5FileData(const std::string &filename) : MD5FileData()	{
+	if(LoadMD5Mesh(filename)) {
+		Upload();
+	}
+}
+
+MD5FileData*	MD5FileData::Decode(const std::string &filename)	{
+	MD5FileData* data = new MD5FileData();
+	if(!data->LoadMD5Mesh(filename)) {
+		delete data;
+		return NULL;
+	}
+	return data;
+}
+
+bool MD5FileData::LoadMD5Mesh(const std::string &filename)	{
+	//Use the compiled version of the file if it's up to date, otherwise load the text
+	//file and compile it, so it'll be quicker next time
+	const std::string binaryFilename = filename + MD5_BINARY_EXTENSION;
+
+	if(!LoadBinaryMD5Mesh(binaryFilename, filename)) {
+		if(!LoadTextMD5Mesh(filename)) {
+			return false; //Oh dear!
+		}
+		SaveBinaryMD5Mesh(binaryFilename, filename);
+	}
+
+	BuildSkinningData();
+
+	//Read the shader proxies (and decode their textures) here too, so all Upload has to do is create things in OpenGL
+	for(unsigned int i = 0; i < numSubMeshes; ++i) {
+		if(!subMeshes[i].shader.empty()) {
+			LoadShaderProxy(subMeshes[i].shader, subMeshes[i]);
+		}
+	}
+	return true;
+}
+
+void MD5FileData::Upload()	{
+	if(IsUploaded()) {
+		return;
+	}
+
+	//Load in the textures used by each submesh, through the ResourceRegistry so characters sharing a
+	//texture only load it once. As long as we actually delete the MD5Mesh, these textures will
+	//eventually be released, as they'll end up applied to the Mesh texture values.
+	for(unsigned int i = 0; i < numSubMeshes; ++i) {
+		if(!subMeshes[i].diffuseMap.empty()) {
+			subMeshes[i].texIndex = decodedTextures.Acquire(subMeshes[i].diffuseMap, SOIL_FLAG_MIPMAPS);// | SOIL_FLAG_COMPRESS_TO_DXT
+		}
+#ifdef MD5_USE_TANGENTS_BUMPMAPS
+		if(!subMeshes[i].bumpMap.empty()) {
+			subMeshes[i].bumpIndex = decodedTextures.Acquire(subMeshes[i].bumpMap, SOIL_FLAG_MIPMAPS | 0);
+		}
+#endif
+	}
+	decodedTextures.Clear();
+
+	//Everything is OK! let's create our submeshes :)
+	CreateMeshes();
+
+
+#ifdef MD5_USE_HARDWARE_SKINNING 
+	//Create the Texture Buffer Objects for this mesh
+	CreateTBOs();
+#endif
+}
+
+bool MD5FileData::CompileBinary(const std::string &filename)	{
+	MD5FileData data;
+	return data.LoadTextMD5Mesh(filename)
+		&& data.SaveBinaryMD5Mesh(filename + MD5_BINARY_EXTENSION, filename);
+}
+
+bool MD5FileData::LoadTextMD5Mesh(const std::string &filename)	{
 	std::ifstream f(filename,std::ios::in);	//MD5 files are text based, so don't make it an ios::binary ifstream...
 
 	if(!f) {
-		return; //Oh dear!
+		return false; //Oh dear!
 	}
 
 	//We have our MD5 file handle!
@@ -54,25 +199,24 @@ MD5FileData::MD5FileData(const std::string &filename)	{
 			//We've found the MD5 version string!
 			//ifstream allows us to stream ints,floats etc into variables
 			f >> md5Version;
-			std::cout << "MD5 File version is: " << md5Version << std::endl;
 		}
 		else if(currentLine.find(MD5_COMMANDLINE_TAG) != std::string::npos) {
 			/*
 			MD5Mesh files sometimes have a 'command line' value, used by the game
 			toolchain to generate some data. We don't care about it!
 			*/
-			std::cout << "Ignoring commandline value" << std::endl;
 			getline(f,currentLine);
 		}
 		else if(currentLine.find(MD5_NUMJOINTS_TAG) != std::string::npos) {
 			f >> numExpectedJoints; //Load in the number of joints held in this MD5Mesh file
-			std::cout << "Expecting file to have " << numExpectedJoints << " joints" << std::endl;
 			//grab enough space for this number of joints
 			bindPose.joints = new MD5Joint[numExpectedJoints];
+
+			//Joints keep pointers to their names, so the names must never be reallocated
+			jointNames.reserve(numExpectedJoints);
 		}
 		else if(currentLine.find(MD5_NUMMESHES_TAG) != std::string::npos) {
 			f >> numExpectedMeshes; //load in the number of submeshes held in this md5mesh
-			std::cout << "Expecting file to have " << numExpectedMeshes << " meshes" << std::endl;
 
 			subMeshes = new MD5SubMesh[numExpectedMeshes];
 		}
@@ -95,22 +239,190 @@ MD5FileData::MD5FileData(const std::string &filename)	{
 	//
 	if(numLoadedJoints != numExpectedJoints) {
 		std::cout << "Expected " << numExpectedJoints << " joints, but loaded " << numLoadedJoints << std::endl;
-		return;
+		return false;
 	}
 
 	if(numLoadedMeshes != numExpectedMeshes) {
 		std::cout << "Expected " << numExpectedMeshes << " meshes, but loaded " << numLoadedMeshes << std::endl;
-		return;
+		return false;
 	}
 
-	//Everything is OK! let's create our submeshes :)
-	CreateMeshes();
+	return true;
+}
 
+/*
+The skinning code indexes straight into the weight and joint arrays, so a
+binary file with a bad index in it would read (or write) past the end of them.
+Every index is checked here, and if any are wrong the text file is loaded instead.
+*/
+static bool ValidBinarySubMesh(const char* base, const MD5BinarySubMesh &m, uint numJoints)	{
+	const MD5Vert*		verts	= (const MD5Vert*)(base + m.vertsOffset);
+	const MD5Tri*		tris	= (const MD5Tri*)(base + m.trisOffset);
+	const MD5Weight*	weights	= (const MD5Weight*)(base + m.weightsOffset);
+
+	for(uint i = 0; i < m.numVerts; ++i) {
+		if(verts[i].weightIndex < 0 || verts[i].weightElements < 0
+			|| (uint64_t)verts[i].weightIndex + (uint64_t)verts[i].weightElements > m.numWeights) {
+			return false;
+		}
+	}
+	for(uint i = 0; i < m.numWeights; ++i) {
+		if(weights[i].jointIndex < 0 || (uint)weights[i].jointIndex >= numJoints) {
+			return false;
+		}
+	}
+	for(uint i = 0; i < m.numTris; ++i) {
+		if(tris[i].a >= m.numVerts || tris[i].b >= m.numVerts || tris[i].c >= m.numVerts) {
+			return false;
+		}
+	}
+	return true;
+}
 
-#ifdef MD5_USE_HARDWARE_SKINNING 
-	//Create the Texture Buffer Objects for this mesh
-	CreateTBOs();
-#endif
+bool MD5FileData::LoadBinaryMD5Mesh(const std::string &filename, const std::string &textFilename)	{
+	MappedFile file;
+	if(!file.Open(filename) || file.GetSize() < sizeof(MD5BinaryMeshHeader)) {
+		return false;
+	}
+
+	const char* base = file.GetData();
+	const MD5BinaryMeshHeader* header = (const MD5BinaryMeshHeader*)base;
+
+	if(memcmp(header->magic, MD5_BINARY_MESH_MAGIC, sizeof(MD5_BINARY_MESH_MAGIC)) != 0
+		|| header->version != MD5_BINARY_VERSION) {
+		return false;
+	}
+
+	//If the text file has been changed since it was compiled, the binary file is out of date. If there
+	//is no text file at all, we'll just have to trust it!
+	uint64_t srcSize, srcTimestamp;
+	if(MappedFile::GetFileInfo(textFilename, &srcSize, &srcTimestamp)
+		&& (header->srcSize != srcSize || header->srcTimestamp != srcTimestamp)) {
+		return false;
+	}
+
+	if(!file.Contains(header->jointsOffset, (uint64_t)header->numJoints * sizeof(MD5BinaryJoint))
+		|| !file.Contains(header->subMeshesOffset, (uint64_t)header->numSubMeshes * sizeof(MD5BinarySubMesh))) {
+		return false;
+	}
+
+	const MD5BinaryJoint*	joints	= (const MD5BinaryJoint*)(base + header->jointsOffset);
+	const MD5BinarySubMesh*	meshes	= (const MD5BinarySubMesh*)(base + header->subMeshesOffset);
+
+	//Check everything is where it should be before allocating anything
+	for(uint i = 0; i < header->numJoints; ++i) {
+		if(!file.Contains(joints[i].nameOffset, joints[i].nameLength)
+			|| joints[i].parent < -1 || joints[i].parent >= (int32_t)header->numJoints) {
+			return false;
+		}
+	}
+
+	for(uint i = 0; i < header->numSubMeshes; ++i) {
+		const MD5BinarySubMesh &m = meshes[i];
+		if(!file.Contains(m.vertsOffset, (uint64_t)m.numVerts * sizeof(MD5Vert))
+			|| !file.Contains(m.trisOffset, (uint64_t)m.numTris * sizeof(MD5Tri))
+			|| !file.Contains(m.weightsOffset, (uint64_t)m.numWeights * sizeof(MD5Weight))
+			|| !file.Contains(m.shaderOffset, m.shaderLength)
+			|| !ValidBinarySubMesh(base, m, header->numJoints)) {
+			return false;
+		}
+	}
+
+	bindPose.numJoints	= header->numJoints;
+	bindPose.joints		= new MD5Joint[header->numJoints];
+	jointNames.resize(header->numJoints);
+
+	for(uint i = 0; i < header->numJoints; ++i) {
+		const MD5BinaryJoint &from	= joints[i];
+		MD5Joint &joint				= bindPose.joints[i];
+
+		jointNames[i].assign(base + from.nameOffset, from.nameLength);
+
+		joint.name			= &jointNames[i];
+		joint.parent		= from.parent;
+		joint.forceWorld	= 0;
+		joint.position		= Vector3(from.position[0], from.position[1], from.position[2]);
+		joint.orientation	= Quaternion(from.orientation[0], from.orientation[1], from.orientation[2], from.orientation[3]);
+
+		BuildJointTransform(joint);
+	}
+
+	numSubMeshes	= header->numSubMeshes;
+	subMeshes		= new MD5SubMesh[numSubMeshes];
+
+	for(uint i = 0; i < numSubMeshes; ++i) {
+		const MD5BinarySubMesh &from	= meshes[i];
+		MD5SubMesh &m					= subMeshes[i];
+
+		m.numverts		= from.numVerts;
+		m.numtris		= from.numTris;
+		m.numweights	= from.numWeights;
+
+		m.verts			= new MD5Vert[m.numverts];
+		m.tris			= new MD5Tri[m.numtris];
+		m.weights		= new MD5Weight[m.numweights];
+
+		memcpy(m.verts,   base + from.vertsOffset,   m.numverts	  * sizeof(MD5Vert));
+		memcpy(m.tris,    base + from.trisOffset,    m.numtris	  * sizeof(MD5Tri));
+		memcpy(m.weights, base + from.weightsOffset, m.numweights * sizeof(MD5Weight));
+
+		m.shader.assign(base + from.shaderOffset, from.shaderLength);
+	}
+
+	return true;
+}
+
+bool MD5FileData::SaveBinaryMD5Mesh(const std::string &filename, const std::string &textFilename) const	{
+	MD5BinaryMeshHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MD5_BINARY_MESH_MAGIC, sizeof(MD5_BINARY_MESH_MAGIC));
+	header.version		= MD5_BINARY_VERSION;
+	header.numJoints	= bindPose.numJoints;
+	header.numSubMeshes	= numSubMeshes;
+
+	if(!MappedFile::GetFileInfo(textFilename, &header.srcSize, &header.srcTimestamp)) {
+		return false;
+	}
+
+	BinaryFileBuilder builder(sizeof(MD5BinaryMeshHeader));
+
+	std::vector<MD5BinaryJoint> joints(bindPose.numJoints);
+	for(int i = 0; i < bindPose.numJoints; ++i) {
+		const MD5Joint &from	= bindPose.joints[i];
+		MD5BinaryJoint &joint	= joints[i];
+
+		joint.nameOffset		= builder.Append(from.name->data(), from.name->size());
+		joint.nameLength		= (uint32_t)from.name->size();
+		joint.parent			= from.parent;
+		joint.position[0]		= from.position.x;
+		joint.position[1]		= from.position.y;
+		joint.position[2]		= from.position.z;
+		joint.orientation[0]	= from.orientation.x;
+		joint.orientation[1]	= from.orientation.y;
+		joint.orientation[2]	= from.orientation.z;
+		joint.orientation[3]	= from.orientation.w;
+	}
+
+	std::vector<MD5BinarySubMesh> meshes(numSubMeshes);
+	for(unsigned int i = 0; i < numSubMeshes; ++i) {
+		const MD5SubMesh &from	= subMeshes[i];
+		MD5BinarySubMesh &m		= meshes[i];
+
+		m.numVerts		= from.numverts;
+		m.numTris		= from.numtris;
+		m.numWeights	= from.numweights;
+		m.shaderLength	= (uint32_t)from.shader.size();
+		m.vertsOffset	= builder.Append(from.verts,   from.numverts   * sizeof(MD5Vert));
+		m.trisOffset	= builder.Append(from.tris,    from.numtris    * sizeof(MD5Tri));
+		m.weightsOffset	= builder.Append(from.weights, from.numweights * sizeof(MD5Weight));
+		m.shaderOffset	= builder.Append(from.shader.data(), from.shader.size());
+	}
+
+	header.jointsOffset		= joints.empty() ? 0 : builder.Append(&joints[0], joints.size() * sizeof(MD5BinaryJoint));
+	header.subMeshesOffset	= meshes.empty() ? 0 : builder.Append(&meshes[0], meshes.size() * sizeof(MD5BinarySubMesh));
+	builder.Write(0, &header, sizeof(header));
+
+	return builder.SaveToFile(filename);
 }
 
 MD5FileData::~MD5FileData(void)	{
@@ -118,13 +430,18 @@ MD5FileData::~MD5FileData(void)	{
 	for(std::map<std::string,MD5Anim*>::iterator i = animations.begin(); i != animations.end(); ++i) {
 		delete i->second;
 	}
+	delete[] subMeshes;
+
 	//Delete the additional data used when doing hardware skinning.
+	//(These won't exist if the file only got as far as being compiled)
 #ifdef MD5_USE_HARDWARE_SKINNING 
-	glDeleteBuffers(1, &weightBuffer);
-	glDeleteBuffers(1, &transformBuffer);
+	if(weightBuffer) {
+		glDeleteBuffers(1, &weightBuffer);
+		glDeleteBuffers(1, &transformBuffer);
 
-	glDeleteTextures(1, &weightTexture);
-	glDeleteTextures(1, &transformTexture);
+		glDeleteTextures(1, &weightTexture);
+		glDeleteTextures(1, &transformTexture);
+	}
 
 	delete[] transforms;
 	delete[] weightings;
@@ -263,29 +580,21 @@ void	MD5FileData::LoadShaderProxy(std::string filename, MD5SubMesh &m) {
 	to add support to load them from a proxy file, too.
 	*/
 
-	string  diffuseMap;
-	f >> diffuseMap;
+	f >> m.diffuseMap;
 #ifdef MD5_USE_TANGENTS_BUMPMAPS
-	string	bumpMap;
-	f >> bumpMap;
+	f >> m.bumpMap;
 #endif
 
 	f.close();	//That's all that's in the file, so we can close it.
 
-
-	//Load in the textures using SOIL. As long as we actually delete the MD5Mesh, these
-	//textures will eventually be deleted from the OGL context, as they'll end up applied
-	//to the Mesh texture values.
-	m.texIndex = SOIL_load_OGL_texture(
-		diffuseMap.c_str(),
-		SOIL_LOAD_AUTO,SOIL_CREATE_NEW_ID,SOIL_FLAG_MIPMAPS// | SOIL_FLAG_COMPRESS_TO_DXT
-	);
-
+	//Decoding the images doesn't need OpenGL, so is done now rather than in Upload
+	if(!m.diffuseMap.empty()) {
+		decodedTextures.Decode(m.diffuseMap, SOIL_FLAG_MIPMAPS);
+	}
 #ifdef MD5_USE_TANGENTS_BUMPMAPS
-	m.bumpIndex = SOIL_load_OGL_texture(
-		bumpMap.c_str(),
-		SOIL_LOAD_AUTO,SOIL_CREATE_NEW_ID,SOIL_FLAG_MIPMAPS | 0
-	);
+	if(!m.bumpMap.empty()) {
+		decodedTextures.Decode(m.bumpMap, SOIL_FLAG_MIPMAPS | 0);
+	}
 #endif
 }
 
@@ -344,17 +653,11 @@ int MD5FileData::LoadMD5Joints( std::ifstream &from )	{
 
 			bindPose.joints[loaded].orientation.GenerateW();
 			bindPose.joints[loaded].orientation.Normalise();
+			bindPose.joints[loaded].forceWorld = 0;
 
 			//Now we have the orientation and position, we can form the transformation matrix
-			//for this joint. We need to further transform this matrix by the conversionmatrix
-			//so that the rotation is in OpenGL space.
-
-			bindPose.joints[loaded].transform = bindPose.joints[loaded].orientation.ToMatrix4();
-			bindPose.joints[loaded].transform.SetPositionVector(bindPose.joints[loaded].position);
-
-			bindPose.joints[loaded].transform = conversionMatrix * bindPose.joints[loaded].transform;
-
-			bindPose.joints[loaded].localTransform = bindPose.joints[loaded].transform;
+			//for this joint.
+			BuildJointTransform(bindPose.joints[loaded]);
 
 			++loaded;	//...Just assume it worked ;)
 		}
@@ -403,10 +706,8 @@ void MD5FileData::LoadMD5SubMesh( std::ifstream &from, int &count )	{
 		from >> tempLine;	
 
 		if(tempLine == MD5_SUBMESH_SHADER) {
-			//If the line is a shader, we let the LoadShaderProxy function handle it
-			std::string shaderName;
-			from >> shaderName;
-			LoadShaderProxy(shaderName,m);
+			//If the line is a shader, we keep hold of it so the LoadShaderProxy function can load its textures later
+			from >> m.shader;
 		}
 		else if(tempLine == MD5_SUBMESH_NUMVERTS) {
 			//if the line tells us how many vertices to expect, initialise the memory for them
@@ -435,14 +736,6 @@ void MD5FileData::LoadMD5SubMesh( std::ifstream &from, int &count )	{
 			from >> m.verts[vertsLoaded].weightIndex;
 			from >> m.verts[vertsLoaded].weightElements;
 
-			static int testweightcount = 0;
-
-			if(m.verts[vertsLoaded].weightElements > testweightcount) {
-				testweightcount = m.verts[vertsLoaded].weightElements;
-
-				std::cout << testweightcount << std::endl;
-			}
-
 			vertsLoaded++;
 		}
 		else if(tempLine == MD5_SUBMESH_WEIGHT) {
@@ -477,6 +770,32 @@ void MD5FileData::LoadMD5SubMesh( std::ifstream &from, int &count )	{
 	}while(tempLine != "}");
 }
 
+void MD5FileData::BuildSkinningData()	{
+	for(unsigned int i = 0; i < numSubMeshes; ++i) {
+		MD5SubMesh& subMesh = subMeshes[i];
+		const int n = subMesh.numweights;
+
+		delete[] subMesh.skinX;
+		delete[] subMesh.skinJoints;
+
+		subMesh.skinX		= new float[n * 4];
+		subMesh.skinY		= subMesh.skinX + n;
+		subMesh.skinZ		= subMesh.skinY + n;
+		subMesh.skinW		= subMesh.skinZ + n;
+		subMesh.skinJoints	= new int[n];
+
+		for(int j = 0; j < n; ++j) {
+			const MD5Weight& weight = subMesh.weights[j];
+
+			subMesh.skinX[j]		= weight.position.x * weight.weightValue;
+			subMesh.skinY[j]		= weight.position.y * weight.weightValue;
+			subMesh.skinZ[j]		= weight.position.z * weight.weightValue;
+			subMesh.skinW[j]		= weight.weightValue;
+			subMesh.skinJoints[j]	= weight.jointIndex;
+		}
+	}
+}
+
 /*
 Create the child Mesh class instances from the loaded in MD5SubMeshes.
 */
@@ -513,6 +832,11 @@ void MD5FileData::CreateMeshes()	{
 		target->numIndices    = subMesh.numtris*3; //Each tri has 3 points....
 		target->numVertices   = subMesh.numverts;
 
+		//UV coords never change, so can be copied straight over to the Mesh textureCoord array
+		for(int j = 0; j < subMesh.numverts; ++j) {
+			target->textureCoords[j] = subMesh.verts[j].texCoords;
+		}
+
 		target->indices		  = new unsigned int[target->numIndices]; //Make mem for indices
 
 		/*
@@ -529,6 +853,13 @@ void MD5FileData::CreateMeshes()	{
 			//now to fill up its weighting information		
 		}
 
+		/*
+		The skinning data is laid out by vertex, so the vertices have to stay where
+		they are, but the triangles can still be reordered to make better use of the
+		vertex cache.
+		*/
+		MeshProcessing::OptimiseVertexCache(target->indices, target->numIndices, target->numVertices);
+
 #ifdef MD5_USE_HARDWARE_SKINNING
 		for(int j = 0; j < subMesh.numverts; ++j) {
 			target->weights[j].x = (float)(subMesh.verts[j].weightElements);
@@ -574,6 +905,11 @@ void	MD5FileData::BindTextureBuffers() const {
 //function before its draw call, so that the vertex shader has the 
 //correct data
 void	MD5FileData::UpdateTransformTBO(const MD5Skeleton &skel) const {
+	BuildSkinTransforms(skel, transforms);
+	UploadTransformTBO(transforms);
+}
+
+void	MD5FileData::BuildSkinTransforms(const MD5Skeleton &skel, Matrix4* out_transforms) const {
 	for(int i = 0; i < skel.numJoints; ++i) {
 		//Oh dear...If we'd stored our MD5Skeleton in a data-driven way,
 		//rather than an object oriented way, this'd be a simple memcpy
@@ -599,13 +935,20 @@ void	MD5FileData::UpdateTransformTBO(const MD5Skeleton &skel) const {
 		//our normal's orientaiton is defined by a joint, it is the inverse
 		//of that joints world transform that will take the normal to the local
 		//space of that joint. 
-		transforms[(i*2)+0] = skel.joints[i].transform;
+		out_transforms[(i*2)+0] = skel.joints[i].transform;
 
-		transforms[(i*2)+1] = bindPose.joints[i].transform.GetTransposedRotation();
+		out_transforms[(i*2)+1] = bindPose.joints[i].transform.GetTransposedRotation();
+	}
+}
+
+void	MD5FileData::UploadTransformTBO(const Matrix4* skinTransforms, unsigned int poseStamp) const {
+	if(poseStamp != 0 && poseStamp == uploadedPoseStamp) {
+		return;
 	}
+	uploadedPoseStamp = poseStamp;
 
 	glBindBuffer(GL_TEXTURE_BUFFER, transformBuffer);
-	glBufferSubData(GL_TEXTURE_BUFFER, 0, bindPose.numJoints*2*sizeof(Matrix4), (void*)&transforms[0]);
+	glBufferSubData(GL_TEXTURE_BUFFER, 0, bindPose.numJoints*2*sizeof(Matrix4), (void*)&skinTransforms[0]);
 	glBindBuffer(GL_TEXTURE_BUFFER, 0);
 
 	GL_BREAKPOINT;
@@ -6,6 +6,14 @@ Description: Implementation of id Software's MD5 skeletal animation format.
 
 This class stores all of the arrays of data loaded in from an MD5Mesh file.
 
+Parsing the text MD5Mesh files is slow, so the first time a file is loaded the
+loaded data is compiled into a packed binary file alongside it (with the
+MD5_BINARY_EXTENSION extension added). The joints, and each submesh's verts,
+tris and weights are stored as contiguous blocks, so later loads just map the
+binary file and copy each block out in one go. The binary file is only used if
+it was compiled from the text file as it is now, or if there is no text file at
+all (so only the compiled files need to be shipped, see CompileBinary).
+
 -_-_-_-_-_-_-_,------,   
 _-_-_-_-_-_-_-|   /\_/\   NYANYANYAN
 -_-_-_-_-_-_-~|__( ^ .^) /
@@ -19,6 +27,7 @@ _-_-_-_-_-_-_-""  ""
 #include "MD5FileData.h"
 #include "MD5Mesh.h"
 #include "MD5Anim.h"
+#include "ResourceRegistry.h"
 
 
 /*
@@ -41,6 +50,9 @@ most of them will only actually be used once.
 #define MD5_SUBMESH_TRI			"tri"
 #define MD5_SUBMESH_WEIGHT		"weight"
 
+#define MD5_BINARY_EXTENSION	".nclmd5"	//Compiled binary MD5Mesh/MD5Anim file, written alongside the text file
+#define MD5_BINARY_VERSION		3			//Increment whenever the layout of the compiled files changes
+
 #define MD5_WEIGHT_TEXNUM		10
 #define MD5_TRANSFORM_TEXNUM	11
 
@@ -154,6 +166,22 @@ struct MD5SubMesh {
 	MD5Weight*	weights;	//Pointer to array of MD5Weights of this MD5SubMesh
 	MD5Vert*	verts;		//Pointer to array of MD5Verts of this MD5SubMesh
 
+	std::string	shader;		//Name of the 'shader' used by this MD5SubMesh (see LoadShaderProxy)
+	std::string	diffuseMap;	//Textures named by the shader's proxy file, decoded along with the mesh
+	std::string	bumpMap;
+
+	/*
+	Structure of arrays copy of the weights, used by MD5Mesh::SkinVertices. Each
+	anchor position is premultiplied by its weight value, and the weight value
+	itself is kept in skinW, so that each weight's contribution to a vertex is
+	just joint.transform * (x, y, z, w). skinX/Y/Z/W all point into one block.
+	*/
+	float*		skinX;
+	float*		skinY;
+	float*		skinZ;
+	float*		skinW;
+	int*		skinJoints;
+
 	MD5SubMesh() {
 		texIndex	= 0;
 #ifdef	MD5_USE_TANGENTS_BUMPMAPS
@@ -162,6 +190,12 @@ struct MD5SubMesh {
 		tris		= NULL;
 		weights		= NULL;
 		verts		= NULL;
+
+		skinX		= NULL;
+		skinY		= NULL;
+		skinZ		= NULL;
+		skinW		= NULL;
+		skinJoints	= NULL;
 	}
 
 	/*
@@ -171,11 +205,15 @@ struct MD5SubMesh {
 		delete[] tris;
 		delete[] weights;
 		delete[] verts;
+
+		delete[] skinX;
+		delete[] skinJoints;
 	}
 };
 
 
 class MD5Anim;
+class MD5Mesh;
 
 class MD5FileData	{
 public:
@@ -186,6 +224,25 @@ public:
 	MD5FileData(const std::string &filename);
 	~MD5FileData(void);
 
+	/*
+	Compiles the given text MD5Mesh file into the binary format, without
+	creating any meshes or textures. This doesn't need an OpenGL context, so
+	can be used to compile all of the MD5 files of a project offline.
+	*/
+	static bool	CompileBinary(const std::string &filename);
+
+	/*
+	The two halves of the constructor. Decode loads the mesh (compiling it if
+	need be) and any animations added to it, without touching OpenGL, so it
+	can be run on any thread (see AssetManager). This includes reading the
+	shader proxy files and decoding their textures. Returns NULL if the file
+	couldn't be loaded. Upload then creates the textures and meshes, and must
+	be called on the thread with the OpenGL context before use.
+	*/
+	static MD5FileData*	Decode(const std::string &filename);
+	void		Upload();
+	bool		IsUploaded() const { return rootMesh != NULL; }
+
 	void		CloneSkeleton(MD5Skeleton &into) const;	
 
 //My experimental hardware skinning uses some extra data, and a couple of
@@ -193,10 +250,25 @@ public:
 #ifdef MD5_USE_HARDWARE_SKINNING 
 	void		BindTextureBuffers() const;
 	void		UpdateTransformTBO(const MD5Skeleton &skel) const;
+
+	/*
+	UpdateTransformTBO split in two, so that an MD5Crowd can build the transforms
+	of all of it's nodes in parallel (BuildSkinTransforms only reads from this,
+	so can be called from any thread), leaving just the upload for when each node
+	is drawn. An upload with the same non-zero poseStamp as the last one is
+	skipped, as the TBO already holds that pose.
+	*/
+	unsigned int	GetNumSkinTransforms() const { return bindPose.numJoints * 2; }
+	void		BuildSkinTransforms(const MD5Skeleton &skel, Matrix4* out_transforms) const;
+	void		UploadTransformTBO(const Matrix4* skinTransforms, unsigned int poseStamp = 0) const;
 #endif
 
 	Mesh*		GetRootMesh() const {return (Mesh*)rootMesh;}
 
+	//The submeshes as loaded from the file, e.g. for skinning them on the CPU (see MD5Mesh::SkinSubMesh)
+	unsigned int		GetNumSubMeshes() const				{return numSubMeshes;}
+	const MD5SubMesh&	GetSubMesh(unsigned int i) const	{return subMeshes[i];}
+
 	MD5Anim*	GetAnim(const string &name) const;
 
 	/*
@@ -222,14 +294,37 @@ public:
 
 
 protected:	
+	//Creates an empty MD5FileData, used by CompileBinary
+	MD5FileData(void);
+
+	/*
+	Loads in all of the joints and submeshes from a text MD5Mesh file.
+	*/
+	//Loads the binary (or text) file, without creating anything in OpenGL
+	bool	LoadMD5Mesh(const std::string &filename);
+
+	bool	LoadTextMD5Mesh(const std::string &filename);
+
 	/*
-	Helper function used by LoadMD5Mesh to load in the joints for this mesh
+	Loads in all of the joints and submeshes from a compiled binary file, as
+	long as it is up to date with the given text file (if it exists).
+	*/
+	bool	LoadBinaryMD5Mesh(const std::string &filename, const std::string &textFilename);
+
+	/*
+	Writes the loaded joints and submeshes out to a binary file, to be loaded
+	in by LoadBinaryMD5Mesh.
+	*/
+	bool	SaveBinaryMD5Mesh(const std::string &filename, const std::string &textFilename) const;
+
+	/*
+	Helper function used by LoadTextMD5Mesh to load in the joints for this mesh
 	from an MD5Mesh file.
 	*/
 	int		LoadMD5Joints(std::ifstream &from);
 
 	/*
-	Helper function used by LoadMD5Mesh to load in the submeshes that make 
+	Helper function used by LoadTextMD5Mesh to load in the submeshes that make 
 	up this mesh from an MD5Mesh file.
 	*/
 	void	LoadMD5SubMesh(std::ifstream &from, int &count);
@@ -241,6 +336,12 @@ protected:
 	*/
 	void	CreateMeshes();
 
+	/*
+	Builds the structure of arrays copy of each MD5SubMesh's weights used
+	for software skinning (see MD5SubMesh::skinX etc)
+	*/
+	void	BuildSkinningData();
+
 #ifdef MD5_USE_HARDWARE_SKINNING 
 	void	CreateTBOs();
 #endif
@@ -252,6 +353,9 @@ protected:
 	As we don't have anything quite so extravagant in this tutorial series,
 	instead we have a series of shader 'proxy' files, containing two strings - 
 	one for the diffuse map, and one for the bump map.
+
+	This just reads the filenames into the MD5SubMesh, and decodes them into
+	decodedTextures, leaving them to be uploaded by Upload.
 	*/
 	void	LoadShaderProxy(std::string filename, MD5SubMesh &m);
 
@@ -267,6 +371,8 @@ protected:
 
 	std::map<std::string, MD5Anim*>	animations;	//map of anims for this mesh
 
+	DecodedTextures	decodedTextures;	//Textures waiting to be uploaded, see LoadShaderProxy
+
 //These are extra buffers, and arrays of data, for use when using hardware
 //skinning of meshes. We have 2 extra buffers - VBOs for storing the
 //weights and skeleton of our mesh. We also have 2 extra textures, which will
@@ -282,6 +388,8 @@ protected:
 
 	Matrix4*		transforms;			//Array of skeleton transforms
 	Vector3*		weightings;			//Array of Vertex weightings
+
+	mutable unsigned int	uploadedPoseStamp;	//Crowd pose the transform TBO holds, 0 if it isn't a shared pose
 #endif
 
 
@@ -1,6 +1,15 @@
 #include "MD5Mesh.h"
 #ifdef WEEK_2_CODE
+
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MD5_SKINNING_SIMD 1
+#else
+#define MD5_SKINNING_SIMD 0
+#endif
+
 MD5Mesh::MD5Mesh(const MD5FileData&t) :  type(t) {
+	skinnedPoseStamp = 0;
 #ifdef MD5_USE_HARDWARE_SKINNING
 	weightObject = 0;
 	weights		 = NULL;
@@ -72,6 +81,15 @@ void MD5Mesh::BufferExtraData() {
 //skeleton pose. 
 //*/
 void	MD5Mesh::SkinVertices(const MD5Skeleton &skel) {
+	/*
+	Every submesh is skinned by the same skeleton, so we only need to gather up
+	the joint transforms once, rather than once per weight.
+	*/
+	jointTransforms.resize(skel.numJoints);
+	for(int i = 0; i < skel.numJoints; ++i) {
+		jointTransforms[i] = skel.joints[i].transform;
+	}
+
 	//For each submesh, we want to transform a position for each vertex
 	for(unsigned int i = 0; i < type.numSubMeshes; ++i) {
 		MD5SubMesh& subMesh = type.subMeshes[i];	//Get a reference to the current submesh
@@ -81,38 +99,7 @@ void	MD5Mesh::SkinVertices(const MD5Skeleton &skel) {
 		*/
 		MD5Mesh*target		= (MD5Mesh*)children.at(i);
 
-		/*
-		For each vertex in the submesh, we want to build up a final position, taking
-		into account the various weighting anchors used.
-		*/
-		for(int j = 0; j < subMesh.numverts; ++j) {
-			//UV coords can be copied straight over to the Mesh textureCoord array
-			target->textureCoords[j]   = subMesh.verts[j].texCoords;
-
-			//And we should start off with a Vector of 0,0,0
-			target->vertices[j].ToZero();
-
-			/*
-			Each vertex has a number of weights, determined by weightElements. The first
-			of these weights will be in the submesh weights array, at position weightIndex.
-
-			Each of these weights has a joint it is in relation to, and a weighting value,
-			which determines how much influence the weight has on the final vertex position
-			*/
-
-			for(int k = 0; k < subMesh.verts[j].weightElements; ++k) {
-				MD5Weight& weight	= subMesh.weights[subMesh.verts[j].weightIndex + k];
-				MD5Joint& joint		= skel.joints[weight.jointIndex];
-
-				/*
-				We can then transform the weight position by the joint's world transform, and multiply
-				the result by the weightvalue. Finally, we add this value to the vertex position, eventually
-				building up a weighted vertex position.
-				*/
-
-				target->vertices[j] += ((joint.transform * weight.position) * weight.weightValue);				
-			}
-		}
+		SkinSubMesh(subMesh, jointTransforms.empty() ? NULL : &jointTransforms[0], target->vertices);
 
 		/*
 		As our vertices have moved, normals and tangents must be regenerated!
@@ -134,6 +121,84 @@ void	MD5Mesh::SkinVertices(const MD5Skeleton &skel) {
 	}
 }
 
+/*
+Each vertex has a number of weights, determined by weightElements. The first
+of these weights will be in the submesh weights array, at position weightIndex.
+
+Each of these weights has a joint it is in relation to, and a weighting value,
+which determines how much influence the weight has on the final vertex position.
+As the joint transforms are affine, (transform * position) * weightValue is the
+same as transform * (position * weightValue, weightValue), which is what the
+premultiplied skinX/Y/Z/W arrays built by MD5FileData::BuildSkinningData hold.
+That's just a sum of the four columns of the transform, scaled by x, y, z and w,
+which we can do for all three components of the vertex at once using SSE.
+*/
+void	MD5Mesh::SkinSubMesh(const MD5SubMesh &subMesh, const Matrix4* jointTransforms, Vector3* out_vertices) {
+	const float* skinX		= subMesh.skinX;
+	const float* skinY		= subMesh.skinY;
+	const float* skinZ		= subMesh.skinZ;
+	const float* skinW		= subMesh.skinW;
+	const int*	 skinJoints = subMesh.skinJoints;
+	const MD5Vert* verts	= subMesh.verts;
+
+#pragma omp parallel for if (subMesh.numverts > MD5_PARALLEL_SKINNING_THRESHOLD)
+	for(int j = 0; j < subMesh.numverts; ++j) {
+		const int start = verts[j].weightIndex;
+		const int end	= start + verts[j].weightElements;
+
+#if MD5_SKINNING_SIMD
+		__m128 pos = _mm_setzero_ps();
+		for(int k = start; k < end; ++k) {
+			const float* m = jointTransforms[skinJoints[k]].values;
+
+			pos = _mm_add_ps(pos,
+				_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(m),	  _mm_set1_ps(skinX[k])),
+									  _mm_mul_ps(_mm_loadu_ps(m + 4), _mm_set1_ps(skinY[k]))),
+						   _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(m + 8), _mm_set1_ps(skinZ[k])),
+									  _mm_mul_ps(_mm_loadu_ps(m + 12), _mm_set1_ps(skinW[k])))));
+		}
+
+		//Vector3 is only 3 floats, so store xy and z separately
+		_mm_storel_pi((__m64*)&out_vertices[j].x, pos);
+		_mm_store_ss(&out_vertices[j].z, _mm_movehl_ps(pos, pos));
+#else
+		Vector3 pos(0.0f, 0.0f, 0.0f);
+		for(int k = start; k < end; ++k) {
+			const float* m = jointTransforms[skinJoints[k]].values;
+
+			pos.x += m[0] * skinX[k] + m[4] * skinY[k] + m[8]  * skinZ[k] + m[12] * skinW[k];
+			pos.y += m[1] * skinX[k] + m[5] * skinY[k] + m[9]  * skinZ[k] + m[13] * skinW[k];
+			pos.z += m[2] * skinX[k] + m[6] * skinY[k] + m[10] * skinZ[k] + m[14] * skinW[k];
+		}
+		out_vertices[j] = pos;
+#endif
+	}
+}
+
+void	MD5Mesh::SkinSubMeshReference(const MD5SubMesh &subMesh, const MD5Skeleton &skel, Vector3* out_vertices) {
+	/*
+	For each vertex in the submesh, we want to build up a final position, taking
+	into account the various weighting anchors used.
+	*/
+	for(int j = 0; j < subMesh.numverts; ++j) {
+		//We should start off with a Vector of 0,0,0
+		out_vertices[j].ToZero();
+
+		for(int k = 0; k < subMesh.verts[j].weightElements; ++k) {
+			MD5Weight& weight	= subMesh.weights[subMesh.verts[j].weightIndex + k];
+			MD5Joint& joint		= skel.joints[weight.jointIndex];
+
+			/*
+			We can then transform the weight position by the joint's world transform, and multiply
+			the result by the weightvalue. Finally, we add this value to the vertex position, eventually
+			building up a weighted vertex position.
+			*/
+
+			out_vertices[j] += ((joint.transform * weight.position) * weight.weightValue);				
+		}
+	}
+}
+
 
 ///*
 //Rebuffers the vertex data on the graphics card. Now you know why we always keep hold of
@@ -54,9 +54,22 @@ than performing everything on the GPU.
 
 #define MD5_USE_HARDWARE_SKINNING
 
+/*
+While MD5_USE_HARDWARE_SKINNING is defined (the default) MD5Nodes are skinned
+in the vertex shader, and the 'software' skinning below (SkinVertices and
+SkinSubMesh) is only run once per mesh, to put it in its bind pose. It only
+runs every frame if the define above is commented out. There's no way to
+switch between the two at runtime, as the shader has to match.
+
+When skinning in software, submeshes with more vertices than this have their
+vertices split across worker threads.
+*/
+#define MD5_PARALLEL_SKINNING_THRESHOLD 1024
+
 #include <fstream>
 #include <string>
 #include <map>
+#include <vector>
 
 #include "ChildMeshInterface.h"
 #include "Quaternion.h"
@@ -71,6 +84,11 @@ than performing everything on the GPU.
 //Let the compiler know we should compile MD5Anim along with this class
 class MD5Anim;
 
+//MD5FileData.h includes this file too, so these may not have been defined yet
+class MD5FileData;
+struct MD5SubMesh;
+struct MD5Skeleton;
+
 
 /*
 Now for the actual class definition itself. We inherit the ability to store
@@ -106,6 +124,20 @@ public:
 	in MD5Skeleton, including skinning all of its submeshes.
 	*/
 	void	SkinVertices(const MD5Skeleton &skel);
+
+	/*
+	Skins the vertices of a single MD5SubMesh into out_vertices, using the world
+	transform of each joint of the skeleton (which must be affine). Uses SIMD to
+	sum the weights, and splits the vertices across threads for large submeshes.
+	Checked against SkinSubMeshReference by the md5_skinning headless check.
+	*/
+	static void	SkinSubMesh(const MD5SubMesh &subMesh, const Matrix4* jointTransforms, Vector3* out_vertices);
+
+	/*
+	The original one weight at a time version of SkinSubMesh, kept as a reference
+	for checking the results of the optimised version against.
+	*/
+	static void	SkinSubMeshReference(const MD5SubMesh &subMesh, const MD5Skeleton &skel, Vector3* out_vertices);
 				
 protected:	
 	/////*
@@ -127,5 +159,12 @@ protected:
 #endif
 
 	const MD5FileData &	type;
+
+	//Joint world transforms of the skeleton currently being skinned, packed
+	//together so SkinSubMesh isn't striding over the rest of each MD5Joint
+	std::vector<Matrix4>	jointTransforms;
+
+	//Which shared MD5Crowd pose the vertices were last skinned with (see MD5Node::Draw)
+	unsigned int			skinnedPoseStamp;
 };
 #endif
\ No newline at end of file
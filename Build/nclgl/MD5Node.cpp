@@ -1,9 +1,22 @@
 #include "MD5Node.h"
 #ifdef WEEK_2_CODE
+#include "MD5Crowd.h"
+
 MD5Node::MD5Node(const MD5FileData &ofType) : sourceData(ofType)	{
 	currentAnim		 = NULL;
-	frameTime		 = 0.0f;
-	currentAnimFrame = 0;
+	currentAnimTime	 = 0.0f;
+
+	previousAnim	 = NULL;
+	previousAnimTime = 0.0f;
+	crossfadeTime	 = 0.0f;
+	crossfadeLength	 = 0.0f;
+
+	blendAnim		 = NULL;
+	blendAnimTime	 = 0.0f;
+	blendWeight		 = 0.0f;
+
+	crowd			 = NULL;
+	poseStamp		 = 0;
 
 	ofType.CloneSkeleton(currentSkeleton);
 
@@ -11,50 +24,115 @@ MD5Node::MD5Node(const MD5FileData &ofType) : sourceData(ofType)	{
 }
 
 MD5Node::~MD5Node(void)	{
-
+	if(crowd) {
+		crowd->RemoveNode(this);
+	}
 }
 
 /*
-This Overridden Update function will update the current animation frame used
-by this particular mesh instance, by subtracting the incoming time value
-by a float /frameTime/, which when less than 0, triggers a frame update. This
-float is then reset to the framerate defined within the current animation. A
-while is used instead of an if for the unusual occurance of a time value being
-large enough that we could risk skipping over frames - generally this only 
-happens when we hit a debug breakpoint.
-
+This Overridden Update function will update the current animation time used
+by this particular mesh instance, and sample the current animation at that time.
+As the time generally falls between two frames, the sampled pose is interpolated
+between them. If there's a blended animation, or one being crossfaded out, they
+are sampled too, and blended together with the current animation's pose, before
+the result is applied to the skeleton.
+
+If this node is part of an MD5Crowd, the crowd does all of this instead.
 */
 void	MD5Node::Update(float msec) {
-	if(currentAnim) {
-		frameTime -= msec;
-		//Time to calculate which frame we're now on!
-		while(frameTime < 0) {
-			frameTime += 1000.0f / currentAnim->GetFrameRate();
-			//all animations are assumed to be 'looping', so we use the modulo
-			//operator to 'wrap around' if we go past the end of the anim
-			currentAnimFrame = currentAnimFrame++%(currentAnim->GetNumFrames());
-		}
-		//Transform this particular node's skeleton to the right frame of
-		//anim
-		currentAnim->TransformSkeleton(currentSkeleton,currentAnimFrame-1);
+	if(!crowd) {
+		AdvanceAnim(msec);
+		UpdatePose();
 	}
 	//Call our base class update function, too! Doing so will presever the 
 	//ability to build up the world matrices for every node. 
 	SceneNode::Update(msec);
 }
 
+void	MD5Node::AdvanceAnim(float msec) {
+	if(!currentAnim) {
+		return;
+	}
 
+	currentAnimTime += msec;
+
+	if(blendAnim) {
+		blendAnimTime += msec;
+	}
+
+	if(previousAnim) {
+		previousAnimTime	+= msec;
+		crossfadeTime		+= msec;
+
+		if(crossfadeTime >= crossfadeLength) {
+			previousAnim = NULL;	//Crossfade has finished
+		}
+	}
+}
+
+void	MD5Node::UpdatePose() {
+	if(!currentAnim) {
+		return;
+	}
+
+	poseStamp = 0;
+	SampleAnim(currentAnim, currentAnimTime, currentPose);
+
+	if(blendAnim && blendWeight > 0.0f) {
+		SampleAnim(blendAnim, blendAnimTime, otherPose);
+
+		MD5Anim::BlendPoses(&currentPose[0], &otherPose[0], min(blendWeight, 1.0f), 
+			min(currentAnim->GetNumJoints(), blendAnim->GetNumJoints()), &currentPose[0]);
+	}
+
+	if(previousAnim) {
+		SampleAnim(previousAnim, previousAnimTime, otherPose);
+
+		MD5Anim::BlendPoses(&otherPose[0], &currentPose[0], crossfadeTime / crossfadeLength,
+			min(currentAnim->GetNumJoints(), previousAnim->GetNumJoints()), &currentPose[0]);
+	}
+
+	//Transform this particular node's skeleton to the blended pose
+	currentAnim->ApplyPose(&currentPose[0], currentSkeleton);
+}
+
+void	MD5Node::SampleAnim(MD5Anim* anim, float msec, std::vector<MD5JointPose> &out_pose) {
+	if(out_pose.size() < anim->GetNumJoints()) {
+		out_pose.resize(anim->GetNumJoints());
+	}
+	anim->SamplePose(anim->GetFrameAtTime(msec), &out_pose[0]);
+}
 
 /*
 Swaps the currently used animation of this MD5Mesh. 
 */
-void	MD5Node::PlayAnim(std::string name)	{
+void	MD5Node::PlayAnim(std::string name, float crossfadeMsec)	{
 /*
-We want to reset all of the animation details
+We want to reset all of the animation details, but keep hold of the old animation
+if we're going to crossfade out of it
 */
-	currentAnimFrame	= 0;
-	frameTime			= 0.0f; 
+	if(crossfadeMsec > 0.0f && currentAnim) {
+		previousAnim		= currentAnim;
+		previousAnimTime	= currentAnimTime;
+		crossfadeTime		= 0.0f;
+		crossfadeLength		= crossfadeMsec;
+	}
+	else {
+		previousAnim		= NULL;
+	}
+
+	currentAnimTime		= 0.0f;
 	currentAnim			= sourceData.GetAnim(name);
+
+	if(!currentAnim) {
+		previousAnim = NULL;
+	}
+}
+
+void	MD5Node::BlendAnim(std::string name, float weight)	{
+	blendAnim		= name.empty() ? NULL : sourceData.GetAnim(name);
+	blendAnimTime	= currentAnimTime;	//Start in step with the current animation
+	blendWeight		= weight;
 }
 
 void	MD5Node::Draw(const OGLRenderer &r) {
@@ -79,7 +157,14 @@ void	MD5Node::Draw(const OGLRenderer &r) {
 
 #ifdef MD5_USE_HARDWARE_SKINNING
 	sourceData.BindTextureBuffers();
-	sourceData.UpdateTransformTBO(currentSkeleton);
+
+	//Nodes in a crowd already had their transforms built (in parallel) when they were posed, so just need uploading
+	if(crowd && !skinTransforms.empty()) {
+		sourceData.UploadTransformTBO(&skinTransforms[0], poseStamp);
+	}
+	else {
+		sourceData.UpdateTransformTBO(currentSkeleton);
+	}
 
 	glUniform1i(glGetUniformLocation(r.GetCurrentShader()->GetProgram(), "weightTex"), MD5_WEIGHT_TEXNUM);
 	glUniform1i(glGetUniformLocation(r.GetCurrentShader()->GetProgram(), "transformTex"), MD5_TRANSFORM_TEXNUM);
@@ -91,7 +176,12 @@ void	MD5Node::Draw(const OGLRenderer &r) {
 	current skeleton, which will have been updated in the Update function to be in
 	the correct pose for the current frame of animation. 
 	*/
-	m->SkinVertices(currentSkeleton);
+	//Nodes sharing a pose from an MD5Crowd don't need to skin the mesh again if the
+	//last node drawn with it had the same pose
+	if(poseStamp == 0 || m->skinnedPoseStamp != poseStamp) {
+		m->SkinVertices(currentSkeleton);
+		m->skinnedPoseStamp = poseStamp;
+	}
 #endif
 	//Finally, we draw the mesh, just like the base class Draw function...
 	m->Draw();
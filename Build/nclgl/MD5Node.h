@@ -20,6 +20,11 @@ data in one class, and the mesh data used by these classes in another class.
 For example, this lets us have 1000s of hell knights on screen, all potentially
 with their own current animation, and current animation frame!
 
+Each node can crossfade from one animation to the next when PlayAnim is called,
+and have a second animation blended in on top of the current one (such as 
+blending between walking and running animations depending on speed). Animations
+are interpolated between frames, rather than snapping from one to the next.
+
 -_-_-_-_-_-_-_,------,   
 _-_-_-_-_-_-_-|   /\_/\   NYANYANYAN
 -_-_-_-_-_-_-~|__( ^ .^) /
@@ -33,6 +38,8 @@ _-_-_-_-_-_-_-""  ""
 #include "MD5FileData.h"
 #include "MD5Mesh.h"
 
+class MD5Crowd;
+
 class MD5Node : public SceneNode	{
 public:
 	MD5Node(const MD5FileData &ofType);
@@ -47,9 +54,35 @@ public:
 
 	/*
 	Searches the map of animations for an MD5Anim with the passed in name, and
-	starts applying it to the current MD5Mesh
+	starts applying it to the current MD5Mesh. If crossfadeMsec is above 0, the
+	previous animation will be smoothly blended out over that time.
+	*/
+	void	PlayAnim(std::string name, float crossfadeMsec = 0.0f);	
+
+	/*
+	Blends another animation in with the current one, weight being how much of
+	the blended animation is used (0 to 1). Passing an empty name stops blending.
+	*/
+	void	BlendAnim(std::string name, float weight);
+
+	//Changes how much of the blended animation is used, without restarting it
+	void	SetBlendWeight(float weight) { blendWeight = weight; }
+
+	/*
+	Update is split into these two, so that an MD5Crowd can advance the time
+	of every node each frame, but only update the pose of some of them.
 	*/
-	void	PlayAnim(std::string name);	
+	void	AdvanceAnim(float msec);
+	void	UpdatePose();
+
+	//True if this node's pose depends only on its current animation and time,
+	//meaning any other node at the same point of the same animation has the same pose
+	bool	IsPoseShareable() const {
+		return currentAnim && !previousAnim && !(blendAnim && blendWeight > 0.0f);
+	}
+
+	MD5Anim*	GetCurrentAnim()		const { return currentAnim; }
+	float		GetCurrentAnimTime()	const { return currentAnimTime; }
 
 
 	bool	GetParentLocalOrientation(const string&name, Quaternion &t);
@@ -93,11 +126,35 @@ public:
 
 
 protected:
+	friend class MD5Crowd;
+
+	//Samples the pose of the given animation at the given time into out_pose, making sure it is big enough
+	void	SampleAnim(MD5Anim* anim, float msec, std::vector<MD5JointPose> &out_pose);
+
 	const MD5FileData&	sourceData;
 	MD5Skeleton			currentSkeleton;
 	MD5Anim*			currentAnim;
+	float				currentAnimTime;	//How long the current animation has been playing for
+
+	MD5Anim*			previousAnim;		//Animation being crossfaded out, if any
+	float				previousAnimTime;
+	float				crossfadeTime;		//How far through the crossfade we are
+	float				crossfadeLength;
+
+	MD5Anim*			blendAnim;			//Animation blended in with the current animation, if any
+	float				blendAnimTime;
+	float				blendWeight;
+
+	//Working space for the sampled poses, kept around so we're not allocating every frame
+	std::vector<MD5JointPose>	currentPose;
+	std::vector<MD5JointPose>	otherPose;
+
+	MD5Crowd*			crowd;			//Crowd animating this node, if any (see MD5Crowd)
+	unsigned int		poseStamp;		//Identifies the pose shared from the crowd, 0 if the pose is this node's own
 
-	float				frameTime;
-	unsigned int		currentAnimFrame;	//Current frame of animation
+#ifdef MD5_USE_HARDWARE_SKINNING
+	//Skinning transforms for the current pose, built by the crowd along with the pose (see MD5FileData::BuildSkinTransforms)
+	std::vector<Matrix4>	skinTransforms;
+#endif
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,131 @@
+#include "MappedFile.h"
+#include <windows.h>
+#include <cstring>
+
+MappedFile::MappedFile(void)	{
+	fileHandle		= INVALID_HANDLE_VALUE;
+	mappingHandle	= NULL;
+	data			= NULL;
+	size			= 0;
+}
+
+MappedFile::MappedFile(const std::string& filename)	{
+	fileHandle		= INVALID_HANDLE_VALUE;
+	mappingHandle	= NULL;
+	data			= NULL;
+	size			= 0;
+
+	Open(filename);
+}
+
+MappedFile::~MappedFile(void)	{
+	Close();
+}
+
+bool MappedFile::Open(const std::string& filename)	{
+	Close();
+
+	fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(fileHandle, &file_size) || file_size.QuadPart == 0) {
+		//Empty files can't be mapped, but are still valid (if useless) files
+		Close();
+		return false;
+	}
+
+	mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mappingHandle == NULL) {
+		Close();
+		return false;
+	}
+
+	data = (const char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (data == NULL) {
+		Close();
+		return false;
+	}
+
+	size = (size_t)file_size.QuadPart;
+	return true;
+}
+
+void MappedFile::Close()	{
+	if (data) {
+		UnmapViewOfFile(data);
+		data = NULL;
+	}
+
+	if (mappingHandle) {
+		CloseHandle(mappingHandle);
+		mappingHandle = NULL;
+	}
+
+	if (fileHandle != INVALID_HANDLE_VALUE) {
+		CloseHandle(fileHandle);
+		fileHandle = INVALID_HANDLE_VALUE;
+	}
+
+	size = 0;
+}
+
+bool MappedFile::GetFileInfo(const std::string& filename, uint64_t* out_size, uint64_t* out_timestamp)	{
+	WIN32_FILE_ATTRIBUTE_DATA info;
+	if (!GetFileAttributesExA(filename.c_str(), GetFileExInfoStandard, &info)) {
+		return false;
+	}
+
+	if (out_size) {
+		*out_size = ((uint64_t)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+	}
+	if (out_timestamp) {
+		*out_timestamp = ((uint64_t)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime;
+	}
+	return true;
+}
+
+bool MappedFile::WriteFile(const std::string& filename, const void* data, size_t size)	{
+	//Write to a temporary file first, so a half written file is never mistaken for a valid one
+	std::string temp_filename = filename + ".tmp";
+
+	HANDLE file = CreateFileA(temp_filename.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	DWORD written = 0;
+	BOOL success = ::WriteFile(file, data, (DWORD)size, &written, NULL);
+	CloseHandle(file);
+
+	if (!success || written != (DWORD)size) {
+		DeleteFileA(temp_filename.c_str());
+		return false;
+	}
+
+	if (!MoveFileExA(temp_filename.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+		DeleteFileA(temp_filename.c_str());
+		return false;
+	}
+	return true;
+}
+
+uint64_t BinaryFileBuilder::Append(const void* data, size_t length)	{
+	if (length == 0) {
+		return 0;
+	}
+
+	const size_t offset = (buffer.size() + 7) & ~(size_t)7;
+	buffer.resize(offset + length, 0);
+	memcpy(&buffer[offset], data, length);
+	return offset;
+}
+
+void BinaryFileBuilder::Write(size_t offset, const void* data, size_t length)	{
+	if (offset + length > buffer.size()) {
+		buffer.resize(offset + length, 0);
+	}
+	memcpy(&buffer[offset], data, length);
+}
\ No newline at end of file
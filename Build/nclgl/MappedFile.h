@@ -0,0 +1,81 @@
+/******************************************************************************
+Class:MappedFile
+Implements:
+Author:Pieran Marris <p.marris@newcastle.ac.uk>
+Description:Read only memory mapped view of a file on disk. The whole file is
+mapped into the address space in one go and paged in by the OS on demand, so
+large asset files can be parsed directly from memory without any intermediate
+copies through a stream.
+
+Also has a few small helpers for writing out binary cache files alongside
+the original assets.
+
+-_-_-_-_-_-_-_,------,
+_-_-_-_-_-_-_-|   /\_/\   NYANYANYAN
+-_-_-_-_-_-_-~|__( ^ .^) /
+_-_-_-_-_-_-_-""  ""
+
+*//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+class MappedFile	{
+public:
+	MappedFile(void);
+	MappedFile(const std::string& filename);
+	~MappedFile(void);
+
+	//Maps the given file, returns false if it does not exist or could not be mapped
+	bool	Open(const std::string& filename);
+	void	Close();
+
+	bool		IsOpen()	const	{ return data != NULL; }
+	const char*	GetData()	const	{ return data; }
+	size_t		GetSize()	const	{ return size; }
+
+	//Returns true if the given block of the file lies entirely within it (e.g. to check offsets read from a truncated file)
+	bool		Contains(uint64_t offset, uint64_t length) const { return offset <= size && length <= size - offset; }
+
+	//Gets the size and last modification time of a file without opening it, returns false if the file does not exist
+	static bool	GetFileInfo(const std::string& filename, uint64_t* out_size, uint64_t* out_timestamp);
+
+	//Writes 'size' bytes to the given file in one go, replacing any existing file
+	static bool	WriteFile(const std::string& filename, const void* data, size_t size);
+
+protected:
+	//Kept as void* so this header doesn't need to pull in windows.h
+	void*		fileHandle;
+	void*		mappingHandle;
+
+	const char*	data;
+	size_t		size;
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+};
+
+/*
+Builds up a binary file in memory, made up of a fixed size header block at the
+start, followed by any number of 8 byte aligned data blocks referenced from the
+header by their offset from the start of the file.
+*/
+class BinaryFileBuilder	{
+public:
+	BinaryFileBuilder(size_t headerSize) : buffer(headerSize, 0) {}
+
+	//Appends a block of data, returning its offset in the file (or 0 if the block is empty)
+	uint64_t	Append(const void* data, size_t length);
+
+	//Overwrites part of the header block (or any previously appended data)
+	void		Write(size_t offset, const void* data, size_t length);
+
+	bool		SaveToFile(const std::string& filename) const { return MappedFile::WriteFile(filename, &buffer[0], buffer.size()); }
+
+protected:
+	std::vector<char> buffer;
+};
\ No newline at end of file
@@ -1,4 +1,6 @@
 #include "Mesh.h"
+#include "MeshProcessing.h"
+#include "ResourceRegistry.h"
 
 Mesh::Mesh(void)	{
 	glGenVertexArrays(1, &arrayObject);
@@ -20,24 +22,49 @@ Mesh::Mesh(void)	{
 	tangents	  = NULL;
 	indices		  = NULL;
 	colours		  = NULL;
+	adjacency	  = NULL;
+
+	vertexFormat	= MESH_VERTEX_SEPARATE;
+	keepCPUData		= true;
+	indexType		= GL_UNSIGNED_INT;
+	bufferedSize	= 0;
 
 	transformCoords = true;
 }
 
 Mesh::~Mesh(void)	{
-	glDeleteVertexArrays(1, &arrayObject);			//Delete our VAO
-	glDeleteBuffers(MAX_BUFFER, bufferObject);		//Delete our VBOs
+	//Shared buffers and textures are only deleted once nothing else is using them
+	if(!ResourceRegistry::ReleaseMeshBuffers(arrayObject)) {
+		glDeleteVertexArrays(1, &arrayObject);		//Delete our VAO
+		glDeleteBuffers(MAX_BUFFER, bufferObject);	//Delete our VBOs
+	}
 
-	glDeleteTextures(1,&texture);					//We'll be nice and delete our texture when we're done with it
-	glDeleteTextures(1,&bumpTexture);				//We'll be nice and delete our texture when we're done with it
+	if(!ResourceRegistry::ReleaseTexture(texture)) {
+		glDeleteTextures(1,&texture);				//We'll be nice and delete our texture when we're done with it
+	}
+	if(!ResourceRegistry::ReleaseTexture(bumpTexture)) {
+		glDeleteTextures(1,&bumpTexture);			//We'll be nice and delete our texture when we're done with it
+	}
 
-	//Later tutorial stuff
+	ReleaseCPUData();
+}
+
+void	Mesh::ReleaseCPUData()	{
 	delete[]vertices;
 	delete[]indices;
 	delete[]textureCoords;
 	delete[]tangents;
 	delete[]normals;
 	delete[]colours;
+	delete adjacency;
+
+	vertices		= NULL;
+	indices			= NULL;
+	textureCoords	= NULL;
+	tangents		= NULL;
+	normals			= NULL;
+	colours			= NULL;
+	adjacency		= NULL;
 }
 
 GLuint tex0 = -1, tex1 = -1, arrObj = -1;
@@ -70,7 +97,7 @@ void Mesh::Draw(bool update)	{
 		arrObj = arrayObject;
 	}
 		if (bufferObject[INDEX_BUFFER]) {
-			glDrawElements(type, numIndices, GL_UNSIGNED_INT, 0);
+			glDrawElements(type, numIndices, indexType, 0);
 		}
 		else{
 			glDrawArrays(type, 0, numVertices);	//Draw the triangle!
@@ -208,10 +235,69 @@ Mesh* Mesh::GenerateQuadTexCoordCol(Vector2 scale, Vector2 texCoord, Vector4 col
 
 	return m;
 }
+Mesh* Mesh::GenerateSphere(uint slices, uint stacks)	{
+	Mesh* m = new Mesh();
+
+	//Seam and pole vertices are duplicated so each can have it's own texture coordinate
+	m->numVertices	= (slices + 1) * (stacks + 1);
+	m->numIndices	= slices * stacks * 6;
+	m->type = GL_TRIANGLES;
+
+	m->vertices			= new Vector3[m->numVertices];
+	m->textureCoords	= new Vector2[m->numVertices];
+	m->colours			= new Vector4[m->numVertices];
+	m->normals			= new Vector3[m->numVertices];
+	m->tangents			= new Vector3[m->numVertices];
+	m->indices			= new GLuint[m->numIndices];
+
+	for (uint i = 0; i <= stacks; ++i) {
+		float phi = PI * float(i) / float(stacks);
+		for (uint j = 0; j <= slices; ++j) {
+			float theta = 2.0f * PI * float(j) / float(slices);
+			uint idx = i * (slices + 1) + j;
+
+			Vector3 normal = Vector3(sin(phi) * cos(theta), cos(phi), sin(phi) * sin(theta));
+			m->vertices[idx]		= normal;
+			m->normals[idx]			= normal;
+			m->tangents[idx]		= Vector3(-sin(theta), 0.0f, cos(theta));
+			m->textureCoords[idx]	= Vector2(float(j) / float(slices), float(i) / float(stacks));
+			m->colours[idx]			= Vector4(1.0f, 1.0f, 1.0f, 1.0f);
+		}
+	}
+
+	uint n = 0;
+	for (uint i = 0; i < stacks; ++i) {
+		for (uint j = 0; j < slices; ++j) {
+			uint a = i * (slices + 1) + j;
+			uint b = a + slices + 1;
+
+			m->indices[n++] = a;
+			m->indices[n++] = a + 1;
+			m->indices[n++] = b;
+
+			m->indices[n++] = a + 1;
+			m->indices[n++] = b + 1;
+			m->indices[n++] = b;
+		}
+	}
+
+	m->BufferData();
+
+	return m;
+}
+
 void	Mesh::BufferData()	{
 	//GenerateNormals();
 	//GenerateTangents();
 
+	if(vertexFormat == MESH_VERTEX_PACKED) {
+		BufferPackedData();
+		if(!keepCPUData) {
+			ReleaseCPUData();
+		}
+		return;
+	}
+
 	glBindVertexArray(arrayObject);
 
 	//Buffer vertex data
@@ -265,116 +351,382 @@ void	Mesh::BufferData()	{
 	}
 
 	glBindVertexArray(0);
+
+	indexType		= GL_UNSIGNED_INT;
+	bufferedSize	= numVertices * sizeof(Vector3);
+	if(textureCoords)	{ bufferedSize += numVertices * sizeof(Vector2); }
+	if(colours)			{ bufferedSize += numVertices * sizeof(Vector4); }
+	if(normals)			{ bufferedSize += numVertices * sizeof(Vector3); }
+	if(tangents)		{ bufferedSize += numVertices * sizeof(Vector3); }
+	if(indices)			{ bufferedSize += numIndices * sizeof(GLuint); }
+
+	if(!keepCPUData) {
+		ReleaseCPUData();
+	}
 }
 
 /*
-Stuff for later tutorials...
+Packs every attribute of each vertex into a single interleaved VBO (see
+SetVertexFormat). Each attribute is kept 4 byte aligned, so the vertex is
+24 bytes with everything (plus 4 with float positions, and 4 more with float
+texture coordinates), instead of 60 bytes spread across 5 VBOs.
 */
+void	Mesh::BufferPackedData()	{
+	//Half float positions are only used if every vertex survives the round trip well enough
+	Vector3 minBounds = numVertices ? vertices[0] : Vector3(0, 0, 0);
+	Vector3 maxBounds = minBounds;
+	for(GLuint i = 1; i < numVertices; ++i) {
+		minBounds.x = min(minBounds.x, vertices[i].x);	maxBounds.x = max(maxBounds.x, vertices[i].x);
+		minBounds.y = min(minBounds.y, vertices[i].y);	maxBounds.y = max(maxBounds.y, vertices[i].y);
+		minBounds.z = min(minBounds.z, vertices[i].z);	maxBounds.z = max(maxBounds.z, vertices[i].z);
+	}
+	const Vector3	extents		= maxBounds - minBounds;
+	const float		tolerance	= max(max(extents.x, extents.y), extents.z) * MESH_HALF_POSITION_TOLERANCE;
+
+	int numInaccurate = 0;
+#pragma omp parallel for reduction(+:numInaccurate) if (numVertices > MESH_PARALLEL_THRESHOLD)
+	for(int i = 0; i < (int)numVertices; ++i) {
+		const float* v = &vertices[i].x;
+		for(int j = 0; j < 3; ++j) {
+			if(!(fabs(MeshProcessing::HalfToFloat(MeshProcessing::FloatToHalf(v[j])) - v[j]) <= tolerance)) {
+				numInaccurate++;
+			}
+		}
+	}
+	const bool halfPositions = (numInaccurate == 0);
 
-void	Mesh::GenerateNormals()	{
-	if(!normals) {
-		normals = new Vector3[numVertices];
+	bool unormTexCoords = true;
+	for(GLuint i = 0; textureCoords && i < numVertices && unormTexCoords; ++i) {
+		unormTexCoords = textureCoords[i].x >= 0.0f && textureCoords[i].x <= 1.0f
+			&& textureCoords[i].y >= 0.0f && textureCoords[i].y <= 1.0f;
 	}
-	for(GLuint i = 0; i < numVertices; ++i){
-		normals[i] = Vector3();
+
+	//Texture coordinates outside of 0-1 get the same round trip check as the positions, before they're made half floats
+	int numInaccurateTexCoords = 0;
+	if(textureCoords && !unormTexCoords) {
+#pragma omp parallel for reduction(+:numInaccurateTexCoords) if (numVertices > MESH_PARALLEL_THRESHOLD)
+		for(int i = 0; i < (int)numVertices; ++i) {
+			const float* t = &textureCoords[i].x;
+			for(int j = 0; j < 2; ++j) {
+				if(!(fabs(MeshProcessing::HalfToFloat(MeshProcessing::FloatToHalf(t[j])) - t[j]) <= MESH_HALF_TEXCOORD_TOLERANCE)) {
+					numInaccurateTexCoords++;
+				}
+			}
+		}
 	}
+	const bool floatTexCoords = (numInaccurateTexCoords > 0);
+
+	//Work out where each attribute goes within a vertex
+	const GLuint positionSize = halfPositions ? 4 * sizeof(unsigned short) : sizeof(Vector3);
+	const GLuint texCoordSize = floatTexCoords ? sizeof(Vector2) : 2 * sizeof(unsigned short);
+	GLuint stride = positionSize;
+	const GLuint texCoordOffset	= stride;	if(textureCoords)	{ stride += texCoordSize; }
+	const GLuint colourOffset	= stride;	if(colours)			{ stride += 4 * sizeof(unsigned char); }
+	const GLuint normalOffset	= stride;	if(normals)			{ stride += sizeof(unsigned int); }
+	const GLuint tangentOffset	= stride;	if(tangents)		{ stride += sizeof(unsigned int); }
+
+	std::vector<unsigned char> packed((size_t)numVertices * stride);
+
+#pragma omp parallel for if (numVertices > MESH_PARALLEL_THRESHOLD)
+	for(int i = 0; i < (int)numVertices; ++i) {
+		unsigned char* out = &packed[(size_t)i * stride];
+
+		if(halfPositions) {
+			const unsigned short p[4] = { MeshProcessing::FloatToHalf(vertices[i].x), MeshProcessing::FloatToHalf(vertices[i].y),
+				MeshProcessing::FloatToHalf(vertices[i].z), MeshProcessing::FloatToHalf(1.0f) };
+			memcpy(out, p, sizeof(p));
+		}
+		else {
+			memcpy(out, &vertices[i], sizeof(Vector3));
+		}
 
-	if(indices) {
-		GLuint i = 0;
+		if(textureCoords && floatTexCoords) {
+			memcpy(out + texCoordOffset, &textureCoords[i], sizeof(Vector2));
+		}
+		else if(textureCoords) {
+			const unsigned short t[2] = {
+				unormTexCoords ? MeshProcessing::PackUnorm16(textureCoords[i].x) : MeshProcessing::FloatToHalf(textureCoords[i].x),
+				unormTexCoords ? MeshProcessing::PackUnorm16(textureCoords[i].y) : MeshProcessing::FloatToHalf(textureCoords[i].y) };
+			memcpy(out + texCoordOffset, t, sizeof(t));
+		}
+		if(colours) {
+			const unsigned char c[4] = { MeshProcessing::PackUnorm8(colours[i].x), MeshProcessing::PackUnorm8(colours[i].y),
+				MeshProcessing::PackUnorm8(colours[i].z), MeshProcessing::PackUnorm8(colours[i].w) };
+			memcpy(out + colourOffset, c, sizeof(c));
+		}
+		if(normals) {
+			const unsigned int n = MeshProcessing::PackSnorm1010102(normals[i]);
+			memcpy(out + normalOffset, &n, sizeof(n));
+		}
+		if(tangents) {
+			const unsigned int t = MeshProcessing::PackSnorm1010102(tangents[i]);
+			memcpy(out + tangentOffset, &t, sizeof(t));
+		}
+	}
 
-		int test = 0;
-		for(i = 0; i < numIndices; i+=3){
-			int a = indices[i];
-			int b = indices[i+1];
-			int c = indices[i+2];
+	glBindVertexArray(arrayObject);
 
-			Vector3 normal = Vector3::Cross((vertices[b]-vertices[a]),(vertices[c]-vertices[a]));
+	glGenBuffers(1, &bufferObject[VERTEX_BUFFER]);
+	glBindBuffer(GL_ARRAY_BUFFER, bufferObject[VERTEX_BUFFER]);
+	glBufferData(GL_ARRAY_BUFFER, packed.size(), packed.empty() ? NULL : &packed[0], GL_STATIC_DRAW);
 
-			normals[a] += normal;
-			normals[b] += normal;
-			normals[c] += normal;
+	if(halfPositions) {
+		glVertexAttribPointer(VERTEX_BUFFER, 4, GL_HALF_FLOAT, GL_FALSE, stride, 0);
+	}
+	else {
+		glVertexAttribPointer(VERTEX_BUFFER, 3, GL_FLOAT, GL_FALSE, stride, 0);
+	}
+	glEnableVertexAttribArray(VERTEX_BUFFER);
 
-			test+=3;
+	if(textureCoords) {
+		if(unormTexCoords) {
+			glVertexAttribPointer(TEXTURE_BUFFER, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)(size_t)texCoordOffset);
+		}
+		else if(floatTexCoords) {
+			glVertexAttribPointer(TEXTURE_BUFFER, 2, GL_FLOAT, GL_FALSE, stride, (void*)(size_t)texCoordOffset);
+		}
+		else {
+			glVertexAttribPointer(TEXTURE_BUFFER, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)(size_t)texCoordOffset);
+		}
+		glEnableVertexAttribArray(TEXTURE_BUFFER);
+	}
+	if(colours) {
+		glVertexAttribPointer(COLOUR_BUFFER, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)(size_t)colourOffset);
+		glEnableVertexAttribArray(COLOUR_BUFFER);
+	}
+	if(normals) {
+		glVertexAttribPointer(NORMAL_BUFFER, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)(size_t)normalOffset);
+		glEnableVertexAttribArray(NORMAL_BUFFER);
+	}
+	if(tangents) {
+		glVertexAttribPointer(TANGENT_BUFFER, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)(size_t)tangentOffset);
+		glEnableVertexAttribArray(TANGENT_BUFFER);
+	}
+
+	bufferedSize = packed.size();
+
+	indexType = PackedIndexType();
+	if(indices) {
+		glGenBuffers(1, &bufferObject[INDEX_BUFFER]);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferObject[INDEX_BUFFER]);
+
+		if(indexType == GL_UNSIGNED_SHORT) {
+			std::vector<unsigned short> shortIndices(indices, indices + numIndices);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, numIndices*sizeof(unsigned short), &shortIndices[0], GL_STATIC_DRAW);
+			bufferedSize += numIndices * sizeof(unsigned short);
+		}
+		else {
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, numIndices*sizeof(GLuint), indices, GL_STATIC_DRAW);
+			bufferedSize += numIndices * sizeof(GLuint);
 		}
-		bool asdf = true;
 	}
-	else{
-		//It's just a list of triangles, so generate face normals
-		for(GLuint i = 0; i < numVertices; i+=3){
-			Vector3 &a = vertices[i];
-			Vector3 &b = vertices[i+1];
-			Vector3 &c = vertices[i+2];
 
-			Vector3 normal = Vector3::Cross(b-a,c-a);
+	glBindVertexArray(0);
+}
 
-			normals[i]	 = normal;
-			normals[i+1] = normal;
-			normals[i+2] = normal;
+void	Mesh::ShareBufferData()	{
+	const ResourceContentKey content = ContentKey();
+
+	GLuint		sharedArray;
+	uint64_t	sharedSize;
+	if(ResourceRegistry::AcquireMeshBuffers(content, sharedArray, bufferObject, &sharedSize)) {
+		glDeleteVertexArrays(1, &arrayObject);
+		arrayObject		= sharedArray;
+		bufferedSize	= (size_t)sharedSize;
+		indexType		= (vertexFormat == MESH_VERTEX_PACKED) ? PackedIndexType() : GL_UNSIGNED_INT;
+		if(!keepCPUData) {
+			ReleaseCPUData();
 		}
+		return;
 	}
 
-	for(GLuint i = 0; i < numVertices; ++i){
-		normals[i].Normalise();
+	BufferData();
+
+	ResourceRegistry::AddMeshBuffers(content, arrayObject, bufferObject, bufferedSize);
+}
+
+ResourceContentKey	Mesh::ContentKey() const	{
+	//Which attributes are present (and how they're laid out) matters too, not just their contents
+	const unsigned int description[] = { type, vertexFormat, numVertices, numIndices,
+		textureCoords != NULL, colours != NULL, normals != NULL, tangents != NULL, indices != NULL };
+
+	ResourceContentKey content;
+	content.Add(description, sizeof(description));
+	content.Add(vertices, numVertices * sizeof(Vector3));
+	if(textureCoords)	{ content.Add(textureCoords,	numVertices * sizeof(Vector2)); }
+	if(colours)			{ content.Add(colours,			numVertices * sizeof(Vector4)); }
+	if(normals)			{ content.Add(normals,			numVertices * sizeof(Vector3)); }
+	if(tangents)		{ content.Add(tangents,			numVertices * sizeof(Vector3)); }
+	if(indices)			{ content.Add(indices,			numIndices * sizeof(GLuint)); }
+	return content;
+}
+
+void	Mesh::ShareTexture(GLuint tex)	{
+	//Taken before the old one is released, in case they're the same texture
+	ResourceRegistry::AddTextureRef(tex);
+	if(!ResourceRegistry::ReleaseTexture(texture)) {
+		glDeleteTextures(1,&texture);
 	}
+	texture = tex;
+}
+
+/*
+Stuff for later tutorials...
+*/
+
+void	Mesh::GenerateNormals()	{
+	if(!vertices) {
+		return;	//CPU copies have been released, see SetKeepCPUData
+	}
+	if(!normals) {
+		normals = new Vector3[numVertices];
+	}
+	if(indices && !adjacency) {
+		adjacency = new MeshAdjacency();
+	}
+
+	MeshProcessing::GenerateNormals(vertices, numVertices, indices, numIndices, adjacency, normals);
 }
 
 void Mesh::GenerateTangents() {
 	//Extra! stops rare occurrence of this function being called
 	//on a mesh without tex coords, which would break quite badly!
-	if(!textureCoords) {
+	if(!textureCoords || !vertices) {
 		return;
 	}
 
 	if(!tangents) {
 		tangents = new Vector3[numVertices];
 	}
-	for(GLuint i = 0; i < numVertices; ++i){
-		tangents[i] = Vector3();
+	if(indices && !adjacency) {
+		adjacency = new MeshAdjacency();
 	}
 
-	if(indices) {
-		for(GLuint i = 0; i < numIndices; i+=3){
-			int a = indices[i];
-			int b = indices[i+1];
-			int c = indices[i+2];
+	MeshProcessing::GenerateTangents(vertices, textureCoords, numVertices, indices, numIndices, adjacency, tangents);
+}
 
-			Vector3 tangent = GenerateTangent(vertices[a],vertices[b],vertices[c],textureCoords[a],textureCoords[b],textureCoords[c]);
+Vector3 Mesh::GenerateTangent(const Vector3 &a,const Vector3 &b,const Vector3 &c,const Vector2 &ta,const Vector2 &tb,const Vector2 &tc)	 {
+	return MeshProcessing::FaceTangent(a, b, c, ta, tb, tc);
+}
 
-			tangents[a] += tangent;
-			tangents[b] += tangent;
-			tangents[c] += tangent;
-		}
+//Replaces the given attribute array with a remapped copy of itself
+template <class T>
+static void RemapAttribute(T* &data, const unsigned int* remap, unsigned int count, unsigned int newCount) {
+	if(data) {
+		T* remapped = new T[newCount];
+		MeshProcessing::RemapArray(data, remap, count, remapped);
+		delete[] data;
+		data = remapped;
+	}
+}
+
+unsigned int	Mesh::WeldVertices(float epsilon)	{
+	if(!vertices) {
+		return 0;
 	}
-	else{
-		for(GLuint i = 0; i < numVertices; i+=3){
-			Vector3 tangent = GenerateTangent(vertices[i],vertices[i+1],vertices[i+2],textureCoords[i],textureCoords[i+1],textureCoords[i+2]);
 
-			tangents[i]   += tangent;
-			tangents[i+1] += tangent;
-			tangents[i+2] += tangent;
+	std::vector<unsigned int> remap(numVertices);
+	const unsigned int numUnique = MeshProcessing::BuildWeldRemap(vertices, textureCoords, normals, tangents, colours, numVertices, epsilon, &remap[0]);
+
+	if(indices) {
+		for(GLuint i = 0; i < numIndices; ++i) {
+			indices[i] = remap[indices[i]];
 		}
 	}
-	for(GLuint i = 0; i < numVertices; ++i){
-		tangents[i].Normalise();
+	else {
+		numIndices	= numVertices;
+		indices		= new unsigned int[numIndices];
+		for(GLuint i = 0; i < numIndices; ++i) {
+			indices[i] = remap[i];
+		}
 	}
+
+	RemapAttribute(vertices,		&remap[0], numVertices, numUnique);
+	RemapAttribute(colours,			&remap[0], numVertices, numUnique);
+	RemapAttribute(textureCoords,	&remap[0], numVertices, numUnique);
+	RemapAttribute(normals,			&remap[0], numVertices, numUnique);
+	RemapAttribute(tangents,		&remap[0], numVertices, numUnique);
+
+	const unsigned int removed = numVertices - numUnique;
+	numVertices = numUnique;
+
+	delete adjacency;	//The index buffer has changed
+	adjacency = NULL;
+	return removed;
 }
 
-Vector3 Mesh::GenerateTangent(const Vector3 &a,const Vector3 &b,const Vector3 &c,const Vector2 &ta,const Vector2 &tb,const Vector2 &tc)	 {
-	Vector2 coord1  = tb-ta;
-	Vector2 coord2  = tc-ta;
+void	Mesh::OptimiseIndices()	{
+	if(!indices) {
+		return;	//Nothing to reorder without an index buffer, see WeldVertices
+	}
 
-	Vector3 vertex1 = b-a;
-	Vector3 vertex2 = c-a;
+	MeshProcessing::OptimiseVertexCache(indices, numIndices, numVertices);
 
-	Vector3 axis = Vector3(vertex1*coord2.y - vertex2*coord1.y);
+	std::vector<unsigned int> remap(numVertices);
+	const unsigned int numUsed = MeshProcessing::OptimiseVertexFetch(indices, numIndices, numVertices, &remap[0]);
 
-	float factor = 1.0f / (coord1.x * coord2.y - coord2.x * coord1.y);
+	RemapAttribute(vertices,		&remap[0], numVertices, numUsed);
+	RemapAttribute(colours,			&remap[0], numVertices, numUsed);
+	RemapAttribute(textureCoords,	&remap[0], numVertices, numUsed);
+	RemapAttribute(normals,			&remap[0], numVertices, numUsed);
+	RemapAttribute(tangents,		&remap[0], numVertices, numUsed);
+	numVertices = numUsed;
+
+	delete adjacency;
+	adjacency = NULL;
+}
+
+void Mesh::DrawInstanced(GLuint num_instances, GLuint instance_buffer, size_t instance_offset, GLsizei instance_stride, bool update)	{
+	if(update) {
+		if (tex0 != texture || tex1 != bumpTexture)
+		{
+			tex0 = texture;
+			tex1 = bumpTexture;
+
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, texture);
 
-	return axis * factor;
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, bumpTexture);
+		}
+	}
+
+	if (arrObj != arrayObject)
+	{
+		glBindVertexArray(arrayObject);
+		arrObj = arrayObject;
+	}
+
+	//Point the instance attributes at this batch's section of the instance buffer
+	// (without base-instance support, this has to be done for every batch)
+	glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+	for (int i = 0; i < 4; ++i) {
+		glVertexAttribPointer(INSTANCE_MODELMATRIX_ATTRIB + i, 4, GL_FLOAT, GL_FALSE, instance_stride, (void*)(instance_offset + sizeof(float) * 4 * i));
+		glVertexAttribDivisor(INSTANCE_MODELMATRIX_ATTRIB + i, 1);
+		glEnableVertexAttribArray(INSTANCE_MODELMATRIX_ATTRIB + i);
+	}
+	glVertexAttribPointer(INSTANCE_COLOUR_ATTRIB, 4, GL_FLOAT, GL_FALSE, instance_stride, (void*)(instance_offset + sizeof(float) * 16));
+	glVertexAttribDivisor(INSTANCE_COLOUR_ATTRIB, 1);
+	glEnableVertexAttribArray(INSTANCE_COLOUR_ATTRIB);
+
+	if (bufferObject[INDEX_BUFFER]) {
+		glDrawElementsInstanced(type, numIndices, indexType, 0, num_instances);
+	}
+	else{
+		glDrawArraysInstanced(type, 0, numVertices, num_instances);
+	}
+
+	//The VAO is shared with regular Draw calls, so the instance attributes mustn't be left reading from the instance buffer
+	for (int i = 0; i < 4; ++i) {
+		glVertexAttribDivisor(INSTANCE_MODELMATRIX_ATTRIB + i, 0);
+		glDisableVertexAttribArray(INSTANCE_MODELMATRIX_ATTRIB + i);
+	}
+	glVertexAttribDivisor(INSTANCE_COLOUR_ATTRIB, 0);
+	glDisableVertexAttribArray(INSTANCE_COLOUR_ATTRIB);
 }
 
 void Mesh::DrawDebugNormals(float length)	{
-	if(numVertices > 0) {
+	if(numVertices > 0 && vertices && normals) {
 		GLuint array;
 		GLuint buffer;
 		GLuint cbuffer;
@@ -428,7 +780,7 @@ void Mesh::DrawDebugNormals(float length)	{
 }
 
 void Mesh::DrawDebugTangents(float length)	{
-	if(numVertices > 0) {
+	if(numVertices > 0 && vertices && tangents) {
 		GLuint array;
 		GLuint buffer;
 		GLuint cbuffer;
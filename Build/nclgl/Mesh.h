@@ -20,6 +20,10 @@ _-_-_-_-_-_-_-""  ""
 
 #include "OGLRenderer.h"
 #include <vector>
+#include <cstdint>
+
+class MeshAdjacency;
+struct ResourceContentKey;
 
 //A handy enumerator, to determine which member of the bufferObject array
 //holds which data
@@ -33,6 +37,22 @@ enum MeshBuffer {
 	MAX_BUFFER
 };
 
+//Per-instance vertex attributes used by DrawInstanced
+// - The model matrix takes up 4 consecutive attribute locations (one per column)
+#define INSTANCE_MODELMATRIX_ATTRIB	8
+#define INSTANCE_COLOUR_ATTRIB		12
+
+//How the vertex attributes are laid out on the graphics card, see SetVertexFormat
+enum MeshVertexFormat {
+	MESH_VERTEX_SEPARATE,	//Each attribute in it's own VBO, at full precision
+	MESH_VERTEX_PACKED		//All attributes interleaved in a single VBO, quantised to smaller types
+};
+
+//Largest error (as a fraction of the mesh's size) allowed when packing positions as half floats
+#define MESH_HALF_POSITION_TOLERANCE	(1.0f / 4096.0f)
+//Largest error (in texture coordinates, so a quarter of a texel of a 1024 texture) allowed when packing texture coordinates as half floats
+#define MESH_HALF_TEXCOORD_TOLERANCE	(1.0f / 4096.0f)
+
 class Mesh	{
 public:
 	friend class MD5Mesh;
@@ -42,6 +62,10 @@ public:
 	static void Reset();
 	virtual void Draw(bool update = true);
 
+	//Draws multiple copies of the mesh in a single draw call. Each instance reads it's model matrix (mat4) followed
+	//by it's colour (vec4) from 'instance_buffer', starting at 'instance_offset' bytes and 'instance_stride' bytes apart.
+	void DrawInstanced(GLuint num_instances, GLuint instance_buffer, size_t instance_offset, GLsizei instance_stride, bool update = true);
+
 	//Generates a single triangle, with RGB colours
 	static Mesh*	GenerateTriangle();
 	
@@ -51,9 +75,16 @@ public:
 	static Mesh*	GenerateQuadAlt();
 	//Generates a coloured quad, going from -1 to 1 on the x and z axis, with adjustable texture coords.
 	static Mesh*	GenerateQuadTexCoordCol(Vector2 scale, Vector2 texCoord, Vector4 colour); //NX 01/11/2012
+	//Generates a white unit sphere (radius 1) made up of the given number of slices (around the y axis) and stacks (top to bottom)
+	//	- Mainly useful for building lower level of detail versions of sphere meshes
+	static Mesh*	GenerateSphere(uint slices, uint stacks);
 
 	//Sets the Mesh's diffuse map. Takes an OpenGL texture 'name'
+	// - The mesh deletes it's textures along with itself (or releases them, if they came from the ResourceRegistry)
 	void	SetTexture(GLuint tex)	{texture = tex;}
+	//Swaps the Mesh's diffuse map for a ResourceRegistry texture someone else is also using, taking a
+	//reference to it, and releasing (or deleting) the one it had before
+	void	ShareTexture(GLuint tex);
 	//Gets the Mesh's diffuse map. Returns an OpenGL texture 'name'
 	GLuint  GetTexture()			{return texture;}
 
@@ -71,15 +102,67 @@ public:
 	bool	TransformsTexCoords() { return transformCoords;}
 
 	//Generates normals for all facets. Assumes geometry type is GL_TRIANGLES...
+	//	- Done in parallel for big meshes, and doesn't allocate anything after the first call (see MeshProcessing)
 	void	GenerateNormals();
 
 	//Generates tangents for all facets. Assumes geometry type is GL_TRIANGLES...
 	void	GenerateTangents();
 
+	//Merges vertices whose attributes are all within 'epsilon' of each other, turning unindexed meshes into indexed
+	//ones. Assumes geometry type is GL_TRIANGLES, and must be called before BufferData. Returns how many vertices were removed
+	unsigned int	WeldVertices(float epsilon = 0.0f);
+
+	//Reorders the triangles to make better use of the post transform vertex cache, and then the vertices into the
+	//order they're used. Assumes geometry type is GL_TRIANGLES, and must be called before BufferData
+	void	OptimiseIndices();
+
+	/*
+	Chooses the layout BufferData uses, which must be set before it is called.
+	The packed layout interleaves every attribute into a single VBO as:-
+		- Positions as half floats (with w = 1), if they fit within
+		  MESH_HALF_POSITION_TOLERANCE of the mesh's size, or floats otherwise
+		- Normals and tangents as signed normalised 10:10:10:2 integers
+		- Texture coordinates as unsigned normalised shorts if they're all
+		  between 0 and 1, otherwise as half floats if they fit within
+		  MESH_HALF_TEXCOORD_TOLERANCE, or floats if they don't (half floats
+		  only manage that between -1 and 1)
+		- Colours as unsigned normalised bytes
+	with 16 bit indices if there are few enough vertices. OpenGL turns them all
+	back into floats before they reach the vertex shader, so shaders don't
+	need to change. Meshes that update their buffers (e.g. MD5Mesh skinning)
+	should stick with separate buffers.
+	*/
+	void				SetVertexFormat(MeshVertexFormat format)	{ vertexFormat = format; }
+	MeshVertexFormat	GetVertexFormat() const						{ return vertexFormat; }
+
+	//If false, the CPU copies of the vertex data are deleted once BufferData has uploaded them,
+	//after which generating normals/tangents, welding, optimising and debug drawing do nothing
+	void	SetKeepCPUData(bool keep)	{ keepCPUData = keep; }
+	void	ReleaseCPUData();
+
+	//Size of the vertex and index data sent to the graphics card, in bytes
+	size_t	GetBufferedSize() const		{ return bufferedSize; }
+
 protected:
 	//Buffers all VBO data into graphics memory. Required before drawing!
 	void	BufferData();
 
+	//BufferData for the MESH_VERTEX_PACKED layout
+	void	BufferPackedData();
+
+	//16 bit indices are enough for packed meshes with up to 65536 vertices
+	GLenum	PackedIndexType() const		{ return (numVertices <= 65536) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT; }
+
+	/*
+	As above, but shares the VAO and VBOs with any other mesh that has exactly
+	the same contents, using the ResourceRegistry. The buffers of a mesh that
+	has been shared must not be changed afterwards.
+	*/
+	void	ShareBufferData();
+
+	//Hashes of everything BufferData sends to the graphics card
+	ResourceContentKey	ContentKey() const;
+
 	//Helper function for GenerateTangents
 	Vector3 GenerateTangent(const Vector3 &a,const Vector3 &b,const Vector3 &c,const Vector2 &ta,const Vector2 &tb,const Vector2 &tc);
 
@@ -120,6 +203,15 @@ protected:
 	//Pointer to vertex indices attribute data
 	unsigned int*	indices;
 
+	//Which triangles use each vertex, built the first time normals or tangents are generated
+	MeshAdjacency*	adjacency;
+
+	MeshVertexFormat	vertexFormat;
+	bool				keepCPUData;
+	//Type of the indices in the index buffer (GL_UNSIGNED_INT or GL_UNSIGNED_SHORT)
+	GLenum				indexType;
+	size_t				bufferedSize;
+
 
 	bool			transformCoords;
 };
@@ -0,0 +1,472 @@
+#include "MeshProcessing.h"
+#include <cmath>
+#include <cstring>
+
+MeshAdjacency::MeshAdjacency(void)	{
+	builtIndices		= NULL;
+	builtNumIndices		= 0;
+	builtNumVertices	= 0;
+}
+
+void	MeshAdjacency::Build(const unsigned int* indices, unsigned int numIndices, unsigned int numVertices)	{
+	const unsigned int numTris = numIndices / 3;
+
+	//Count how many faces use each vertex, then turn the counts into offsets into the face list
+	offsets.assign(numVertices + 1, 0);
+	for(unsigned int i = 0; i < numTris * 3; ++i) {
+		offsets[indices[i] + 1]++;
+	}
+	for(unsigned int i = 0; i < numVertices; ++i) {
+		offsets[i + 1] += offsets[i];
+	}
+
+	//Going through the triangles in order keeps each vertex's faces in order too
+	faces.resize(numTris * 3);
+	std::vector<unsigned int> next(offsets.begin(), offsets.end() - 1);
+	for(unsigned int i = 0; i < numTris * 3; ++i) {
+		faces[next[indices[i]]++] = i / 3;
+	}
+
+	faceScratch.resize(numTris);
+
+	builtIndices		= indices;
+	builtNumIndices		= numIndices;
+	builtNumVertices	= numVertices;
+}
+
+void	MeshProcessing::GenerateNormals(const Vector3* vertices, unsigned int numVertices,
+	const unsigned int* indices, unsigned int numIndices, MeshAdjacency* adjacency, Vector3* outNormals)	{
+	if(!indices) {
+		//It's just a list of triangles, so generate face normals
+		const int numTris = (int)(numVertices / 3);
+#pragma omp parallel for if (numTris > MESH_PARALLEL_THRESHOLD)
+		for(int i = 0; i < numTris; ++i) {
+			const Vector3 &a = vertices[i * 3];
+			const Vector3 &b = vertices[i * 3 + 1];
+			const Vector3 &c = vertices[i * 3 + 2];
+
+			Vector3 normal = Vector3::Cross(b - a, c - a);
+			normal.Normalise();
+
+			outNormals[i * 3]		= normal;
+			outNormals[i * 3 + 1]	= normal;
+			outNormals[i * 3 + 2]	= normal;
+		}
+		return;
+	}
+
+	if(!adjacency->IsBuiltFor(indices, numIndices, numVertices)) {
+		adjacency->Build(indices, numIndices, numVertices);
+	}
+
+	//Each face's normal is worked out once...
+	Vector3* faceNormals = adjacency->GetFaceScratch();
+	const int numTris = (int)(numIndices / 3);
+#pragma omp parallel for if (numTris > MESH_PARALLEL_THRESHOLD)
+	for(int i = 0; i < numTris; ++i) {
+		const Vector3 &a = vertices[indices[i * 3]];
+		const Vector3 &b = vertices[indices[i * 3 + 1]];
+		const Vector3 &c = vertices[indices[i * 3 + 2]];
+
+		faceNormals[i] = Vector3::Cross(b - a, c - a);
+	}
+
+	//...and then each vertex adds up the normals of the faces using it
+	const int numVerts = (int)numVertices;
+#pragma omp parallel for if (numVerts > MESH_PARALLEL_THRESHOLD)
+	for(int i = 0; i < numVerts; ++i) {
+		const unsigned int* faces		= adjacency->GetFaces(i);
+		const unsigned int	numFaces	= adjacency->GetNumFaces(i);
+
+		Vector3 normal;
+		for(unsigned int j = 0; j < numFaces; ++j) {
+			normal += faceNormals[faces[j]];
+		}
+		normal.Normalise();
+		outNormals[i] = normal;
+	}
+}
+
+void	MeshProcessing::GenerateTangents(const Vector3* vertices, const Vector2* texCoords, unsigned int numVertices,
+	const unsigned int* indices, unsigned int numIndices, MeshAdjacency* adjacency, Vector3* outTangents)	{
+	if(!indices) {
+		const int numTris = (int)(numVertices / 3);
+#pragma omp parallel for if (numTris > MESH_PARALLEL_THRESHOLD)
+		for(int i = 0; i < numTris; ++i) {
+			const int a = i * 3;
+			Vector3 tangent = FaceTangent(vertices[a], vertices[a + 1], vertices[a + 2], texCoords[a], texCoords[a + 1], texCoords[a + 2]);
+			tangent.Normalise();
+
+			outTangents[a]		= tangent;
+			outTangents[a + 1]	= tangent;
+			outTangents[a + 2]	= tangent;
+		}
+		return;
+	}
+
+	if(!adjacency->IsBuiltFor(indices, numIndices, numVertices)) {
+		adjacency->Build(indices, numIndices, numVertices);
+	}
+
+	Vector3* faceTangents = adjacency->GetFaceScratch();
+	const int numTris = (int)(numIndices / 3);
+#pragma omp parallel for if (numTris > MESH_PARALLEL_THRESHOLD)
+	for(int i = 0; i < numTris; ++i) {
+		const unsigned int a = indices[i * 3];
+		const unsigned int b = indices[i * 3 + 1];
+		const unsigned int c = indices[i * 3 + 2];
+
+		faceTangents[i] = FaceTangent(vertices[a], vertices[b], vertices[c], texCoords[a], texCoords[b], texCoords[c]);
+	}
+
+	const int numVerts = (int)numVertices;
+#pragma omp parallel for if (numVerts > MESH_PARALLEL_THRESHOLD)
+	for(int i = 0; i < numVerts; ++i) {
+		const unsigned int* faces		= adjacency->GetFaces(i);
+		const unsigned int	numFaces	= adjacency->GetNumFaces(i);
+
+		Vector3 tangent;
+		for(unsigned int j = 0; j < numFaces; ++j) {
+			tangent += faceTangents[faces[j]];
+		}
+		tangent.Normalise();
+		outTangents[i] = tangent;
+	}
+}
+
+Vector3	MeshProcessing::FaceTangent(const Vector3 &a, const Vector3 &b, const Vector3 &c, const Vector2 &ta, const Vector2 &tb, const Vector2 &tc)	{
+	Vector2 coord1  = tb-ta;
+	Vector2 coord2  = tc-ta;
+
+	Vector3 vertex1 = b-a;
+	Vector3 vertex2 = c-a;
+
+	Vector3 axis = Vector3(vertex1*coord2.y - vertex2*coord1.y);
+
+	float factor = 1.0f / (coord1.x * coord2.y - coord2.x * coord1.y);
+
+	return axis * factor;
+}
+
+/*
+Welding compares vertices by a key of all of their attributes, snapped to a grid
+'epsilon' in size (or the exact bits of each float if it's 0). Vertices are
+looked up in an open addressed hash table of keys, like the OBJ loader uses.
+*/
+#define MESH_WELD_MAX_KEY	15	//Position, tex coord, normal, tangent and colour
+
+struct MeshWeldKey {
+	int				values[MESH_WELD_MAX_KEY];
+
+	bool operator==(const MeshWeldKey &o) const {
+		return memcmp(values, o.values, sizeof(values)) == 0;
+	}
+};
+
+static int	WeldQuantise(float f, float invEpsilon)	{
+	if(invEpsilon > 0.0f) {
+		return (int)floor(f * invEpsilon + 0.5f);
+	}
+	if(f == 0.0f) {
+		return 0;	//Stops -0 and 0 being treated as different
+	}
+	int bits;
+	memcpy(&bits, &f, sizeof(int));
+	return bits;
+}
+
+static unsigned int	WeldHash(const MeshWeldKey &key)	{
+	unsigned int hash = 2166136261u;	//FNV-1a
+	for(int i = 0; i < MESH_WELD_MAX_KEY; ++i) {
+		hash = (hash ^ (unsigned int)key.values[i]) * 16777619u;
+	}
+	return hash;
+}
+
+unsigned int	MeshProcessing::BuildWeldRemap(const Vector3* vertices, const Vector2* texCoords, const Vector3* normals,
+	const Vector3* tangents, const Vector4* colours, unsigned int numVertices, float epsilon, unsigned int* outRemap)	{
+	const float invEpsilon = epsilon > 0.0f ? 1.0f / epsilon : 0.0f;
+
+	std::vector<MeshWeldKey> keys(numVertices);
+#pragma omp parallel for if (numVertices > MESH_PARALLEL_THRESHOLD)
+	for(int i = 0; i < (int)numVertices; ++i) {
+		MeshWeldKey &key = keys[i];
+		memset(key.values, 0, sizeof(key.values));
+
+		key.values[0] = WeldQuantise(vertices[i].x, invEpsilon);
+		key.values[1] = WeldQuantise(vertices[i].y, invEpsilon);
+		key.values[2] = WeldQuantise(vertices[i].z, invEpsilon);
+		if(texCoords) {
+			key.values[3] = WeldQuantise(texCoords[i].x, invEpsilon);
+			key.values[4] = WeldQuantise(texCoords[i].y, invEpsilon);
+		}
+		if(normals) {
+			key.values[5] = WeldQuantise(normals[i].x, invEpsilon);
+			key.values[6] = WeldQuantise(normals[i].y, invEpsilon);
+			key.values[7] = WeldQuantise(normals[i].z, invEpsilon);
+		}
+		if(tangents) {
+			key.values[8]  = WeldQuantise(tangents[i].x, invEpsilon);
+			key.values[9]  = WeldQuantise(tangents[i].y, invEpsilon);
+			key.values[10] = WeldQuantise(tangents[i].z, invEpsilon);
+		}
+		if(colours) {
+			key.values[11] = WeldQuantise(colours[i].x, invEpsilon);
+			key.values[12] = WeldQuantise(colours[i].y, invEpsilon);
+			key.values[13] = WeldQuantise(colours[i].z, invEpsilon);
+			key.values[14] = WeldQuantise(colours[i].w, invEpsilon);
+		}
+	}
+
+	unsigned int tableSize = 16;
+	while(tableSize < numVertices * 2) {
+		tableSize *= 2;
+	}
+	std::vector<unsigned int> table(tableSize, MESH_UNUSED_VERTEX);	//Holds the first vertex with each key
+
+	unsigned int numUnique = 0;
+	for(unsigned int i = 0; i < numVertices; ++i) {
+		unsigned int slot = WeldHash(keys[i]) & (tableSize - 1);
+		while(table[slot] != MESH_UNUSED_VERTEX && !(keys[table[slot]] == keys[i])) {
+			slot = (slot + 1) & (tableSize - 1);
+		}
+
+		if(table[slot] == MESH_UNUSED_VERTEX) {
+			table[slot]		= i;
+			outRemap[i]		= numUnique++;
+		}
+		else {
+			outRemap[i]		= outRemap[table[slot]];
+		}
+	}
+	return numUnique;
+}
+
+/*
+Scores from Tom Forsyth's 'Linear-Speed Vertex Cache Optimisation'. Vertices
+recently added to the cache score highly (other than the last triangle's, which
+are slightly lower, so we don't just make long thin strips), as do vertices with
+only a few triangles left to use them, so we don't leave lone triangles behind.
+*/
+#define MESH_CACHE_DECAY_POWER		1.5f
+#define MESH_LAST_TRI_SCORE			0.75f
+#define MESH_VALENCE_BOOST_SCALE	2.0f
+#define MESH_VALENCE_BOOST_POWER	0.5f
+
+static float	VertexCacheScore(int cachePosition, unsigned int remainingFaces)	{
+	if(remainingFaces == 0) {
+		return -1.0f;	//No triangles left to use it, so it doesn't matter any more
+	}
+
+	float score = 0.0f;
+	if(cachePosition >= 0) {
+		if(cachePosition < 3) {
+			score = MESH_LAST_TRI_SCORE;
+		}
+		else {
+			const float scaler = 1.0f / (MESH_VERTEX_CACHE_SIZE - 3);
+			score = powf(1.0f - (cachePosition - 3) * scaler, MESH_CACHE_DECAY_POWER);
+		}
+	}
+	return score + MESH_VALENCE_BOOST_SCALE * powf((float)remainingFaces, -MESH_VALENCE_BOOST_POWER);
+}
+
+void	MeshProcessing::OptimiseVertexCache(unsigned int* indices, unsigned int numIndices, unsigned int numVertices)	{
+	const unsigned int numTris = numIndices / 3;
+	if(numTris == 0) {
+		return;
+	}
+
+	MeshAdjacency adjacency;
+	adjacency.Build(indices, numIndices, numVertices);
+
+	//Each vertex's list of faces, which are removed as they are added to the output
+	std::vector<unsigned int>	liveFaces(numTris * 3);
+	std::vector<unsigned int>	liveStart(numVertices);
+	std::vector<unsigned int>	remaining(numVertices);
+	std::vector<int>			cachePosition(numVertices, -1);
+	std::vector<float>			vertexScore(numVertices);
+
+	for(unsigned int i = 0; i < numVertices; ++i) {
+		const unsigned int numFaces = adjacency.GetNumFaces(i);
+		liveStart[i]	= (unsigned int)(adjacency.GetFaces(i) - adjacency.GetFaces(0));
+		remaining[i]	= numFaces;
+		vertexScore[i]	= VertexCacheScore(-1, numFaces);
+		if(numFaces > 0) {
+			memcpy(&liveFaces[liveStart[i]], adjacency.GetFaces(i), numFaces * sizeof(unsigned int));
+		}
+	}
+
+	std::vector<bool>	triAdded(numTris, false);
+
+	std::vector<unsigned int> output(numTris * 3);
+
+	//The cache gets up to 3 extra entries while a triangle is being added, which then fall out of the end
+	unsigned int	cache[MESH_VERTEX_CACHE_SIZE + 3];
+	unsigned int	cacheCount = 0;
+	unsigned int	scanPosition = 0;
+	int				bestTri = -1;
+
+	for(unsigned int written = 0; written < numTris; ++written) {
+		if(bestTri < 0) {
+			//Nothing in the cache has any triangles left, so carry on from the next triangle we haven't added yet
+			while(triAdded[scanPosition]) {
+				++scanPosition;
+			}
+			bestTri = (int)scanPosition;
+		}
+
+		const unsigned int* tri = &indices[bestTri * 3];
+		triAdded[bestTri] = true;
+		memcpy(&output[written * 3], tri, 3 * sizeof(unsigned int));
+
+		//Remove the triangle from its vertices' live face lists
+		for(int j = 0; j < 3; ++j) {
+			const unsigned int v = tri[j];
+			unsigned int* faces = &liveFaces[liveStart[v]];
+			for(unsigned int k = 0; k < remaining[v]; ++k) {
+				if(faces[k] == (unsigned int)bestTri) {
+					faces[k] = faces[remaining[v] - 1];
+					break;
+				}
+			}
+			remaining[v]--;
+		}
+
+		//The triangle's vertices move to the front of the cache, pushing everything else back
+		unsigned int newCache[MESH_VERTEX_CACHE_SIZE + 3];
+		unsigned int newCount = 0;
+		for(int j = 0; j < 3; ++j) {
+			if(j == 0 || (tri[j] != tri[0] && (j == 1 || tri[j] != tri[1]))) {
+				newCache[newCount++] = tri[j];
+			}
+		}
+		for(unsigned int j = 0; j < cacheCount; ++j) {
+			const unsigned int v = cache[j];
+			if(v != tri[0] && v != tri[1] && v != tri[2]) {
+				newCache[newCount++] = v;
+			}
+		}
+
+		//Rescore everything that was in the cache, along with their triangles, and find the new best one
+		float bestScore = -1.0f;
+		bestTri = -1;
+		for(unsigned int j = 0; j < newCount; ++j) {
+			const unsigned int v = newCache[j];
+			cachePosition[v]	= (j < MESH_VERTEX_CACHE_SIZE) ? (int)j : -1;
+			vertexScore[v]		= VertexCacheScore(cachePosition[v], remaining[v]);
+		}
+		for(unsigned int j = 0; j < newCount; ++j) {
+			const unsigned int v = newCache[j];
+			const unsigned int* faces = &liveFaces[liveStart[v]];
+			for(unsigned int k = 0; k < remaining[v]; ++k) {
+				const unsigned int t = faces[k];
+				const float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+				if(score > bestScore) {
+					bestScore	= score;
+					bestTri		= (int)t;
+				}
+			}
+		}
+
+		cacheCount = newCount < MESH_VERTEX_CACHE_SIZE ? newCount : MESH_VERTEX_CACHE_SIZE;
+		memcpy(cache, newCache, cacheCount * sizeof(unsigned int));
+	}
+
+	memcpy(indices, &output[0], numTris * 3 * sizeof(unsigned int));
+}
+
+unsigned int	MeshProcessing::OptimiseVertexFetch(unsigned int* indices, unsigned int numIndices, unsigned int numVertices, unsigned int* outRemap)	{
+	for(unsigned int i = 0; i < numVertices; ++i) {
+		outRemap[i] = MESH_UNUSED_VERTEX;
+	}
+
+	unsigned int numUsed = 0;
+	for(unsigned int i = 0; i < numIndices; ++i) {
+		unsigned int &remapped = outRemap[indices[i]];
+		if(remapped == MESH_UNUSED_VERTEX) {
+			remapped = numUsed++;
+		}
+		indices[i] = remapped;
+	}
+	return numUsed;
+}
+
+float	MeshProcessing::CalculateACMR(const unsigned int* indices, unsigned int numIndices, unsigned int numVertices, unsigned int cacheSize)	{
+	const unsigned int numTris = numIndices / 3;
+	if(numTris == 0) {
+		return 0.0f;
+	}
+
+	//A vertex is still in the FIFO if fewer than cacheSize misses have happened since it was added
+	std::vector<unsigned int> addedAt(numVertices, 0);
+	unsigned int misses = 0;
+	unsigned int time	= cacheSize + 1;
+
+	for(unsigned int i = 0; i < numTris * 3; ++i) {
+		const unsigned int v = indices[i];
+		if(time - addedAt[v] > cacheSize) {
+			addedAt[v] = time++;
+			++misses;
+		}
+	}
+	return misses / (float)numTris;
+}
+
+unsigned short	MeshProcessing::FloatToHalf(float f)	{
+	unsigned int bits;
+	memcpy(&bits, &f, sizeof(bits));
+
+	const unsigned short	sign	= (unsigned short)((bits >> 16) & 0x8000);
+	const unsigned int		absBits	= bits & 0x7FFFFFFF;
+
+	if(absBits >= 0x47800000) {
+		//Too big (>= 65536), infinity or NaN
+		return sign | ((absBits > 0x7F800000) ? 0x7E00 : 0x7C00);
+	}
+	if(absBits < 0x38800000) {
+		//Below the smallest normal half (2^-14), so it becomes a multiple of 2^-24
+		return sign | (unsigned short)floor(fabs(f) * 16777216.0f + 0.5f);
+	}
+
+	//Rebias the exponent, and round the mantissa to the nearest (even) 10 bits. Rounding up can carry into the exponent, which is fine
+	unsigned int half		= ((absBits - 0x38000000) >> 13);
+	const unsigned int rem	= absBits & 0x1FFF;
+	if(rem > 0x1000 || (rem == 0x1000 && (half & 1))) {
+		++half;
+	}
+	return sign | (unsigned short)half;
+}
+
+float	MeshProcessing::HalfToFloat(unsigned short h)	{
+	const int exponent = (h >> 10) & 0x1F;
+	const int mantissa = h & 0x3FF;
+
+	float f;
+	if(exponent == 0) {
+		f = ldexp((float)mantissa, -24);
+	}
+	else if(exponent == 31) {
+		f = mantissa ? NAN : INFINITY;
+	}
+	else {
+		f = ldexp((float)(mantissa | 0x400), exponent - 25);
+	}
+	return (h & 0x8000) ? -f : f;
+}
+
+unsigned int	MeshProcessing::PackSnorm1010102(const Vector3 &v)	{
+	//OpenGL 4.2 onwards maps -511..511 to -1..1 (older versions are very slightly different, but near enough)
+	const int x = (int)floor(min(max(v.x, -1.0f), 1.0f) * 511.0f + 0.5f);
+	const int y = (int)floor(min(max(v.y, -1.0f), 1.0f) * 511.0f + 0.5f);
+	const int z = (int)floor(min(max(v.z, -1.0f), 1.0f) * 511.0f + 0.5f);
+	return (x & 0x3FF) | ((y & 0x3FF) << 10) | ((z & 0x3FF) << 20);
+}
+
+unsigned short	MeshProcessing::PackUnorm16(float f)	{
+	return (unsigned short)floor(min(max(f, 0.0f), 1.0f) * 65535.0f + 0.5f);
+}
+
+unsigned char	MeshProcessing::PackUnorm8(float f)	{
+	return (unsigned char)floor(min(max(f, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
@@ -0,0 +1,142 @@
+/******************************************************************************
+Class:MeshProcessing
+Implements:
+Author:Pieran Marris <p.marris@newcastle.ac.uk>
+Description:Helper functions for processing raw triangle mesh data, used by
+Mesh, OBJMesh and MD5Mesh.
+
+Generating smooth normals (and tangents) the obvious way means adding each
+face's normal onto all three of it's vertices, which can't be done in parallel
+without threads fighting over the vertices they share. Instead, a
+MeshAdjacency is built once for a mesh, listing the faces that use each vertex,
+so that each vertex can gather it's own faces' normals without any other thread
+writing to it. It also keeps the per face working space, so once it has been
+built (e.g. on the first frame of an animated MD5Mesh) generating normals
+doesn't allocate any memory.
+
+There's also a couple of functions for making meshes quicker to render:
+ - Welding, which merges duplicate vertices and turns triangle lists into
+   indexed meshes.
+ - Reordering the triangles to make good use of the GPU's post transform vertex
+   cache (Tom Forsyth's 'Linear-Speed Vertex Cache Optimisation'), so each
+   vertex gets run through the vertex shader fewer times, and then reordering
+   the vertices into the order they're used, so they're fetched in order.
+
+-_-_-_-_-_-_-_,------,
+_-_-_-_-_-_-_-|   /\_/\   NYANYANYAN
+-_-_-_-_-_-_-~|__( ^ .^) /
+_-_-_-_-_-_-_-""  ""
+
+*//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Vector2.h"
+#include "Vector3.h"
+#include "Vector4.h"
+#include <vector>
+
+#define MESH_PARALLEL_THRESHOLD		4096	//Meshes with fewer triangles/vertices than this are processed on one thread
+#define MESH_VERTEX_CACHE_SIZE		32		//Size of the post transform vertex cache the triangle order is optimised for
+#define MESH_UNUSED_VERTEX			0xFFFFFFFF	//Remap entry of vertices that aren't used by any triangle
+
+/*
+Lists which triangles use each vertex of an indexed triangle mesh. The
+triangles using vertex v are GetFaces(v)[0] to GetFaces(v)[GetNumFaces(v)-1],
+in the order they appear in the index buffer.
+*/
+class MeshAdjacency	{
+public:
+	MeshAdjacency(void);
+	~MeshAdjacency(void) {}
+
+	void	Build(const unsigned int* indices, unsigned int numIndices, unsigned int numVertices);
+
+	//Returns true if this was built from the given index buffer (it's up to the caller to rebuild it if the contents change)
+	bool	IsBuiltFor(const unsigned int* indices, unsigned int numIndices, unsigned int numVertices) const {
+		return builtIndices == indices && builtNumIndices == numIndices && builtNumVertices == numVertices;
+	}
+
+	const unsigned int*	GetFaces(unsigned int vertex)		const { return &faces[0] + offsets[vertex]; }
+	unsigned int		GetNumFaces(unsigned int vertex)	const { return offsets[vertex + 1] - offsets[vertex]; }
+
+	//One Vector3 per triangle of working space, kept here so it's only allocated once
+	Vector3*			GetFaceScratch() { return faceScratch.empty() ? NULL : &faceScratch[0]; }
+
+protected:
+	std::vector<unsigned int>	offsets;	//numVertices + 1 entries
+	std::vector<unsigned int>	faces;		//One entry per index
+	std::vector<Vector3>		faceScratch;
+
+	const unsigned int*	builtIndices;
+	unsigned int		builtNumIndices;
+	unsigned int		builtNumVertices;
+};
+
+class MeshProcessing	{
+public:
+	/*
+	Generates smooth (area weighted) normals for an indexed triangle mesh, or
+	flat normals if 'indices' is NULL. The adjacency is (re)built if it wasn't
+	built for these indices. Gives exactly the same results as adding each
+	face's normal onto it's vertices in order.
+	*/
+	static void	GenerateNormals(const Vector3* vertices, unsigned int numVertices,
+		const unsigned int* indices, unsigned int numIndices, MeshAdjacency* adjacency, Vector3* outNormals);
+
+	//As above, but for tangents
+	static void	GenerateTangents(const Vector3* vertices, const Vector2* texCoords, unsigned int numVertices,
+		const unsigned int* indices, unsigned int numIndices, MeshAdjacency* adjacency, Vector3* outTangents);
+
+	//Tangent of a single triangle, pointing along the direction the u texture coordinate increases in
+	static Vector3	FaceTangent(const Vector3 &a, const Vector3 &b, const Vector3 &c, const Vector2 &ta, const Vector2 &tb, const Vector2 &tc);
+
+	/*
+	Finds vertices whose attributes are all the same (to within epsilon, or
+	exactly if it's 0), filling in 'outRemap' with the new index of each vertex,
+	with the duplicates all mapping to the first one. Any of the attribute
+	arrays other than the positions can be NULL. Returns the number of unique
+	vertices.
+	*/
+	static unsigned int	BuildWeldRemap(const Vector3* vertices, const Vector2* texCoords, const Vector3* normals,
+		const Vector3* tangents, const Vector4* colours, unsigned int numVertices, float epsilon, unsigned int* outRemap);
+
+	//Reorders the triangles in the index buffer to reduce the number of post transform vertex cache misses
+	static void	OptimiseVertexCache(unsigned int* indices, unsigned int numIndices, unsigned int numVertices);
+
+	/*
+	Renumbers the vertices in the order they are first used by the index buffer,
+	updating the indices, and filling in 'outRemap' with the new index of each
+	vertex (or MESH_UNUSED_VERTEX). Returns the number of used vertices.
+	*/
+	static unsigned int	OptimiseVertexFetch(unsigned int* indices, unsigned int numIndices, unsigned int numVertices, unsigned int* outRemap);
+
+	//Moves each element of 'in' to 'out[remap[i]]', skipping unused ones. 'out' must not overlap 'in'
+	template <class T>
+	static void	RemapArray(const T* in, const unsigned int* remap, unsigned int count, T* out) {
+		for(unsigned int i = 0; i < count; ++i) {
+			if(remap[i] != MESH_UNUSED_VERTEX) {
+				out[remap[i]] = in[i];
+			}
+		}
+	}
+
+	//Average number of vertex shader invocations per triangle with a FIFO post transform cache of the given size (3.0 is the worst, ~0.5 the best)
+	static float	CalculateACMR(const unsigned int* indices, unsigned int numIndices, unsigned int numVertices, unsigned int cacheSize = MESH_VERTEX_CACHE_SIZE);
+
+	/*
+	Conversions used to pack vertex attributes into smaller types for the
+	graphics card, matching how OpenGL turns them back into floats.
+	*/
+
+	//IEEE half precision float, rounded to the nearest
+	static unsigned short	FloatToHalf(float f);
+	static float			HalfToFloat(unsigned short h);
+
+	//Signed normalised 10:10:10:2 (GL_INT_2_10_10_10_REV), with the 2 bit w component left as 0
+	static unsigned int		PackSnorm1010102(const Vector3 &v);
+
+	//Unsigned normalised integers, clamping to 0-1
+	static unsigned short	PackUnorm16(float f);
+	static unsigned char	PackUnorm8(float f);
+};
@@ -1,5 +1,9 @@
 #include "OBJMesh.h"
 #ifdef WEEK_2_CODE
+#include "GameTimer.h"
+#include "MeshProcessing.h"
+#include <cstring>
+#include <climits>
 /*
 OBJ files look generally something like this:
 
@@ -18,15 +22,437 @@ f vert index / tex index / norm index  vert index / tex index / norm index  vert
 (i.e there's a set of float/float/float for each vertex of a face)
 
 OBJ files can also be split up into a number of submeshes, making loading them
-in even more annoying. 
+in even more annoying.
 */
-bool	OBJMesh::LoadOBJMesh(std::string filename)	{
-	std::ifstream f(filename.c_str(),std::ios::in);
 
-	if(!f) {//Oh dear, it can't find the file :(
+/*
+Layout of the binary cache file: an OBJCacheHeader, followed by 'numSubMeshes'
+OBJCacheSubMesh entries, followed by the data they point to. All offsets are in
+bytes from the start of the file (8 byte aligned), and are 0 if not present.
+*/
+struct OBJCacheHeader {
+	char		magic[4];
+	uint32_t	version;
+	uint64_t	srcSize;		//Size and modification time of the OBJ file the cache was built from
+	uint64_t	srcTimestamp;
+	uint32_t	numSubMeshes;
+	uint32_t	padding;
+};
+
+struct OBJCacheSubMesh {
+	uint32_t	numVertices;
+	uint32_t	numIndices;
+	uint64_t	verticesOffset;
+	uint64_t	texCoordsOffset;
+	uint64_t	normalsOffset;
+	uint64_t	indicesOffset;
+	uint64_t	mtlTypeOffset;
+	uint64_t	mtlSrcOffset;
+	uint32_t	mtlTypeLength;
+	uint32_t	mtlSrcLength;
+};
+
+static const char OBJ_CACHE_MAGIC[4] = { 'N', 'O', 'B', 'J' };
+
+static const uint OBJ_EMPTY_SLOT = 0xFFFFFFFF;
+
+/*
+Unique combination of vertex/texcoord/normal indices making up one vertex of a
+submesh. 'group' stops vertices without normals being shared across faces that
+should be flat shaded (see ParseOBJ).
+*/
+struct OBJVertexKey {
+	int v;
+	int t;
+	int n;
+	int group;
+};
+
+/*
+Open addressing hash table, mapping each OBJVertexKey to the index of the vertex
+it created in the current submesh
+*/
+class OBJVertexCache {
+public:
+	void Reset(size_t expectedVertices) {
+		size_t numSlots = 64;
+		while (numSlots < expectedVertices * 2) {
+			numSlots <<= 1;
+		}
+		slots.assign(numSlots, OBJ_EMPTY_SLOT);
+		keys.clear();
+	}
+
+	//Returns the index of the vertex with the given key, setting 'added' if it has not been seen before
+	uint FindOrAdd(const OBJVertexKey &key, bool &added) {
+		if ((keys.size() + 1) * 2 > slots.size()) {
+			Grow();
+		}
+
+		const size_t mask = slots.size() - 1;
+		for (size_t i = Hash(key) & mask; ; i = (i + 1) & mask) {
+			uint index = slots[i];
+			if (index == OBJ_EMPTY_SLOT) {
+				index = (uint)keys.size();
+				keys.push_back(key);
+				slots[i] = index;
+				added = true;
+				return index;
+			}
+
+			const OBJVertexKey &other = keys[index];
+			if (other.v == key.v && other.t == key.t && other.n == key.n && other.group == key.group) {
+				added = false;
+				return index;
+			}
+		}
+	}
+
+protected:
+	static inline size_t Hash(const OBJVertexKey &key) {
+		uint h = (uint)key.v * 0x9E3779B1u + (uint)key.t * 0x85EBCA77u + (uint)key.n * 0xC2B2AE3Du + (uint)key.group * 0x27D4EB2Fu;
+		h ^= h >> 16;
+		h *= 0x7FEB352Du;
+		h ^= h >> 15;
+		return h;
+	}
+
+	void Grow() {
+		const size_t mask = slots.size() * 2 - 1;
+		slots.assign(slots.size() * 2, OBJ_EMPTY_SLOT);
+
+		for (uint index = 0; index < (uint)keys.size(); ++index) {
+			size_t i = Hash(keys[index]) & mask;
+			while (slots[i] != OBJ_EMPTY_SLOT) {
+				i = (i + 1) & mask;
+			}
+			slots[i] = index;
+		}
+	}
+
+	std::vector<uint>			slots;
+	std::vector<OBJVertexKey>	keys;
+};
+
+/*
+Hand rolled tokenising functions. These all work on the memory mapped file
+directly, and never read past the end of the current line.
+*/
+static inline bool IsLineSpace(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char* SkipLineSpace(const char* p, const char* end) {
+	while (p < end && IsLineSpace(*p)) {
+		++p;
+	}
+	return p;
+}
+
+static inline const char* SkipLine(const char* p, const char* end) {
+	const char* newline = (const char*)memchr(p, '\n', end - p);
+	return newline ? newline + 1 : end;
+}
+
+static inline const char* ParseToken(const char* p, const char* end, string &token) {
+	p = SkipLineSpace(p, end);
+	const char* start = p;
+	while (p < end && *p != '\n' && !IsLineSpace(*p)) {
+		++p;
+	}
+	token.assign(start, p - start);
+	return p;
+}
+
+static inline bool TokenEquals(const char* token, size_t length, const char* str) {
+	return strlen(str) == length && memcmp(token, str, length) == 0;
+}
+
+//Replacement for strtof, parses [+-]digits[.digits][(e|E)[+-]digits]
+static inline const char* ParseFloat(const char* p, const char* end, float &out) {
+	static const double powersOfTen[] = {
+		1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	p = SkipLineSpace(p, end);
+
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = (*p == '-');
+		++p;
+	}
+
+	//Only the first 18 significant digits are kept, which is far more than a float can hold anyway
+	uint64_t mantissa = 0;
+	int exponent = 0;
+	int digits = 0;
+	for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+		if (digits < 18) {
+			mantissa = mantissa * 10 + (*p - '0');
+			digits += (mantissa != 0);
+		}
+		else {
+			exponent++;
+		}
+	}
+
+	if (p < end && *p == '.') {
+		for (++p; p < end && *p >= '0' && *p <= '9'; ++p) {
+			if (digits < 18) {
+				mantissa = mantissa * 10 + (*p - '0');
+				digits += (mantissa != 0);
+				exponent--;
+			}
+		}
+	}
+
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		++p;
+		bool negativeExponent = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negativeExponent = (*p == '-');
+			++p;
+		}
+
+		int value = 0;
+		for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+			if (value < 10000) {
+				value = value * 10 + (*p - '0');
+			}
+		}
+		exponent += negativeExponent ? -value : value;
+	}
+
+	double value = (double)mantissa;
+	if (exponent < 0) {
+		value = (exponent >= -22) ? value / powersOfTen[-exponent] : value * pow(10.0, exponent);
+	}
+	else if (exponent > 0) {
+		value = (exponent <= 22) ? value * powersOfTen[exponent] : value * pow(10.0, exponent);
+	}
+
+	out = (float)(negative ? -value : value);
+	return p;
+}
+
+//Parses a single (1 based, or negative relative) OBJ index, turning it into a 0 based index into an array of 'count' elements
+static inline const char* ParseIndex(const char* p, const char* end, size_t count, int &out, bool &valid) {
+	bool negative = false;
+	if (p < end && *p == '-') {
+		negative = true;
+		++p;
+	}
+
+	const char* start = p;
+	int64_t value = 0;
+	for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+		if (value <= INT_MAX) {
+			value = value * 10 + (*p - '0');
+		}
+	}
+
+	if (p == start || value == 0) {
+		valid = false;
+		return p;
+	}
+
+	value = negative ? (int64_t)count - value : value - 1;
+	if (value < 0 || value >= (int64_t)count) {
+		valid = false;
+	}
+
+	out = (int)value;
+	return p;
+}
+
+//Parses a single face vertex in any of the forms "v", "v/t", "v//n" or "v/t/n"
+static inline const char* ParseFaceVertex(const char* p, const char* end, size_t numVerts, size_t numTexCoords, size_t numNormals, OBJVertexKey &out, bool &valid) {
+	out.t = -1;
+	out.n = -1;
+	out.group = 0;
+
+	p = ParseIndex(p, end, numVerts, out.v, valid);
+	if (p < end && *p == '/') {
+		++p;
+		if (p < end && *p != '/') {
+			p = ParseIndex(p, end, numTexCoords, out.t, valid);
+		}
+
+		if (p < end && *p == '/') {
+			++p;
+			p = ParseIndex(p, end, numNormals, out.n, valid);
+		}
+	}
+	return p;
+}
+
+bool	OBJMesh::LoadOBJMesh(std::string filename, bool useCache)	{
+	loadedFromCache = false;
+
+	OBJDecodedMesh decoded;
+	if (!DecodeOBJMesh(filename, useCache, decoded)) {
+		return false;	//Oh dear, it can't find the file :(
+	}
+
+	CreateFromDecoded(decoded);
+	return true;
+}
+
+void	OBJMesh::CreateFromDecoded(OBJDecodedMesh &decoded)	{
+	GameTimer timer;
+	BuildMeshes(decoded.subMeshes, decoded.textures);
+
+	loadedFromCache = decoded.fromCache;
+	loadTime		= decoded.decodeTime + timer.GetMS();
+}
+
+bool	OBJMesh::DecodeOBJMesh(const std::string &filename, bool useCache, OBJDecodedMesh &out)	{
+	GameTimer timer;
+	out.Clear();
+	out.fromCache = false;
+
+	uint64_t srcSize, srcTimestamp;
+	if (!MappedFile::GetFileInfo(filename, &srcSize, &srcTimestamp)) {
+		return false;
+	}
+
+	const string cacheFilename = filename + OBJ_CACHE_EXTENSION;
+	if (useCache && LoadOBJCache(cacheFilename, srcSize, srcTimestamp, out)) {
+		DecodeMaterialsAndNormals(out);
+
+		out.fromCache	= true;
+		out.decodeTime	= timer.GetMS();
+		return true;
+	}
+	out.Clear();	//Anything left over from an out of date or broken cache
+
+	MappedFile file;
+	if (!file.Open(filename)) {
 		return false;
 	}
 
+	/*
+	SubMeshes temporarily get kept in here
+	*/
+	std::vector<OBJSubMesh*> &inputSubMeshes = out.parsedSubMeshes;
+	ParseOBJ(file.GetData(), file.GetSize(), inputSubMeshes);
+	file.Close();
+
+	for (unsigned int i = 0; i < inputSubMeshes.size(); ) {
+		if (inputSubMeshes[i]->indices.empty()) {
+			delete inputSubMeshes[i];
+			inputSubMeshes.erase(inputSubMeshes.begin() + i);
+		}
+		else {
+			++i;
+		}
+	}
+
+	//Done before caching, so it only has to be done once per OBJ file
+	for (unsigned int i = 0; i < inputSubMeshes.size(); ++i) {
+		OptimiseSubMesh(*inputSubMeshes[i]);
+	}
+
+	if (useCache) {
+		//Not being able to write the cache (e.g. read only data directory) isn't an error, it'll just be slower next time
+		SaveOBJCache(cacheFilename, srcSize, srcTimestamp, inputSubMeshes);
+	}
+
+	out.subMeshes.resize(inputSubMeshes.size());
+	for (unsigned int i = 0; i < inputSubMeshes.size(); ++i) {
+		OBJSubMesh*		sm = inputSubMeshes[i];
+		OBJSubMeshData& smd = out.subMeshes[i];
+
+		smd.numVertices	= (uint)sm->vertices.size();
+		smd.numIndices	= (uint)sm->indices.size();
+		smd.vertices	= &sm->vertices[0];
+		smd.texCoords	= sm->texCoords.empty() ? NULL : &sm->texCoords[0];
+		smd.normals		= sm->normals.empty() ? NULL : &sm->normals[0];
+		smd.indices		= &sm->indices[0];
+		smd.mtlType		= sm->mtlType;
+		smd.mtlSrc		= sm->mtlSrc;
+	}
+
+	DecodeMaterialsAndNormals(out);
+
+	out.decodeTime = timer.GetMS();
+	return true;
+}
+
+void	OBJMesh::DecodeMaterialsAndNormals(OBJDecodedMesh &out)	{
+	const unsigned int textureFlags = SOIL_FLAG_INVERT_Y | SOIL_FLAG_TEXTURE_REPEATS;
+
+	out.generatedNormals.resize(out.subMeshes.size());
+	for (unsigned int i = 0; i < out.subMeshes.size(); ++i) {
+		OBJSubMeshData &sm = out.subMeshes[i];
+
+		if (!sm.mtlType.empty() && !sm.mtlSrc.empty()) {
+			const MaterialLibrary* library = LoadMTL(sm.mtlSrc);
+			if (library) {
+				MaterialLibrary::const_iterator m = library->find(sm.mtlType);
+				if (m != library->end()) {
+					sm.material = m->second;
+				}
+			}
+		}
+
+		//Decoded here so the main thread only has to upload them, see SetTexturesFromMTL
+		if (!sm.material.diffuse.empty()) {
+			out.textures.Decode(TEXTUREDIR + sm.material.diffuse, textureFlags);
+		}
+		const bool hasBump = !sm.material.bump.empty() && out.textures.Decode(TEXTUREDIR + sm.material.bump, textureFlags);
+#ifdef OBJ_FIX_TEXTURES
+		if (!hasBump && !sm.material.diffuse.empty()) {
+			out.textures.Decode(TEXTUREDIR + FixedBumpMap(sm.material.diffuse), textureFlags);
+		}
+#endif
+
+#ifdef OBJ_USE_NORMALS
+		if (!sm.normals) {
+			std::vector<Vector3> &normals = out.generatedNormals[i];
+			normals.resize(sm.numVertices);
+
+			MeshAdjacency adjacency;
+			MeshProcessing::GenerateNormals(sm.vertices, sm.numVertices, sm.indices, sm.numIndices, &adjacency, &normals[0]);
+			sm.normals = &normals[0];
+		}
+#endif
+	}
+}
+
+//Replaces the given attribute with a remapped copy of itself
+template <class T>
+static void RemapOBJAttribute(std::vector<T> &data, const std::vector<uint> &remap, uint numUsed) {
+	if (!data.empty()) {
+		std::vector<T> remapped(numUsed);
+		MeshProcessing::RemapArray(&data[0], &remap[0], (uint)data.size(), &remapped[0]);
+		data.swap(remapped);
+	}
+}
+
+/*
+Reorders the submesh's triangles to make better use of the vertex cache, and
+then its vertices into the order the triangles use them.
+*/
+void	OBJMesh::OptimiseSubMesh(OBJSubMesh &sm)	{
+	const uint numVertices	= (uint)sm.vertices.size();
+	const uint numIndices	= (uint)sm.indices.size();
+
+	MeshProcessing::OptimiseVertexCache(&sm.indices[0], numIndices, numVertices);
+
+	std::vector<uint> remap(numVertices);
+	const uint numUsed = MeshProcessing::OptimiseVertexFetch(&sm.indices[0], numIndices, numVertices, &remap[0]);
+
+	RemapOBJAttribute(sm.vertices,	remap, numUsed);
+	RemapOBJAttribute(sm.texCoords,	remap, numUsed);
+	RemapOBJAttribute(sm.normals,	remap, numUsed);
+}
+
+bool	OBJMesh::ParseOBJ(const char* data, size_t size, std::vector<OBJSubMesh*> &subMeshes)	{
+	const char* p	= data;
+	const char* end	= data + size;
+
 	/*
 	Stores the loaded in vertex attributes
 	*/
@@ -34,217 +460,309 @@ bool	OBJMesh::LoadOBJMesh(std::string filename)	{
 	std::vector<Vector3>inputVertices;
 	std::vector<Vector3>inputNormals;
 
-	/*
-	SubMeshes temporarily get kept in here
-	*/
-	std::vector<OBJSubMesh*> inputSubMeshes;
-
 	OBJSubMesh* currentMesh = new OBJSubMesh();
-	inputSubMeshes.push_back(currentMesh);	//It's safe to assume our OBJ will have a mesh in it ;)
+	subMeshes.push_back(currentMesh);	//It's safe to assume our OBJ will have a mesh in it ;)
 
 	string currentMtlLib;
 	string currentMtlType;
 
-	while(!f.eof()) {
-		std::string currentLine;
-		f >> currentLine;
+	OBJVertexCache vertexCache;
+	vertexCache.Reset(0);
+
+	bool currentHasTexCoords	= false;
+	bool currentHasNormals		= false;
+
+	//Drops any attributes none of the current submesh's faces used, and starts a new submesh
+	auto StartSubMesh = [&]() {
+		if (!currentMesh->indices.empty()) {
+			if (!currentHasTexCoords)	currentMesh->texCoords.clear();
+			if (!currentHasNormals)		currentMesh->normals.clear();
 
-		if(currentLine == OBJCOMMENT) {		//This line is a comment, ignore it
-			continue;
-		}
-		else if (currentLine == "0") {
-			continue;
-		}
-		else if(currentLine == OBJMTLLIB) {
-			f >> currentMtlLib;
-		}
-		else if(currentLine == OBJUSEMTL) {
 			currentMesh = new OBJSubMesh();
-			inputSubMeshes.push_back(currentMesh);
+			subMeshes.push_back(currentMesh);
+			vertexCache.Reset(0);
+			currentHasTexCoords	= false;
+			currentHasNormals	= false;
+		}
+		//Otherwise the current submesh has no faces yet, so just reuse it
+	};
+
+	/*
+	Faces without normals will have them generated later on. In OBJ files these
+	should only be smoothed if they are part of a smoothing group, otherwise each
+	face is given a unique group so none of it's vertices can be shared.
+	*/
+	int smoothingGroup	= 0;
+	int faceCount		= 0;
 
-			currentMesh->mtlSrc = currentMtlLib;
+	std::vector<OBJVertexKey>	faceVertices;
+	string						token;
 
-			f >> currentMtlType;
+	while (p < end) {
+		p = SkipLineSpace(p, end);
 
-			currentMesh->mtlType = currentMtlType;
+		const char* keyword = p;
+		while (p < end && *p != '\n' && !IsLineSpace(*p)) {
+			++p;
 		}
-		else if(currentLine == OBJMESH || currentLine == OBJOBJECT) {	//This line is a submesh!
-			currentMesh = new OBJSubMesh();
-			inputSubMeshes.push_back(currentMesh);
+		const size_t keywordLength = p - keyword;
 
-			currentMesh->mtlSrc = currentMtlLib;
-			currentMesh->mtlType = currentMtlType;
+		if (keywordLength == 0 || keyword[0] == OBJCOMMENT[0]) {	//This line is empty or a comment, ignore it
 		}
-		else if(currentLine == OBJVERT) {	//This line is a vertex
+		else if (TokenEquals(keyword, keywordLength, OBJVERT)) {	//This line is a vertex
 			Vector3 vertex;
-			f >> vertex.x; f >> vertex.y; f >> vertex.z;
+			p = ParseFloat(p, end, vertex.x);
+			p = ParseFloat(p, end, vertex.y);
+			p = ParseFloat(p, end, vertex.z);
 			inputVertices.push_back(vertex);
 		}
-		else if(currentLine == OBJNORM) {	//This line is a Normal!
+		else if (TokenEquals(keyword, keywordLength, OBJNORM)) {	//This line is a Normal!
 			Vector3 normal;
-			f >> normal.x; f >> normal.y; f >> normal.z;
+			p = ParseFloat(p, end, normal.x);
+			p = ParseFloat(p, end, normal.y);
+			p = ParseFloat(p, end, normal.z);
 			inputNormals.push_back(normal);
 		}
-		else if(currentLine == OBJTEX) {	//This line is a texture coordinate!
+		else if (TokenEquals(keyword, keywordLength, OBJTEX)) {	//This line is a texture coordinate!
 			Vector2 texCoord;
-			f >> texCoord.x; f >> texCoord.y;
+			p = ParseFloat(p, end, texCoord.x);
+			p = ParseFloat(p, end, texCoord.y);
 			/*
 			TODO! Some OBJ files might have 3D tex coords...
 			*/
 			inputTexCoords.push_back(texCoord);
 		}
-		else if(currentLine == OBJFACE) {	//This is an object face!
-			if(!currentMesh) {
-				inputSubMeshes.push_back(new OBJSubMesh());
-				currentMesh = inputSubMeshes[inputSubMeshes.size()-1];
+		else if (TokenEquals(keyword, keywordLength, OBJFACE)) {	//This is an object face!
+			faceVertices.clear();
+
+			bool valid = true;
+			p = SkipLineSpace(p, end);
+			while (valid && p < end && *p != '\n') {
+				OBJVertexKey key;
+				p = ParseFaceVertex(p, end, inputVertices.size(), inputTexCoords.size(), inputNormals.size(), key, valid);
+				faceVertices.push_back(key);
+				p = SkipLineSpace(p, end);
 			}
 
-			std::string			faceData;		//Keep the entire line in this!
-			std::vector<int>	faceIndices;	//Keep the extracted indices in here!
-		
-			getline(f,faceData);		//Use a string helper function to read in the entire face line
+			//Faces with bad indices are skipped, and anything bigger than a triangle is turned into a triangle fan
+			if (valid && faceVertices.size() >= 3) {
+				const int faceGroup = (smoothingGroup != 0) ? smoothingGroup : -1 - faceCount;
+				faceCount++;
 
-			/*
-			It's possible an OBJ might have normals defined, but not tex coords!
-			Such files should then have a face which looks like this:
+				for (size_t i = 2; i < faceVertices.size(); ++i) {
+					const OBJVertexKey* triangle[3] = { &faceVertices[0], &faceVertices[i - 1], &faceVertices[i] };
 
-				f <vertex index>//<normal index>
-				instead of <vertex index>/<tex coord>/<normal index>
-
-				you can be some OBJ files will have "/ /" instead of "//" though... :(
-			*/
-			bool	skipTex = false;
-			if(faceData.find("//") != std::string::npos) {	
-				skipTex = true;
-			}
-
-			/*
-			Count the number of slashes, but also convert the slashes to spaces
-			so that string streaming of ints doesn't fail on the slash
-
-				"f  0/0/0" becomes "f 0 0 0" etc
-			*/
-			for(size_t i = 0; i < faceData.length(); ++i) {
-				if(faceData[i] == '/') {
-					faceData[i] = ' ';
-				}
-			}
+					for (int j = 0; j < 3; ++j) {
+						OBJVertexKey key = *triangle[j];
+						if (key.n < 0) {
+							key.group = faceGroup;
+						}
 
-			/*
-			Now string stream the indices from the string into a temporary
-			vector.
-			*/
-			int tempIndex;
-			std::stringstream	ss(faceData);
-			while(ss >> tempIndex) {
-				faceIndices.push_back(tempIndex);
-			}
+						bool added;
+						uint index = vertexCache.FindOrAdd(key, added);
+						if (added) {
+							currentMesh->vertices.push_back(inputVertices[key.v]);
+							currentMesh->texCoords.push_back(key.t >= 0 ? inputTexCoords[key.t] : Vector2(0.0f, 0.0f));
+							currentMesh->normals.push_back(key.n >= 0 ? inputNormals[key.n] : Vector3(0.0f, 0.0f, 0.0f));
 
-			//If the face indices vector is a multiple of 3, we're looking at triangles
-			//with some combination of vertices, normals, texCoords
-			if(faceIndices.size()%3 == 0) {		//This face is a triangle (probably)!
-				if(faceIndices.size() == 3) {	//This face has only vertex information;
-					currentMesh->vertIndices.push_back(faceIndices.at(0));
-					currentMesh->vertIndices.push_back(faceIndices.at(1));
-					currentMesh->vertIndices.push_back(faceIndices.at(2));
-				}
-				else if(faceIndices.size() == 9) {	//This face has vertex, normal and tex information!
-					for(int i = 0; i < 9; i += 3) {
-						currentMesh->vertIndices.push_back(faceIndices.at(i));
-						currentMesh->texIndices.push_back(faceIndices.at(i+1));
-						currentMesh->normIndices.push_back(faceIndices.at(i+2));
-					}
-				}
-				else if(faceIndices.size() == 6) {	//This face has vertex, and one other index...
-					for(int i = 0; i < 6; i += 2) {
-						currentMesh->vertIndices.push_back(faceIndices.at(i));
-						if(!skipTex) {		// a double slash means it's skipping tex info...
-							currentMesh->texIndices.push_back(faceIndices.at(i+1));
-						}
-						else{
-							currentMesh->normIndices.push_back(faceIndices.at(i+1));
+							currentHasTexCoords	|= (key.t >= 0);
+							currentHasNormals	|= (key.n >= 0);
 						}
+						currentMesh->indices.push_back(index);
 					}
 				}
 			}
-			else{	
-				//Uh oh! Face isn't a triangle. Have fun adding stuff to this ;)
-				bool a = true;
-			}
 		}
-		else{
+		else if (TokenEquals(keyword, keywordLength, OBJSMOOTH)) {
+			p = ParseToken(p, end, token);
+			smoothingGroup = (token == "off") ? 0 : atoi(token.c_str());
+		}
+		else if (TokenEquals(keyword, keywordLength, OBJMTLLIB)) {
+			p = ParseToken(p, end, currentMtlLib);
+		}
+		else if (TokenEquals(keyword, keywordLength, OBJUSEMTL)) {
+			StartSubMesh();
+			p = ParseToken(p, end, currentMtlType);
+
+			currentMesh->mtlSrc		= currentMtlLib;
+			currentMesh->mtlType	= currentMtlType;
+		}
+		else if (TokenEquals(keyword, keywordLength, OBJMESH) || TokenEquals(keyword, keywordLength, OBJOBJECT)) {	//This line is a submesh!
+			StartSubMesh();
+
+			currentMesh->mtlSrc		= currentMtlLib;
+			currentMesh->mtlType	= currentMtlType;
+		}
+		else {
 			//No comments!
-			//std::cout << "OBJMesh::LoadOBJMesh Unknown file data:" << currentLine << std::endl;
 		}
+
+		p = SkipLine(p, end);
 	}
 
-	f.close();
+	if (!currentHasTexCoords)	currentMesh->texCoords.clear();
+	if (!currentHasNormals)		currentMesh->normals.clear();
 
-	//We now have all our mesh data loaded in...Now to convert it into OpenGL vertex buffers!
-	for(unsigned int i = 0; i < inputSubMeshes.size(); ) {
-		OBJSubMesh*sm = inputSubMeshes[i];
+	return true;
+}
 
-		/*
-		We're going to be lazy and turn the indices into an absolute list
-		of vertex attributes (it makes handling the submesh list easier)
-		*/
-		if(sm->vertIndices.empty()) {
-			delete sm;
-			inputSubMeshes.erase(inputSubMeshes.begin() + i);
-			continue;
+/*
+The indices are handed straight to OpenGL (and used to index the vertex arrays
+when generating tangents), so a cache with a bad index in it would read past
+the end of them. Every index is checked here, and if any are wrong the OBJ
+file is parsed again instead.
+*/
+static bool ValidCacheIndices(const uint* indices, uint numIndices, uint numVertices)	{
+	for (uint i = 0; i < numIndices; ++i) {
+		if (indices[i] >= numVertices) {
+			return false;
 		}
-		else	{
-			OBJMesh*m;
-			
-			if(i == 0) {
-				m = this;
-			}
-			else{
-				m = new OBJMesh();
-			}
+	}
+	return true;
+}
 
-			m->SetTexturesFromMTL(sm->mtlSrc, sm->mtlType);
+bool	OBJMesh::LoadOBJCache(const std::string &filename, uint64_t srcSize, uint64_t srcTimestamp, OBJDecodedMesh &out)	{
+	//The submeshes point straight into the mapped file, so it's kept open until they've been used
+	MappedFile &file = out.cacheFile;
+	if (!file.Open(filename) || file.GetSize() < sizeof(OBJCacheHeader)) {
+		return false;
+	}
 
-			m->numVertices	= sm->vertIndices.size();
+	const char*	base = file.GetData();
+	const size_t size = file.GetSize();
 
-			m->vertices		= new Vector3[m->numVertices];
-			for(unsigned int j = 0; j < sm->vertIndices.size(); ++j) {
-				m->vertices[j] = inputVertices[sm->vertIndices[j]-1];
-			}
+	//Only use the cache if it was built by this version of the loader, from the OBJ file as it is now
+	const OBJCacheHeader* header = (const OBJCacheHeader*)base;
+	if (memcmp(header->magic, OBJ_CACHE_MAGIC, sizeof(OBJ_CACHE_MAGIC)) != 0
+		|| header->version != OBJ_CACHE_VERSION
+		|| header->srcSize != srcSize
+		|| header->srcTimestamp != srcTimestamp) {
+		return false;
+	}
 
-			if(!sm->texIndices.empty())	{
-				m->textureCoords	= new Vector2[m->numVertices];
-				for(unsigned int j = 0; j < sm->texIndices.size(); ++j) {
-					m->textureCoords[j] = inputTexCoords[sm->texIndices[j]-1];
-				}
-			}
+	if (header->numSubMeshes > (size - sizeof(OBJCacheHeader)) / sizeof(OBJCacheSubMesh)) {
+		return false;
+	}
 
-#ifdef OBJ_USE_NORMALS
-			if(sm->normIndices.empty()) {
-				m->GenerateNormals();
-			}
-			else{
-				m->normals		= new Vector3[m->numVertices];
+	const OBJCacheSubMesh* entries = (const OBJCacheSubMesh*)(base + sizeof(OBJCacheHeader));
+	std::vector<OBJSubMeshData> &subMeshes = out.subMeshes;
+	subMeshes.resize(header->numSubMeshes);
+	for (uint i = 0; i < header->numSubMeshes; ++i) {
+		const OBJCacheSubMesh&	entry	= entries[i];
+		OBJSubMeshData&			sm		= subMeshes[i];
+
+		const uint64_t vec3Size = (uint64_t)entry.numVertices * sizeof(Vector3);
+		const uint64_t vec2Size = (uint64_t)entry.numVertices * sizeof(Vector2);
+		const uint64_t indexSize = (uint64_t)entry.numIndices * sizeof(uint);
+
+		if (entry.numVertices == 0 || entry.numIndices == 0 || entry.verticesOffset == 0 || entry.indicesOffset == 0
+			|| !file.Contains(entry.verticesOffset, vec3Size)
+			|| !file.Contains(entry.texCoordsOffset, vec2Size)
+			|| !file.Contains(entry.normalsOffset, vec3Size)
+			|| !file.Contains(entry.indicesOffset, indexSize)
+			|| !file.Contains(entry.mtlTypeOffset, entry.mtlTypeLength)
+			|| !file.Contains(entry.mtlSrcOffset, entry.mtlSrcLength)
+			|| !ValidCacheIndices((const uint*)(base + entry.indicesOffset), entry.numIndices, entry.numVertices)) {
+			return false;
+		}
 
-				for(unsigned int j = 0; j < sm->normIndices.size(); ++j) {
-					m->normals[j] = inputNormals[sm->normIndices[j]-1];
-				}
-			}
+		//Fix up the offsets into pointers straight into the mapped file
+		sm.numVertices	= entry.numVertices;
+		sm.numIndices	= entry.numIndices;
+		sm.vertices		= (const Vector3*)(base + entry.verticesOffset);
+		sm.texCoords	= entry.texCoordsOffset ? (const Vector2*)(base + entry.texCoordsOffset) : NULL;
+		sm.normals		= entry.normalsOffset ? (const Vector3*)(base + entry.normalsOffset) : NULL;
+		sm.indices		= (const uint*)(base + entry.indicesOffset);
+		sm.mtlType.assign(base + entry.mtlTypeOffset, entry.mtlTypeLength);
+		sm.mtlSrc.assign(base + entry.mtlSrcOffset, entry.mtlSrcLength);
+	}
+	return true;
+}
+
+void	OBJMesh::SaveOBJCache(const std::string &filename, uint64_t srcSize, uint64_t srcTimestamp, const std::vector<OBJSubMesh*> &subMeshes)	{
+	BinaryFileBuilder builder(sizeof(OBJCacheHeader) + subMeshes.size() * sizeof(OBJCacheSubMesh));
+
+	for (size_t i = 0; i < subMeshes.size(); ++i) {
+		const OBJSubMesh* sm = subMeshes[i];
+
+		OBJCacheSubMesh entry;
+		memset(&entry, 0, sizeof(entry));
+		entry.numVertices		= (uint32_t)sm->vertices.size();
+		entry.numIndices		= (uint32_t)sm->indices.size();
+		entry.verticesOffset	= builder.Append(sm->vertices.data(), sm->vertices.size() * sizeof(Vector3));
+		entry.texCoordsOffset	= builder.Append(sm->texCoords.data(), sm->texCoords.size() * sizeof(Vector2));
+		entry.normalsOffset		= builder.Append(sm->normals.data(), sm->normals.size() * sizeof(Vector3));
+		entry.indicesOffset		= builder.Append(sm->indices.data(), sm->indices.size() * sizeof(uint));
+		entry.mtlTypeOffset		= builder.Append(sm->mtlType.data(), sm->mtlType.size());
+		entry.mtlTypeLength		= (uint32_t)sm->mtlType.size();
+		entry.mtlSrcOffset		= builder.Append(sm->mtlSrc.data(), sm->mtlSrc.size());
+		entry.mtlSrcLength		= (uint32_t)sm->mtlSrc.size();
+
+		builder.Write(sizeof(OBJCacheHeader) + i * sizeof(OBJCacheSubMesh), &entry, sizeof(entry));
+	}
+
+	OBJCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, OBJ_CACHE_MAGIC, sizeof(OBJ_CACHE_MAGIC));
+	header.version		= OBJ_CACHE_VERSION;
+	header.srcSize		= srcSize;
+	header.srcTimestamp	= srcTimestamp;
+	header.numSubMeshes	= (uint32_t)subMeshes.size();
+	builder.Write(0, &header, sizeof(header));
+
+	builder.SaveToFile(filename);
+}
+
+void	OBJMesh::BuildMeshes(std::vector<OBJSubMeshData> &subMeshes, DecodedTextures &textures)	{
+	for (unsigned int i = 0; i < subMeshes.size(); ++i) {
+		OBJSubMeshData &sm = subMeshes[i];
+
+		OBJMesh*m;
+		if(i == 0) {
+			m = this;
+		}
+		else{
+			m = new OBJMesh();
+		}
+
+		m->SetTexturesFromMTL(sm.material, textures);
+
+		m->numVertices	= sm.numVertices;
+		m->vertices		= new Vector3[m->numVertices];
+		memcpy(m->vertices, sm.vertices, m->numVertices * sizeof(Vector3));
+
+		if (sm.texCoords) {
+			m->textureCoords = new Vector2[m->numVertices];
+			memcpy(m->textureCoords, sm.texCoords, m->numVertices * sizeof(Vector2));
+		}
+
+		m->numIndices	= sm.numIndices;
+		m->indices		= new unsigned int[m->numIndices];
+		memcpy(m->indices, sm.indices, m->numIndices * sizeof(unsigned int));
+
+#ifdef OBJ_USE_NORMALS
+		//Missing normals were generated by DecodeOBJMesh
+		m->normals = new Vector3[m->numVertices];
+		memcpy(m->normals, sm.normals, m->numVertices * sizeof(Vector3));
 #endif
 #ifdef OBJ_USE_TANGENTS_BUMPMAPS
-			m->GenerateTangents();
+		m->GenerateTangents();
+#endif
+
+#ifdef OBJ_USE_PACKED_VERTICES
+		m->SetVertexFormat(MESH_VERTEX_PACKED);
+#endif
+#ifdef OBJ_RELEASE_CPU_DATA
+		m->SetKeepCPUData(false);
 #endif
 
-			m->BufferData();
+		//Identical submeshes (or the same OBJ loaded again) share their VAO and VBOs
+		m->ShareBufferData();
 
-			if(i != 0) {
-				AddChild(m);
-			}	
+		if(i != 0) {
+			AddChild(m);
 		}
-		delete inputSubMeshes[i];
-		++i;
 	}
-	return true;
 }
 
 /*
@@ -262,33 +780,39 @@ void OBJMesh::Draw() {
 	}
 };
 
-void	OBJMesh::SetTexturesFromMTL(string &mtlFile, string &mtlType) {
-	if(mtlType.empty() || mtlFile.empty()) {
-		return;
-	}
+void	OBJMesh::SetTexturesFromMTL(const MaterialInfo &material, DecodedTextures &textures) {
+	const unsigned int textureFlags = SOIL_FLAG_INVERT_Y | SOIL_FLAG_TEXTURE_REPEATS;
 
-	map <string, MTLInfo>::iterator i = materials.find(mtlType);
+	if(!material.diffuse.empty())	{
+		texture = textures.Acquire(string(TEXTUREDIR + material.diffuse), textureFlags);
+	}
 
-	if(i != materials.end()) {
-		if(!i->second.diffuse.empty())	{
-			texture = i->second.diffuseNum;
-		}
+	if(!material.bump.empty())	{
+		bumpTexture = textures.Acquire(string(TEXTUREDIR + material.bump), textureFlags);
+	}
 
-		if(!i->second.bump.empty())	{
-			bumpTexture = i->second.bumpNum;
-		}
+#ifdef OBJ_FIX_TEXTURES
+	if(!bumpTexture && !material.diffuse.empty()) {
+		bumpTexture = textures.Acquire(string(TEXTUREDIR + FixedBumpMap(material.diffuse)), textureFlags);
+	}
+#endif
+}
 
-		return;
+const MaterialLibrary*	OBJMesh::LoadMTL(const string &mtlFile) {
+	const MaterialLibrary* found = ResourceRegistry::FindMaterialLibrary(mtlFile);
+	if(found) {
+		return found;
 	}
 
 	std::ifstream f(string(MESHDIR + mtlFile).c_str(),std::ios::in);
 
 	if(!f) {//Oh dear, it can't find the file :(
-		return;
+		return NULL;
 	}
 
-	MTLInfo currentMTL;
-	string  currentMTLName;
+	MaterialLibrary	library;
+	MaterialInfo	currentMTL;
+	string			currentMTLName;
 	
 	int mtlCount = 0;
 
@@ -298,12 +822,7 @@ void	OBJMesh::SetTexturesFromMTL(string &mtlFile, string &mtlType) {
 		
 		if(currentLine == MTLNEW) {
 			if(mtlCount > 0) {
-
-#ifdef OBJ_FIX_TEXTURES
-				FixTextures(currentMTL);
-#endif
-
-				materials.insert(std::make_pair(currentMTLName,currentMTL));
+				library.insert(std::make_pair(currentMTLName,currentMTL));
 			}
 			currentMTL.diffuse = "";
 			currentMTL.bump = "";
@@ -323,10 +842,6 @@ void	OBJMesh::SetTexturesFromMTL(string &mtlFile, string &mtlType) {
 				int at = currentMTL.diffuse.find_last_of('\\');
 				currentMTL.diffuse = currentMTL.diffuse.substr(at+1);
 			}
-
-			if(!currentMTL.diffuse.empty()) {
-				currentMTL.diffuseNum = SOIL_load_OGL_texture(string(TEXTUREDIR + currentMTL.diffuse).c_str(), SOIL_LOAD_AUTO, SOIL_CREATE_NEW_ID, SOIL_FLAG_INVERT_Y | SOIL_FLAG_TEXTURE_REPEATS);
-			}
 		}
 		else if(currentLine == MTLBUMPMAP || currentLine == MTLBUMPMAPALT) {
 			f >> currentMTL.bump;
@@ -339,41 +854,26 @@ void	OBJMesh::SetTexturesFromMTL(string &mtlFile, string &mtlType) {
 				int at = currentMTL.bump.find_last_of('\\');
 				currentMTL.bump = currentMTL.bump.substr(at+1);
 			}
-
-			if(!currentMTL.bump.empty()) {
-				currentMTL.bumpNum = SOIL_load_OGL_texture(string(TEXTUREDIR + currentMTL.bump).c_str(), SOIL_LOAD_AUTO, SOIL_CREATE_NEW_ID, SOIL_FLAG_INVERT_Y | SOIL_FLAG_TEXTURE_REPEATS);
-			}
 		}
 	}
 
-#ifdef OBJ_FIX_TEXTURES
-	FixTextures(currentMTL);
-#endif
-
-	materials.insert(std::make_pair(currentMTLName,currentMTL));
+	library.insert(std::make_pair(currentMTLName,currentMTL));
 
-	
-	SetTexturesFromMTL(mtlFile,mtlType);
+	return ResourceRegistry::AddMaterialLibrary(mtlFile, library);
 }
 
 /*
 The mtl files in that big pack of city buildings haven't been exported correctly...
 */
-void	OBJMesh::FixTextures(MTLInfo &info) {
-	if(!info.bumpNum) {
-
-		string temp = info.diffuse;
-
-		if(temp[temp.size() - 5] == 'd') {
-			temp[temp.size() - 5] = 'n';
-		}
-		else {
-			temp.insert(temp.size() - 4, "_n");
-		}
+string	OBJMesh::FixedBumpMap(const string &diffuse) {
+	string temp = diffuse;
 
-		info.bump = temp;
-
-		info.bumpNum = SOIL_load_OGL_texture(string(TEXTUREDIR + info.bump).c_str(), SOIL_LOAD_AUTO, SOIL_CREATE_NEW_ID, SOIL_FLAG_INVERT_Y |  SOIL_FLAG_TEXTURE_REPEATS);
+	if(temp.size() >= 5 && temp[temp.size() - 5] == 'd') {
+		temp[temp.size() - 5] = 'n';
+	}
+	else {
+		temp.insert(temp.size() < 4 ? temp.size() : temp.size() - 4, "_n");
 	}
+	return temp;
 }
 #endif
\ No newline at end of file
@@ -10,21 +10,23 @@ framework, instead.
 
 You'll very quickly find OBJ meshes that can't be loaded by this loader.
 
-First up - any mesh with anything other than triangles in it won't work. Quads
-should be trivial to add in, n-sided polygons should be OK if they are convex
-(add a point in the middle and create triangles out of pairs of points).
+Faces with more than 3 vertices are split into a triangle fan, which is fine
+for quads and other convex polygons, but concave polygons will come out wrong.
+Negative (relative) indices are supported.
 
-Some OBJ meshes use negative indices, which won't work.
+If it still won't load, loading the OBJ into Blender or maybe Milkshape, and
+exporting them out as OBJs again might create a file more likely to load. 
 
-In both cases, loading the OBJ into Blender or maybe Milkshape, and exporting
-them out as OBJs again might create a file more likely to load. 
+The file is memory mapped and parsed by hand rather than through iostreams, and
+each unique vertex/texcoord/normal combination is only stored once, with the
+faces drawn using an index buffer. Faces without normals that are not part of a
+smoothing group ('s off') never share vertices, so they keep their flat shading
+once normals are generated.
 
-OBJ files are ok for simple geometry (the tutorial series uses them for 2
-slightly different cubes, and an icosphere), but generally don't work very
-well for 'big' geometry. 
-
-The simple loader doesn't do anything fancy with indices - have fun trying
-to get that working!
+As parsing large OBJ files is still slow, the final vertex data is also written
+out to a binary cache file alongside the OBJ (OBJ_CACHE_EXTENSION). Subsequent
+loads just map the cache file and copy the arrays straight out of it, as long
+as the OBJ hasn't been modified since and the cache version matches.
 
 The 'Stanford Bunny' OBJ does load up with this though, if you really want
 to see a rabbit.
@@ -73,6 +75,12 @@ time lighting tutorial, uncomment both OBJ_USE_NORMALS and OBJ_USE_TANGENTS_BUMP
 
 #define OBJ_FIX_TEXTURES
 
+//Uploads the vertex data in Mesh's compact interleaved layout (see Mesh::SetVertexFormat)
+#define OBJ_USE_PACKED_VERTICES
+//Deletes the CPU copies of the vertex data once they're uploaded. Nothing reads them afterwards - normals (and
+//tangents) are generated before the upload, and doing so afterwards wouldn't change what's on the graphics card anyway
+#define OBJ_RELEASE_CPU_DATA
+
 
 #pragma once
 
@@ -80,10 +88,13 @@ time lighting tutorial, uncomment both OBJ_USE_NORMALS and OBJ_USE_TANGENTS_BUMP
 #include <string>
 #include <sstream>
 #include <map>
+#include <cstdint>
 
 #include "Vector3.h"
 #include "Vector2.h"
 #include "Mesh.h"
+#include "MappedFile.h"
+#include "ResourceRegistry.h"
 #include "ChildMeshInterface.h"
 
 #define OBJOBJECT		"object"	//the current line of the obj file defines the start of a new material
@@ -96,6 +107,11 @@ time lighting tutorial, uncomment both OBJ_USE_NORMALS and OBJ_USE_TANGENTS_BUMP
 #define OBJNORM			"vn"		//the current line of the obj file defines a normal
 #define OBJFACE			"f"			//the current line of the obj file defines a face
 
+#define OBJSMOOTH		"s"			//the current line of the obj file sets the smoothing group ('off' or 0 to disable)
+
+#define OBJ_CACHE_EXTENSION	".nclobj"	//Binary cache file written alongside each OBJ file
+#define OBJ_CACHE_VERSION	2			//Increment whenever the layout (or content) of the cache file changes
+
 #define MTLNEW			"newmtl"
 #define MTLDIFFUSE		"Kd"
 #define MTLSPEC			"Ks"
@@ -112,47 +128,119 @@ time lighting tutorial, uncomment both OBJ_USE_NORMALS and OBJ_USE_TANGENTS_BUMP
 /*
 OBJSubMesh structs are used to temporarily keep the data loaded 
 in from the OBJ files, before being parsed into a series of
-Meshes
+Meshes. Vertex attributes have already been de-duplicated, so each
+entry in the vertex arrays is unique and referenced by the indices.
 */
 struct OBJSubMesh {
-	std::vector<int> texIndices;
-	std::vector<int> vertIndices;
-	std::vector<int> normIndices;
+	std::vector<Vector3>	vertices;
+	std::vector<Vector2>	texCoords;	//Empty if no face had texture coordinates
+	std::vector<Vector3>	normals;	//Empty if no face had normals
+	std::vector<uint>		indices;
 
-	int indexOffset;
 	string mtlType;
 	string mtlSrc;
 };
 
-struct MTLInfo {
-	string bump;
-	string diffuse;
+/*
+Final vertex data of a single submesh, pointing either into an OBJSubMesh or
+straight into a memory mapped cache file
+*/
+struct OBJSubMeshData {
+	uint			numVertices;
+	uint			numIndices;
+	const Vector3*	vertices;
+	const Vector2*	texCoords;	//NULL if not present
+	const Vector3*	normals;	//NULL if not present
+	const uint*		indices;
+
+	string mtlType;
+	string mtlSrc;
 
-	GLuint bumpNum;
-	GLuint diffuseNum;
+	MaterialInfo	material;	//Textures of mtlType in mtlSrc, filled in by DecodeOBJMesh
+};
 
-	MTLInfo() {
-		bumpNum		= 0;
-		diffuseNum	= 0;
+/*
+Everything loaded in from an OBJ file (or its cache) before any of it is sent
+to OpenGL, including the .mtl files, any normals that had to be generated, and
+the decoded textures. Decoding doesn't touch OpenGL at all, so can be done on
+any thread (see AssetManager), leaving only the OpenGL buffers and textures to
+be created from it on the main thread.
+*/
+class OBJDecodedMesh {
+public:
+	OBJDecodedMesh() : fromCache(false), decodeTime(0.0f) {}
+	~OBJDecodedMesh() { Clear(); }
+
+	void Clear() {
+		for (unsigned int i = 0; i < parsedSubMeshes.size(); ++i) {
+			delete parsedSubMeshes[i];
+		}
+		parsedSubMeshes.clear();
+		subMeshes.clear();
+		generatedNormals.clear();
+		textures.Clear();
+		cacheFile.Close();
 	}
-	//this is all we care about...
+
+	std::vector<OBJSubMeshData>	subMeshes;			//Point into either the cache file, or the parsed submeshes
+	MappedFile					cacheFile;
+	std::vector<OBJSubMesh*>	parsedSubMeshes;
+	std::vector< std::vector<Vector3> >	generatedNormals;	//For submeshes without any normals, by submesh
+	DecodedTextures				textures;
+
+	bool						fromCache;
+	float						decodeTime;			//In milliseconds
+
+private:
+	OBJDecodedMesh(const OBJDecodedMesh&);
+	OBJDecodedMesh& operator=(const OBJDecodedMesh&);
 };
 
 class OBJMesh : public Mesh, public ChildMeshInterface	{
 public:
-	OBJMesh(void){};
-	OBJMesh(std::string filename){LoadOBJMesh(filename);};
+	OBJMesh(void) : loadTime(0.0f), loadedFromCache(false) {};
+	OBJMesh(std::string filename, bool useCache = true) : loadTime(0.0f), loadedFromCache(false) {LoadOBJMesh(filename, useCache);};
 	~OBJMesh(void){};
-	bool	LoadOBJMesh(std::string filename);
+
+	//Loads the given OBJ file, reading from (and writing out) the binary cache file if 'useCache' is set
+	bool	LoadOBJMesh(std::string filename, bool useCache = true);
+
+	//The two halves of LoadOBJMesh. Decoding doesn't use OpenGL so can be run on any thread, but creating
+	//the meshes from the decoded data must be done on the thread with the OpenGL context
+	static bool	DecodeOBJMesh(const std::string &filename, bool useCache, OBJDecodedMesh &out);
+	void		CreateFromDecoded(OBJDecodedMesh &decoded);
+
+	//How long the last call to LoadOBJMesh took in milliseconds (including uploading to the GPU), and if it was read from the cache
+	float	GetLoadTime()			{ return loadTime; }
+	bool	WasLoadedFromCache()	{ return loadedFromCache; }
 
 	virtual void Draw();
 
 protected:
-	void	SetTexturesFromMTL(string &mtlFile, string &mtlType);
+	static bool	ParseOBJ(const char* data, size_t size, std::vector<OBJSubMesh*> &subMeshes);
+	//Reorders the submesh's triangles and vertices to be quicker to render
+	static void	OptimiseSubMesh(OBJSubMesh &sm);
+
+	static bool	LoadOBJCache(const std::string &filename, uint64_t srcSize, uint64_t srcTimestamp, OBJDecodedMesh &out);
+	static void	SaveOBJCache(const std::string &filename, uint64_t srcSize, uint64_t srcTimestamp, const std::vector<OBJSubMesh*> &subMeshes);
+
+	//Looks up each submesh's material and decodes it's textures, and generates any missing normals
+	static void	DecodeMaterialsAndNormals(OBJDecodedMesh &out);
+
+	//Turns each submesh into an OpenGL mesh, the first being 'this' and the rest added as children
+	void	BuildMeshes(std::vector<OBJSubMeshData> &subMeshes, DecodedTextures &textures);
+
+	//Sets the textures of the given material, sharing them through the ResourceRegistry
+	void	SetTexturesFromMTL(const MaterialInfo &material, DecodedTextures &textures);
+
+	//Returns the materials in the given .mtl file, only reading it the first time it's used (on any thread)
+	static const MaterialLibrary*	LoadMTL(const string &mtlFile);
 
-	void	FixTextures(MTLInfo &info);
+	//Bump map guessed from the diffuse map's filename, for materials that don't have one, see OBJ_FIX_TEXTURES
+	static string	FixedBumpMap(const string &diffuse);
 
-	map <string, MTLInfo> materials;
+	float	loadTime;
+	bool	loadedFromCache;
 };
 
 #endif
\ No newline at end of file
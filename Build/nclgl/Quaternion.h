@@ -64,7 +64,7 @@ public:
 		return Quaternion(x + a.x, y + a.y, z + a.z, w + a.w);
 	}
 
-	Quaternion Interpolate(const Quaternion& pStart, const Quaternion& pEnd, float pFactor);
+	static Quaternion Interpolate(const Quaternion& pStart, const Quaternion& pEnd, float pFactor);
 
 	inline friend std::ostream& operator<<(std::ostream& o, const Quaternion& q){
 		o << "Quat(" << q.x << "," << q.y << "," << q.z <<  "," << q.w << ")" << std::endl;
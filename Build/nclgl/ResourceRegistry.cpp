@@ -0,0 +1,376 @@
+#include "ResourceRegistry.h"
+#include "TextureData.h"
+#include <cstring>
+
+std::unordered_map<std::string, ResourceRegistry::Resource*>	ResourceRegistry::textureKeys;
+std::unordered_map<uint64_t, ResourceRegistry::Resource*>		ResourceRegistry::textureHashes;
+std::unordered_map<GLuint, ResourceRegistry::Resource*>			ResourceRegistry::textures;
+std::unordered_map<uint64_t, ResourceRegistry::Resource*>		ResourceRegistry::meshHashes;
+std::unordered_map<GLuint, ResourceRegistry::Resource*>			ResourceRegistry::meshes;
+std::map<std::string, MaterialLibrary>							ResourceRegistry::materialLibraries;
+std::mutex														ResourceRegistry::materialMutex;
+std::list<ResourceRegistry::Resource*>							ResourceRegistry::unused;
+
+uint64_t				ResourceRegistry::memoryCap = RESOURCE_REGISTRY_DEFAULT_MEMORY_CAP;
+ResourceRegistryStats	ResourceRegistry::stats		= { 0 };
+
+ResourceContentKey::ResourceContentKey(void)	{
+	hash		= 0;
+	checkHash	= 0x9e3779b97f4a7c15ULL;	//Any seed other than hash's, so the two hashes are independent
+	size		= 0;
+}
+
+void	ResourceContentKey::Add(const void* data, size_t bytes)	{
+	hash		= ResourceRegistry::HashData(data, bytes, hash);
+	checkHash	= ResourceRegistry::HashData(data, bytes, checkHash);
+	size		+= bytes;
+}
+
+std::string	ResourceRegistry::TextureKey(const std::string &filename, unsigned int soilFlags)	{
+	return std::to_string(soilFlags) + ":" + filename;
+}
+
+GLuint	ResourceRegistry::AcquireTexture(const std::string &filename, unsigned int soilFlags)	{
+	std::unordered_map<std::string, Resource*>::iterator i = textureKeys.find(TextureKey(filename, soilFlags));
+	if (i != textureKeys.end()) {
+		AddRef(i->second);
+		stats.bytesSaved += i->second->size;
+		stats.numShared++;
+		return i->second->name;
+	}
+
+	if (TextureData::CanBake(soilFlags)) {
+		TextureData data;
+		if (!data.Load(filename, soilFlags)) {
+			return 0;
+		}
+		return AcquireTexture(filename, soilFlags, data);
+	}
+
+	//Flags TextureData can't handle are left to SOIL, so the texture can only be shared by it's filename
+	GLuint texture = SOIL_load_OGL_texture(filename.c_str(), SOIL_LOAD_AUTO, SOIL_CREATE_NEW_ID, soilFlags & ~TEXTURE_FLAG_NEAREST);
+	if (!texture) {
+		return 0;
+	}
+
+	GLint width = 0, height = 0;
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+	if (soilFlags & TEXTURE_FLAG_NEAREST) {
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (soilFlags & SOIL_FLAG_MIPMAPS) ? GL_NEAREST_MIPMAP_NEAREST : GL_NEAREST);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	//Near enough, assuming RGBA (plus a third for the mipmaps)
+	uint64_t size = (uint64_t)width * height * 4;
+	if (soilFlags & SOIL_FLAG_MIPMAPS) {
+		size += size / 3;
+	}
+
+	Resource* r = NewResource(false, texture, ResourceContentKey(), size);
+	r->keys.push_back(TextureKey(filename, soilFlags));
+	textureKeys[r->keys.back()] = r;
+	return texture;
+}
+
+GLuint	ResourceRegistry::AcquireTexture(const std::string &filename, unsigned int soilFlags, const TextureData &data)	{
+	const std::string key = TextureKey(filename, soilFlags);
+	std::unordered_map<std::string, Resource*>::iterator i = textureKeys.find(key);
+	if (i != textureKeys.end()) {
+		AddRef(i->second);
+		stats.bytesSaved += i->second->size;
+		stats.numShared++;
+		return i->second->name;
+	}
+
+	if (!data.IsLoaded()) {
+		return 0;
+	}
+
+	//Hash everything that ends up on the graphics card (the flags cover the sampler settings)
+	const unsigned int description[] = { soilFlags, data.GetInternalFormat(), data.GetNumLevels() };
+	ResourceContentKey content;
+	content.Add(description, sizeof(description));
+	uint64_t size = 0;
+	for (unsigned int l = 0; l < data.GetNumLevels(); ++l) {
+		const TextureLevel &level = data.GetLevel(l);
+		content.Add(&level.width, sizeof(level.width));
+		content.Add(&level.height, sizeof(level.height));
+		content.Add(level.data, level.size);
+		size += level.size;
+	}
+
+	Resource* r;
+	std::unordered_map<uint64_t, Resource*>::iterator h = textureHashes.find(content.hash);
+	if (h != textureHashes.end() && h->second->content == content) {
+		//Same image under a different name
+		r = h->second;
+		AddRef(r);
+		stats.bytesSaved += r->size;
+		stats.numShared++;
+	}
+	else {
+		GLuint texture = data.Upload();
+		if (!texture) {
+			return 0;
+		}
+		r = NewResource(false, texture, content, size);
+
+		//A different image with the same hash keeps it, and this one just isn't shared by it's contents
+		if (h == textureHashes.end()) {
+			textureHashes[content.hash] = r;
+		}
+	}
+
+	r->keys.push_back(key);
+	textureKeys[key] = r;
+	return r->name;
+}
+
+void	ResourceRegistry::AddTextureRef(GLuint texture)	{
+	std::unordered_map<GLuint, Resource*>::iterator i = textures.find(texture);
+	if (i != textures.end()) {
+		AddRef(i->second);
+	}
+}
+
+bool	ResourceRegistry::ReleaseTexture(GLuint texture)	{
+	std::unordered_map<GLuint, Resource*>::iterator i = textures.find(texture);
+	if (i == textures.end()) {
+		return false;
+	}
+	Release(i->second);
+	return true;
+}
+
+bool	ResourceRegistry::AcquireMeshBuffers(const ResourceContentKey &content, GLuint &arrayObject, GLuint* bufferObjects, uint64_t* size)	{
+	std::unordered_map<uint64_t, Resource*>::iterator i = meshHashes.find(content.hash);
+	if (i == meshHashes.end() || i->second->content != content) {
+		return false;
+	}
+
+	Resource* r = i->second;
+	AddRef(r);
+	stats.bytesSaved += r->size;
+	stats.numShared++;
+
+	arrayObject = r->name;
+	memcpy(bufferObjects, r->buffers, sizeof(r->buffers));
+	if (size) {
+		*size = r->size;
+	}
+	return true;
+}
+
+void	ResourceRegistry::AddMeshBuffers(const ResourceContentKey &content, GLuint arrayObject, const GLuint* bufferObjects, uint64_t size)	{
+	Resource* r = NewResource(true, arrayObject, content, size);
+	memcpy(r->buffers, bufferObjects, sizeof(r->buffers));
+	if (meshHashes.find(content.hash) == meshHashes.end()) {
+		meshHashes[content.hash] = r;
+	}
+}
+
+bool	ResourceRegistry::ReleaseMeshBuffers(GLuint arrayObject)	{
+	std::unordered_map<GLuint, Resource*>::iterator i = meshes.find(arrayObject);
+	if (i == meshes.end()) {
+		return false;
+	}
+	Release(i->second);
+	return true;
+}
+
+const MaterialLibrary*	ResourceRegistry::FindMaterialLibrary(const std::string &filename)	{
+	std::lock_guard<std::mutex> lock(materialMutex);
+	std::map<std::string, MaterialLibrary>::iterator i = materialLibraries.find(filename);
+	return (i != materialLibraries.end()) ? &i->second : NULL;
+}
+
+const MaterialLibrary*	ResourceRegistry::AddMaterialLibrary(const std::string &filename, const MaterialLibrary &library)	{
+	//Libraries are never changed once added, so the pointers handed out stay valid (until ReleaseAll)
+	std::lock_guard<std::mutex> lock(materialMutex);
+	const MaterialLibrary* added = &materialLibraries.insert(std::make_pair(filename, library)).first->second;
+	stats.numMaterialLibraries = (unsigned int)materialLibraries.size();
+	return added;
+}
+
+void	ResourceRegistry::SetMemoryCap(uint64_t bytes)	{
+	memoryCap = bytes;
+	EvictUnused();
+}
+
+void	ResourceRegistry::ReleaseAll()	{
+	while (!textures.empty()) {
+		DeleteResource(textures.begin()->second);
+	}
+	while (!meshes.empty()) {
+		DeleteResource(meshes.begin()->second);
+	}
+	std::lock_guard<std::mutex> lock(materialMutex);
+	materialLibraries.clear();
+	stats.numMaterialLibraries = 0;
+}
+
+ResourceRegistry::Resource*	ResourceRegistry::NewResource(bool isMesh, GLuint name, const ResourceContentKey &content, uint64_t size)	{
+	Resource* r = new Resource();
+	r->isMesh	= isMesh;
+	r->name		= name;
+	r->content	= content;
+	r->size		= size;
+	r->refCount	= 1;
+	memset(r->buffers, 0, sizeof(r->buffers));
+	r->unusedItr = unused.end();
+
+	if (isMesh) {
+		meshes[name] = r;
+		stats.numMeshes++;
+	}
+	else {
+		textures[name] = r;
+		stats.numTextures++;
+	}
+	stats.bytesUsed += size;
+	return r;
+}
+
+void	ResourceRegistry::AddRef(Resource* r)	{
+	if (r->refCount++ == 0) {
+		//Back in use, so it can't be evicted any more
+		unused.erase(r->unusedItr);
+		r->unusedItr = unused.end();
+		stats.bytesUnused	-= r->size;
+		stats.bytesUsed		+= r->size;
+	}
+}
+
+void	ResourceRegistry::Release(Resource* r)	{
+	if (--r->refCount > 0) {
+		return;
+	}
+
+	r->unusedItr = unused.insert(unused.end(), r);
+	stats.bytesUsed		-= r->size;
+	stats.bytesUnused	+= r->size;
+	EvictUnused();
+}
+
+void	ResourceRegistry::EvictUnused()	{
+	while (stats.bytesUnused > memoryCap && !unused.empty()) {
+		DeleteResource(unused.front());
+		stats.numEvicted++;
+	}
+}
+
+void	ResourceRegistry::DeleteResource(Resource* r)	{
+	if (r->refCount > 0) {
+		stats.bytesUsed -= r->size;
+	}
+	else {
+		unused.erase(r->unusedItr);
+		stats.bytesUnused -= r->size;
+	}
+
+	if (r->isMesh) {
+		meshes.erase(r->name);
+		std::unordered_map<uint64_t, Resource*>::iterator h = meshHashes.find(r->content.hash);
+		if (h != meshHashes.end() && h->second == r) {
+			meshHashes.erase(h);
+		}
+		stats.numMeshes--;
+
+		glDeleteVertexArrays(1, &r->name);
+		glDeleteBuffers(MAX_BUFFER, r->buffers);
+	}
+	else {
+		textures.erase(r->name);
+		std::unordered_map<uint64_t, Resource*>::iterator h = textureHashes.find(r->content.hash);
+		if (h != textureHashes.end() && h->second == r) {
+			textureHashes.erase(h);
+		}
+		for (unsigned int i = 0; i < r->keys.size(); ++i) {
+			textureKeys.erase(r->keys[i]);
+		}
+		stats.numTextures--;
+
+		glDeleteTextures(1, &r->name);
+	}
+	delete r;
+}
+
+/*
+Hashes 8 bytes at a time, mixing each one in with a multiply and shift (along
+the lines of MurmurHash2's 64 bit version), then scrambles the result so every
+bit of the input affects every bit of the hash.
+*/
+uint64_t	ResourceRegistry::HashData(const void* data, size_t size, uint64_t seed)	{
+	const uint64_t m = 0xc6a4a7935bd1e995ULL;
+	const int r = 47;
+
+	uint64_t h = seed ^ (size * m);
+
+	const unsigned char* bytes = (const unsigned char*)data;
+	const size_t numWords = size / 8;
+	for (size_t i = 0; i < numWords; ++i) {
+		uint64_t k;
+		memcpy(&k, bytes + i * 8, 8);
+
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+
+		h ^= k;
+		h *= m;
+	}
+
+	const unsigned char* tail = bytes + numWords * 8;
+	const size_t numTail = size & 7;
+	if (numTail > 0) {
+		uint64_t k = 0;
+		memcpy(&k, tail, numTail);
+		h ^= k;
+		h *= m;
+	}
+
+	h ^= h >> r;
+	h *= m;
+	h ^= h >> r;
+	return h;
+}
+
+bool	DecodedTextures::Decode(const std::string &filename, unsigned int soilFlags)	{
+	const std::string key = ResourceRegistry::TextureKey(filename, soilFlags);
+	std::map<std::string, TextureData*>::iterator i = textures.find(key);
+	if (i != textures.end()) {
+		return i->second != NULL;
+	}
+	if (!TextureData::CanBake(soilFlags)) {
+		return true;	//Left for SOIL to load in Acquire
+	}
+
+	TextureData* data = new TextureData();
+	if (!data->Load(filename, soilFlags)) {
+		delete data;
+		data = NULL;
+	}
+	textures[key] = data;
+	return data != NULL;
+}
+
+GLuint	DecodedTextures::Acquire(const std::string &filename, unsigned int soilFlags)	{
+	std::map<std::string, TextureData*>::iterator i = textures.find(ResourceRegistry::TextureKey(filename, soilFlags));
+	if (i == textures.end()) {
+		return ResourceRegistry::AcquireTexture(filename, soilFlags);
+	}
+	if (!i->second) {
+		return 0;
+	}
+	return ResourceRegistry::AcquireTexture(filename, soilFlags, *i->second);
+}
+
+void	DecodedTextures::Clear()	{
+	for (std::map<std::string, TextureData*>::iterator i = textures.begin(); i != textures.end(); ++i) {
+		delete i->second;
+	}
+	textures.clear();
+}
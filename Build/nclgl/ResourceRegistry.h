@@ -0,0 +1,216 @@
+/******************************************************************************
+Class:ResourceRegistry
+Implements:
+Author:Pieran Marris <p.marris@newcastle.ac.uk>
+Description:Shares textures, mesh buffers and materials between everything
+that uses them, so loading the same thing twice doesn't make a second copy of
+it in memory (or on the graphics card).
+
+Resources are looked up by their contents, not just their filename, so two
+different files (or two submeshes of the same file) containing the same image
+or geometry still end up sharing a single OpenGL texture/VAO. Contents are
+identified by two independent 64 bit hashes along with their size (see
+ResourceContentKey), rather than by keeping a copy of the data to compare.
+
+Shared textures must not be changed once they've been acquired, as whatever
+else is using them would see the change. Their sampler settings come from
+their flags instead (e.g. SOIL_FLAG_TEXTURE_REPEATS, TEXTURE_FLAG_NEAREST),
+which are part of the key they're shared by.
+
+ - Textures are also found by filename and SOIL flags, so loading a texture
+   that's already loaded doesn't even have to decode it.
+ - Mesh buffers are the VAO and VBOs made by Mesh::ShareBufferData, see there.
+ - Materials are the parsed contents of OBJ .mtl files, so each .mtl file is
+   only read once, rather than once for every submesh that uses it.
+
+Everything is reference counted. Once nothing is using a texture or mesh, it
+isn't deleted straight away, but is kept around in case it gets loaded again
+(e.g. when switching back to a scene) until the total size of the unused
+resources goes over the memory cap, at which point the least recently used
+ones are deleted.
+
+This uses OpenGL, so should only be used from the main thread (apart from the
+material libraries, which worker threads can find and add while decoding).
+
+-_-_-_-_-_-_-_,------,
+_-_-_-_-_-_-_-|   /\_/\   NYANYANYAN
+-_-_-_-_-_-_-~|__( ^ .^) /
+_-_-_-_-_-_-_-""  ""
+
+*//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "OGLRenderer.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+
+class TextureData;
+
+#define RESOURCE_REGISTRY_DEFAULT_MEMORY_CAP	(128 * 1024 * 1024)	//Bytes of unused resources kept around in case they're needed again
+
+//Texture files used by a single material
+struct MaterialInfo {
+	std::string diffuse;
+	std::string bump;
+};
+
+//All of the materials in a .mtl file, by name
+typedef std::map<std::string, MaterialInfo> MaterialLibrary;
+
+/*
+Identifies a texture's or mesh's contents: two 64 bit hashes of them, seeded
+differently, and the number of bytes hashed. Resources are only shared when
+all three match, so a collision in a single hash can't hand out the wrong
+texture or mesh.
+*/
+struct ResourceContentKey {
+	uint64_t	hash;
+	uint64_t	checkHash;
+	uint64_t	size;
+
+	ResourceContentKey(void);
+
+	//Hashes another block of the contents
+	void	Add(const void* data, size_t bytes);
+
+	bool	operator==(const ResourceContentKey &k) const { return hash == k.hash && checkHash == k.checkHash && size == k.size; }
+	bool	operator!=(const ResourceContentKey &k) const { return !(*this == k); }
+};
+
+struct ResourceRegistryStats {
+	unsigned int	numTextures;		//Including unused ones
+	unsigned int	numMeshes;
+	unsigned int	numMaterialLibraries;
+	uint64_t		bytesUsed;			//Size of the resources that are in use
+	uint64_t		bytesUnused;		//Size of those kept around after they stopped being used
+	uint64_t		bytesSaved;			//Total size of all the copies that would have been made if nothing was shared
+	unsigned int	numShared;			//Number of times a request was given an existing resource
+	unsigned int	numEvicted;			//Number of unused resources deleted to stay under the memory cap
+};
+
+/*
+Textures decoded ahead of time (e.g. by the AssetManager's worker threads), so
+that all the main thread has to do is hand them to OpenGL. Decode doesn't use
+OpenGL (or the registry), so each list can be filled in on any one thread, and
+then Acquire'd from on the main thread.
+*/
+class DecodedTextures	{
+public:
+	DecodedTextures(void) {}
+	~DecodedTextures(void) { Clear(); }
+
+	//Loads the given texture into a TextureData, unless it already has been. Returns false if it couldn't be loaded
+	bool	Decode(const std::string &filename, unsigned int soilFlags);
+
+	/*
+	Returns the texture from the ResourceRegistry, giving it the decoded data
+	if it isn't already loaded. Textures that weren't decoded (e.g. because
+	TextureData can't bake their flags) are loaded straight away instead, and
+	those that failed to decode return 0 without trying again.
+	*/
+	GLuint	Acquire(const std::string &filename, unsigned int soilFlags);
+
+	void	Clear();
+
+protected:
+	std::map<std::string, TextureData*>	textures;	//By ResourceRegistry::TextureKey, NULL if it failed to decode
+
+private:
+	DecodedTextures(const DecodedTextures&);
+	DecodedTextures& operator=(const DecodedTextures&);
+};
+
+class ResourceRegistry	{
+	friend class DecodedTextures;
+
+public:
+	/*
+	Returns the texture loaded from the given file with the given SOIL flags,
+	loading it (through TextureData, so using it's baked cache where possible)
+	if it isn't already. Returns 0 if the file couldn't be loaded.
+	*/
+	static GLuint	AcquireTexture(const std::string &filename, unsigned int soilFlags);
+
+	//As above, for a texture that has already been decoded (e.g. on a worker thread)
+	static GLuint	AcquireTexture(const std::string &filename, unsigned int soilFlags, const TextureData &data);
+
+	//Adds another reference to a texture previously returned by AcquireTexture
+	static void		AddTextureRef(GLuint texture);
+
+	//Releases a reference to the given texture. Returns false if it wasn't one of the registry's textures
+	static bool		ReleaseTexture(GLuint texture);
+
+	/*
+	Looks up mesh buffers with the given contents, filling in 'arrayObject' and
+	'bufferObjects' (MAX_BUFFER of them), along with their size in bytes if
+	'size' isn't NULL, and returning true if there are some.
+	*/
+	static bool		AcquireMeshBuffers(const ResourceContentKey &content, GLuint &arrayObject, GLuint* bufferObjects, uint64_t* size = NULL);
+
+	//Hands the given mesh buffers over to the registry, along with a reference to them. If different
+	//contents already have the same hash, the buffers are still released through the registry, but aren't shared
+	static void		AddMeshBuffers(const ResourceContentKey &content, GLuint arrayObject, const GLuint* bufferObjects, uint64_t size);
+
+	//Releases a reference to the mesh buffers with the given VAO. Returns false if they weren't the registry's
+	static bool		ReleaseMeshBuffers(GLuint arrayObject);
+
+	//Returns the materials in the given .mtl file, or NULL if it hasn't been added. Can be called from any thread
+	static const MaterialLibrary*	FindMaterialLibrary(const std::string &filename);
+	//Adds the given materials, unless another thread got there first, and returns the registry's copy of them
+	static const MaterialLibrary*	AddMaterialLibrary(const std::string &filename, const MaterialLibrary &library);
+
+	//Maximum total size of the unused resources kept around. Setting it to 0 deletes them all
+	static void		SetMemoryCap(uint64_t bytes);
+	static uint64_t	GetMemoryCap() { return memoryCap; }
+
+	static const ResourceRegistryStats&	GetStats() { return stats; }
+
+	//Deletes everything, whether it's still in use or not (e.g. before the OpenGL context is destroyed)
+	static void		ReleaseAll();
+
+	//64 bit hash of a block of memory, carrying on from 'seed' (so several blocks can be hashed in turn)
+	static uint64_t	HashData(const void* data, size_t size, uint64_t seed = 0);
+
+protected:
+	struct Resource {
+		bool			isMesh;
+		GLuint			name;					//Texture or VAO
+		GLuint			buffers[MAX_BUFFER];	//Only used by meshes
+		ResourceContentKey	content;			//All zero for textures loaded by SOIL, which are only shared by filename
+		uint64_t		size;
+		int				refCount;
+		std::vector<std::string>			keys;	//Filename keys pointing at this texture
+		std::list<Resource*>::iterator		unusedItr;
+	};
+
+	static Resource*	NewResource(bool isMesh, GLuint name, const ResourceContentKey &content, uint64_t size);
+	static void			AddRef(Resource* r);
+	static void			Release(Resource* r);
+	static void			DeleteResource(Resource* r);
+
+	//Deletes the least recently used unused resources until they fit in the memory cap
+	static void			EvictUnused();
+
+	//Texture flags make up part of the key (and hash), as textures with different flags have different sampler settings
+	static std::string	TextureKey(const std::string &filename, unsigned int soilFlags);
+
+	static std::unordered_map<std::string, Resource*>	textureKeys;
+	static std::unordered_map<uint64_t, Resource*>		textureHashes;	//By content.hash
+	static std::unordered_map<GLuint, Resource*>		textures;
+	static std::unordered_map<uint64_t, Resource*>		meshHashes;		//By content.hash
+	static std::unordered_map<GLuint, Resource*>		meshes;
+	static std::map<std::string, MaterialLibrary>		materialLibraries;
+	static std::mutex									materialMutex;
+
+	//Unused resources, least recently used at the front
+	static std::list<Resource*>		unused;
+
+	static uint64_t					memoryCap;
+	static ResourceRegistryStats	stats;
+};
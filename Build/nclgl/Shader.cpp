@@ -110,4 +110,7 @@ void	Shader::SetDefaultAttributes()	{
 	glBindAttribLocation(program, TEXTURE_BUFFER, "texCoord");
 
 	glBindAttribLocation(program, MAX_BUFFER+1,  "transformIndex");
+
+	glBindAttribLocation(program, INSTANCE_MODELMATRIX_ATTRIB, "instanceModelMatrix");
+	glBindAttribLocation(program, INSTANCE_COLOUR_ATTRIB, "instanceColour");
 }
\ No newline at end of file
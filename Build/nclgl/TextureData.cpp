@@ -0,0 +1,528 @@
+#include "TextureData.h"
+#include "GameTimer.h"
+#include <Simple OpenGL Image Library/src/image_helper.h>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+//image_DXT.h doesn't wrap itself in extern "C" like the rest of SOIL's headers
+extern "C" {
+#include <Simple OpenGL Image Library/src/image_DXT.h>
+}
+
+/*
+Layout of the baked cache file: a TextureCacheHeader, followed by 'numLevels'
+TextureCacheLevel entries (largest first), followed by the data they point to.
+Offsets are in bytes from the start of the file (8 byte aligned).
+*/
+struct TextureCacheHeader {
+	char		magic[4];
+	uint32_t	version;
+	uint64_t	srcSize;		//Size and modification time of the image file the cache was built from
+	uint64_t	srcTimestamp;
+	uint32_t	flags;			//SOIL flags (within TEXTURE_BAKE_FLAGS) it was baked with
+	uint32_t	channels;
+	uint32_t	internalFormat;
+	uint32_t	pixelFormat;
+	uint32_t	numLevels;
+	uint32_t	padding;
+};
+
+struct TextureCacheLevel {
+	uint32_t	width;
+	uint32_t	height;
+	uint32_t	size;
+	uint32_t	padding;
+	uint64_t	offset;
+};
+
+static const char TEXTURE_CACHE_MAGIC[4] = { 'N', 'T', 'E', 'X' };
+
+static const unsigned int TEXTURE_MAX_LEVELS = 32;
+
+//The uncompressed format images with the given number of channels are baked in
+static GLenum	PixelFormatFor(unsigned int channels)	{
+	switch (channels) {
+		case 1:		return GL_LUMINANCE;
+		case 2:		return GL_LUMINANCE_ALPHA;
+		case 3:		return GL_RGB;
+		default:	return GL_RGBA;
+	}
+}
+
+//Odd number of channels means there's no alpha
+static GLenum	DXTFormatFor(unsigned int channels)	{
+	return (channels & 1) ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
+//Size in bytes of a single mip level
+static uint64_t	LevelSize(unsigned int width, unsigned int height, unsigned int channels, GLenum internalFormat)	{
+	switch (internalFormat) {
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:	return (uint64_t)((width + 3) / 4) * ((height + 3) / 4) * 8;
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:	return (uint64_t)((width + 3) / 4) * ((height + 3) / 4) * 16;
+		default:								return (uint64_t)width * height * channels;
+	}
+}
+
+//Expands a 5:6:5 colour from a DXT block into 8 bits per channel
+static void	Decode565(unsigned int c, unsigned char* out)	{
+	const unsigned int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+	out[0] = (unsigned char)((r << 3) | (r >> 2));
+	out[1] = (unsigned char)((g << 2) | (g >> 4));
+	out[2] = (unsigned char)((b << 3) | (b >> 2));
+}
+
+/*
+Decodes a level of DXT1 (to RGB) or DXT5 (to RGBA) blocks back into pixels,
+for graphics cards that can't use the compressed data themselves.
+*/
+static void	DecompressDXT(const TextureLevel &level, bool dxt1, std::vector<unsigned char> &out)	{
+	const unsigned int outChannels	= dxt1 ? 3 : 4;
+	const unsigned int blockSize	= dxt1 ? 8 : 16;
+	const unsigned int blocksWide	= (level.width + 3) / 4;
+	const unsigned int blocksHigh	= (level.height + 3) / 4;
+	out.resize((size_t)level.width * level.height * outChannels);
+
+	for (unsigned int by = 0; by < blocksHigh; ++by) {
+		for (unsigned int bx = 0; bx < blocksWide; ++bx) {
+			const unsigned char* block = level.data + ((size_t)by * blocksWide + bx) * blockSize;
+
+			unsigned char alphas[16];
+			if (!dxt1) {
+				//Two end points, and 3 bits per pixel choosing between them and 6 values (or 4, plus 0 and 255) in between
+				unsigned int palette[8];
+				palette[0] = block[0];
+				palette[1] = block[1];
+				if (palette[0] > palette[1]) {
+					for (unsigned int i = 2; i < 8; ++i) {
+						palette[i] = ((8 - i) * palette[0] + (i - 1) * palette[1]) / 7;
+					}
+				}
+				else {
+					for (unsigned int i = 2; i < 6; ++i) {
+						palette[i] = ((6 - i) * palette[0] + (i - 1) * palette[1]) / 5;
+					}
+					palette[6] = 0;
+					palette[7] = 255;
+				}
+
+				uint64_t bits = 0;
+				for (unsigned int i = 0; i < 6; ++i) {
+					bits |= (uint64_t)block[2 + i] << (8 * i);
+				}
+				for (unsigned int i = 0; i < 16; ++i) {
+					alphas[i] = (unsigned char)palette[(bits >> (3 * i)) & 7];
+				}
+				block += 8;
+			}
+
+			//Two 5:6:5 end points, and 2 bits per pixel choosing between them and the colours in between
+			const unsigned int c0 = block[0] | (block[1] << 8);
+			const unsigned int c1 = block[2] | (block[3] << 8);
+			unsigned char colours[4][3];
+			Decode565(c0, colours[0]);
+			Decode565(c1, colours[1]);
+			for (unsigned int c = 0; c < 3; ++c) {
+				if (c0 > c1 || !dxt1) {
+					colours[2][c] = (unsigned char)((2 * colours[0][c] + colours[1][c]) / 3);
+					colours[3][c] = (unsigned char)((colours[0][c] + 2 * colours[1][c]) / 3);
+				}
+				else {
+					colours[2][c] = (unsigned char)((colours[0][c] + colours[1][c]) / 2);
+					colours[3][c] = 0;
+				}
+			}
+
+			const unsigned int indices = block[4] | (block[5] << 8) | (block[6] << 16) | ((unsigned int)block[7] << 24);
+			for (unsigned int py = 0; py < 4; ++py) {
+				for (unsigned int px = 0; px < 4; ++px) {
+					const unsigned int x = bx * 4 + px, y = by * 4 + py;
+					if (x >= level.width || y >= level.height) {
+						continue;
+					}
+
+					const unsigned int i = py * 4 + px;
+					unsigned char* p = &out[((size_t)y * level.width + x) * outChannels];
+					memcpy(p, colours[(indices >> (2 * i)) & 3], 3);
+					if (!dxt1) {
+						p[3] = alphas[i];
+					}
+				}
+			}
+		}
+	}
+}
+
+TextureData::TextureData(void)	{
+	Clear();
+}
+
+void	TextureData::Clear()	{
+	channels		= 0;
+	flags			= 0;
+	internalFormat	= 0;
+	pixelFormat		= 0;
+	compressed		= false;
+	fromCache		= false;
+	loadTime		= 0.0f;
+
+	levels.clear();
+	std::vector<unsigned char>().swap(bakedData);
+	cacheFile.Close();
+}
+
+bool	TextureData::CanBake(unsigned int soilFlags)	{
+	return (soilFlags & ~(TEXTURE_BAKE_FLAGS | TEXTURE_SAMPLER_FLAGS)) == 0;
+}
+
+bool	TextureData::Load(const std::string &filename, unsigned int soilFlags, bool useCache)	{
+	GameTimer timer;
+	Clear();
+
+	uint64_t srcSize, srcTimestamp;
+	if (!MappedFile::GetFileInfo(filename, &srcSize, &srcTimestamp)) {
+		return false;
+	}
+
+	//The same image could be loaded with different flags, so each set of flags gets it's own cache
+	const std::string cacheFilename = filename + "_" + std::to_string(soilFlags & TEXTURE_BAKE_FLAGS) + TEXTURE_CACHE_EXTENSION;
+	if (useCache && LoadCache(cacheFilename, srcSize, srcTimestamp, soilFlags)) {
+		fromCache	= true;
+		loadTime	= timer.GetMS();
+		return true;
+	}
+	Clear();	//Anything left over from an out of date or broken cache
+
+	int width, height, imgChannels;
+	unsigned char* pixels = SOIL_load_image(filename.c_str(), &width, &height, &imgChannels, SOIL_LOAD_AUTO);
+	if (!pixels) {
+		return false;
+	}
+
+	const bool baked = Bake(pixels, width, height, imgChannels, soilFlags);
+	SOIL_free_image_data(pixels);
+
+	if (baked && useCache) {
+		//Not being able to write the cache (e.g. read only data directory) isn't an error, it'll just be slower next time
+		SaveCache(cacheFilename, srcSize, srcTimestamp);
+	}
+
+	loadTime = timer.GetMS();
+	return baked;
+}
+
+/*
+Does the same processing to the image as SOIL_create_OGL_texture, other than
+shrinking images bigger than GL_MAX_TEXTURE_SIZE, as that depends on the
+graphics card.
+*/
+bool	TextureData::Bake(const unsigned char* pixels, int width, int height, int numChannels, unsigned int soilFlags)	{
+	Clear();
+	if (!pixels || width < 1 || height < 1 || numChannels < 1 || numChannels > 4) {
+		return false;
+	}
+
+	channels	= numChannels;
+	flags		= soilFlags & (TEXTURE_BAKE_FLAGS | TEXTURE_SAMPLER_FLAGS);
+	compressed	= (flags & SOIL_FLAG_COMPRESS_TO_DXT) != 0;
+
+	pixelFormat		= PixelFormatFor(channels);
+	internalFormat	= compressed ? DXTFormatFor(channels) : pixelFormat;
+
+	const size_t rowSize = (size_t)width * channels;
+	std::vector<unsigned char> img(pixels, pixels + rowSize * height);
+
+	if (flags & SOIL_FLAG_INVERT_Y) {
+		for (int j = 0; j < height / 2; ++j) {
+			std::swap_ranges(&img[j * rowSize], &img[j * rowSize] + rowSize, &img[(height - 1 - j) * rowSize]);
+		}
+	}
+
+	if (flags & SOIL_FLAG_NTSC_SAFE_RGB) {
+		scale_image_RGB_to_NTSC_safe(&img[0], width, height, channels);
+	}
+
+	if ((flags & SOIL_FLAG_MULTIPLY_ALPHA) && (channels == 2 || channels == 4)) {
+		const size_t numPixels = (size_t)width * height;
+		for (size_t i = 0; i < numPixels; ++i) {
+			unsigned char* p		= &img[i * channels];
+			const unsigned int a	= p[channels - 1];
+			for (unsigned int c = 0; c < channels - 1; ++c) {
+				p[c] = (unsigned char)((p[c] * a + 128) >> 8);
+			}
+		}
+	}
+
+	//Mipmaps are generated by averaging blocks of 2^level pixels, so need power of two sizes
+	if (flags & (SOIL_FLAG_POWER_OF_TWO | SOIL_FLAG_MIPMAPS)) {
+		int potWidth = 1, potHeight = 1;
+		while (potWidth < width)	{ potWidth *= 2; }
+		while (potHeight < height)	{ potHeight *= 2; }
+
+		if (potWidth != width || potHeight != height) {
+			std::vector<unsigned char> resampled((size_t)potWidth * potHeight * channels);
+			up_scale_image(&img[0], width, height, channels, &resampled[0], potWidth, potHeight);
+			img.swap(resampled);
+			width	= potWidth;
+			height	= potHeight;
+		}
+	}
+
+	unsigned int numLevels = 1;
+	if (flags & SOIL_FLAG_MIPMAPS) {
+		while ((1 << numLevels) <= width || (1 << numLevels) <= height) {
+			++numLevels;
+		}
+	}
+
+	//Work out where each level goes, so they can all be filled in at the same time
+	const unsigned int blockSize = (internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT) ? 8 : 16;
+	size_t totalSize = 0;
+	std::vector<size_t> offsets(numLevels);
+	levels.resize(numLevels);
+	for (unsigned int i = 0; i < numLevels; ++i) {
+		TextureLevel &level = levels[i];
+		level.width		= (width >> i) > 0 ? (width >> i) : 1;
+		level.height	= (height >> i) > 0 ? (height >> i) : 1;
+		level.size		= (unsigned int)LevelSize(level.width, level.height, channels, internalFormat);
+
+		offsets[i]	= totalSize;
+		totalSize	+= (level.size + 7) & ~7;
+	}
+	bakedData.resize(totalSize);
+
+	/*
+	Each mip level is made by averaging 2x2 blocks of the level before it, so
+	every level only reads a quarter of the pixels of the last one (rather
+	than all of the full size image). The levels have to be done in order, so
+	instead each level is split into strips of rows, which only read the rows
+	of the last level directly above them.
+	*/
+	std::vector<std::vector<unsigned char>> mipPixels(numLevels);
+	mipPixels[0].swap(img);
+
+	for (unsigned int i = 1; i < numLevels; ++i) {
+		const TextureLevel &src = levels[i - 1];
+		const TextureLevel &dst = levels[i];
+		mipPixels[i].resize((size_t)dst.width * dst.height * channels);
+
+		const unsigned char*	srcPixels = &mipPixels[i - 1][0];
+		unsigned char*			dstPixels = &mipPixels[i][0];
+		const int numStrips = (int)((dst.height + TEXTURE_MIP_STRIP_ROWS - 1) / TEXTURE_MIP_STRIP_ROWS);
+#pragma omp parallel for if ((size_t)src.width * src.height > TEXTURE_PARALLEL_THRESHOLD)
+		for (int s = 0; s < numStrips; ++s) {
+			const unsigned int y		= s * TEXTURE_MIP_STRIP_ROWS;
+			const unsigned int rows		= (dst.height - y) < TEXTURE_MIP_STRIP_ROWS ? (dst.height - y) : TEXTURE_MIP_STRIP_ROWS;
+			//Once the last level is a single row high, it's only halved across
+			const unsigned int srcRows	= (2 * rows) < src.height ? (2 * rows) : src.height;
+			mipmap_image(srcPixels + (size_t)(2 * y) * src.width * channels, src.width, srcRows, channels,
+				dstPixels + (size_t)y * dst.width * channels, 2, 2);
+		}
+	}
+
+	if (!compressed) {
+		for (unsigned int i = 0; i < numLevels; ++i) {
+			memcpy(&bakedData[offsets[i]], &mipPixels[i][0], levels[i].size);
+		}
+	}
+	else {
+		/*
+		DXT blocks are stored a row at a time, and each block is compressed on
+		it's own, so compressing a strip of rows gives exactly the same blocks as
+		the same rows of the whole image. That lets the compression be split
+		into strips across every level, to keep all of the threads busy even
+		once the levels get small.
+		*/
+		std::vector<std::pair<unsigned int, unsigned int>> strips;	//Level and first row
+		for (unsigned int i = 0; i < numLevels; ++i) {
+			for (unsigned int y = 0; y < levels[i].height; y += TEXTURE_DXT_STRIP_ROWS) {
+				strips.push_back(std::make_pair(i, y));
+			}
+		}
+
+		const int numStrips = (int)strips.size();
+		const bool parallel = (size_t)width * height > TEXTURE_PARALLEL_THRESHOLD;
+		int numFailed = 0;
+#pragma omp parallel for schedule(dynamic) reduction(+:numFailed) if (parallel)
+		for (int s = 0; s < numStrips; ++s) {
+			const unsigned int		l		= strips[s].first;
+			const unsigned int		y		= strips[s].second;
+			const TextureLevel&		level	= levels[l];
+			const unsigned int		rows	= (level.height - y) < TEXTURE_DXT_STRIP_ROWS ? (level.height - y) : TEXTURE_DXT_STRIP_ROWS;
+			const unsigned char*	src		= &mipPixels[l][0] + (size_t)y * level.width * channels;
+
+			int outSize = 0;
+			unsigned char* blocks = (channels & 1)
+				? convert_image_to_DXT1(src, level.width, rows, channels, &outSize)
+				: convert_image_to_DXT5(src, level.width, rows, channels, &outSize);
+
+			if (!blocks) {
+				++numFailed;
+				continue;
+			}
+
+			const size_t blockRowSize = ((level.width + 3) / 4) * blockSize;
+			memcpy(&bakedData[offsets[l] + (y / 4) * blockRowSize], blocks, outSize);
+			free(blocks);
+		}
+
+		if (numFailed > 0) {
+			Clear();
+			return false;
+		}
+	}
+
+	for (unsigned int i = 0; i < numLevels; ++i) {
+		levels[i].data = &bakedData[offsets[i]];
+	}
+	return true;
+}
+
+GLuint	TextureData::Upload(GLuint reuseTexture) const	{
+	if (levels.empty()) {
+		return 0;
+	}
+
+	//If the graphics card can't use DXT textures, the blocks are decompressed again and uploaded as RGB(A) instead
+	const bool decompress = compressed && !GLEW_EXT_texture_compression_s3tc;
+	const bool dxt1 = (internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT);
+	std::vector<unsigned char> decompressed;
+
+	GLuint texture = reuseTexture;
+	if (!texture) {
+		glGenTextures(1, &texture);
+		if (!texture) {
+			return 0;
+		}
+	}
+	glBindTexture(GL_TEXTURE_2D, texture);
+
+	//Rows of the smaller RGB levels aren't padded out to 4 bytes
+	GLint oldAlignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &oldAlignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	for (unsigned int i = 0; i < levels.size(); ++i) {
+		const TextureLevel &level = levels[i];
+		if (decompress) {
+			DecompressDXT(level, dxt1, decompressed);
+			glTexImage2D(GL_TEXTURE_2D, i, dxt1 ? GL_RGB : GL_RGBA, level.width, level.height, 0, dxt1 ? GL_RGB : GL_RGBA, GL_UNSIGNED_BYTE, &decompressed[0]);
+		}
+		else if (compressed) {
+			glCompressedTexImage2D(GL_TEXTURE_2D, i, internalFormat, level.width, level.height, 0, level.size, level.data);
+		}
+		else {
+			glTexImage2D(GL_TEXTURE_2D, i, internalFormat, level.width, level.height, 0, pixelFormat, GL_UNSIGNED_BYTE, level.data);
+		}
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, oldAlignment);
+
+	//Same sampling SOIL would have set up, unless we're asked not to filter
+	const bool nearest = (flags & TEXTURE_FLAG_NEAREST) != 0;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size() - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, nearest ? GL_NEAREST : GL_LINEAR);
+	if (levels.size() > 1) {
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, nearest ? GL_NEAREST_MIPMAP_NEAREST : GL_LINEAR_MIPMAP_LINEAR);
+	}
+	else {
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, nearest ? GL_NEAREST : GL_LINEAR);
+	}
+
+	const GLint wrap = (flags & SOIL_FLAG_TEXTURE_REPEATS) ? GL_REPEAT : GL_CLAMP_TO_EDGE;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return texture;
+}
+
+bool	TextureData::LoadCache(const std::string &filename, uint64_t srcSize, uint64_t srcTimestamp, unsigned int soilFlags)	{
+	//The levels point straight into the mapped file, so it's kept open until they've been uploaded
+	if (!cacheFile.Open(filename) || cacheFile.GetSize() < sizeof(TextureCacheHeader)) {
+		return false;
+	}
+
+	const char*	base = cacheFile.GetData();
+	const size_t size = cacheFile.GetSize();
+
+	//Only use the cache if it was baked by this version of the code, from the image as it is now
+	const TextureCacheHeader* header = (const TextureCacheHeader*)base;
+	if (memcmp(header->magic, TEXTURE_CACHE_MAGIC, sizeof(TEXTURE_CACHE_MAGIC)) != 0
+		|| header->version != TEXTURE_CACHE_VERSION
+		|| header->srcSize != srcSize
+		|| header->srcTimestamp != srcTimestamp
+		|| header->flags != (soilFlags & TEXTURE_BAKE_FLAGS)) {
+		return false;
+	}
+
+	if (header->channels < 1 || header->channels > 4
+		|| header->numLevels < 1 || header->numLevels > TEXTURE_MAX_LEVELS
+		|| header->numLevels > (size - sizeof(TextureCacheHeader)) / sizeof(TextureCacheLevel)
+		|| (header->numLevels > 1 && !(header->flags & SOIL_FLAG_MIPMAPS))) {
+		return false;
+	}
+
+	//The formats are handed straight to OpenGL, so must be exactly what Bake would have chosen for these flags
+	const GLenum cachePixelFormat		= PixelFormatFor(header->channels);
+	const GLenum cacheInternalFormat	= (header->flags & SOIL_FLAG_COMPRESS_TO_DXT) ? DXTFormatFor(header->channels) : cachePixelFormat;
+	if (header->pixelFormat != cachePixelFormat || header->internalFormat != cacheInternalFormat) {
+		return false;
+	}
+
+	//As is the size of each level, and each level must be half the size of the last
+	const TextureCacheLevel* entries = (const TextureCacheLevel*)(base + sizeof(TextureCacheHeader));
+	levels.resize(header->numLevels);
+	for (unsigned int i = 0; i < header->numLevels; ++i) {
+		const TextureCacheLevel &entry = entries[i];
+		if (entry.width == 0 || entry.height == 0 || entry.size == 0 || entry.offset == 0
+			|| !cacheFile.Contains(entry.offset, entry.size)
+			|| entry.size != LevelSize(entry.width, entry.height, header->channels, cacheInternalFormat)) {
+			return false;
+		}
+		if (i > 0 && (entry.width != max(entries[0].width >> i, 1u) || entry.height != max(entries[0].height >> i, 1u))) {
+			return false;
+		}
+
+		levels[i].width		= entry.width;
+		levels[i].height	= entry.height;
+		levels[i].size		= entry.size;
+		levels[i].data		= (const unsigned char*)(base + entry.offset);
+	}
+
+	channels		= header->channels;
+	flags			= soilFlags & (TEXTURE_BAKE_FLAGS | TEXTURE_SAMPLER_FLAGS);
+	internalFormat	= header->internalFormat;
+	pixelFormat		= header->pixelFormat;
+	compressed		= internalFormat != pixelFormat;
+	return true;
+}
+
+bool	TextureData::SaveCache(const std::string &filename, uint64_t srcSize, uint64_t srcTimestamp) const	{
+	BinaryFileBuilder builder(sizeof(TextureCacheHeader) + levels.size() * sizeof(TextureCacheLevel));
+
+	for (size_t i = 0; i < levels.size(); ++i) {
+		TextureCacheLevel entry;
+		memset(&entry, 0, sizeof(entry));
+		entry.width		= levels[i].width;
+		entry.height	= levels[i].height;
+		entry.size		= levels[i].size;
+		entry.offset	= builder.Append(levels[i].data, levels[i].size);
+
+		builder.Write(sizeof(TextureCacheHeader) + i * sizeof(TextureCacheLevel), &entry, sizeof(entry));
+	}
+
+	TextureCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TEXTURE_CACHE_MAGIC, sizeof(TEXTURE_CACHE_MAGIC));
+	header.version			= TEXTURE_CACHE_VERSION;
+	header.srcSize			= srcSize;
+	header.srcTimestamp		= srcTimestamp;
+	header.flags			= flags & TEXTURE_BAKE_FLAGS;
+	header.channels			= channels;
+	header.internalFormat	= internalFormat;
+	header.pixelFormat		= pixelFormat;
+	header.numLevels		= (uint32_t)levels.size();
+	builder.Write(0, &header, sizeof(header));
+
+	return builder.SaveToFile(filename);
+}
@@ -0,0 +1,132 @@
+/******************************************************************************
+Class:TextureData
+Implements:
+Author:Pieran Marris <p.marris@newcastle.ac.uk>
+Description:A texture that has been fully prepared on the CPU, ready to be
+handed straight to OpenGL: the image with all of the processing asked for by
+it's SOIL flags already applied, along with it's whole mip chain, and
+optionally compressed into DXT blocks.
+
+Letting SOIL_load_OGL_texture do all this means decoding the image, generating
+every mip level, and (with SOIL_FLAG_COMPRESS_TO_DXT) running the CPU DXT
+compressor over all of them, every time the program starts. Instead, the first
+time a texture is loaded the result is 'baked' into a small binary cache file
+next to the original image (see TEXTURE_CACHE_EXTENSION), and from then on
+loading it is just mapping the cache file, and uploading each level as it is.
+There is no separate build step that bakes textures, so the first run of the
+program (or the first after an image changes) still pays for all of this, on
+the AssetManager's worker threads.
+
+If the graphics card doesn't support DXT textures, compressed textures are
+decompressed again when they are uploaded.
+
+When the cache is cold, each mip level is generated from the one before it,
+split into strips of rows across threads, and the DXT compression is split up
+across every mip level and strips of blocks within them.
+
+Only the SOIL flags in TEXTURE_BAKE_FLAGS are baked (along with those in
+TEXTURE_SAMPLER_FLAGS, which are just set when uploading). Anything else
+(e.g. SOIL_FLAG_CoCg_Y) should still go through SOIL, see CanBake.
+
+-_-_-_-_-_-_-_,------,
+_-_-_-_-_-_-_-|   /\_/\   NYANYANYAN
+-_-_-_-_-_-_-~|__( ^ .^) /
+_-_-_-_-_-_-_-""  ""
+
+*//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "OGLRenderer.h"
+#include "MappedFile.h"
+#include <string>
+#include <vector>
+
+#define TEXTURE_CACHE_EXTENSION	".ncltex"
+#define TEXTURE_CACHE_VERSION	1
+
+//SOIL flags that are applied when the texture is baked
+#define TEXTURE_BAKE_FLAGS		(SOIL_FLAG_INVERT_Y | SOIL_FLAG_NTSC_SAFE_RGB | SOIL_FLAG_MULTIPLY_ALPHA \
+								| SOIL_FLAG_POWER_OF_TWO | SOIL_FLAG_MIPMAPS | SOIL_FLAG_COMPRESS_TO_DXT)
+
+//Our own flag, alongside SOIL's: sample the texture without any filtering (e.g. to keep a checkerboard crisp)
+#define TEXTURE_FLAG_NEAREST	(1 << 16)
+
+//Flags that only change how the texture is sampled, not it's contents
+#define TEXTURE_SAMPLER_FLAGS	(SOIL_FLAG_TEXTURE_REPEATS | TEXTURE_FLAG_NEAREST)
+
+#define TEXTURE_DXT_STRIP_ROWS	32		//Height (in pixels, a multiple of 4) of each strip of DXT blocks compressed on a single thread
+#define TEXTURE_MIP_STRIP_ROWS	16		//Height (in pixels) of each strip of a mip level generated on a single thread
+#define TEXTURE_PARALLEL_THRESHOLD	(256 * 256)	//Images with fewer pixels than this are baked on one thread
+
+//A single mip level, pointing into either the baked data or the mapped cache file
+struct TextureLevel {
+	unsigned int			width;
+	unsigned int			height;
+	unsigned int			size;	//In bytes
+	const unsigned char*	data;
+};
+
+class TextureData	{
+public:
+	TextureData(void);
+	~TextureData(void) {}
+
+	//Returns true if everything the given SOIL flags ask for can be baked
+	static bool	CanBake(unsigned int soilFlags);
+
+	/*
+	Loads the given image file with the given SOIL flags, using the baked cache
+	if it's up to date, or decoding and baking it (and saving the cache, if
+	'useCache' is set) if not. Doesn't use OpenGL, so can be called from any
+	thread.
+	*/
+	bool	Load(const std::string &filename, unsigned int soilFlags, bool useCache = true);
+
+	//Bakes the given (width * height * channels) image
+	bool	Bake(const unsigned char* pixels, int width, int height, int channels, unsigned int soilFlags);
+
+	/*
+	Creates an OpenGL texture from the baked levels, or replaces the contents
+	of 'reuseTexture' if it is not 0. Returns the texture, or 0 if it failed.
+	Must be called on the thread with the OpenGL context.
+	*/
+	GLuint	Upload(GLuint reuseTexture = 0) const;
+
+	//Throws away the baked data (e.g. once it has been uploaded)
+	void	Clear();
+
+	bool				IsLoaded()		const { return !levels.empty(); }
+	bool				IsCompressed()	const { return compressed; }
+	bool				IsFromCache()	const { return fromCache; }
+	GLenum				GetInternalFormat() const { return internalFormat; }
+	unsigned int		GetWidth()		const { return levels.empty() ? 0 : levels[0].width; }
+	unsigned int		GetHeight()		const { return levels.empty() ? 0 : levels[0].height; }
+	unsigned int		GetNumLevels()	const { return (unsigned int)levels.size(); }
+	const TextureLevel&	GetLevel(unsigned int level) const { return levels[level]; }
+
+	//Time taken by the last call to Load, in milliseconds
+	float				GetLoadTime()	const { return loadTime; }
+
+protected:
+	bool	LoadCache(const std::string &filename, uint64_t srcSize, uint64_t srcTimestamp, unsigned int soilFlags);
+	bool	SaveCache(const std::string &filename, uint64_t srcSize, uint64_t srcTimestamp) const;
+
+	unsigned int		channels;
+	unsigned int		flags;			//SOIL flags the texture was baked (and will be uploaded) with
+	GLenum				internalFormat;	//Either the same as pixelFormat, or a DXT format
+	GLenum				pixelFormat;
+	bool				compressed;
+	bool				fromCache;
+	float				loadTime;
+
+	std::vector<TextureLevel>	levels;
+
+	//The levels point into one of these, depending on whether the texture was baked or read from the cache
+	std::vector<unsigned char>	bakedData;
+	MappedFile					cacheFile;
+
+private:
+	TextureData(const TextureData&);
+	TextureData& operator=(const TextureData&);
+};
@@ -0,0 +1,252 @@
+#include "AssetManager.h"
+#include "NCLDebug.h"
+#include <nclgl\GameTimer.h>
+#include <nclgl\ResourceRegistry.h>
+#include <sstream>
+
+void Asset::Release()
+{
+	if (--m_RefCount == 0)
+		AssetManager::Instance()->DeleteAsset(this);
+}
+
+bool MeshAsset::Upload()
+{
+	m_Mesh = new OBJMesh();
+	m_Mesh->CreateFromDecoded(m_Decoded);
+	m_Decoded.Clear();
+	return true;
+}
+
+bool MD5Asset::Decode()
+{
+	m_Data = MD5FileData::Decode(m_Filename);
+	if (m_Data == NULL)
+		return false;
+
+	//Animations don't need OpenGL either, so get loaded here too
+	for (const std::string& anim : m_Anims)
+		m_Data->AddAnim(anim);
+	return true;
+}
+
+TextureAsset::~TextureAsset()
+{
+	if (m_Pixels)
+		SOIL_free_image_data(m_Pixels);
+
+	if (m_Texture && !ResourceRegistry::ReleaseTexture(m_Texture))
+		glDeleteTextures(1, &m_Texture);
+}
+
+bool TextureAsset::Decode()
+{
+	if (TextureData::CanBake(m_Flags))
+		return m_Data.Load(m_Filename, m_Flags);
+
+	//Note: SOIL keeps the reason for the last failure in a global, so it may be muddled up if two loads fail at once
+	m_Pixels = SOIL_load_image(m_Filename.c_str(), &m_Width, &m_Height, &m_Channels, SOIL_LOAD_AUTO);
+	return m_Pixels != NULL;
+}
+
+bool TextureAsset::Upload()
+{
+	if (m_Data.IsLoaded())
+	{
+		//Shared with any other texture loaded from the same file (or with the same contents)
+		m_Texture = ResourceRegistry::AcquireTexture(m_Filename, m_Flags, m_Data);
+		m_Data.Clear();
+		return m_Texture != 0;
+	}
+
+	//Any mipmap generation/compression requested by the flags is done here by SOIL (which doesn't know our own flags)
+	m_Texture = SOIL_create_OGL_texture(m_Pixels, m_Width, m_Height, m_Channels, SOIL_CREATE_NEW_ID, m_Flags & ~TEXTURE_FLAG_NEAREST);
+	if (m_Texture && (m_Flags & TEXTURE_FLAG_NEAREST))
+	{
+		glBindTexture(GL_TEXTURE_2D, m_Texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (m_Flags & SOIL_FLAG_MIPMAPS) ? GL_NEAREST_MIPMAP_NEAREST : GL_NEAREST);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	SOIL_free_image_data(m_Pixels);
+	m_Pixels = NULL;
+	return m_Texture != 0;
+}
+
+
+
+AssetManager::AssetManager()
+	: m_IsTerminating(false)
+	, m_NumLoading(0)
+	, m_LastUploadTime(0.0f)
+{
+	for (int i = 0; i < ASSETMANAGER_NUM_WORKER_THREADS; ++i)
+	{
+		m_Workers[i] = std::thread(&AssetManager::WorkerLoop, this);
+	}
+}
+
+AssetManager::~AssetManager()
+{
+	//Inform all worker threads that the program is closing, and wait for them to exit
+	{
+		std::lock_guard<std::mutex> lck(m_QueueMutex);
+		m_IsTerminating = true;
+	}
+	m_cvDecodeReady.notify_all();
+
+	for (int i = 0; i < ASSETMANAGER_NUM_WORKER_THREADS; ++i)
+	{
+		m_Workers[i].join();
+	}
+
+	//Anything left (still queued, or with handles that were never released) gets deleted here
+	m_DecodeQueue.clear();
+	m_UploadQueue.clear();
+	for (auto& entry : m_Assets)
+	{
+		delete entry.second;
+	}
+	m_Assets.clear();
+}
+
+MeshHandle AssetManager::LoadMesh(const std::string& filename)
+{
+	return MeshHandle((MeshAsset*)FindOrQueue("mesh:" + filename, [&]() -> Asset* {
+		return new MeshAsset(filename);
+	}));
+}
+
+MD5Handle AssetManager::LoadMD5(const std::string& filename, const std::vector<std::string>& anims)
+{
+	std::ostringstream key;
+	key << "md5:" << filename;
+	for (const std::string& anim : anims)
+		key << "|" << anim;
+
+	return MD5Handle((MD5Asset*)FindOrQueue(key.str(), [&]() -> Asset* {
+		return new MD5Asset(filename, anims);
+	}));
+}
+
+TextureHandle AssetManager::LoadTexture(const std::string& filename, uint soil_flags)
+{
+	std::ostringstream key;
+	key << "tex:" << soil_flags << ":" << filename;
+
+	return TextureHandle((TextureAsset*)FindOrQueue(key.str(), [&]() -> Asset* {
+		return new TextureAsset(filename, soil_flags);
+	}));
+}
+
+Asset* AssetManager::FindOrQueue(const std::string& key, const std::function<Asset*()>& create_asset)
+{
+	auto itr = m_Assets.find(key);
+	if (itr != m_Assets.end())
+		return itr->second;
+
+	Asset* asset = create_asset();
+	asset->m_Key = key;
+	m_Assets[key] = asset;
+
+	//The queues hold their own reference, so the asset can't be deleted while it's still being loaded
+	asset->AddRef();
+	++m_NumLoading;
+	{
+		std::lock_guard<std::mutex> lck(m_QueueMutex);
+		m_DecodeQueue.push_back(asset);
+	}
+	m_cvDecodeReady.notify_one();
+
+	return asset;
+}
+
+void AssetManager::Update(float budget_ms)
+{
+	GameTimer timer;
+	for (;;)
+	{
+		Asset* asset;
+		{
+			std::lock_guard<std::mutex> lck(m_QueueMutex);
+			if (m_UploadQueue.empty())
+				break;
+
+			asset = m_UploadQueue.front();
+			m_UploadQueue.pop_front();
+		}
+
+		FinishAsset(asset);
+
+		if (timer.GetMS() >= budget_ms)
+			break;
+	}
+	m_LastUploadTime = timer.GetMS();
+}
+
+void AssetManager::WaitFor(const Asset* asset)
+{
+	while (asset->GetState() < ASSET_READY)
+	{
+		Asset* next;
+		{
+			std::unique_lock<std::mutex> lck(m_QueueMutex);
+			m_cvUploadReady.wait(lck, [this] { return !m_UploadQueue.empty(); });
+
+			next = m_UploadQueue.front();
+			m_UploadQueue.pop_front();
+		}
+
+		FinishAsset(next);
+	}
+}
+
+void AssetManager::FinishAsset(Asset* asset)
+{
+	if (asset->m_State == ASSET_DECODED && asset->Upload())
+	{
+		asset->m_State = ASSET_READY;
+	}
+	else
+	{
+		asset->m_State = ASSET_FAILED;
+		NCLERROR("Unable to load asset: %s", asset->m_Filename.c_str());
+	}
+
+	--m_NumLoading;
+	asset->Release();
+}
+
+void AssetManager::DeleteAsset(Asset* asset)
+{
+	m_Assets.erase(asset->m_Key);
+	delete asset;
+}
+
+void AssetManager::WorkerLoop()
+{
+	for (;;)
+	{
+		Asset* asset;
+		{
+			std::unique_lock<std::mutex> lck(m_QueueMutex);
+			m_cvDecodeReady.wait(lck, [this] { return m_IsTerminating || !m_DecodeQueue.empty(); });
+
+			if (m_IsTerminating)
+				return;
+
+			asset = m_DecodeQueue.front();
+			m_DecodeQueue.pop_front();
+		}
+
+		//Failures are still passed on to the main thread, so they can be reported (and the queue's reference released)
+		asset->m_State = asset->Decode() ? ASSET_DECODED : ASSET_FAILED;
+
+		{
+			std::lock_guard<std::mutex> lck(m_QueueMutex);
+			m_UploadQueue.push_back(asset);
+		}
+		m_cvUploadReady.notify_one();
+	}
+}
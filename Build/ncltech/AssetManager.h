@@ -0,0 +1,243 @@
+/******************************************************************************
+Class: AssetManager
+Implements: TSingleton
+Author: Pieran Marris <p.marris@newcastle.ac.uk>
+Description:
+Loads OBJ meshes, MD5 meshes (along with their animations) and textures in the
+background, so the program can keep rendering while they load.
+
+Loading an asset happens in two stages:-
+	1. Decode	[Worker Thread]	- Reading and parsing the file (OBJ parsing or reading it's cache, MD5 compiling,
+								  image decoding and baking). This never touches OpenGL, so can be tested without a context.
+	2. Upload	[Main Thread]	- Creating the OpenGL buffers/textures from the decoded data. This is done in Update(),
+								  which stops once it has used up it's time budget for the frame, leaving the rest
+								  of the decoded assets for the next frame.
+
+Requesting the same file again returns the asset that is already loaded (or loading), which is shared
+between all of the handles pointing to it and deleted once the last handle lets go of it. Handles should
+only be created, copied and released on the main thread.
+
+Scenes can list the assets they need with Scene::RequireAsset, and the SceneManager will keep running
+the current scene until they have all loaded before switching to it.
+
+
+		(\_/)
+		( '_')
+	 /""""""""""""\=========     -----D
+	/"""""""""""""""""""""""\
+....\_@____@____@____@____@_/
+
+*//////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <nclgl\OBJMesh.h>
+#include <nclgl\MD5FileData.h>
+#include <nclgl\TextureData.h>
+#include "TSingleton.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+
+//Number of background threads decoding assets
+#define ASSETMANAGER_NUM_WORKER_THREADS		2
+
+//Default time (in milliseconds) spent each frame uploading decoded assets to the graphics card
+#define ASSETMANAGER_DEFAULT_UPLOAD_BUDGET	2.0f
+
+enum AssetState
+{
+	ASSET_LOADING	= 0,	//Waiting for (or being decoded by) a worker thread
+	ASSET_DECODED	= 1,	//Waiting to be uploaded on the main thread
+	ASSET_READY		= 2,
+	ASSET_FAILED	= 3
+};
+
+class Asset
+{
+	friend class AssetManager;
+
+public:
+	const std::string&	GetFilename()	const	{ return m_Filename; }
+	AssetState			GetState()		const	{ return m_State; }
+	bool				IsReady()		const	{ return m_State == ASSET_READY; }
+	bool				IsDone()		const	{ return m_State >= ASSET_READY; }	//Either ready or failed to load
+
+	//Reference counting used by AssetHandle, the asset is deleted when the last reference is released
+	void				AddRef()				{ ++m_RefCount; }
+	void				Release();
+
+protected:
+	Asset(const std::string& filename) : m_Filename(filename), m_State(ASSET_LOADING), m_RefCount(0) {}
+	virtual ~Asset() {}
+
+	virtual bool		Decode() = 0;	//Called on a worker thread - must not use OpenGL
+	virtual bool		Upload() = 0;	//Called on the main thread
+
+protected:
+	std::string				m_Filename;
+	std::string				m_Key;			//Key in the AssetManager's map of assets
+	std::atomic<AssetState>	m_State;
+	int						m_RefCount;
+};
+
+//OBJ file, with any submeshes added as children of the root mesh
+class MeshAsset : public Asset
+{
+public:
+	MeshAsset(const std::string& filename) : Asset(filename), m_Mesh(NULL) {}
+	virtual ~MeshAsset()		{ delete m_Mesh; }
+
+	OBJMesh*		GetMesh() const		{ return m_Mesh; }
+
+protected:
+	virtual bool	Decode() override	{ return OBJMesh::DecodeOBJMesh(m_Filename, true, m_Decoded); }
+	virtual bool	Upload() override;
+
+	OBJDecodedMesh	m_Decoded;
+	OBJMesh*		m_Mesh;
+};
+
+//MD5Mesh file, along with the animations requested with it
+class MD5Asset : public Asset
+{
+public:
+	MD5Asset(const std::string& filename, const std::vector<std::string>& anims) : Asset(filename), m_Anims(anims), m_Data(NULL) {}
+	virtual ~MD5Asset()			{ delete m_Data; }
+
+	MD5FileData*	GetData() const		{ return m_Data; }
+
+protected:
+	virtual bool	Decode() override;
+	virtual bool	Upload() override	{ m_Data->Upload(); return m_Data->IsUploaded(); }
+
+	std::vector<std::string>	m_Anims;
+	MD5FileData*				m_Data;
+};
+
+//Any image file SOIL can load, uploaded with the given SOIL flags
+// - Mipmaps/DXT compression are baked on the worker thread (and cached, see TextureData) where the flags allow it
+class TextureAsset : public Asset
+{
+public:
+	TextureAsset(const std::string& filename, uint soil_flags)
+		: Asset(filename), m_Flags(soil_flags), m_Pixels(NULL), m_Width(0), m_Height(0), m_Channels(0), m_Texture(0) {}
+	virtual ~TextureAsset();
+
+	GLuint			GetTexture() const	{ return m_Texture; }
+
+protected:
+	virtual bool	Decode() override;
+	virtual bool	Upload() override;
+
+	uint			m_Flags;
+	TextureData		m_Data;
+
+	//Raw image, only used if the flags ask for something TextureData can't bake
+	unsigned char*	m_Pixels;
+	int				m_Width, m_Height, m_Channels;
+
+	GLuint			m_Texture;
+};
+
+
+
+//Shared reference to an asset, keeping it alive until all handles to it are released
+template <class T>
+class AssetHandle
+{
+public:
+	AssetHandle() : m_Asset(NULL) {}
+	AssetHandle(T* asset) : m_Asset(asset)					{ if (m_Asset) m_Asset->AddRef(); }
+	AssetHandle(const AssetHandle& other) : m_Asset(other.m_Asset)	{ if (m_Asset) m_Asset->AddRef(); }
+	~AssetHandle()											{ Reset(); }
+
+	AssetHandle& operator=(const AssetHandle& other)
+	{
+		if (other.m_Asset) other.m_Asset->AddRef();
+		Reset();
+		m_Asset = other.m_Asset;
+		return *this;
+	}
+
+	void Reset()
+	{
+		if (m_Asset)
+		{
+			m_Asset->Release();
+			m_Asset = NULL;
+		}
+	}
+
+	T*		Get()			const { return m_Asset; }
+	T*		operator->()	const { return m_Asset; }
+	bool	IsValid()		const { return m_Asset != NULL; }
+	bool	IsReady()		const { return m_Asset != NULL && m_Asset->IsReady(); }
+
+protected:
+	T* m_Asset;
+};
+
+typedef AssetHandle<MeshAsset>		MeshHandle;
+typedef AssetHandle<MD5Asset>		MD5Handle;
+typedef AssetHandle<TextureAsset>	TextureHandle;
+
+
+
+class AssetManager : public TSingleton<AssetManager>
+{
+	friend class TSingleton<AssetManager>;
+	friend class Asset;
+
+public:
+	//Start loading the given files in the background (or return them if they are already loaded/loading)
+	MeshHandle		LoadMesh(const std::string& filename);
+	MD5Handle		LoadMD5(const std::string& filename, const std::vector<std::string>& anims = std::vector<std::string>());
+	TextureHandle	LoadTexture(const std::string& filename, uint soil_flags = SOIL_FLAG_MIPMAPS);
+
+	//Uploads decoded assets until 'budget_ms' has passed (always uploading at least one if any are waiting)
+	// - Called once per frame on the main thread by the SceneManager
+	void	Update(float budget_ms = ASSETMANAGER_DEFAULT_UPLOAD_BUDGET);
+
+	//Blocks until the given asset has finished loading, uploading anything else that is decoded in the meantime
+	void	WaitFor(const Asset* asset);
+
+	//Number of assets still being decoded or waiting to be uploaded
+	uint	GetNumLoading() const	{ return m_NumLoading; }
+
+	//Time spent uploading assets during the last call to Update
+	float	GetLastUploadTime() const { return m_LastUploadTime; }
+
+protected:
+	AssetManager();
+	virtual ~AssetManager();
+
+	//Returns the existing asset with the given key, or adds the new one and queues it for loading
+	Asset*	FindOrQueue(const std::string& key, const std::function<Asset*()>& create_asset);
+
+	//Uploads (or reports the failure of) a single decoded asset
+	void	FinishAsset(Asset* asset);
+
+	//Called when the last reference to an asset has been released
+	void	DeleteAsset(Asset* asset);
+
+	void	WorkerLoop();
+
+protected:
+	std::thread				m_Workers[ASSETMANAGER_NUM_WORKER_THREADS];
+	bool					m_IsTerminating;
+
+	//Assets waiting to be decoded, and those decoded and waiting to be uploaded
+	std::mutex				m_QueueMutex;
+	std::condition_variable	m_cvDecodeReady;
+	std::condition_variable	m_cvUploadReady;
+	std::deque<Asset*>		m_DecodeQueue;
+	std::deque<Asset*>		m_UploadQueue;
+
+	//All assets currently loaded (or loading), only used on the main thread
+	std::unordered_map<std::string, Asset*> m_Assets;
+	uint					m_NumLoading;
+	float					m_LastUploadTime;
+};
@@ -0,0 +1,45 @@
+
+#pragma once
+
+#include "Constraint.h"
+#include "NCLDebug.h"
+
+//Pins a point on objA to a point on objB, leaving all three rotational degrees of freedom free
+// - Used for ragdoll shoulders/hips and chain links
+class BallSocketConstraint : public Constraint
+{
+public:
+	BallSocketConstraint(PhysicsObject* objA, PhysicsObject* objB, const Vector3& globalPivot)
+	{
+		this->objA = objA;
+		this->objB = objB;
+
+		localOnA = Matrix3::Transpose(objA->GetOrientation().ToMatrix3()) * (globalPivot - objA->GetPosition());
+		localOnB = Matrix3::Transpose(objB->GetOrientation().ToMatrix3()) * (globalPivot - objB->GetPosition());
+	}
+
+	virtual void BuildJacobianRows(float dt, ConstraintRowBuffer& rows) override
+	{
+		Vector3 r1 = objA->GetOrientation().ToMatrix3() * localOnA;
+		Vector3 r2 = objB->GetOrientation().ToMatrix3() * localOnB;
+
+		Vector3 ab = (objB->GetPosition() + r2) - (objA->GetPosition() + r1);
+
+		AddLinearRow(rows, objA, objB, r1, r2, Vector3(1.0f, 0.0f, 0.0f), ab.x, dt);
+		AddLinearRow(rows, objA, objB, r1, r2, Vector3(0.0f, 1.0f, 0.0f), ab.y, dt);
+		AddLinearRow(rows, objA, objB, r1, r2, Vector3(0.0f, 0.0f, 1.0f), ab.z, dt);
+	}
+
+	virtual void DebugDraw() const override
+	{
+		Vector3 globalOnA = objA->GetOrientation().ToMatrix3() * localOnA + objA->GetPosition();
+		Vector3 globalOnB = objB->GetOrientation().ToMatrix3() * localOnB + objB->GetPosition();
+
+		NCLDebug::DrawThickLine(objA->GetPosition(), globalOnA, 0.02f, Vector4(0.0f, 0.0f, 0.0f, 1.0f));
+		NCLDebug::DrawThickLine(objB->GetPosition(), globalOnB, 0.02f, Vector4(0.0f, 0.0f, 0.0f, 1.0f));
+		NCLDebug::DrawPointNDT(globalOnA, 0.05f, Vector4(1.0f, 0.8f, 1.0f, 1.0f));
+	}
+
+protected:
+	Vector3 localOnA, localOnB;
+};
\ No newline at end of file
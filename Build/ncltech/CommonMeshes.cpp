@@ -1,31 +1,55 @@
 #include "CommonMeshes.h"
-#include <nclgl\OBJMesh.h>
 
 Mesh* CommonMeshes::m_pPlane	= NULL;
 Mesh* CommonMeshes::m_pCube		= NULL;
 Mesh* CommonMeshes::m_pSphere	= NULL;
+Mesh* CommonMeshes::m_pSphereLODs[COMMONMESHES_NUM_SPHERE_LODS] = { NULL };
+
+//sphere.obj has 528 triangles, the LODs have 192, 96 and 48
+const float CommonMeshes::m_SphereLODScreenSizes[COMMONMESHES_NUM_SPHERE_LODS] = { 0.1f, 0.04f, 0.015f };
+static const uint g_SphereLODSlices[COMMONMESHES_NUM_SPHERE_LODS] = { 12, 8, 6 };
+static const uint g_SphereLODStacks[COMMONMESHES_NUM_SPHERE_LODS] = { 8, 6, 4 };
 
 GLuint CommonMeshes::m_CheckerboardTex = 0;
 
+MeshHandle		CommonMeshes::m_CubeAsset;
+MeshHandle		CommonMeshes::m_SphereAsset;
+TextureHandle	CommonMeshes::m_CheckerboardAsset;
+
 void CommonMeshes::InitializeMeshes()
 {
 	if (m_pPlane == NULL)
 	{
-		m_CheckerboardTex = SOIL_load_OGL_texture(TEXTUREDIR"checkerboard.tga", SOIL_LOAD_AUTO, SOIL_CREATE_NEW_ID, SOIL_FLAG_MIPMAPS | SOIL_FLAG_NTSC_SAFE_RGB | SOIL_FLAG_COMPRESS_TO_DXT);
-		glBindTexture(GL_TEXTURE_2D, m_CheckerboardTex);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST); //No linear interpolation to get crisp checkerboard no matter the scalling
-		glBindTexture(GL_TEXTURE_2D, 0);
+		//Everything is requested first so it all loads at once, and then we wait for it as it's needed straight away
+		//No filtering, to get a crisp checkerboard no matter the scaling. These are part of what it's shared by, so it mustn't be changed afterwards
+		m_CheckerboardAsset = AssetManager::Instance()->LoadTexture(TEXTUREDIR"checkerboard.tga",
+			SOIL_FLAG_MIPMAPS | SOIL_FLAG_NTSC_SAFE_RGB | SOIL_FLAG_COMPRESS_TO_DXT | SOIL_FLAG_TEXTURE_REPEATS | TEXTURE_FLAG_NEAREST);
+		m_CubeAsset = AssetManager::Instance()->LoadMesh(MESHDIR"cube.obj");
+		m_SphereAsset = AssetManager::Instance()->LoadMesh(MESHDIR"sphere.obj");
 
 		m_pPlane = Mesh::GenerateQuadTexCoordCol(Vector2(1.f, 1.f), Vector2(0.0f, 1.0f), Vector4(1.0f, 1.0f, 1.0f, 1.0f));
-		m_pCube = new OBJMesh(MESHDIR"cube.obj");
-		m_pSphere = new OBJMesh(MESHDIR"sphere.obj");
 
-		m_pPlane->SetTexture(m_CheckerboardTex);
-		m_pCube->SetTexture(m_CheckerboardTex);
-		m_pSphere->SetTexture(m_CheckerboardTex);
+		AssetManager::Instance()->WaitFor(m_CheckerboardAsset.Get());
+		AssetManager::Instance()->WaitFor(m_CubeAsset.Get());
+		AssetManager::Instance()->WaitFor(m_SphereAsset.Get());
+
+		//Anything that failed to load (already reported by the AssetManager) is replaced, so the meshes are never NULL
+		// - An empty mesh for the cube (as OBJMesh used to give when it's file was missing), a generated sphere and no texture
+		m_CheckerboardTex = m_CheckerboardAsset.IsReady() ? m_CheckerboardAsset->GetTexture() : 0;
+
+		m_pCube = m_CubeAsset.IsReady() ? m_CubeAsset->GetMesh() : new OBJMesh();
+		m_pSphere = m_SphereAsset.IsReady() ? m_SphereAsset->GetMesh() : Mesh::GenerateSphere(16, 12);
+
+		//Each mesh holds it's own reference to the checkerboard (releasing the texture from the cube/sphere's .mtl file)
+		m_pPlane->ShareTexture(m_CheckerboardTex);
+		m_pCube->ShareTexture(m_CheckerboardTex);
+		m_pSphere->ShareTexture(m_CheckerboardTex);
+
+		for (uint i = 0; i < COMMONMESHES_NUM_SPHERE_LODS; ++i)
+		{
+			m_pSphereLODs[i] = Mesh::GenerateSphere(g_SphereLODSlices[i], g_SphereLODStacks[i]);
+			m_pSphereLODs[i]->ShareTexture(m_CheckerboardTex);
+		}
 	}
 }
 
@@ -33,10 +57,23 @@ void CommonMeshes::ReleaseMeshes()
 {
 	if (m_pPlane != NULL)
 	{
-		glDeleteTextures(1, &m_CheckerboardTex);
+		//Each mesh releases it's own reference to the checkerboard
 		delete m_pPlane;
-		delete m_pCube;
-		delete m_pSphere;
+		if (!m_CubeAsset.IsReady())		delete m_pCube;
+		if (!m_SphereAsset.IsReady())	delete m_pSphere;
+		m_CubeAsset.Reset();
+		m_SphereAsset.Reset();
+		m_pCube = NULL;
+		m_pSphere = NULL;
+
+		for (uint i = 0; i < COMMONMESHES_NUM_SPHERE_LODS; ++i)
+		{
+			delete m_pSphereLODs[i];
+			m_pSphereLODs[i] = NULL;
+		}
+
+		m_CheckerboardAsset.Reset();
+		m_CheckerboardTex = 0;
 	}
 
 	m_pPlane = NULL;
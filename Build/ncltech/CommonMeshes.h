@@ -22,9 +22,13 @@ false in order to prevent them being deleted when the ObjectMesh instance is del
 
 #pragma once
 #include <nclgl\Mesh.h>
+#include "AssetManager.h"
 
 class Scene;
 
+//Number of lower detail versions of the sphere mesh
+#define COMMONMESHES_NUM_SPHERE_LODS 3
+
 class CommonMeshes
 {
 	friend class SceneRenderer; //Initializes/Destroys the given meshes within it's own lifecycle
@@ -40,6 +44,10 @@ public:
 	//Sphere
 	static Mesh* Sphere()			{ return m_pSphere; }
 
+	//Lower detail spheres, along with the fraction of the screen height below which they should be used (see ObjectMesh::AddLODMesh)
+	static Mesh* SphereLOD(uint lod)			{ return m_pSphereLODs[lod]; }
+	static float SphereLODScreenSize(uint lod)	{ return m_SphereLODScreenSizes[lod]; }
+
 
 
 	//PhysicsEngine Checkerboard - Hidden here for reasons of laziness
@@ -52,9 +60,16 @@ protected:
 	static void ReleaseMeshes();
 
 protected:
+	//Cube, sphere and checkerboard are loaded through the AssetManager, so they decode in parallel
+	static MeshHandle		m_CubeAsset;
+	static MeshHandle		m_SphereAsset;
+	static TextureHandle	m_CheckerboardAsset;
+
 	static Mesh* m_pCube;
 	static Mesh* m_pSphere;
 	static Mesh* m_pPlane;
+	static Mesh* m_pSphereLODs[COMMONMESHES_NUM_SPHERE_LODS];
+	static const float m_SphereLODScreenSizes[COMMONMESHES_NUM_SPHERE_LODS];
 
 
 	static GLuint m_CheckerboardTex;
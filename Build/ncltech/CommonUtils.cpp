@@ -38,6 +38,10 @@ Object* CommonUtils::BuildSphereObject(
 		: new ObjectMesh(name);
 
 	sphere->SetMesh(CommonMeshes::Sphere(), false);
+	for (uint i = 0; i < COMMONMESHES_NUM_SPHERE_LODS; ++i)
+	{
+		sphere->AddLODMesh(CommonMeshes::SphereLOD(i), CommonMeshes::SphereLODScreenSize(i), false);
+	}
 	sphere->SetTexture(CommonMeshes::CheckerboardTex(), false);
 	sphere->SetLocalTransform(Matrix4::Scale(Vector3(radius, radius, radius)));
 	sphere->SetColour(color);
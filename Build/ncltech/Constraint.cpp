@@ -1,65 +1,93 @@
-/*#include "Constraint.h"
+#include "Constraint.h"
 
-Constraint::Constraint() {
-	this->objA = NULL;
-	this->objB = NULL;
+#define BAUMGARTE_SCALAR 0.1f
 
-	this->b = 0.0f;
+ConstraintRow::ConstraintRow(PhysicsObject* objA, PhysicsObject* objB,
+	const Vector3& j1, const Vector3& j2, const Vector3& j3, const Vector3& j4, float b)
+	: objA(objA)
+	, objB(objB)
+	, j1(j1), j2(j2), j3(j3), j4(j4)
+	, b(b)
+	, effectiveMass(0.0f)
+	, impulseSum(0.0f)
+	, impulseSumMin(-FLT_MAX)
+	, impulseSumMax(FLT_MAX)
+{
+}
+
+void ConstraintRow::PreSolverStep()
+{
+	mj1 = j1 * objA->GetInverseMass();
+	mj2 = objA->GetInverseInertia() * j2;
+	mj3 = j3 * objB->GetInverseMass();
+	mj4 = objB->GetInverseInertia() * j4;
+
+	//J * M(-1) * J(t)
+	float constraint_mass = Vector3::Dot(j1, mj1)
+		+ Vector3::Dot(j2, mj2)
+		+ Vector3::Dot(j3, mj3)
+		+ Vector3::Dot(j4, mj4);
 
-	delta = 0.0f;
-	softness = 0.0f;
+	effectiveMass = (constraint_mass > 0.00001f) ? 1.0f / constraint_mass : 0.0f;
 	impulseSum = 0.0f;
-	impulseSumMin = -FLT_MAX;
-	impulseSumMax = FLT_MAX;
 }
 
-Constraint::Constraint(PhysicsObject* objA, PhysicsObject* objB,
-	Vector3 j1, Vector3 j2, Vector3 j3, Vector3 j4, float b) {
-	this->objA = objA;
-	this->objB = objB;
+void ConstraintRow::ApplyImpulse()
+{
+	if (effectiveMass == 0.0f)
+		return;
 
-	this->j1 = j1;
-	this->j2 = j2;
-	this->j3 = j3;
-	this->j4 = j4;
-	this->b = b;
+	//JV
+	float jv = Vector3::Dot(j1, objA->GetLinearVelocity())
+		+ Vector3::Dot(j2, objA->GetAngularVelocity())
+		+ Vector3::Dot(j3, objB->GetLinearVelocity())
+		+ Vector3::Dot(j4, objB->GetAngularVelocity());
 
-	delta = 0.0f;
-	softness = 0.0f;
-	impulseSum = 0.0f;
-	impulseSumMin = -FLT_MAX;
-	impulseSumMax = FLT_MAX;
+	float delta = -(jv + b) * effectiveMass;
+
+	float oldImpulseSum = impulseSum;
+	impulseSum = min(max(impulseSum + delta, impulseSumMin), impulseSumMax);
+	float realDelta = impulseSum - oldImpulseSum;
+
+	objA->SetLinearVelocity(objA->GetLinearVelocity() + mj1 * realDelta);
+	objA->SetAngularVelocity(objA->GetAngularVelocity() + mj2 * realDelta);
+	objB->SetLinearVelocity(objB->GetLinearVelocity() + mj3 * realDelta);
+	objB->SetAngularVelocity(objB->GetAngularVelocity() + mj4 * realDelta);
+}
+
+
+
+void Constraint::ComputeTangentBasis(const Vector3& axis, Vector3& t1, Vector3& t2)
+{
+	//Pick whichever world axis is least aligned with the given axis to avoid a degenerate cross product
+	if (abs(axis.x) < 0.57735f)
+		t1 = Vector3::Cross(axis, Vector3(1.0f, 0.0f, 0.0f));
+	else
+		t1 = Vector3::Cross(axis, Vector3(0.0f, 1.0f, 0.0f));
+
+	t1.Normalise();
+	t2 = Vector3::Cross(axis, t1);
 }
 
-void Constraint::ApplyImpulse()
+void Constraint::AddLinearRow(ConstraintRowBuffer& rows, PhysicsObject* objA, PhysicsObject* objB,
+	const Vector3& rA, const Vector3& rB, const Vector3& axis, float error, float dt)
 {
-	delta = 0.0f;
+	//Baumgarte Offset (Adds energy to the system to counter slight solving errors that accumulate over time - known as 'constraint drift')
+	float b = (BAUMGARTE_SCALAR / dt) * error;
 
-	//J * M(-1) * J(t)
-	float contstraint_mass = objA->GetInverseMass() * Vector3::Dot(j1, j1)
-		+ Vector3::Dot(j2, (objA->GetInverseInertia() * j2))
-		+ objB->GetInverseMass() * Vector3::Dot(j3, j3)
-		+ Vector3::Dot(j4, (objB->GetInverseInertia() * j4))
-		+ softness;
-
-	if (contstraint_mass > 0.00001f)
-	{
-		//JV
-		float jv = Vector3::Dot(j1, objA->GetLinearVelocity())
-			+ Vector3::Dot(j2, objA->GetAngularVelocity())
-			+ Vector3::Dot(j3, objB->GetLinearVelocity())
-			+ Vector3::Dot(j4, objB->GetAngularVelocity());
-
-		float denom = -(jv + b);
-		delta = denom / contstraint_mass;
-
-		float oldImpulseSum = impulseSum;
-		impulseSum = min(max(impulseSum + delta, impulseSumMin), impulseSumMax);
-		float realDelta = impulseSum - oldImpulseSum;
-
-		objA->SetLinearVelocity(objA->GetLinearVelocity() + (j1 * realDelta) * objA->GetInverseMass());
-		objA->SetAngularVelocity(objA->GetAngularVelocity() + objA->GetInverseInertia() * (j2 * realDelta));
-		objB->SetLinearVelocity(objB->GetLinearVelocity() + (j3 * realDelta) * objB->GetInverseMass());
-		objB->SetAngularVelocity(objB->GetAngularVelocity() + objB->GetInverseInertia() * (j4 * realDelta));
-	}
-}*/
\ No newline at end of file
+	rows.push_back(ConstraintRow(objA, objB,
+		-axis, -Vector3::Cross(rA, axis),
+		axis, Vector3::Cross(rB, axis),
+		b));
+}
+
+void Constraint::AddAngularRow(ConstraintRowBuffer& rows, PhysicsObject* objA, PhysicsObject* objB,
+	const Vector3& axis, float error, float dt)
+{
+	float b = (BAUMGARTE_SCALAR / dt) * error;
+
+	rows.push_back(ConstraintRow(objA, objB,
+		Vector3(0.0f, 0.0f, 0.0f), -axis,
+		Vector3(0.0f, 0.0f, 0.0f), axis,
+		b));
+}
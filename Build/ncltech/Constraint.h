@@ -1,14 +1,22 @@
 /******************************************************************************
 Class: Constraint
-Implements: 
+Implements:
 Author: Pieran Marris <p.marris@newcastle.ac.uk>
 Description:
-A generic template class to represent a linear constraint. 
+A generic template class to represent a linear constraint.
 
-A rigid body has 6 degrees of freedom: 3 positional and 3 rotational. A 
+A rigid body has 6 degrees of freedom: 3 positional and 3 rotational. A
 constraint in this sense is anything which acts to constrain the movement of that
 rigid body.
 
+Each constraint is broken down into one or more 'rows', each of which removes
+a single degree of freedom in the form of a Jacobian:
+	J = [ j1 (linear A), j2 (angular A), j3 (linear B), j4 (angular B) ]
+and solves the velocity constraint Jv + b = 0. Once per physics update every
+constraint appends it's rows to one contiguous buffer owned by the physics engine,
+the effective mass of each row is computed once, and then the solver iterations
+just loop over the packed rows rather than calling back into each constraint.
+
 		(\_/)
 		( '_')
 	 /""""""""""""\=========     -----D
@@ -19,20 +27,78 @@ rigid body.
 #pragma once
 #include "PhysicsObject.h"
 #include <nclgl\Vector3.h>
+#include <vector>
+
+struct ConstraintRow
+{
+	PhysicsObject* objA;
+	PhysicsObject* objB;
+
+	//Jacobian
+	Vector3 j1, j2, j3, j4;
+
+	//Inverse mass matrix multiplied by the jacobian (M^-1 * J^T) - computed in PreSolverStep
+	Vector3 mj1, mj2, mj3, mj4;
+
+	float	b;					//Bias term (baumgarte correction or motor target speed)
+	float	effectiveMass;		//1.0 / (J * M^-1 * J^T) - computed in PreSolverStep
+
+	float	impulseSum;
+	float	impulseSumMin;
+	float	impulseSumMax;
+
+
+	//Builds a bilateral row (impulse can push or pull)
+	ConstraintRow(PhysicsObject* objA, PhysicsObject* objB,
+		const Vector3& j1, const Vector3& j2, const Vector3& j3, const Vector3& j4, float b);
+
+	//Precomputes the effective mass - called once per physics update before any solver iterations
+	void PreSolverStep();
+
+	//Apply Delta Update
+	void ApplyImpulse();
+};
+
+typedef std::vector<ConstraintRow> ConstraintRowBuffer;
+
 
 class Constraint
 {
 public:
-	Constraint() {}
+	Constraint() : objA(NULL), objB(NULL) {}
+	virtual ~Constraint() {}
 
-	Constraint(PhysicsObject* objA, PhysicsObject* objB,
-		Vector3 j1, Vector3 j2, Vector3 j3, Vector3 j4, float b) {}
+	//The two objects being constrained
+	// - Destroying either object through the physics engine will also remove and delete the constraint
+	PhysicsObject* GetObjectA() const	{ return objA; }
+	PhysicsObject* GetObjectB() const	{ return objB; }
 
+	//Returns false while either object has been removed from the physics engine (e.g. despawned by the scene)
+	// - The constraint is kept, but not solved or drawn, until the object is added back again
+	bool IsActive() const				{ return (objA == NULL || objA->IsInPhysicsEngine()) && (objB == NULL || objB->IsInPhysicsEngine()); }
 
-	virtual void ApplyImpulse() = 0;	//Apply Delta Update
-	
+	//Called once per physics update, appends the jacobian rows required to solve this constraint to the given row buffer
+	// - Anything that changes over the course of a frame (e.g. the direction of a distance constraint) should be computed here
+	//   as the rows are then solved as-is for all solver iterations.
+	virtual void BuildJacobianRows(float dt, ConstraintRowBuffer& rows) = 0;
 
-	//Optional overridable functions, incase the constraint values change each frame (e.g distance constraint changes direction after each position update)
-	virtual void PreSolverStep(float dt) {}
 	virtual void DebugDraw() const {}
-};
\ No newline at end of file
+
+
+	//Helpers for building constraint rows
+
+	//Computes two unit vectors perpendicular to the given (normalised) axis and to each other
+	static void ComputeTangentBasis(const Vector3& axis, Vector3& t1, Vector3& t2);
+
+	//Adds a row constraining the two world space anchor points to have no relative velocity along the given axis
+	// - 'error' is the current positional error along the axis, which will be pushed towards zero by the baumgarte term
+	static void AddLinearRow(ConstraintRowBuffer& rows, PhysicsObject* objA, PhysicsObject* objB,
+		const Vector3& rA, const Vector3& rB, const Vector3& axis, float error, float dt);
+
+	//Adds a row constraining the two objects to have no relative angular velocity about the given axis
+	static void AddAngularRow(ConstraintRowBuffer& rows, PhysicsObject* objA, PhysicsObject* objB,
+		const Vector3& axis, float error, float dt);
+
+protected:
+	PhysicsObject *objA, *objB;
+};
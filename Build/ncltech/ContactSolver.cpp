@@ -0,0 +1,292 @@
+#include "ContactSolver.h"
+#include "Constraint.h"
+#include <xmmintrin.h>
+
+//Number of the most recently created batches to search for a free lane before starting a new batch
+// - Stops batching from becoming O(n^2) for large numbers of contacts, at the cost of slightly less full batches
+#define CONTACT_BATCH_SEARCH_WINDOW 8
+
+
+//SSE helpers - each Vec3x4 holds one three component vector for each of the four lanes
+struct Vec3x4
+{
+	__m128 x, y, z;
+};
+
+static inline Vec3x4 LoadVec3x4(const ContactLaneVec3& v)
+{
+	Vec3x4 out;
+	out.x = _mm_loadu_ps(v.x);
+	out.y = _mm_loadu_ps(v.y);
+	out.z = _mm_loadu_ps(v.z);
+	return out;
+}
+
+static inline __m128 DotVec3x4(const Vec3x4& a, const Vec3x4& b)
+{
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+}
+
+static inline void MulAddVec3x4(Vec3x4& out, const Vec3x4& v, const __m128& s)
+{
+	out.x = _mm_add_ps(out.x, _mm_mul_ps(v.x, s));
+	out.y = _mm_add_ps(out.y, _mm_mul_ps(v.y, s));
+	out.z = _mm_add_ps(out.z, _mm_mul_ps(v.z, s));
+}
+
+static inline void MulSubVec3x4(Vec3x4& out, const Vec3x4& v, const __m128& s)
+{
+	out.x = _mm_sub_ps(out.x, _mm_mul_ps(v.x, s));
+	out.y = _mm_sub_ps(out.y, _mm_mul_ps(v.y, s));
+	out.z = _mm_sub_ps(out.z, _mm_mul_ps(v.z, s));
+}
+
+//Gather/Scatter a velocity from each lane's physics object
+#define GATHER_VEC3(out, objs, getter) \
+	out.x = _mm_setr_ps(objs[0]->getter().x, objs[1]->getter().x, objs[2]->getter().x, objs[3]->getter().x); \
+	out.y = _mm_setr_ps(objs[0]->getter().y, objs[1]->getter().y, objs[2]->getter().y, objs[3]->getter().y); \
+	out.z = _mm_setr_ps(objs[0]->getter().z, objs[1]->getter().z, objs[2]->getter().z, objs[3]->getter().z);
+
+#define SCATTER_VEC3(in, objs, setter, num_lanes) \
+	{ \
+		float sx[4], sy[4], sz[4]; \
+		_mm_storeu_ps(sx, in.x); _mm_storeu_ps(sy, in.y); _mm_storeu_ps(sz, in.z); \
+		for (int lane = 0; lane < num_lanes; ++lane) \
+			objs[lane]->setter(Vector3(sx[lane], sy[lane], sz[lane])); \
+	}
+
+
+//Writes a single vector into the given lane
+static inline void SetLane(ContactLaneVec3& out, int lane, const Vector3& v)
+{
+	out.x[lane] = v.x;
+	out.y[lane] = v.y;
+	out.z[lane] = v.z;
+}
+
+//Fills in the given lane of a jacobian row, precomputing all of the inverse mass/inertia terms
+static inline void SetRowLane(ContactLaneRow& row, int lane, const Vector3& axis, const Vector3& r1, const Vector3& r2,
+	float invMassA, float invMassB, const Matrix3& invInertiaA, const Matrix3& invInertiaB, float bias)
+{
+	Vector3 angA = Vector3::Cross(r1, axis);
+	Vector3 angB = Vector3::Cross(r2, axis);
+	Vector3 invIAngA = invInertiaA * angA;
+	Vector3 invIAngB = invInertiaB * angB;
+
+	SetLane(row.axis, lane, axis);
+	SetLane(row.angA, lane, angA);
+	SetLane(row.angB, lane, angB);
+	SetLane(row.invIAngA, lane, invIAngA);
+	SetLane(row.invIAngB, lane, invIAngB);
+
+	float constraintMass = invMassA + invMassB + Vector3::Dot(angA, invIAngA) + Vector3::Dot(angB, invIAngB);
+	row.mass[lane] = (constraintMass > 0.00001f) ? 1.0f / constraintMass : 0.0f;
+	row.bias[lane] = bias;
+	row.impulse[lane] = 0.0f;
+}
+
+//Solves one jacobian row for all four lanes
+static inline void SolveRow(ContactLaneRow& row, Vec3x4& vA, Vec3x4& wA, Vec3x4& vB, Vec3x4& wB,
+	const __m128& invMassA, const __m128& invMassB, const __m128& impulseMin, const __m128& impulseMax)
+{
+	Vec3x4 axis = LoadVec3x4(row.axis);
+	Vec3x4 angA = LoadVec3x4(row.angA);
+	Vec3x4 angB = LoadVec3x4(row.angB);
+
+	//Relative velocity along the constraint axis (JV)
+	__m128 jv = _mm_sub_ps(DotVec3x4(axis, vB), DotVec3x4(axis, vA));
+	jv = _mm_add_ps(jv, _mm_sub_ps(DotVec3x4(angB, wB), DotVec3x4(angA, wA)));
+
+	__m128 lambda = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(row.bias), jv), _mm_loadu_ps(row.mass));
+
+	//Clamp the total impulse applied this physics update
+	__m128 oldImpulse = _mm_loadu_ps(row.impulse);
+	__m128 newImpulse = _mm_min_ps(_mm_max_ps(_mm_add_ps(oldImpulse, lambda), impulseMin), impulseMax);
+	_mm_storeu_ps(row.impulse, newImpulse);
+	lambda = _mm_sub_ps(newImpulse, oldImpulse);
+
+	MulSubVec3x4(vA, axis, _mm_mul_ps(lambda, invMassA));
+	MulAddVec3x4(vB, axis, _mm_mul_ps(lambda, invMassB));
+	MulSubVec3x4(wA, LoadVec3x4(row.invIAngA), lambda);
+	MulAddVec3x4(wB, LoadVec3x4(row.invIAngB), lambda);
+}
+
+
+
+ContactSolver::ContactSolver()
+	: m_NumContacts(0)
+{
+}
+
+ContactSolver::~ContactSolver()
+{
+	m_Batches.clear();
+}
+
+bool ContactSolver::IsStatic(const PhysicsObject* obj)
+{
+	return obj->GetInverseMass() == 0.0f
+		&& memcmp(&obj->GetInverseInertia(), &Matrix3::ZeroMatrix, sizeof(Matrix3)) == 0;
+}
+
+void ContactSolver::PreSolverStep(const std::vector<Manifold*>& manifolds, float dt)
+{
+	//Only cleared, so the batch memory is re-used each physics update
+	m_Batches.clear();
+	m_NumContacts = 0;
+
+	for (Manifold* m : manifolds)
+	{
+		for (const ContactPoint& contact : m->m_Contacts)
+		{
+			AddContact(m, contact, dt);
+		}
+	}
+}
+
+void ContactSolver::AddContact(Manifold* manifold, const ContactPoint& contact, float dt)
+{
+	PhysicsObject* objA = manifold->NodeA();
+	PhysicsObject* objB = manifold->NodeB();
+
+	if (objA->GetInverseMass() + objB->GetInverseMass() == 0.0f)
+		return;
+
+	PhysicsObject* lockA = IsStatic(objA) ? NULL : objA;
+	PhysicsObject* lockB = IsStatic(objB) ? NULL : objB;
+
+	//Find a recent batch with a free lane that doesn't already write to either of our objects
+	ContactBatch* batch = NULL;
+	size_t search_start = (m_Batches.size() > CONTACT_BATCH_SEARCH_WINDOW) ? m_Batches.size() - CONTACT_BATCH_SEARCH_WINDOW : 0;
+	for (size_t i = search_start; i < m_Batches.size() && batch == NULL; ++i)
+	{
+		ContactBatch& candidate = m_Batches[i];
+		if (candidate.numLanes == CONTACT_SOLVER_LANES)
+			continue;
+
+		bool conflict = false;
+		for (int lane = 0; lane < candidate.numLanes && !conflict; ++lane)
+		{
+			PhysicsObject* usedA = candidate.lockA[lane];
+			PhysicsObject* usedB = candidate.lockB[lane];
+			conflict = (lockA != NULL && (lockA == usedA || lockA == usedB))
+					|| (lockB != NULL && (lockB == usedA || lockB == usedB));
+		}
+
+		if (!conflict)
+			batch = &candidate;
+	}
+
+	if (batch == NULL)
+	{
+		//Start a new batch, with all lanes defaulting to zero-mass placeholders that the solver will never move
+		m_Batches.push_back(ContactBatch());
+		batch = &m_Batches.back();
+		memset(batch, 0, sizeof(ContactBatch));
+		for (int lane = 0; lane < CONTACT_SOLVER_LANES; ++lane)
+		{
+			batch->objA[lane] = &m_EmptyLaneObject;
+			batch->objB[lane] = &m_EmptyLaneObject;
+		}
+	}
+
+	const int lane = batch->numLanes++;
+	batch->objA[lane] = objA;
+	batch->objB[lane] = objB;
+	batch->lockA[lane] = lockA;
+	batch->lockB[lane] = lockB;
+
+	const float invMassA = objA->GetInverseMass();
+	const float invMassB = objB->GetInverseMass();
+	batch->invMassA[lane] = invMassA;
+	batch->invMassB[lane] = invMassB;
+
+	//Same coefficient as Manifold::SolveContactPoint, shared out between all of the manifold's contacts
+	batch->friction[lane] = (objA->GetFriction() * objB->GetFriction()) / manifold->m_Contacts.size();
+
+	const Vector3& r1 = contact.relPosA;
+	const Vector3& r2 = contact.relPosB;
+	const Vector3& normal = contact.collisionNormal;
+
+
+	//Target seperating velocity - identical to Manifold::SolveContactPoint, but as none of it changes between solver iterations it is only computed once
+	// - Baumgarte offset to push the objects apart if penetrating beyond the allowed slop
+	// - Elasticity term (computed in Manifold::PreSolverStep) if the objects should bounce
+	float bias;
+	{
+		const float baumgarte_scalar = 0.1f;
+		const float baumgarte_slop = 0.02f;
+		float penetration_slop = min(contact.collisionPenetration + baumgarte_slop, 0.0f);
+		float b = -(baumgarte_scalar / dt) * penetration_slop;
+		bias = max(b, contact.elatisity_term + b * 0.2f);
+	}
+
+	SetRowLane(batch->normal, lane, normal, r1, r2,
+		invMassA, invMassB, objA->GetInverseInertia(), objB->GetInverseInertia(), bias);
+
+
+	//Friction
+	// - Rather than recomputing the friction direction from the current velocities each iteration, two fixed directions
+	//   are chosen here. The first is aligned to the initial sliding direction (if there is any) so most of the friction
+	//   is resolved along a single axis.
+	Vector3 dv = objB->GetLinearVelocity() + Vector3::Cross(objB->GetAngularVelocity(), r2)
+		- objA->GetLinearVelocity() - Vector3::Cross(objA->GetAngularVelocity(), r1);
+
+	Vector3 t1 = dv - normal * Vector3::Dot(dv, normal);
+	Vector3 t2;
+	float tangent_len = t1.Length();
+	if (tangent_len > 0.001f)
+	{
+		t1 = t1 * (1.0f / tangent_len);
+		t2 = Vector3::Cross(normal, t1);
+	}
+	else
+	{
+		Constraint::ComputeTangentBasis(normal, t1, t2);
+	}
+
+	SetRowLane(batch->tangent1, lane, t1, r1, r2,
+		invMassA, invMassB, objA->GetInverseInertia(), objB->GetInverseInertia(), 0.0f);
+	SetRowLane(batch->tangent2, lane, t2, r1, r2,
+		invMassA, invMassB, objA->GetInverseInertia(), objB->GetInverseInertia(), 0.0f);
+
+	m_NumContacts++;
+}
+
+void ContactSolver::ApplyImpulses()
+{
+	for (ContactBatch& batch : m_Batches)
+	{
+		SolveBatch(batch);
+	}
+}
+
+void ContactSolver::SolveBatch(ContactBatch& batch)
+{
+	Vec3x4 vA, wA, vB, wB;
+	GATHER_VEC3(vA, batch.objA, GetLinearVelocity);
+	GATHER_VEC3(wA, batch.objA, GetAngularVelocity);
+	GATHER_VEC3(vB, batch.objB, GetLinearVelocity);
+	GATHER_VEC3(wB, batch.objB, GetAngularVelocity);
+
+	const __m128 invMassA = _mm_loadu_ps(batch.invMassA);
+	const __m128 invMassB = _mm_loadu_ps(batch.invMassB);
+	const __m128 zero = _mm_setzero_ps();
+
+	//Collision Resolution
+	// - Objects can only ever be pushed apart, so the total impulse must remain positive
+	SolveRow(batch.normal, vA, wA, vB, wB, invMassA, invMassB, zero, _mm_set1_ps(FLT_MAX));
+
+	//Friction
+	// - Total friction impulse in each direction is limited to the friction coefficient multiplied by the total normal impulse
+	__m128 maxFriction = _mm_mul_ps(_mm_loadu_ps(batch.friction), _mm_loadu_ps(batch.normal.impulse));
+	__m128 minFriction = _mm_sub_ps(zero, maxFriction);
+	SolveRow(batch.tangent1, vA, wA, vB, wB, invMassA, invMassB, minFriction, maxFriction);
+	SolveRow(batch.tangent2, vA, wA, vB, wB, invMassA, invMassB, minFriction, maxFriction);
+
+	//Write back the new velocities
+	SCATTER_VEC3(vA, batch.objA, SetLinearVelocity, batch.numLanes);
+	SCATTER_VEC3(wA, batch.objA, SetAngularVelocity, batch.numLanes);
+	SCATTER_VEC3(vB, batch.objB, SetLinearVelocity, batch.numLanes);
+	SCATTER_VEC3(wB, batch.objB, SetAngularVelocity, batch.numLanes);
+}
\ No newline at end of file
@@ -0,0 +1,102 @@
+/******************************************************************************
+Class: ContactSolver
+Implements:
+Author: Pieran Marris <p.marris@newcastle.ac.uk>
+Description:
+An alternative to solving each Manifold one contact at a time. All contact
+points for the current physics update are flattened into batches of four, where
+every contact in a batch acts on a different pair of dynamic bodies. This means
+the four contacts can be solved side by side using SSE instructions without
+any of them fighting over the same body's velocity.
+
+Everything that remains constant for the duration of the physics update
+(effective masses, friction directions, bias terms, friction coefficients) is
+computed once in PreSolverStep, so each solver iteration only has to gather the
+body velocities, solve and scatter them back out again.
+
+Static objects (zero inverse mass and inertia) are never written to, so they can
+safely appear in every lane of a batch - e.g. a pile of boxes on the ground.
+
+		(\_/)
+		( '_')
+	 /""""""""""""\=========     -----D
+	/"""""""""""""""""""""""\
+....\_@____@____@____@____@_/
+
+*//////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include "Manifold.h"
+#include <vector>
+
+#define CONTACT_SOLVER_LANES 4
+
+//Three component vectors for each lane, stored as seperate x, y, z arrays so they can be loaded straight into SSE registers
+struct ContactLaneVec3
+{
+	float x[CONTACT_SOLVER_LANES];
+	float y[CONTACT_SOLVER_LANES];
+	float z[CONTACT_SOLVER_LANES];
+};
+
+//A single jacobian row (normal or friction direction) for every lane
+struct ContactLaneRow
+{
+	ContactLaneVec3 axis;			//Linear jacobian (+ for objB, - for objA)
+	ContactLaneVec3 angA, angB;		//Angular jacobians (r x axis)
+	ContactLaneVec3 invIAngA;		//InvInertiaA * angA
+	ContactLaneVec3 invIAngB;		//InvInertiaB * angB
+
+	float mass[CONTACT_SOLVER_LANES];		//Effective mass (1 / J M^-1 J^T)
+	float bias[CONTACT_SOLVER_LANES];		//Target seperating velocity
+	float impulse[CONTACT_SOLVER_LANES];	//Accumulated impulse this physics update
+};
+
+struct ContactBatch
+{
+	int				numLanes;
+	PhysicsObject*	objA[CONTACT_SOLVER_LANES];
+	PhysicsObject*	objB[CONTACT_SOLVER_LANES];
+
+	//Dynamic objects written to by each lane (NULL if static), used to make sure no two lanes modify the same body
+	PhysicsObject*	lockA[CONTACT_SOLVER_LANES];
+	PhysicsObject*	lockB[CONTACT_SOLVER_LANES];
+
+	float invMassA[CONTACT_SOLVER_LANES];
+	float invMassB[CONTACT_SOLVER_LANES];
+	float friction[CONTACT_SOLVER_LANES];
+
+	ContactLaneRow normal;
+	ContactLaneRow tangent1;
+	ContactLaneRow tangent2;
+};
+
+
+class ContactSolver
+{
+public:
+	ContactSolver();
+	~ContactSolver();
+
+	//Builds contact batches for all contact points in the given manifolds
+	// - Must be called after each Manifold's own PreSolverStep, as that computes the elasticity terms
+	void PreSolverStep(const std::vector<Manifold*>& manifolds, float dt);
+
+	//Runs a single solver iteration over every contact batch
+	void ApplyImpulses();
+
+	size_t GetNumContacts()	const	{ return m_NumContacts; }
+	size_t GetNumBatches()	const	{ return m_Batches.size(); }
+
+protected:
+	void AddContact(Manifold* manifold, const ContactPoint& contact, float dt);
+	void SolveBatch(ContactBatch& batch);
+
+	static bool IsStatic(const PhysicsObject* obj);
+
+protected:
+	std::vector<ContactBatch> m_Batches;
+	size_t m_NumContacts;
+
+	//Used to fill any unused lanes in a batch, has zero mass so will never be affected by the solver
+	PhysicsObject m_EmptyLaneObject;
+};
\ No newline at end of file
@@ -24,11 +24,8 @@ public:
 		localOnB = Matrix3::Transpose(objB->GetOrientation().ToMatrix3()) * r2;
 	}
 
-	virtual void ApplyImpulse() override
+	virtual void BuildJacobianRows(float dt, ConstraintRowBuffer& rows) override
 	{
-		if (objA->GetInverseMass() + objB->GetInverseMass() == 0.0f)
-			return;
-
 		Vector3 r1 = objA->GetOrientation().ToMatrix3() * localOnA;
 		Vector3 r2 = objB->GetOrientation().ToMatrix3() * localOnB;
 
@@ -36,37 +33,12 @@ public:
 		Vector3 globalOnB = r2 + objB->GetPosition();
 
 		Vector3 ab = globalOnB - globalOnA;
-		Vector3 abn = ab;
-		abn.Normalise();
-
-
-
-		Vector3 v0 = objA->GetLinearVelocity() + Vector3::Cross(objA->GetAngularVelocity(), r1);
-		Vector3 v1 = objB->GetLinearVelocity() + Vector3::Cross(objB->GetAngularVelocity(), r2);
-		{
-			float constraintMass = (objA->GetInverseMass() + objB->GetInverseMass()) +
-				Vector3::Dot(abn,
-				Vector3::Cross(objA->GetInverseInertia()*Vector3::Cross(r1, abn), r1) +
-				Vector3::Cross(objB->GetInverseInertia()*Vector3::Cross(r2, abn), r2));
-
-			//Baumgarte Offset (Adds energy to the system to counter slight solving errors that accumulate over time - known as 'constraint drift')
-			float b = 0.0f;
-			{
-				float distance_offset = ab.Length() - distance;
-				float baumgarte_scalar = 0.1f;
-				b = -(baumgarte_scalar / PhysicsEngine::Instance()->GetDeltaTime()) * distance_offset;
-			}
-
-			float jn = -(Vector3::Dot(v0 - v1, abn) + b) / constraintMass;
-
-			objA->SetLinearVelocity(objA->GetLinearVelocity() + abn*(jn*objA->GetInverseMass()));
-			objB->SetLinearVelocity(objB->GetLinearVelocity() - abn*(jn*objB->GetInverseMass()));
-
-			objA->SetAngularVelocity(objA->GetAngularVelocity() + objA->GetInverseInertia()* Vector3::Cross(r1, abn * jn));
-			objB->SetAngularVelocity(objB->GetAngularVelocity() - objB->GetInverseInertia()* Vector3::Cross(r2, abn * jn));
-		}
-
+		float ab_len = ab.Length();
+		if (ab_len < 0.00001f)
+			return;
 
+		Vector3 abn = ab * (1.0f / ab_len);
+		AddLinearRow(rows, objA, objB, r1, r2, abn, ab_len - distance, dt);
 	}
 
 	virtual void DebugDraw() const
@@ -80,7 +52,6 @@ public:
 	}
 
 protected:
-	PhysicsObject *objA, *objB;
 	float   distance;
 	Vector3 localOnA, localOnB;
 };
\ No newline at end of file
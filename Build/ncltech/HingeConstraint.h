@@ -0,0 +1,100 @@
+
+#pragma once
+
+#include "Constraint.h"
+#include "NCLDebug.h"
+
+//Pins a point on objA to a point on objB and only allows rotation around a single shared axis
+// - Optionally drives the rotation with a motor, clamped to a maximum torque (e.g. wheels, doors, robot arms)
+class HingeConstraint : public Constraint
+{
+public:
+	HingeConstraint(PhysicsObject* objA, PhysicsObject* objB, const Vector3& globalPivot, const Vector3& globalAxis)
+		: motorEnabled(false)
+		, motorSpeed(0.0f)
+		, motorMaxTorque(0.0f)
+	{
+		this->objA = objA;
+		this->objB = objB;
+
+		Matrix3 invRotA = Matrix3::Transpose(objA->GetOrientation().ToMatrix3());
+		Matrix3 invRotB = Matrix3::Transpose(objB->GetOrientation().ToMatrix3());
+
+		Vector3 axis = globalAxis;
+		axis.Normalise();
+
+		localOnA = invRotA * (globalPivot - objA->GetPosition());
+		localOnB = invRotB * (globalPivot - objB->GetPosition());
+		localAxisA = invRotA * axis;
+		localAxisB = invRotB * axis;
+	}
+
+	//Drives objB to rotate relative to objA around the hinge axis at the given speed (radians per second)
+	void SetMotor(bool enabled, float speed = 0.0f, float max_torque = 0.0f)
+	{
+		motorEnabled = enabled;
+		motorSpeed = speed;
+		motorMaxTorque = max_torque;
+	}
+
+	virtual void BuildJacobianRows(float dt, ConstraintRowBuffer& rows) override
+	{
+		Matrix3 rotA = objA->GetOrientation().ToMatrix3();
+		Matrix3 rotB = objB->GetOrientation().ToMatrix3();
+
+		//Positional constraint (identical to a ball-socket)
+		Vector3 r1 = rotA * localOnA;
+		Vector3 r2 = rotB * localOnB;
+		Vector3 ab = (objB->GetPosition() + r2) - (objA->GetPosition() + r1);
+
+		AddLinearRow(rows, objA, objB, r1, r2, Vector3(1.0f, 0.0f, 0.0f), ab.x, dt);
+		AddLinearRow(rows, objA, objB, r1, r2, Vector3(0.0f, 1.0f, 0.0f), ab.y, dt);
+		AddLinearRow(rows, objA, objB, r1, r2, Vector3(0.0f, 0.0f, 1.0f), ab.z, dt);
+
+
+		//Rotational constraint
+		// - Stop all relative rotation about the two axes perpendicular to the hinge. The cross product of the two
+		//   hinge axes gives the (small angle) rotation required to bring them back into alignment.
+		Vector3 axisA = rotA * localAxisA;
+		Vector3 axisB = rotB * localAxisB;
+
+		Vector3 t1, t2;
+		ComputeTangentBasis(axisA, t1, t2);
+
+		Vector3 misalignment = Vector3::Cross(axisA, axisB);
+		AddAngularRow(rows, objA, objB, t1, Vector3::Dot(misalignment, t1), dt);
+		AddAngularRow(rows, objA, objB, t2, Vector3::Dot(misalignment, t2), dt);
+
+
+		//Motor
+		// - Target relative angular velocity about the hinge axis, with the impulse limited by the max torque
+		if (motorEnabled)
+		{
+			rows.push_back(ConstraintRow(objA, objB,
+				Vector3(0.0f, 0.0f, 0.0f), -axisA,
+				Vector3(0.0f, 0.0f, 0.0f), axisA,
+				-motorSpeed));
+
+			rows.back().impulseSumMin = -motorMaxTorque * dt;
+			rows.back().impulseSumMax = motorMaxTorque * dt;
+		}
+	}
+
+	virtual void DebugDraw() const override
+	{
+		Vector3 globalOnA = objA->GetOrientation().ToMatrix3() * localOnA + objA->GetPosition();
+		Vector3 axisA = objA->GetOrientation().ToMatrix3() * localAxisA;
+
+		NCLDebug::DrawThickLine(objA->GetPosition(), globalOnA, 0.02f, Vector4(0.0f, 0.0f, 0.0f, 1.0f));
+		NCLDebug::DrawThickLine(objB->GetPosition(), globalOnA, 0.02f, Vector4(0.0f, 0.0f, 0.0f, 1.0f));
+		NCLDebug::DrawThickLineNDT(globalOnA - axisA * 0.5f, globalOnA + axisA * 0.5f, 0.02f, Vector4(1.0f, 0.8f, 1.0f, 1.0f));
+	}
+
+protected:
+	Vector3 localOnA, localOnB;
+	Vector3 localAxisA, localAxisB;
+
+	bool	motorEnabled;
+	float	motorSpeed;
+	float	motorMaxTorque;
+};
\ No newline at end of file
@@ -0,0 +1,68 @@
+#include "InstanceBatcher.h"
+
+uint InstanceBatcher::Build(const std::vector<RenderCommand>& commands, InstanceData* out_instances, uint max_instances)
+{
+	m_Batches.clear();
+	m_SingleObjects.clear();
+
+	uint num_instances = 0;
+	const size_t size = commands.size();
+
+	size_t i = 0;
+	while (i < size)
+	{
+		//Find the run of consecutive commands sharing the same mesh/texture
+		size_t run_end = i + 1;
+		while (run_end < size
+			&& commands[run_end].meshID == commands[i].meshID
+			&& commands[run_end].textureID == commands[i].textureID)
+		{
+			run_end++;
+		}
+
+		//Split the run into objects that can be instanced and those that render themselves
+		InstanceBatch batch;
+		batch.mesh = NULL;
+		batch.texture = 0;
+		batch.firstInstance = num_instances;
+		batch.numInstances = 0;
+
+		m_BatchObjects.clear();
+		for (size_t j = i; j < run_end; ++j)
+		{
+			Object* obj = commands[j].obj;
+			if (!obj->SupportsInstancing() || num_instances >= max_instances)
+			{
+				m_SingleObjects.push_back(obj);
+				continue;
+			}
+
+			if (batch.mesh == NULL)
+			{
+				batch.mesh = obj->GetRenderMesh();
+				batch.texture = obj->GetRenderTexture();
+			}
+
+			InstanceData& inst = out_instances[num_instances++];
+			inst.modelMatrix = obj->m_WorldTransform;
+			inst.colour = obj->m_Colour;
+			batch.numInstances++;
+			m_BatchObjects.push_back(obj);
+		}
+
+		if (batch.numInstances >= INSTANCE_MIN_BATCH_SIZE)
+		{
+			m_Batches.push_back(batch);
+		}
+		else if (batch.numInstances > 0)
+		{
+			//Not worth instancing - return the packed instances and draw the objects normally
+			num_instances -= batch.numInstances;
+			m_SingleObjects.insert(m_SingleObjects.end(), m_BatchObjects.begin(), m_BatchObjects.end());
+		}
+
+		i = run_end;
+	}
+
+	return num_instances;
+}
\ No newline at end of file
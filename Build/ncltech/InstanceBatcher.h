@@ -0,0 +1,68 @@
+/******************************************************************************
+Class: InstanceBatcher
+Implements:
+Author: Pieran Marris <p.marris@newcastle.ac.uk>
+Description:
+Groups the draw commands of a sorted RenderQueue into instanced draw calls. As the
+queue is already sorted by texture and mesh, all objects sharing the same mesh and
+texture are consecutive, so each run of instanceable objects becomes a single
+batch. The model matrix and colour of each object in the batch are packed into
+the given instance data array (normally a persistently mapped GPU buffer, see
+InstanceBuffer), ready to be drawn with Mesh::DrawInstanced.
+
+Objects that do their own rendering, or meshes with too few visible copies to be
+worth instancing, are returned seperately to be drawn normally.
+
+The batcher never touches OpenGL, so the grouping/packing can be tested and timed
+without a GPU.
+
+		(\_/)
+		( '_')
+	 /""""""""""""\=========     -----D
+	/"""""""""""""""""""""""\
+....\_@____@____@____@____@_/
+
+*//////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include "RenderQueue.h"
+#include <nclgl\Matrix4.h>
+#include <nclgl\Vector4.h>
+#include <vector>
+
+//Minimum number of objects sharing the same mesh/texture before they are drawn instanced
+#define INSTANCE_MIN_BATCH_SIZE 4
+
+//Per-instance data, layout must match the instance attributes read by Mesh::DrawInstanced
+struct InstanceData
+{
+	Matrix4 modelMatrix;
+	Vector4 colour;
+};
+
+struct InstanceBatch
+{
+	Mesh*	mesh;
+	uint	texture;
+	uint	firstInstance;	//Index of the first instance within the packed instance data
+	uint	numInstances;
+};
+
+class InstanceBatcher
+{
+public:
+	InstanceBatcher() {}
+	~InstanceBatcher() {}
+
+	//Groups the (sorted) commands into batches, writing up to 'max_instances' entries into 'out_instances'
+	// - Any objects that could not be instanced are added to GetSingleObjects() instead
+	// - Returns the number of instances written
+	uint Build(const std::vector<RenderCommand>& commands, InstanceData* out_instances, uint max_instances);
+
+	const std::vector<InstanceBatch>&	GetBatches() const			{ return m_Batches; }
+	const std::vector<Object*>&			GetSingleObjects() const	{ return m_SingleObjects; }
+
+protected:
+	std::vector<InstanceBatch>	m_Batches;
+	std::vector<Object*>		m_SingleObjects;
+	std::vector<Object*>		m_BatchObjects;		//Scratch list of objects packed into the current batch
+};
\ No newline at end of file
@@ -0,0 +1,122 @@
+#include "InstanceBuffer.h"
+#include "NCLDebug.h"
+
+InstanceBuffer::InstanceBuffer()
+	: m_Buffer(0)
+	, m_MappedData(NULL)
+	, m_FrameIdx(0)
+	, m_FrameUsed(0)
+	, m_MapOffset(0)
+{
+	for (uint i = 0; i < INSTANCE_BUFFER_NUM_FRAMES; ++i)
+		m_Fences[i] = NULL;
+}
+
+InstanceBuffer::~InstanceBuffer()
+{
+	Release();
+}
+
+void InstanceBuffer::Initialize()
+{
+	Release();
+
+	const GLsizeiptr size = sizeof(InstanceData) * INSTANCE_BUFFER_MAX_INSTANCES * INSTANCE_BUFFER_NUM_FRAMES;
+
+	glGenBuffers(1, &m_Buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, m_Buffer);
+
+	if (GLEW_ARB_buffer_storage)
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, size, NULL, flags);
+		m_MappedData = (InstanceData*)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+	}
+
+	if (m_MappedData == NULL)
+	{
+		NCLDebug::Log(Vector3(1.0f, 0.6f, 0.0f), "Persistent buffer mapping not supported - instance data will be uploaded each frame");
+
+		//Buffer storage is immutable, so if mapping failed a new buffer is required
+		if (GLEW_ARB_buffer_storage)
+		{
+			glDeleteBuffers(1, &m_Buffer);
+			glGenBuffers(1, &m_Buffer);
+			glBindBuffer(GL_ARRAY_BUFFER, m_Buffer);
+		}
+		glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+		m_FallbackData.resize(INSTANCE_BUFFER_MAX_INSTANCES);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceBuffer::Release()
+{
+	for (uint i = 0; i < INSTANCE_BUFFER_NUM_FRAMES; ++i)
+	{
+		if (m_Fences[i])
+		{
+			glDeleteSync(m_Fences[i]);
+			m_Fences[i] = NULL;
+		}
+	}
+
+	if (m_Buffer)
+	{
+		if (m_MappedData)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, m_Buffer);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			m_MappedData = NULL;
+		}
+
+		glDeleteBuffers(1, &m_Buffer);
+		m_Buffer = 0;
+	}
+	m_FallbackData.clear();
+}
+
+void InstanceBuffer::BeginFrame()
+{
+	m_FrameIdx = (m_FrameIdx + 1) % INSTANCE_BUFFER_NUM_FRAMES;
+	m_FrameUsed = 0;
+
+	//Wait for the GPU to finish with the last frame that used this region of the buffer
+	GLsync& fence = m_Fences[m_FrameIdx];
+	if (fence)
+	{
+		glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		glDeleteSync(fence);
+		fence = NULL;
+	}
+}
+
+void InstanceBuffer::EndFrame()
+{
+	m_Fences[m_FrameIdx] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+InstanceData* InstanceBuffer::Map(uint* max_instances, size_t* out_offset)
+{
+	*max_instances = min(*max_instances, INSTANCE_BUFFER_MAX_INSTANCES - m_FrameUsed);
+
+	const size_t first_instance = m_FrameIdx * INSTANCE_BUFFER_MAX_INSTANCES + m_FrameUsed;
+	m_MapOffset = first_instance * sizeof(InstanceData);
+	*out_offset = m_MapOffset;
+
+	return (m_MappedData != NULL) ? &m_MappedData[first_instance] : &m_FallbackData[0];
+}
+
+void InstanceBuffer::Unmap(uint num_instances)
+{
+	if (m_MappedData == NULL && num_instances > 0)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, m_Buffer);
+		glBufferSubData(GL_ARRAY_BUFFER, m_MapOffset, num_instances * sizeof(InstanceData), &m_FallbackData[0]);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	m_FrameUsed += num_instances;
+}
\ No newline at end of file
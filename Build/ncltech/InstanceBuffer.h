@@ -0,0 +1,69 @@
+/******************************************************************************
+Class: InstanceBuffer
+Implements:
+Author: Pieran Marris <p.marris@newcastle.ac.uk>
+Description:
+GPU buffer holding per-instance data (InstanceData) for instanced rendering.
+
+Where supported (GL_ARB_buffer_storage) the buffer is persistently mapped, so
+instance data is written straight into GPU visible memory each frame without any
+map/unmap or buffer upload calls. To avoid overwriting data the GPU may still be
+reading, the buffer is split into INSTANCE_BUFFER_NUM_FRAMES regions used in turn,
+with a fence placed at the end of each frame and waited on before that frame's
+region is reused.
+
+On older drivers it falls back to packing into a CPU side array which is uploaded
+with glBufferSubData.
+
+		(\_/)
+		( '_')
+	 /""""""""""""\=========     -----D
+	/"""""""""""""""""""""""\
+....\_@____@____@____@____@_/
+
+*//////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include "InstanceBatcher.h"
+#include <nclgl\OGLRenderer.h>
+#include <vector>
+
+//Number of frames that can be in flight at once (each with their own section of the buffer)
+#define INSTANCE_BUFFER_NUM_FRAMES 3
+
+//Maximum number of instances that can be drawn in a single frame (across all passes)
+#define INSTANCE_BUFFER_MAX_INSTANCES 65536
+
+class InstanceBuffer
+{
+public:
+	InstanceBuffer();
+	~InstanceBuffer();
+
+	//Creates the GPU buffer (requires an OpenGL context)
+	void Initialize();
+	void Release();
+
+	//Must surround all calls to Map/Unmap each frame
+	void BeginFrame();
+	void EndFrame();
+
+	//Returns space for up to 'max_instances' instances (clamped to the space left this frame)
+	// - 'out_offset' is the byte offset of the returned space within GetBuffer()
+	InstanceData* Map(uint* max_instances, size_t* out_offset);
+
+	//Finishes writing to the space returned by Map, with only the first 'num_instances' having been used
+	void Unmap(uint num_instances);
+
+	GLuint GetBuffer() const			{ return m_Buffer; }
+	bool   IsPersistentlyMapped() const	{ return m_MappedData != NULL; }
+
+protected:
+	GLuint			m_Buffer;
+	InstanceData*	m_MappedData;		//Persistent mapping of the entire buffer (NULL if not supported)
+	std::vector<InstanceData> m_FallbackData;
+
+	GLsync			m_Fences[INSTANCE_BUFFER_NUM_FRAMES];
+	uint			m_FrameIdx;
+	uint			m_FrameUsed;		//Number of instances used so far this frame
+	size_t			m_MapOffset;		//Byte offset of the space returned by the last call to Map
+};
\ No newline at end of file
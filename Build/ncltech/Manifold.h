@@ -48,6 +48,8 @@ struct ContactPoint
 
 class Manifold
 {
+	friend class ContactSolver;
+
 public:
 	Manifold();
 	~Manifold();
@@ -5,12 +5,13 @@
 Vector3	NCLDebug::m_CameraPosition;
 Matrix4	NCLDebug::m_ProjView;
 
-int NCLDebug::m_NumStatusEntries = 0;
+std::atomic<int> NCLDebug::m_NumStatusEntries(0);
 std::vector<LogEntry> NCLDebug::m_LogEntries;
 int NCLDebug::m_LogEntriesOffset = 0;
+std::mutex NCLDebug::m_LogMutex;
 size_t	NCLDebug::m_OffsetChars  = 0;
 
-std::vector<Vector4> NCLDebug::m_Characters;
+NCLDebug::DebugVertexStream NCLDebug::m_Characters;
 NCLDebug::DebugDrawList NCLDebug::m_DrawList;
 NCLDebug::DebugDrawList NCLDebug::m_DrawListNDT;
 
@@ -23,14 +24,51 @@ GLuint NCLDebug::m_glArray = NULL;
 GLuint NCLDebug::m_glBuffer = NULL;
 GLuint NCLDebug::m_glFontTex = NULL;
 
+Vector4* NCLDebug::m_glMappedBuffer = NULL;
+size_t	 NCLDebug::m_glBufferFrameCapacity = 0;
+uint	 NCLDebug::m_glBufferFrame = 0;
+GLsync	 NCLDebug::m_glBufferFences[NCLDEBUG_NUM_BUFFERED_FRAMES] = { NULL };
+
+
+Vector4* NCLDebug::DebugVertexStream::Allocate(size_t n)
+{
+	//Reserve space by bumping the size, making sure it never passes the capacity so the stream never contains unwritten data
+	size_t offset = size.load(std::memory_order_relaxed);
+	do
+	{
+		if (offset + n > data.size())
+		{
+			overflow += n;
+			return NULL;
+		}
+	} while (!size.compare_exchange_weak(offset, offset + n));
+
+	return &data[offset];
+}
+
+void NCLDebug::DebugVertexStream::Clear()
+{
+	//Only grows if data was dropped last frame, so no allocations happen once the lists reach their working size
+	size_t required = size + overflow;
+	if (required > data.size())
+	{
+		data.resize(max(required, data.size() * 2));
+	}
+
+	size = 0;
+	overflow = 0;
+}
+
 
 
 //Draw Point (circle)
 void NCLDebug::GenDrawPoint(bool ndt, const Vector3& pos, float point_radius, const Vector4& colour)
 {
-	auto list = ndt ? &m_DrawListNDT : &m_DrawList;
-	list->points.push_back(Vector4(pos.x, pos.y, pos.z, point_radius));
-	list->points.push_back(colour);
+	Vector4* verts = (ndt ? m_DrawListNDT : m_DrawList).points.Allocate(2);
+	if (verts == NULL) return;
+
+	verts[0] = Vector4(pos.x, pos.y, pos.z, point_radius);
+	verts[1] = colour;
 }
 
 void NCLDebug::DrawPoint(const Vector3& pos, float point_radius, const Vector3& colour)
@@ -55,18 +93,19 @@ void NCLDebug::DrawPointNDT(const Vector3& pos, float point_radius, const Vector
 //Draw Line with a given thickness 
 void NCLDebug::GenDrawThickLine(bool ndt, const Vector3& start, const Vector3& end, float line_width, const Vector4& colour)
 {
-	auto list = ndt ? &m_DrawListNDT : &m_DrawList;
+	Vector4* verts = (ndt ? m_DrawListNDT : m_DrawList).thickLines.Allocate(4);
+	if (verts == NULL) return;
 
 	//For Depth Sorting
 	Vector3 midPoint = (start + end) * 0.5f;
 	float camDist = Vector3::Dot(midPoint - m_CameraPosition, midPoint - m_CameraPosition);
 
 	//Add to Data Structures
-	list->thickLines.push_back(Vector4(start.x, start.y, start.z, line_width));
-	list->thickLines.push_back(colour);
+	verts[0] = Vector4(start.x, start.y, start.z, line_width);
+	verts[1] = colour;
 
-	list->thickLines.push_back(Vector4(end.x, end.y, end.z, camDist));
-	list->thickLines.push_back(colour);
+	verts[2] = Vector4(end.x, end.y, end.z, camDist);
+	verts[3] = colour;
 
 	GenDrawPoint(ndt, start, line_width * 0.5f, colour);
 	GenDrawPoint(ndt, end, line_width * 0.5f, colour);
@@ -92,12 +131,14 @@ void NCLDebug::DrawThickLineNDT(const Vector3& start, const Vector3& end, float
 //Draw line with thickness of 1 screen pixel regardless of distance from camera
 void NCLDebug::GenDrawHairLine(bool ndt, const Vector3& start, const Vector3& end, const Vector4& colour)
 {
-	auto list = ndt ? &m_DrawListNDT : &m_DrawList;
-	list->hairLines.push_back(Vector4(start.x, start.y, start.z, 1.0f));
-	list->hairLines.push_back(colour);
+	Vector4* verts = (ndt ? m_DrawListNDT : m_DrawList).hairLines.Allocate(4);
+	if (verts == NULL) return;
+
+	verts[0] = Vector4(start.x, start.y, start.z, 1.0f);
+	verts[1] = colour;
 
-	list->hairLines.push_back(Vector4(end.x, end.y, end.z, 1.0f));
-	list->hairLines.push_back(colour);
+	verts[2] = Vector4(end.x, end.y, end.z, 1.0f);
+	verts[3] = colour;
 }
 void NCLDebug::DrawHairLine(const Vector3& start, const Vector3& end, const Vector3& colour)
 {
@@ -150,21 +191,22 @@ void NCLDebug::DrawMatrixNDT(const Matrix3& mtx, const Vector3& position)
 //Draw Triangle 
 void NCLDebug::GenDrawTriangle(bool ndt, const Vector3& v0, const Vector3& v1, const Vector3& v2, const Vector4& colour)
 {
-	auto list = ndt ? &m_DrawListNDT : &m_DrawList;
+	Vector4* verts = (ndt ? m_DrawListNDT : m_DrawList).tris.Allocate(6);
+	if (verts == NULL) return;
 
 	//For Depth Sorting
 	Vector3 midPoint = (v0 + v1 + v2) * (1.0f / 3.0f);
 	float camDist = Vector3::Dot(midPoint - m_CameraPosition, midPoint - m_CameraPosition);
 
 	//Add to data structures
-	list->tris.push_back(Vector4(v0.x, v0.y, v0.z, camDist));
-	list->tris.push_back(colour);
+	verts[0] = Vector4(v0.x, v0.y, v0.z, camDist);
+	verts[1] = colour;
 
-	list->tris.push_back(Vector4(v1.x, v1.y, v1.z, 1.0f));
-	list->tris.push_back(colour);
+	verts[2] = Vector4(v1.x, v1.y, v1.z, 1.0f);
+	verts[3] = colour;
 
-	list->tris.push_back(Vector4(v2.x, v2.y, v2.z, 1.0f));
-	list->tris.push_back(colour);
+	verts[4] = Vector4(v2.x, v2.y, v2.z, 1.0f);
+	verts[5] = colour;
 }
 void NCLDebug::DrawTriangle(const Vector3& v0, const Vector3& v1, const Vector3& v2, const Vector4& colour)
 {
@@ -221,15 +263,18 @@ void NCLDebug::DrawTextCs(const Vector4& cs_pos, const float font_size, const st
 
 
 	//Add each characters to the draw list individually
+	Vector4* verts = m_Characters.Allocate(text_len * 4);
+	if (verts == NULL) return;
+
 	for (int i = 0; i < text_len; ++i)
 	{
 		Vector4 char_pos = Vector4(cs_pos.x + x_offset, cs_pos.y, cs_pos.z, cs_pos.w);
 		Vector4 char_data = Vector4(cs_size.x, cs_size.y, (float)(text[i]), 0.0f);
 
-		m_Characters.push_back(char_pos);
-		m_Characters.push_back(char_data);
-		m_Characters.push_back(colour);
-		m_Characters.push_back(colour);	//We dont really need this, but we need the padding to match the same vertex data format as all the other debug drawables
+		*verts++ = char_pos;
+		*verts++ = char_data;
+		*verts++ = colour;
+		*verts++ = colour;	//We dont really need this, but we need the padding to match the same vertex data format as all the other debug drawables
 
 		x_offset += cs_size.x * 1.2f;
 	}
@@ -290,8 +335,9 @@ void NCLDebug::AddStatusEntry(const Vector4& colour, const std::string text, ...
 
 	std::string formatted_text = std::string(buf, (size_t)length);
 
-	DrawTextCs(Vector4(-1.0f + cs_size_x * 0.5f, 1.0f - (m_NumStatusEntries * cs_size_y) - cs_size_y, -1.0f, 1.0f), STATUS_TEXT_SIZE, formatted_text, TEXTALIGN_LEFT, colour);
-	m_NumStatusEntries++;
+	//Each entry claims it's own row, so entries added from multiple threads at once never overlap
+	const int row = m_NumStatusEntries++;
+	DrawTextCs(Vector4(-1.0f + cs_size_x * 0.5f, 1.0f - (row * cs_size_y) - cs_size_y, -1.0f, 1.0f), STATUS_TEXT_SIZE, formatted_text, TEXTALIGN_LEFT, colour);
 }
 
 
@@ -329,6 +375,8 @@ void NCLDebug::Log(const Vector3& colour, const std::string text, ...)
 	va_end(args);
 
 	int length = (needed < 0) ? 1024 : needed;
+
+	std::lock_guard<std::mutex> lock(m_LogMutex);
 	AddLogEntry(colour, std::string(buf, (size_t)length));
 }
 
@@ -347,7 +395,12 @@ void NCLDebug::LogE(const char* filename, int linenumber, const std::string text
 
 	int length = (needed < 0) ? 1024 : needed;
 
-	Log(Vector3(1.0f, 0.25f, 0.25f), "[ERROR] %s:%d", filename, linenumber);
+	std::stringstream location;
+	location << "[ERROR] " << filename << ":" << linenumber;
+
+	//Both lines are added under one lock, so errors from other threads can't end up between them
+	std::lock_guard<std::mutex> lock(m_LogMutex);
+	AddLogEntry(Vector3(1.0f, 0.25f, 0.25f), location.str());
 	AddLogEntry(Vector3(1.0f, 0.5f, 0.5f), "\t \x01 \"" + std::string(buf, (size_t)length) + "\"");
 	
 	std::cout << endl;
@@ -358,14 +411,14 @@ void NCLDebug::LogE(const char* filename, int linenumber, const std::string text
 
 void NCLDebug::ClearDebugLists()
 {
-	m_Characters.clear();
+	m_Characters.Clear();
 
 	auto clear_list = [](NCLDebug::DebugDrawList& list)
 	{
-		list.points.clear();
-		list.thickLines.clear();
-		list.hairLines.clear();
-		list.tris.clear();	
+		list.points.Clear();
+		list.thickLines.Clear();
+		list.hairLines.Clear();
+		list.tris.Clear();	
 	};
 	clear_list(m_DrawList);
 	clear_list(m_DrawListNDT);
@@ -375,6 +428,7 @@ void NCLDebug::ClearDebugLists()
 
 void NCLDebug::ClearLog()
 {
+	std::lock_guard<std::mutex> lock(m_LogMutex);
 	m_LogEntries.clear();
 	m_LogEntriesOffset = 0;
 }
@@ -398,45 +452,73 @@ struct TriVertex
 	PointVertex p2;
 };
 
-void NCLDebug::SortDebugLists()
+//Sorts the primitives in the given vertex data back to front (furthest depth first)
+// - If 'translucent_only' is set, opaque primitives are moved to the front in any order as the depth buffer will sort them out, and
+//   only the remaining translucent primitives are sorted
+template <typename PrimitiveType, typename DepthFunc>
+static void SortPrimitives(Vector4* data, size_t num_vectors, bool translucent_only, DepthFunc depth)
 {
-	auto sort_lists = [](NCLDebug::DebugDrawList& list)
+	PrimitiveType* begin = reinterpret_cast<PrimitiveType*>(data);
+	PrimitiveType* end = begin + num_vectors / (sizeof(PrimitiveType) / sizeof(Vector4));
+
+	if (translucent_only)
 	{
-		//Sort Points
-		if (!list.points.empty())
+		begin = std::partition(begin, end, [](const PrimitiveType& prim)
 		{
-			PointVertex* points = reinterpret_cast<PointVertex*>(&list.points[0].x);
-			std::sort(points, points + list.points.size() / 2, [&](const PointVertex& a, const PointVertex& b)
-			{
-				float a2 = Vector3::Dot(a.pos.ToVector3() - m_CameraPosition, a.pos.ToVector3() - m_CameraPosition);
-				float b2 = Vector3::Dot(b.pos.ToVector3() - m_CameraPosition, b.pos.ToVector3() - m_CameraPosition);
-				return (a2 > b2);
-			});
-		}
+			return reinterpret_cast<const PointVertex&>(prim).col.w >= 0.999f;
+		});
+	}
 
-		//Sort Lines
-		if (!list.thickLines.empty())
-		{
-			LineVertex* lines = reinterpret_cast<LineVertex*>(&list.thickLines[0].x);
-			std::sort(lines, lines + list.thickLines.size() / 4, [](const LineVertex& a, const LineVertex& b)
-			{
-				return (a.p1.pos.w > b.p1.pos.w);
-			});
-		}
+	std::sort(begin, end, [&](const PrimitiveType& a, const PrimitiveType& b)
+	{
+		return depth(a) > depth(b);
+	});
+}
 
-		//Sort Triangles
-		if (!list.tris.empty())
+void NCLDebug::SortDebugLists()
+{
+	//Depth tested lists only need their translucent primitives sorted, but without depth testing the draw order
+	// decides what ends up on top so everything needs to be sorted
+	//  - Each list/primitive type is independant, so they are all sorted in parallel
+#pragma omp parallel for
+	for (int i = 0; i < 6; ++i)
+	{
+		const bool ndt = (i >= 3);
+		NCLDebug::DebugDrawList& list = ndt ? m_DrawListNDT : m_DrawList;
+
+		switch (i % 3)
 		{
-			TriVertex* tris = reinterpret_cast<TriVertex*>(&list.tris[0].x);
-			std::sort(tris, tris + list.tris.size() / 6, [](const TriVertex& a, const TriVertex& b)
+		case 0:
+			if (!list.points.empty())
+			{
+				SortPrimitives<PointVertex>(&list.points.data[0], list.points.size, !ndt, [](const PointVertex& p)
+				{
+					return Vector3::Dot(p.pos.ToVector3() - m_CameraPosition, p.pos.ToVector3() - m_CameraPosition);
+				});
+			}
+			break;
+
+		case 1:
+			if (!list.thickLines.empty())
+			{
+				SortPrimitives<LineVertex>(&list.thickLines.data[0], list.thickLines.size, !ndt, [](const LineVertex& l)
+				{
+					return l.p1.pos.w;
+				});
+			}
+			break;
+
+		case 2:
+			if (!list.tris.empty())
 			{
-				return (a.p0.pos.w > b.p0.pos.w);
-			});
+				SortPrimitives<TriVertex>(&list.tris.data[0], list.tris.size, !ndt, [](const TriVertex& t)
+				{
+					return t.p0.pos.w;
+				});
+			}
+			break;
 		}
-	};
-
-	sort_lists(m_DrawList);
-	sort_lists(m_DrawListNDT);
+	}
 }
 
 void NCLDebug::DrawDebugLists()
@@ -444,6 +526,8 @@ void NCLDebug::DrawDebugLists()
 	//Draw log text
 	float cs_size_x = LOG_TEXT_SIZE / Window::GetWindow().GetScreenSize().x * 2.0f;
 	float cs_size_y = LOG_TEXT_SIZE / Window::GetWindow().GetScreenSize().y * 2.0f;
+
+	std::unique_lock<std::mutex> log_lock(m_LogMutex);
 	size_t log_len = m_LogEntries.size();
 	for (size_t i = 0; i < log_len; ++i)
 	{
@@ -453,6 +537,7 @@ void NCLDebug::DrawDebugLists()
 
 		DrawTextCs(Vector4(-1.0f + cs_size_x * 0.5f, -1.0f + ((log_len - i - 1) * cs_size_y) + cs_size_y, 0.0f, 1.0f), LOG_TEXT_SIZE, m_LogEntries[idx].text, TEXTALIGN_LEFT, m_LogEntries[idx].colour);
 	}
+	log_lock.unlock();
 
 
 	if (!m_glArray)
@@ -461,53 +546,68 @@ void NCLDebug::DrawDebugLists()
 		return;
 	}
 
-	//Buffer all data into the single buffer object
-	size_t max_size = 0;
-	max_size += m_DrawList.points.size() + m_DrawList.thickLines.size() + m_DrawList.hairLines.size() + m_DrawList.tris.size();
-	max_size += m_DrawListNDT.points.size() + m_DrawListNDT.thickLines.size() + m_DrawListNDT.hairLines.size() + m_DrawListNDT.tris.size();
-	max_size += m_Characters.size();
-	max_size *= sizeof(Vector4);
-
-
+	//Work out where each list goes within this frame's section of the buffer
 	size_t buffer_offsets[8];
 	//Draw List
 	buffer_offsets[0] = 0;
-	buffer_offsets[1] = m_DrawList.points.size();
-	buffer_offsets[2] = buffer_offsets[1] + m_DrawList.thickLines.size();
-	buffer_offsets[3] = buffer_offsets[2] + m_DrawList.hairLines.size();
+	buffer_offsets[1] = m_DrawList.points.size;
+	buffer_offsets[2] = buffer_offsets[1] + m_DrawList.thickLines.size;
+	buffer_offsets[3] = buffer_offsets[2] + m_DrawList.hairLines.size;
 
 	//NDT Draw List
-	buffer_offsets[4] = buffer_offsets[3] + m_DrawList.tris.size();
-	buffer_offsets[5] = buffer_offsets[4] + m_DrawListNDT.points.size();
-	buffer_offsets[6] = buffer_offsets[5] + m_DrawListNDT.thickLines.size();
-	buffer_offsets[7] = buffer_offsets[6] + m_DrawListNDT.hairLines.size();
+	buffer_offsets[4] = buffer_offsets[3] + m_DrawList.tris.size;
+	buffer_offsets[5] = buffer_offsets[4] + m_DrawListNDT.points.size;
+	buffer_offsets[6] = buffer_offsets[5] + m_DrawListNDT.thickLines.size;
+	buffer_offsets[7] = buffer_offsets[6] + m_DrawListNDT.hairLines.size;
 
 	//Char Offset 
-	m_OffsetChars     = buffer_offsets[7] + m_DrawListNDT.tris.size();
+	m_OffsetChars     = buffer_offsets[7] + m_DrawListNDT.tris.size;
 
+	const size_t total_size = m_OffsetChars + m_Characters.size;
+	if (total_size > m_glBufferFrameCapacity)
+	{
+		ResizeStreamBuffer(max(total_size, m_glBufferFrameCapacity * 2));
+	}
 
 
-	const size_t stride = 2 * sizeof(Vector4);
+	//Move on to the next section of the buffer, waiting for the GPU if it is still drawing the last frame that used it
+	m_glBufferFrame = (m_glBufferFrame + 1) % NCLDEBUG_NUM_BUFFERED_FRAMES;
+	GLsync& fence = m_glBufferFences[m_glBufferFrame];
+	if (fence)
+	{
+		glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		glDeleteSync(fence);
+		fence = NULL;
+	}
+
+	const size_t frame_offset = m_glBufferFrame * m_glBufferFrameCapacity;
+	for (size_t& offset : buffer_offsets) offset += frame_offset;
+	m_OffsetChars += frame_offset;
+
 
 	glBindVertexArray(m_glArray);
 	glBindBuffer(GL_ARRAY_BUFFER, m_glBuffer);
-	glBufferData(GL_ARRAY_BUFFER, max_size, NULL, GL_STATIC_DRAW);
 
-	glVertexAttribPointer(VERTEX_BUFFER, 4, GL_FLOAT, GL_FALSE, stride, (void*)(0));
-	glEnableVertexAttribArray(VERTEX_BUFFER);
-	glVertexAttribPointer(COLOUR_BUFFER, 4, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(Vector4)));
-	glEnableVertexAttribArray(COLOUR_BUFFER);
+	auto buffer_stream = [&](const NCLDebug::DebugVertexStream& stream, size_t offset)
+	{
+		if (stream.empty())
+			return;
 
+		if (m_glMappedBuffer != NULL)
+			memcpy(&m_glMappedBuffer[offset], &stream.data[0], stream.size * sizeof(Vector4));
+		else
+			glBufferSubData(GL_ARRAY_BUFFER, offset * sizeof(Vector4), stream.size * sizeof(Vector4), &stream.data[0].x);
+	};
 	auto buffer_drawlist = [&](NCLDebug::DebugDrawList& list, size_t* offsets)
 	{
-		if (!list.points.empty()) glBufferSubData(GL_ARRAY_BUFFER, offsets[0] * sizeof(Vector4), list.points.size() * sizeof(Vector4), &list.points[0].x);
-		if (!list.thickLines.empty()) glBufferSubData(GL_ARRAY_BUFFER, offsets[1] * sizeof(Vector4), list.thickLines.size() * sizeof(Vector4), &list.thickLines[0].x);
-		if (!list.hairLines.empty()) glBufferSubData(GL_ARRAY_BUFFER, offsets[2] * sizeof(Vector4), list.hairLines.size() * sizeof(Vector4), &list.hairLines[0].x);
-		if (!list.tris.empty()) glBufferSubData(GL_ARRAY_BUFFER, offsets[3] * sizeof(Vector4), list.tris.size() * sizeof(Vector4), &list.tris[0].x);
+		buffer_stream(list.points, offsets[0]);
+		buffer_stream(list.thickLines, offsets[1]);
+		buffer_stream(list.hairLines, offsets[2]);
+		buffer_stream(list.tris, offsets[3]);
 	};
 	buffer_drawlist(m_DrawList, &buffer_offsets[0]);
 	buffer_drawlist(m_DrawListNDT, &buffer_offsets[4]);
-	if (!m_Characters.empty()) glBufferSubData(GL_ARRAY_BUFFER, m_OffsetChars * sizeof(Vector4), m_Characters.size() * sizeof(Vector4), &m_Characters[0].x);
+	buffer_stream(m_Characters, m_OffsetChars);
 
 	Vector2 screen_size = Window::GetWindow().GetScreenSize();
 	float aspectRatio = screen_size.y / screen_size.x;
@@ -515,31 +615,31 @@ void NCLDebug::DrawDebugLists()
 
 	auto render_drawlist = [&](NCLDebug::DebugDrawList& list, size_t* offsets)
 	{
-		if (m_pShaderPoints && list.points.size() > 0)
+		if (m_pShaderPoints && !list.points.empty())
 		{
 			glUseProgram(m_pShaderPoints->GetProgram());
 			glUniformMatrix4fv(glGetUniformLocation(m_pShaderPoints->GetProgram(), "projViewMatrix"), 1, GL_FALSE, &m_ProjView.values[0]);
 			glUniform1f(glGetUniformLocation(m_pShaderPoints->GetProgram(), "pix_scalar"), aspectRatio);
 
-			glDrawArrays(GL_POINTS, offsets[0] >> 1, list.points.size() >> 1);
+			glDrawArrays(GL_POINTS, offsets[0] >> 1, list.points.size >> 1);
 		}
 
-		if (m_pShaderLines && list.thickLines.size() > 0)
+		if (m_pShaderLines && !list.thickLines.empty())
 		{
 			glUseProgram(m_pShaderLines->GetProgram());
 			glUniformMatrix4fv(glGetUniformLocation(m_pShaderLines->GetProgram(), "projViewMatrix"), 1, GL_FALSE, &m_ProjView.values[0]);
 			glUniform1f(glGetUniformLocation(m_pShaderLines->GetProgram(), "pix_scalar"), aspectRatio);
 
-			glDrawArrays(GL_LINES, offsets[1] >> 1, list.thickLines.size() >> 1);
+			glDrawArrays(GL_LINES, offsets[1] >> 1, list.thickLines.size >> 1);
 		}
 
-		if (m_pShaderHairLines && (list.hairLines.size() + list.tris.size()) > 0)
+		if (m_pShaderHairLines && (!list.hairLines.empty() || !list.tris.empty()))
 		{
 			glUseProgram(m_pShaderHairLines->GetProgram());
 			glUniformMatrix4fv(glGetUniformLocation(m_pShaderHairLines->GetProgram(), "projViewMatrix"), 1, GL_FALSE, &m_ProjView.values[0]);
 
-			if (!list.hairLines.empty()) glDrawArrays(GL_LINES, offsets[2] >> 1, list.hairLines.size() >> 1);
-			if (!list.tris.empty()) glDrawArrays(GL_TRIANGLES, offsets[3] >> 1, list.tris.size() >> 1);
+			if (!list.hairLines.empty()) glDrawArrays(GL_LINES, offsets[2] >> 1, list.hairLines.size >> 1);
+			if (!list.tris.empty()) glDrawArrays(GL_TRIANGLES, offsets[3] >> 1, list.tris.size >> 1);
 		}
 	};
 
@@ -555,7 +655,7 @@ void NCLDebug::DrawDebubHUD()
 	//All text data already updated in main DebugDrawLists
 	// - we just need to rebind and draw it
 
-	if (m_pShaderText && m_Characters.size() > 0)
+	if (m_pShaderText && !m_Characters.empty())
 	{
 		glBindVertexArray(m_glArray);
 		glUseProgram(m_pShaderText->GetProgram());
@@ -564,8 +664,80 @@ void NCLDebug::DrawDebubHUD()
 		glActiveTexture(GL_TEXTURE5);
 		glBindTexture(GL_TEXTURE_2D, m_glFontTex);
 
-		glDrawArrays(GL_LINES, m_OffsetChars >> 1, m_Characters.size() >> 1);
+		glDrawArrays(GL_LINES, m_OffsetChars >> 1, m_Characters.size >> 1);
+	}
+
+	//This is the last use of this frame's section of the stream buffer
+	if (m_glBuffer)
+	{
+		GLsync& fence = m_glBufferFences[m_glBufferFrame];
+		if (fence) glDeleteSync(fence);
+		fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+}
+
+void NCLDebug::ResizeStreamBuffer(size_t frame_capacity)
+{
+	ReleaseStreamBuffer();
+
+	//Each vertex is two Vector4's, so keep each frame's section aligned to whole vertices
+	m_glBufferFrameCapacity = (frame_capacity + 1) & ~(size_t)1;
+	const GLsizeiptr size = m_glBufferFrameCapacity * NCLDEBUG_NUM_BUFFERED_FRAMES * sizeof(Vector4);
+
+	glBindVertexArray(m_glArray);
+	glGenBuffers(1, &m_glBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, m_glBuffer);
+
+	if (GLEW_ARB_buffer_storage)
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, size, NULL, flags);
+		m_glMappedBuffer = (Vector4*)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+	}
+
+	if (m_glMappedBuffer == NULL)
+	{
+		//Buffer storage is immutable, so if mapping failed a new buffer is required
+		if (GLEW_ARB_buffer_storage)
+		{
+			glDeleteBuffers(1, &m_glBuffer);
+			glGenBuffers(1, &m_glBuffer);
+			glBindBuffer(GL_ARRAY_BUFFER, m_glBuffer);
+		}
+		glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+	}
+
+	const size_t stride = 2 * sizeof(Vector4);
+	glVertexAttribPointer(VERTEX_BUFFER, 4, GL_FLOAT, GL_FALSE, stride, (void*)(0));
+	glEnableVertexAttribArray(VERTEX_BUFFER);
+	glVertexAttribPointer(COLOUR_BUFFER, 4, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(Vector4)));
+	glEnableVertexAttribArray(COLOUR_BUFFER);
+}
+
+void NCLDebug::ReleaseStreamBuffer()
+{
+	for (GLsync& fence : m_glBufferFences)
+	{
+		if (fence)
+		{
+			glDeleteSync(fence);
+			fence = NULL;
+		}
+	}
+
+	if (m_glBuffer)
+	{
+		if (m_glMappedBuffer)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, m_glBuffer);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+			m_glMappedBuffer = NULL;
+		}
+
+		glDeleteBuffers(1, &m_glBuffer);
+		m_glBuffer = NULL;
 	}
+	m_glBufferFrameCapacity = 0;
 }
 
 void NCLDebug::LoadShaders()
@@ -607,7 +779,7 @@ void NCLDebug::LoadShaders()
 
 	//Create Buffers
 	glGenVertexArrays(1, &m_glArray);
-	glGenBuffers(1, &m_glBuffer);
+	ResizeStreamBuffer(NCLDEBUG_INITIAL_BUFFER_CAPACITY);
 
 	//Load Font Texture
 	m_glFontTex = SOIL_load_OGL_texture(
@@ -654,8 +826,8 @@ void NCLDebug::ReleaseShaders()
 
 	if (m_glArray)
 	{
+		ReleaseStreamBuffer();
 		glDeleteVertexArrays(1, &m_glArray);
-		glDeleteBuffers(1, &m_glBuffer);
 		m_glArray = NULL;
 	}
 
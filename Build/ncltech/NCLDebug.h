@@ -10,6 +10,11 @@ simple geometry on-screen anywhere in the program.
 All functions are global, and can be called at any time any where in the program. All log entries are
 also printed out to the console in case of log messages/errors that occur before the renderer has initiated.
 
+All draw functions, along with AddStatusEntry, are thread safe, so debug data can be added from worker threads
+(e.g. parallel physics updates) without locking. Log entries are added under a lock, so can also be written from
+any thread, though are slower to add. Each draw list has a reserved capacity which is only ever grown between frames, so
+there is no per-frame allocation, and the data is streamed to the GPU through a persistently mapped buffer.
+
 
 Below is a list of functions supported by NCLDebug:
 	Note: All functions have an "<function>NDT" varient which refers to 'non depth-tested' meaning
@@ -72,12 +77,22 @@ Below is a list of functions supported by NCLDebug:
 #include <nclgl\Vector3.h>
 #include <nclgl\Shader.h>
 #include <vector>
+#include <atomic>
 #include <mutex>
 
 #define MAX_LOG_SIZE		25
 #define LOG_TEXT_SIZE  		14.0f
 #define STATUS_TEXT_SIZE	16.0f
 
+//Number of Vector4's initially reserved for each draw list - lists that overflow are grown before the next frame
+#define NCLDEBUG_INITIAL_LIST_CAPACITY		4096
+
+//Number of Vector4's initially reserved in the GPU buffer for each frame
+#define NCLDEBUG_INITIAL_BUFFER_CAPACITY	65536
+
+//Number of frames of data the GPU buffer holds, so a new frame never overwrites data the GPU could still be drawing
+#define NCLDEBUG_NUM_BUFFERED_FRAMES		2
+
 enum TextAlignment
 {
 	TEXTALIGN_LEFT,
@@ -166,6 +181,7 @@ protected:
 
 
 
+	//Must be called with m_LogMutex locked
 	static void AddLogEntry(const Vector3& colour, const std::string& text);
 
 	//Called by Scene Renderer class
@@ -177,6 +193,10 @@ protected:
 	static void LoadShaders();
 	static void ReleaseShaders();
 
+	//(Re)creates the GPU stream buffer with space for 'frame_capacity' Vector4's per frame
+	static void ResizeStreamBuffer(size_t frame_capacity);
+	static void ReleaseStreamBuffer();
+
 	static void ClearLog();
 
 	static void SetDebugDrawData(const Matrix4& projViewMatrix, const Vector3& camera_pos)
@@ -189,17 +209,35 @@ protected:
 	static Vector3	m_CameraPosition;
 	static Matrix4	m_ProjView;
 
-	static int m_NumStatusEntries;
+	static std::atomic<int> m_NumStatusEntries;
 	static std::vector<LogEntry> m_LogEntries;
 	static int m_LogEntriesOffset;
+	static std::mutex m_LogMutex;		//Guards the log entries, which may be added from any thread
+
+	//Fixed capacity array of vertex data that any number of threads can append to at once
+	// - Data that doesn't fit is dropped, and the capacity increased to fit it when the stream is next cleared
+	struct DebugVertexStream
+	{
+		std::vector<Vector4>	data;
+		std::atomic<size_t>		size;
+		std::atomic<size_t>		overflow;
+
+		DebugVertexStream() : data(NCLDEBUG_INITIAL_LIST_CAPACITY), size(0), overflow(0) {}
+
+		//Returns space for 'n' Vector4's, or NULL if the stream is full
+		Vector4* Allocate(size_t n);
+		void	 Clear();
+
+		bool	 empty() const	{ return size == 0; }
+	};
 
-	static std::vector<Vector4> m_Characters;
+	static DebugVertexStream m_Characters;
 	struct DebugDrawList
 	{
-		std::vector<Vector4> points;	
-		std::vector<Vector4> thickLines;
-		std::vector<Vector4> hairLines;
-		std::vector<Vector4> tris;
+		DebugVertexStream points;	
+		DebugVertexStream thickLines;
+		DebugVertexStream hairLines;
+		DebugVertexStream tris;
 	};
 	static DebugDrawList m_DrawList;			//Depth-Tested
 	static DebugDrawList m_DrawListNDT;			//Not Depth-Tested
@@ -213,5 +251,9 @@ protected:
 	static GLuint	m_glFontTex;
 	static size_t	m_OffsetChars;
 
-	static std::mutex m_DebugMutex;
+	//Persistently mapped GPU buffer split into NCLDEBUG_NUM_BUFFERED_FRAMES sections, used in turn each frame
+	static Vector4*	m_glMappedBuffer;		//NULL if persistent mapping is not supported
+	static size_t	m_glBufferFrameCapacity;
+	static uint		m_glBufferFrame;
+	static GLsync	m_glBufferFences[NCLDEBUG_NUM_BUFFERED_FRAMES];
 };
\ No newline at end of file
@@ -1,27 +1,52 @@
 #include "Object.h"
 #include "PhysicsEngine.h"
+#include "RenderList.h"
+
+uint Object::g_NumRenderIDs = 0;
+std::vector<uint> Object::g_FreeRenderIDs;
+uint Object::g_HierarchyVersion = 1;
 
 Object::Object(const std::string& name)
 	: m_Scene(NULL)
 	, m_Parent(NULL)
+	, m_ChildIdx(0)
 	, m_Name(name)
 	, m_Colour(1.0f, 1.0f, 1.0f, 1.0f)
 	, m_BoundingRadius(1.0f)
-	, m_FrustumCullFlags(NULL)
+	, m_TransformDirty(true)
+	, m_WorldTransformChanged(false)
+	, m_RenderDirty(true)
+	, m_RenderChanged(false)
+	, m_PhysicsWasMoving(false)
+	, m_PhysicsPoseVersion(0)
 	, m_PhysicsObject(NULL)
+	, m_ScreenPickerIdx(0)
 {
 	m_LocalTransform.ToIdentity();
 	m_WorldTransform.ToIdentity();
+
+	if (!g_FreeRenderIDs.empty())
+	{
+		m_RenderID = g_FreeRenderIDs.back();
+		g_FreeRenderIDs.pop_back();
+	}
+	else
+	{
+		m_RenderID = g_NumRenderIDs++;
+	}
 }
 
 Object::~Object()
 {
 	if (m_PhysicsObject != NULL)
 	{
-		PhysicsEngine::Instance()->RemovePhysicsObject(m_PhysicsObject);
-		delete m_PhysicsObject;
+		PhysicsEngine::Instance()->DestroyPhysicsObject(m_PhysicsObject);
 		m_PhysicsObject = NULL;
 	}
+
+	//Make sure we are not left dangling in any persistent renderlists before our ID is given to another object
+	RenderList::RemoveObjectFromAllLists(this);
+	g_FreeRenderIDs.push_back(m_RenderID);
 }
 
 
@@ -29,9 +54,8 @@ void Object::CreatePhysicsNode()
 {
 	if (m_PhysicsObject == NULL)
 	{
-		m_PhysicsObject = new PhysicsObject();
+		m_PhysicsObject = PhysicsEngine::Instance()->CreatePhysicsObject();
 		m_PhysicsObject->SetAssociatedObject(this);
-		PhysicsEngine::Instance()->AddPhysicsObject(m_PhysicsObject);
 	}
 }
 
@@ -60,7 +84,29 @@ Object*	Object::FindGameObject(const std::string& name)
 
 void Object::AddChildObject(Object* child)
 {
+	child->m_ChildIdx = (uint)m_Children.size();
 	m_Children.push_back(child);
 	child->m_Parent = this;
 	child->m_Scene = this->m_Scene;
+
+	//World transform is now relative to a new parent
+	child->m_TransformDirty = true;
+	g_HierarchyVersion++;
+}
+
+void Object::RemoveChildObject(Object* child)
+{
+	if (child->m_Parent != this)
+		return;
+
+	//Swap and pop
+	Object* last = m_Children.back();
+	m_Children[child->m_ChildIdx] = last;
+	last->m_ChildIdx = child->m_ChildIdx;
+	m_Children.pop_back();
+
+	child->m_Parent = NULL;
+	child->m_Scene = NULL;
+	child->m_ChildIdx = 0;
+	g_HierarchyVersion++;
 }
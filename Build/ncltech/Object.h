@@ -32,6 +32,7 @@ _-_-_-_-_-_-_-""  ""
 #include <vector>
 
 class Scene;
+class Mesh;
 class PhysicsEngine;
 class RenderList;
 class SceneRenderer;
@@ -44,6 +45,9 @@ class Object
 	friend class SceneRenderer;
 	friend class PhysicsEngine;
 	friend class ScreenPicker;
+	friend class SceneBVH;
+	friend class RenderQueue;
+	friend class InstanceBatcher;
 
 public:
 	Object(const std::string& name = "");
@@ -72,6 +76,13 @@ public:
 	//Add a child object to this scene node
 	void				AddChildObject(Object* child);
 
+	//Removes (but does not delete) a child object from this scene node
+	// - O(1), though the order of the remaining children is not preserved
+	void				RemoveChildObject(Object* child);
+
+	//Get the parent scene-tree object (or NULL if this object has not been added to the scene)
+	Object*				GetParent()							{ return m_Parent; }
+
 
 //<------- Object Parameters ------>
 	//Get the name of this object (if set)
@@ -94,19 +105,33 @@ public:
 	//	- This will be multiplied by the transform provided by the physicsObject to form
 	//	  the world transform used for rendering. If no physicsObject exists, this contains
 	//	  the position of the object relevant to it's parent.
-	void			SetLocalTransform(const Matrix4& transform)			{ m_LocalTransform = transform; }
+	void			SetLocalTransform(const Matrix4& transform)			{ m_LocalTransform = transform; m_TransformDirty = true; }
 	const Matrix4&  GetLocalTransform()									{ return m_LocalTransform; }
 
 	//Get the final world transform of the object, this is recalculated each render pass
 	// - This is premultiplied by the objects parent (if any) and is the combination of it's physics transform (if any) and local transform.
+	// - Only objects that have moved (or whose parent has moved) since the last render pass are recalculated
 	const Matrix4&  GetWorldTransform()					{ return m_WorldTransform; }
 
+	//Flags the world transform of this object (and all it's children) to be recalculated next render pass
+	//	- Called automatically by SetLocalTransform, only needed if m_LocalTransform is modified directly
+	void			InvalidateWorldTransform()			{ m_TransformDirty = true; }
+
+	//Flags the object as looking different without having moved, so any cached renders of it (e.g. static shadow maps) are refreshed
+	//	- Objects doing their own custom rendering (GetRenderMesh() returns NULL) should call this whenever what they draw changes
+	void			InvalidateRender()					{ m_RenderDirty = true; }
 
-	//Get the frustum flags used to identify which RenderList's this object is currently visible within
-	uint			GetFrustumCullFlags()				{ return m_FrustumCullFlags; }
+
+	//Get the unique (densely packed) index of this object, used by RenderList's to track which objects they contain
+	// - IDs are reused once an object is deleted
+	uint			GetRenderID() const					{ return m_RenderID; }
 
 	//Get the screen picker unique ID used to identify where the object exists (if it exsists) within the screen picker array
 	uint			GetScreenPickerIdx()				{ return m_ScreenPickerIdx; }
+
+	//Get a counter that is incremented whenever any object is added to or removed from a parent
+	//	- Used by the scene to know when it's flattened hierarchy needs to be rebuilt
+	static uint		GetHierarchyVersion()				{ return g_HierarchyVersion; }
 protected:
 
 //<------ OVERRIDABLE FUNCTIONALITY ---->
@@ -114,10 +139,23 @@ protected:
 	//	- This can be called multiple times per screen render, or none at all if the object is not in any visible view frustum
 	virtual void OnRenderObject()				{};	
 
+	//Returns the mesh/texture drawn by OnRenderObject, allowing the renderer to sort draw calls to minimise state changes
+	//	- Objects returning NULL (default) are assumed to do their own custom rendering and are only drawn via OnRenderObject
+	virtual Mesh* GetRenderMesh()				{ return NULL; }
+	virtual uint  GetRenderTexture()			{ return 0; }
+
+	//Returns true if drawing GetRenderMesh() with GetRenderTexture() and the object's colour is all OnRenderObject does,
+	//	allowing it to be drawn in a single instanced draw call along with all other objects using the same mesh/texture
+	virtual bool  SupportsInstancing()			{ return false; }
+
 	//Called when the object should be updated
 	//	- This is called once per frame regardless of screen-visibility and should handle all object logic
 	virtual void OnUpdateObject(float dt)		{};	
 
+	//Called by renderlists performing level of detail selection, with the approximate height of the object as a fraction of the screen height
+	//	- Only called while the object is visible, and may be called multiple times a frame (from multiple threads for different objects)
+	virtual void OnUpdateLOD(float screen_size)	{};
+
 
 //<----- MOUSE INTERACTIVITY --------->
 //	- To Enable mouse interactivity the object must call "ScreenPicker::Instance()->RegisterObject(this)"
@@ -143,6 +181,7 @@ protected:
 	Scene*						m_Scene;
 	Object*						m_Parent;
 	std::vector<Object*>		m_Children;
+	uint						m_ChildIdx;			//Index within the parent's list of children, allowing O(1) removal
 
 	//Physics
 	PhysicsObject*				m_PhysicsObject;
@@ -152,8 +191,21 @@ protected:
 	float						m_BoundingRadius;	
 	Matrix4						m_LocalTransform;
 	Matrix4						m_WorldTransform;
+	bool						m_TransformDirty;			//Local transform changed since the world transform was last built
+	bool						m_WorldTransformChanged;	//World transform was rebuilt during the last render pass
+	bool						m_RenderDirty;				//InvalidateRender was called since the last render pass
+	bool						m_RenderChanged;			//InvalidateRender was called before the last render pass
+	bool						m_PhysicsWasMoving;			//Physics object was not at rest when the world transform was last built
+	uint						m_PhysicsPoseVersion;		//Physics pose version used when the world transform was last built
 
 	//Misc Parameters
-	uint						m_FrustumCullFlags;
+	uint						m_RenderID;
 	uint						m_ScreenPickerIdx;  
+
+private:
+	//Render ID allocation - freed IDs are reused so renderlist membership arrays stay as small as possible
+	static uint					g_NumRenderIDs;
+	static std::vector<uint>	g_FreeRenderIDs;
+
+	static uint					g_HierarchyVersion;
 };
\ No newline at end of file
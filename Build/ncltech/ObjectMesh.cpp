@@ -1,4 +1,5 @@
 #include "ObjectMesh.h"
+#include <algorithm>
 
 ObjectMesh::ObjectMesh(const std::string& name)
 	: Object(name)
@@ -6,11 +7,15 @@ ObjectMesh::ObjectMesh(const std::string& name)
 	, m_DeleteTexOnCleanup(false)
 	, m_pMesh(NULL)
 	, m_Texture(0)
+	, m_CurrentLOD(0)
+	, m_pRenderMesh(NULL)
 {
 }
 
 ObjectMesh::~ObjectMesh()
 {
+	ClearLODMeshes();
+
 	if (m_DeleteMeshOnCleanup && m_pMesh)
 	{
 		delete m_pMesh;
@@ -29,12 +34,49 @@ void ObjectMesh::SetMesh(Mesh* mesh, bool deleteOnCleanup)
 	m_pMesh = mesh;
 	m_DeleteMeshOnCleanup = deleteOnCleanup;
 
+	if (m_CurrentLOD == 0)
+	{
+		m_pRenderMesh = mesh;
+	}
+
 	if (!m_Texture)
 	{
 		m_Texture = m_pMesh->GetTexture();
 	}
 }
 
+void ObjectMesh::AddLODMesh(Mesh* mesh, float max_screen_size, bool deleteOnCleanup)
+{
+	ObjectMeshLOD lod;
+	lod.mesh = mesh;
+	lod.maxScreenSize = max_screen_size;
+	lod.deleteOnCleanup = deleteOnCleanup;
+
+	m_LODs.insert(std::upper_bound(m_LODs.begin(), m_LODs.end(), lod, [](const ObjectMeshLOD& a, const ObjectMeshLOD& b)
+	{
+		return a.maxScreenSize > b.maxScreenSize;
+	}), lod);
+
+	//Indices may have shifted, so go back to full detail until the next LOD update
+	m_CurrentLOD = 0;
+	m_pRenderMesh = m_pMesh;
+}
+
+void ObjectMesh::ClearLODMeshes()
+{
+	for (ObjectMeshLOD& lod : m_LODs)
+	{
+		if (lod.deleteOnCleanup && lod.mesh)
+		{
+			delete lod.mesh;
+		}
+	}
+	m_LODs.clear();
+
+	m_CurrentLOD = 0;
+	m_pRenderMesh = m_pMesh;
+}
+
 void ObjectMesh::SetTexture(GLuint tex, bool deleteOnCleanup)
 {
 	m_Texture = tex;
@@ -45,8 +87,35 @@ void ObjectMesh::OnRenderObject()
 {
 	if (m_Texture)
 	{
-		m_pMesh->SetTexture(m_Texture);
+		m_pRenderMesh->SetTexture(m_Texture);
+	}
+
+	m_pRenderMesh->Draw();
+}
+
+void ObjectMesh::OnUpdateLOD(float screen_size)
+{
+	if (m_LODs.empty())
+		return;
+
+	uint lod = 0;
+	while (lod < m_LODs.size() && screen_size < m_LODs[lod].maxScreenSize)
+	{
+		lod++;
+	}
+
+	if (lod < m_CurrentLOD && screen_size < m_LODs[m_CurrentLOD - 1].maxScreenSize * (1.0f + OBJECTMESH_LOD_HYSTERESIS))
+	{
+		lod = m_CurrentLOD;
 	}
 
-	m_pMesh->Draw();
+	if (lod != m_CurrentLOD)
+	{
+		m_CurrentLOD = lod;
+		m_pRenderMesh = (lod == 0) ? m_pMesh : m_LODs[lod - 1].mesh;
+
+		//Flag the object as changed, so any cached renders of it (e.g. static shadow maps) are refreshed
+		// - Only touches this object's own flag, so is safe from the parallel LOD update
+		InvalidateRender();
+	}
 }
\ No newline at end of file
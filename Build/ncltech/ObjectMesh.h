@@ -15,6 +15,9 @@ If they are set then the relavent components will automatically be cleanup when
 object is deleted. This can be useful for a hands free approach, though does mean
 care must be taken when multiple objects point to the same mesh/texture.
 
+Lower detail versions of the mesh can be added with AddLODMesh, and are switched
+between automatically based on the size of the object on screen.
+
 		(\_/)							
 		( '_')							
 	 /""""""""""""\=========     -----D
@@ -25,6 +28,18 @@ care must be taken when multiple objects point to the same mesh/texture.
 #pragma once
 #include "Object.h"
 #include <nclgl/Mesh.h>
+#include <vector>
+
+//Fraction past an LOD's screen size threshold an object must reach before switching back to a more detailed mesh
+// - Stops objects flickering between meshes when sat right on the threshold
+#define OBJECTMESH_LOD_HYSTERESIS 0.1f
+
+struct ObjectMeshLOD
+{
+	Mesh*	mesh;
+	float	maxScreenSize;		//Used once the object covers less than this fraction of the screen height
+	bool	deleteOnCleanup;
+};
 
 class ObjectMesh : public Object
 {
@@ -36,6 +51,14 @@ public:
 	void	SetMesh(Mesh* mesh, bool deleteMeshOnCleanup);
 	Mesh*	GetMesh()		{ return m_pMesh; }
 
+	//Adds a lower detail version of the mesh, used once the object covers less than 'max_screen_size' of the screen's height
+	// - LODs can be added in any order, and are only selected by renderlists with screen size parameters set (e.g. the main camera view)
+	void	AddLODMesh(Mesh* mesh, float max_screen_size, bool deleteMeshOnCleanup);
+	void	ClearLODMeshes();
+
+	//Get the mesh currently being rendered, 0 being the mesh given to SetMesh and 1+ the lower detail meshes
+	uint	GetCurrentLOD()	{ return m_CurrentLOD; }
+
 	//Get/Set the texture to use for mesh rendering
 	void	SetTexture(GLuint tex, bool deleteTexOnCleanup);
 	GLuint  GetTexture()	{ return m_Texture; }
@@ -44,10 +67,25 @@ protected:
 	//Handles OpenGL calls to Render the object - called by SceneRenderer
 	void	OnRenderObject() override;				
 
+	//Switches to the LOD mesh matching the object's size on screen
+	void	OnUpdateLOD(float screen_size) override;
+
+	//Mesh/Texture used for sorting draw calls (see RenderQueue)
+	Mesh*	GetRenderMesh() override				{ return m_pRenderMesh; }
+	uint	GetRenderTexture() override				{ return (m_Texture || !m_pRenderMesh) ? m_Texture : m_pRenderMesh->GetTexture(); }
+
+	//Note: Must be overriden to return false by any derived class that changes OnRenderObject
+	bool	SupportsInstancing() override			{ return m_pRenderMesh != NULL; }
+
 protected:
 	GLuint  m_Texture;
 	Mesh*	m_pMesh;
 
+	//Level of detail meshes, sorted from most to least detailed
+	std::vector<ObjectMeshLOD> m_LODs;
+	uint	m_CurrentLOD;
+	Mesh*	m_pRenderMesh;		//Mesh for the current LOD
+
 	bool	m_DeleteMeshOnCleanup;
 	bool	m_DeleteTexOnCleanup;
 };
\ No newline at end of file
@@ -65,6 +65,7 @@ void ObjectMeshDragable::OnMouseMove(float dt, const Vector3& worldPos, const Ve
 	else
 	{
 		this->m_LocalTransform.SetPositionVector(worldPos - m_LocalClickOffset);
+		this->InvalidateWorldTransform();
 	}
 }
 
@@ -78,6 +79,7 @@ void ObjectMeshDragable::OnMouseUp(float dt, const Vector3& worldPos)
 	else
 	{
 		this->m_LocalTransform.SetPositionVector(worldPos - m_LocalClickOffset);
+		this->InvalidateWorldTransform();
 	}
 
 	this->m_Colour -= m_MouseDownColOffset;
@@ -0,0 +1,201 @@
+/******************************************************************************
+Class: ObjectPool
+Implements:
+Author: Pieran Marris <p.marris@newcastle.ac.uk>
+Description:
+Fixed size block allocator for objects that are created and destroyed at a high
+rate, such as projectiles or particles with physics. Objects are constructed
+in-place inside large chunks of memory which are never moved or released until the
+pool itself is destroyed. Once the pool has grown to the peak number of live objects,
+Allocate/Release no longer touch the heap at all and are both O(1).
+
+Every allocation is also given a handle made up of the slot index and a generation
+counter. The generation is incremented each time the slot is released, so a handle to
+an object that has since been destroyed (and possibly replaced by another) safely
+returns NULL from Get() rather than pointing at the wrong object.
+
+Note: The pool can be used with derived types (e.g. ObjectPool<MyProjectile>), but
+all objects must be released back to the same pool they were allocated from.
+
+		(\_/)
+		( '_')
+	 /""""""""""""\=========     -----D
+	/"""""""""""""""""""""""\
+....\_@____@____@____@____@_/
+
+*//////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <vector>
+#include <new>
+#include <nclgl\common.h>
+
+struct PoolHandle
+{
+	uint index;
+	uint generation;	//Zero is never a valid generation, so a default constructed handle is always invalid
+
+	PoolHandle() : index(0), generation(0) {}
+	PoolHandle(uint idx, uint gen) : index(idx), generation(gen) {}
+
+	bool IsValid() const								{ return generation != 0; }
+	bool operator==(const PoolHandle& rhs) const		{ return index == rhs.index && generation == rhs.generation; }
+	bool operator!=(const PoolHandle& rhs) const		{ return !(*this == rhs); }
+};
+
+
+template <class T, uint ChunkSize = 256>
+class ObjectPool
+{
+public:
+	ObjectPool()
+		: m_NumAllocated(0)
+		, m_FreeListHead(-1)
+	{
+	}
+
+	~ObjectPool()
+	{
+		Clear();
+
+		for (Slot* chunk : m_Chunks)
+		{
+			::operator delete(chunk);
+		}
+		m_Chunks.clear();
+	}
+
+	//Constructs a new object using the given constructor arguments
+	template <typename... Args>
+	T* Allocate(PoolHandle* out_handle, Args&&... args)
+	{
+		if (m_FreeListHead < 0)
+		{
+			Grow();
+		}
+
+		Slot* slot = GetSlot(m_FreeListHead);
+		m_FreeListHead = slot->nextFree;
+
+		T* obj = new (slot->storage) T(std::forward<Args>(args)...);
+		slot->inUse = true;
+		m_NumAllocated++;
+
+		if (out_handle != NULL)
+		{
+			*out_handle = PoolHandle(slot->index, slot->generation);
+		}
+		return obj;
+	}
+
+	//Destroys the given object and returns it's memory to the pool
+	void Release(T* obj)
+	{
+		if (obj == NULL)
+			return;
+
+		//The object is always constructed at the very start of the slot
+		Slot* slot = reinterpret_cast<Slot*>(obj);
+		if (!slot->inUse)
+			return;
+
+		obj->~T();
+		slot->inUse = false;
+		slot->generation = (slot->generation == 0xFFFFFFFF) ? 1 : slot->generation + 1;
+		slot->nextFree = m_FreeListHead;
+		m_FreeListHead = (int)slot->index;
+		m_NumAllocated--;
+	}
+
+	//Releases the object referenced by the given handle (if it is still alive)
+	void Release(const PoolHandle& handle)
+	{
+		Release(Get(handle));
+	}
+
+	//Returns the object referenced by the handle, or NULL if the object has since been released
+	T* Get(const PoolHandle& handle) const
+	{
+		if (!handle.IsValid() || handle.index >= m_Chunks.size() * ChunkSize)
+			return NULL;
+
+		Slot* slot = GetSlot(handle.index);
+		return (slot->inUse && slot->generation == handle.generation) ? reinterpret_cast<T*>(slot->storage) : NULL;
+	}
+
+	//Returns the handle of an object previously allocated from this pool
+	PoolHandle GetHandle(const T* obj) const
+	{
+		const Slot* slot = reinterpret_cast<const Slot*>(obj);
+		return PoolHandle(slot->index, slot->generation);
+	}
+
+	//Destroys all live objects, keeping the memory around for future allocations
+	void Clear()
+	{
+		for (uint i = 0; i < m_Chunks.size() * ChunkSize; ++i)
+		{
+			Slot* slot = GetSlot(i);
+			if (slot->inUse)
+			{
+				Release(reinterpret_cast<T*>(slot->storage));
+			}
+		}
+	}
+
+	//Pre-allocates enough memory to hold the given number of objects without needing to grow mid-game
+	void Reserve(uint num_objects)
+	{
+		while (m_Chunks.size() * ChunkSize < num_objects)
+		{
+			Grow();
+		}
+	}
+
+	uint GetNumAllocated() const	{ return m_NumAllocated; }
+	uint GetCapacity() const		{ return (uint)m_Chunks.size() * ChunkSize; }
+
+protected:
+	struct Slot
+	{
+		//Must remain the first member, so a T* can be converted directly back to it's slot
+		alignas(T) unsigned char storage[sizeof(T)];
+
+		uint	index;
+		uint	generation;
+		int		nextFree;
+		bool	inUse;
+	};
+
+	Slot* GetSlot(uint idx) const
+	{
+		return &m_Chunks[idx / ChunkSize][idx % ChunkSize];
+	}
+
+	void Grow()
+	{
+		const uint base_idx = (uint)m_Chunks.size() * ChunkSize;
+		Slot* chunk = static_cast<Slot*>(::operator new(sizeof(Slot) * ChunkSize));
+		m_Chunks.push_back(chunk);
+
+		//Add all new slots to the free list, in order, so allocations are sequential in memory
+		for (int i = ChunkSize - 1; i >= 0; --i)
+		{
+			Slot* slot = &chunk[i];
+			slot->index = base_idx + i;
+			slot->generation = 1;
+			slot->inUse = false;
+			slot->nextFree = m_FreeListHead;
+			m_FreeListHead = (int)slot->index;
+		}
+	}
+
+protected:
+	std::vector<Slot*>	m_Chunks;
+	uint				m_NumAllocated;
+	int					m_FreeListHead;
+
+private:
+	//No copying! - Handles and pointers would refer to the wrong pool
+	ObjectPool(const ObjectPool&) {}
+	ObjectPool& operator=(const ObjectPool&) { return *this; }
+};
\ No newline at end of file
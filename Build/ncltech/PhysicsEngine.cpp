@@ -4,6 +4,7 @@
 #include "NCLDebug.h"
 #include <nclgl\Window.h>
 #include <omp.h>
+#include <algorithm>
 
 
 void PhysicsEngine::SetDefaults()
@@ -12,11 +13,21 @@ void PhysicsEngine::SetDefaults()
 	m_IsPaused = false;
 	m_UpdateTimestep = 1.0f / 60.f;
 	m_UpdateAccum = 0.0f;
+	m_InterpolationMode = PHYSICS_INTERP_INTERPOLATE;
+	m_FrameBudgetMs = PHYSICS_DEFAULT_BUDGET_MS;
+	m_TimeDilationEnabled = true;
+	m_SolverIterations = SOLVER_ITERATIONS;
+	m_AvgStepCostMs = 0.0f;
+	m_LastFrameCostMs = 0.0f;
+	m_LastFrameSteps = 0;
+	m_TimeDilation = 1.0f;
+	m_UseBatchedContactSolver = true;
 	m_Gravity = Vector3(0.0f, -9.81f, 0.0f);
 	m_DampingFactor = 0.999f;
 }
 
 PhysicsEngine::PhysicsEngine()
+	: m_IsUpdating(false)
 {
 	SetDefaults();
 }
@@ -25,7 +36,8 @@ PhysicsEngine::~PhysicsEngine()
 {
 	for (PhysicsObject* obj : m_PhysicsObjects)
 	{
-		delete obj;
+		obj->m_EngineIdx = PHYSICSOBJECT_INVALID_IDX;
+		FreePhysicsObject(obj);
 	}
 	m_PhysicsObjects.clear();
 
@@ -34,32 +46,162 @@ PhysicsEngine::~PhysicsEngine()
 		delete c;
 	}
 	m_Constraints.clear();
+	m_ConstraintRows.clear();
 	m_Manifolds.clear();
 }
 
+PhysicsObject* PhysicsEngine::CreatePhysicsObject()
+{
+	PoolHandle handle;
+	PhysicsObject* obj = m_PhysicsObjectPool.Allocate(&handle);
+	obj->m_PoolHandle = handle;
+
+	AddPhysicsObject(obj);
+	return obj;
+}
+
+void PhysicsEngine::DestroyPhysicsObject(PhysicsObject* obj)
+{
+	if (obj == NULL)
+		return;
+
+	//The owning object is (probably) in the process of being deleted, so make sure nothing tries to reference it
+	obj->m_Parent = NULL;
+
+	if (m_IsUpdating)
+	{
+		m_PendingDestroys.push_back(obj);
+		return;
+	}
+
+	RemovePhysicsObjects(&obj, 1);
+	RemoveConstraintsOn(&obj, 1);
+	FreePhysicsObject(obj);
+}
+
+void PhysicsEngine::FreePhysicsObject(PhysicsObject* obj)
+{
+	if (obj->m_PoolHandle.IsValid())
+		m_PhysicsObjectPool.Release(obj);
+	else
+		delete obj;
+}
+
+void PhysicsEngine::RemoveConstraintsOn(PhysicsObject* const* objs, size_t count)
+{
+	//The pool slots of destroyed objects will be reused, so any constraint still pointing at them would silently
+	// start constraining whichever object is allocated next
+	auto itr = std::remove_if(m_Constraints.begin(), m_Constraints.end(), [&](Constraint* c)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (c->GetObjectA() == objs[i] || c->GetObjectB() == objs[i])
+			{
+				delete c;
+				return true;
+			}
+		}
+		return false;
+	});
+	m_Constraints.erase(itr, m_Constraints.end());
+}
+
 void PhysicsEngine::AddPhysicsObject(PhysicsObject* obj)
 {
-	m_PhysicsObjects.push_back(obj);
+	AddPhysicsObjects(&obj, 1);
+}
+
+void PhysicsEngine::AddPhysicsObjects(PhysicsObject* const* objs, size_t count)
+{
+	m_PhysicsObjects.reserve(m_PhysicsObjects.size() + count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		PhysicsObject* obj = objs[i];
+		if (obj->m_EngineIdx == PHYSICSOBJECT_INVALID_IDX)
+		{
+			obj->m_EngineIdx = (uint)m_PhysicsObjects.size();
+			m_PhysicsObjects.push_back(obj);
+		}
+	}
 }
 
 void PhysicsEngine::RemovePhysicsObject(PhysicsObject* obj)
 {
-	auto found_loc = std::find(m_PhysicsObjects.begin(), m_PhysicsObjects.end(), obj);
+	RemovePhysicsObjects(&obj, 1);
+}
+
+void PhysicsEngine::RemovePhysicsObjects(PhysicsObject* const* objs, size_t count)
+{
+	if (m_IsUpdating)
+	{
+		m_PendingRemovals.insert(m_PendingRemovals.end(), objs, objs + count);
+		return;
+	}
+
+	bool removed_any = false;
+	for (size_t i = 0; i < count; ++i)
+	{
+		PhysicsObject* obj = objs[i];
+		uint idx = obj->m_EngineIdx;
+		if (idx == PHYSICSOBJECT_INVALID_IDX)
+			continue;
+
+		//Swap and pop - order of the physics object list does not matter
+		PhysicsObject* last = m_PhysicsObjects.back();
+		m_PhysicsObjects[idx] = last;
+		last->m_EngineIdx = idx;
+		m_PhysicsObjects.pop_back();
+
+		obj->m_EngineIdx = PHYSICSOBJECT_INVALID_IDX;
+		removed_any = true;
+	}
+
+	//Manifolds from the last physics update are kept around for debug drawing, so any that reference the removed objects must go too
+	if (removed_any && !m_Manifolds.empty())
+	{
+		auto itr = std::remove_if(m_Manifolds.begin(), m_Manifolds.end(), [](Manifold* m)
+		{
+			if (m->NodeA()->IsInPhysicsEngine() && m->NodeB()->IsInPhysicsEngine())
+				return false;
+
+			delete m;
+			return true;
+		});
+		m_Manifolds.erase(itr, m_Manifolds.end());
+	}
+}
+
+void PhysicsEngine::FlushPendingRemovals()
+{
+	if (!m_PendingRemovals.empty())
+	{
+		RemovePhysicsObjects(&m_PendingRemovals[0], m_PendingRemovals.size());
+		m_PendingRemovals.clear();
+	}
 
-	if (found_loc != m_PhysicsObjects.end())
+	if (!m_PendingDestroys.empty())
 	{
-		m_PhysicsObjects.erase(found_loc);
+		RemovePhysicsObjects(&m_PendingDestroys[0], m_PendingDestroys.size());
+		RemoveConstraintsOn(&m_PendingDestroys[0], m_PendingDestroys.size());
+		for (PhysicsObject* obj : m_PendingDestroys)
+		{
+			FreePhysicsObject(obj);
+		}
+		m_PendingDestroys.clear();
 	}
 }
 
 void PhysicsEngine::RemoveAllPhysicsObjects()
 {
+	FlushPendingRemovals();
+
 	for (PhysicsObject* obj : m_PhysicsObjects)
 	{
 		if (obj != NULL)
 		{
 			if (obj->m_Parent != NULL) obj->m_Parent->m_PhysicsObject = NULL;
-			delete obj;
+			obj->m_EngineIdx = PHYSICSOBJECT_INVALID_IDX;
+			FreePhysicsObject(obj);
 		}
 	}
 	m_PhysicsObjects.clear();
@@ -69,6 +211,7 @@ void PhysicsEngine::RemoveAllPhysicsObjects()
 		delete c;
 	}
 	m_Constraints.clear();
+	m_ConstraintRows.clear();
 
 	for (Manifold* m : m_Manifolds)
 	{
@@ -84,22 +227,111 @@ void PhysicsEngine::Update(float deltaTime)
 	if (!m_IsPaused)
 	{
 		m_UpdateAccum += deltaTime;
-		for (int i = 0; (m_UpdateAccum >= m_UpdateTimestep) && i < max_updates_per_frame; ++i)
+
+		int   steps = 0;
+		float frame_cost_ms = 0.0f;
+		for (; (m_UpdateAccum >= m_UpdateTimestep) && steps < max_updates_per_frame; ++steps)
 		{
+			//Don't start another step if it is predicted to push us over budget - always allow atleast one step so the simulation can progress
+			if (steps > 0 && frame_cost_ms + m_AvgStepCostMs > m_FrameBudgetMs)
+				break;
+
 			m_UpdateAccum -= m_UpdateTimestep;
+
+			m_StepTimer.GetTimedMS();
 			if (!m_IsPaused) UpdatePhysics(); //Additional check here incase physics was paused mid-update and the contents of the physics need to be displayed
+			FlushPendingRemovals();
+			float step_cost_ms = m_StepTimer.GetTimedMS();
+
+			//Running average of step cost, used to predict whether the next step will fit within the budget
+			frame_cost_ms += step_cost_ms;
+			m_AvgStepCostMs = (m_AvgStepCostMs == 0.0f) ? step_cost_ms : m_AvgStepCostMs * 0.9f + step_cost_ms * 0.1f;
 		}
 
-		if (m_UpdateAccum >= m_UpdateTimestep)
+		m_LastFrameSteps = steps;
+		m_LastFrameCostMs = frame_cost_ms;
+
+		UpdateOverloadPolicy(deltaTime, steps * m_UpdateTimestep);
+	}
+}
+
+void PhysicsEngine::UpdateOverloadPolicy(float deltaTime, float simulatedTime)
+{
+	const bool over_budget = m_LastFrameCostMs > m_FrameBudgetMs;
+	const bool behind = m_UpdateAccum >= m_UpdateTimestep;
+
+	//Stage 1: Trade solver accuracy for speed
+	// - Solver cost is roughly linear in the number of iterations, so back off quickly when over budget and
+	//   recover slowly once there is plenty of headroom to avoid oscillating between the two.
+	// - Only the measured physics time counts here. Falling behind on it's own (e.g. a long frame spent rendering or
+	//   loading) isn't made any better by a less accurate solver, and is handled by slowing down time below.
+	if (over_budget)
+	{
+		int new_iterations = max(SOLVER_ITERATIONS_MIN, (m_SolverIterations * 3) / 4);
+		if (new_iterations != m_SolverIterations && new_iterations == SOLVER_ITERATIONS_MIN)
 		{
-			NCLERROR("Physics too slow to run in real time!");
+			NCLDebug::Log(Vector3(1.0f, 0.6f, 0.0f), "Physics overloaded - solver iterations reduced to minimum (%d)", new_iterations);
 		}
+		m_SolverIterations = new_iterations;
+	}
+	else if (m_LastFrameCostMs < m_FrameBudgetMs * 0.5f)
+	{
+		m_SolverIterations = min(SOLVER_ITERATIONS, m_SolverIterations + 1);
+	}
+
+
+	//Stage 2: Slow down simulated time
+	// - Any time we could not simulate this frame is thrown away rather than carried forward, otherwise the next frame
+	//   has even more work to do and we end up in the 'spiral of death'. The leftover timestep is kept so interpolation
+	//   between the last two physics states remains valid.
+	if (behind)
+	{
+		if (m_TimeDilationEnabled)
+		{
+			m_UpdateAccum = fmod(m_UpdateAccum, m_UpdateTimestep);
+		}
+		else
+		{
+			//Still need to bound the backlog, otherwise a single long stall (e.g. loading) will keep physics running flat out for seconds afterwards
+			m_UpdateAccum = min(m_UpdateAccum, m_UpdateTimestep * 5.0f);
+		}
+	}
+
+	if (deltaTime > 0.0f)
+	{
+		float frame_dilation = simulatedTime / deltaTime;
+		m_TimeDilation = min(m_TimeDilation * 0.9f + frame_dilation * 0.1f, 1.0f);
+	}
+}
+
+void PhysicsEngine::PrintOverloadStatus(const Vector4& colour)
+{
+	NCLDebug::AddStatusEntry(colour, "     Physics Budget : %5.2fms [step: %5.2fms x %d]", m_FrameBudgetMs, m_AvgStepCostMs, m_LastFrameSteps);
+	NCLDebug::AddStatusEntry(colour, "     Solver Iters   : %d/%d", m_SolverIterations, SOLVER_ITERATIONS);
+	NCLDebug::AddStatusEntry(colour, "     Time Dilation  : %5.2fx %s", m_TimeDilation, m_TimeDilationEnabled ? "" : "(Disabled)");
+}
+
+
+Matrix4 PhysicsEngine::GetRenderTransform(const PhysicsObject* obj)
+{
+	switch (m_InterpolationMode)
+	{
+	case PHYSICS_INTERP_INTERPOLATE:
+		return obj->GetInterpolatedWorldSpaceTransform(GetInterpolationAlpha());
+
+	case PHYSICS_INTERP_EXTRAPOLATE:
+		return obj->GetExtrapolatedWorldSpaceTransform(min(m_UpdateAccum, m_UpdateTimestep));
+
+	default:
+		return obj->GetWorldSpaceTransform();
 	}
 }
 
 
 void PhysicsEngine::UpdatePhysics()
 {
+	m_IsUpdating = true;
+
 	for (Manifold* m : m_Manifolds)
 	{
 		delete m;
@@ -115,30 +347,38 @@ void PhysicsEngine::UpdatePhysics()
 
 	//Update movement
 	UpdatePhysicsObjects();
+
+	m_IsUpdating = false;
 }
 
 void PhysicsEngine::DebugRender()
 {
+	//NCLDebug can be safely written to from multiple threads, so all the debug data can be generated in parallel
 	if (m_DebugDrawFlags & DEBUHDRAW_FLAGS_MANIFOLD)
 	{
-		for (Manifold* m : m_Manifolds)
+#pragma omp parallel for
+		for (int i = 0; i < (int)m_Manifolds.size(); ++i)
 		{
-			m->DebugDraw();
+			m_Manifolds[i]->DebugDraw();
 		}
 	}
 
 	if (m_DebugDrawFlags & DEBUHDRAW_FLAGS_CONSTRAINT)
 	{
-		for (Constraint* c : m_Constraints)
+#pragma omp parallel for
+		for (int i = 0; i < (int)m_Constraints.size(); ++i)
 		{
-			c->DebugDraw();
+			if (m_Constraints[i]->IsActive())
+				m_Constraints[i]->DebugDraw();
 		}
 	}
 
 	if (m_DebugDrawFlags & DEBUHDRAW_FLAGS_COLLISIONVOLUMES)
 	{
-		for (PhysicsObject* obj : m_PhysicsObjects)
+#pragma omp parallel for
+		for (int i = 0; i < (int)m_PhysicsObjects.size(); ++i)
 		{
+			PhysicsObject* obj = m_PhysicsObjects[i];
 			if (obj->GetCollisionShape() != NULL)
 			{
 				obj->GetCollisionShape()->DebugDraw(obj);
@@ -158,6 +398,10 @@ void PhysicsEngine::UpdatePhysicsObjects()
 
 void PhysicsEngine::UpdatePhysicsObject(PhysicsObject* obj)
 {
+	//Store the pose prior to this timestep, so the renderer can blend between the last two physics states
+	obj->m_PrevPosition = obj->m_Position;
+	obj->m_PrevOrientation = obj->m_Orientation;
+
 	//Apply Gravity
 	//	Technically gravity here is calculated by formula: ( m_Gravity / invMass * invMass * dt )
 	//	So even though the divide and multiply cancel out, we still need to handle the possibility of divide by zero.
@@ -219,7 +463,7 @@ void PhysicsEngine::BroadPhaseCollisions()
 
 	//	Brute force approach.
 	//  - Assumes every object could collide with every other object even if they are on other sides of the world.
-	for (size_t i = 0; i < m_PhysicsObjects.size() - 1; ++i)
+	for (size_t i = 0; i + 1 < m_PhysicsObjects.size(); ++i)
 	{
 		for (size_t j = i + 1; j < m_PhysicsObjects.size(); ++j)
 		{
@@ -298,21 +542,42 @@ void PhysicsEngine::SolveConstraints()
 		m->PreSolverStep(m_UpdateTimestep);
 	}
 
+	if (m_UseBatchedContactSolver)
+	{
+		m_ContactSolver.PreSolverStep(m_Manifolds, m_UpdateTimestep);
+	}
+
+	//Flatten all constraints into a single contiguous set of jacobian rows
+	// - The buffer is only cleared, not freed, so after the first few frames this no longer allocates
+	m_ConstraintRows.clear();
 	for (Constraint* c : m_Constraints)
 	{
-		c->PreSolverStep(m_UpdateTimestep);
+		if (c->IsActive())
+			c->BuildJacobianRows(m_UpdateTimestep, m_ConstraintRows);
+	}
+
+	for (ConstraintRow& row : m_ConstraintRows)
+	{
+		row.PreSolverStep();
 	}
 	
-	for (int i = 0; i < SOLVER_ITERATIONS; ++i)
+	for (int i = 0; i < m_SolverIterations; ++i)
 	{
-		for (Manifold* m : m_Manifolds)
+		if (m_UseBatchedContactSolver)
+		{
+			m_ContactSolver.ApplyImpulses();
+		}
+		else
 		{
-			m->ApplyImpulse();
+			for (Manifold* m : m_Manifolds)
+			{
+				m->ApplyImpulse();
+			}
 		}
 
-		for (Constraint* c : m_Constraints)
+		for (ConstraintRow& row : m_ConstraintRows)
 		{
-			c->ApplyImpulse();
+			row.ApplyImpulse();
 		}
 	}
 }
\ No newline at end of file
@@ -32,11 +32,15 @@ it is fine!
 #include "PhysicsObject.h"
 #include "Constraint.h"
 #include "Manifold.h"
+#include "ContactSolver.h"
+#include <nclgl\GameTimer.h>
 #include <vector>
 #include <mutex>
 
 
-#define SOLVER_ITERATIONS 50
+#define SOLVER_ITERATIONS 50			//Maximum solver iterations, used whenever the physics step fits comfortably within the frame budget
+#define SOLVER_ITERATIONS_MIN 8			//Lowest the overload policy will drop the solver iterations to before it starts slowing down time
+#define PHYSICS_DEFAULT_BUDGET_MS 8.0f	//Default time per-frame that physics is allowed to take before the overload policy kicks in
 
 
 #define FALSE	0
@@ -49,6 +53,15 @@ it is fine!
 #define DEBUHDRAW_FLAGS_COLLISIONNORMALS		0x8
 
 
+//Determines how physics objects are presented to the renderer in between fixed physics timesteps
+enum PhysicsInterpolationMode
+{
+	PHYSICS_INTERP_NONE,			//Render the raw pose from the most recent physics step (stutters if physics runs slower than the display)
+	PHYSICS_INTERP_INTERPOLATE,		//Blend between the previous and current physics step (smooth, but always up to one timestep behind)
+	PHYSICS_INTERP_EXTRAPOLATE		//Predict ahead of the current physics step using object velocities (no latency, but may overshoot collisions)
+};
+
+
 struct CollisionPair	//Forms the output of the broadphase collision detection
 {
 	PhysicsObject* objectA;
@@ -62,12 +75,27 @@ public:
 	//Reset Default Values like gravity/timestep - called when scene is switched out
 	void SetDefaults();
 
+	//Create/Destroy Physics Objects
+	// - Objects are allocated from a pool owned by the engine, so spawning/despawning large numbers of objects does not touch the heap
+	// - Created objects are automatically added to the engine
+	// - Destroying an object mid physics-update (e.g. inside a collision callback) is deferred until the end of the update
+	// - Destroying an object also deletes any constraints attached to it
+	PhysicsObject* CreatePhysicsObject();
+	void DestroyPhysicsObject(PhysicsObject* obj);
+
+	//Returns the physics object referenced by the given handle, or NULL if it has since been destroyed
+	PhysicsObject* GetPhysicsObject(const PoolHandle& handle) { return m_PhysicsObjectPool.Get(handle); }
+
 	//Add/Remove Physics Objects
+	// - Removal is O(1) and does not delete the object, so it can be re-added later (e.g. reusing inactive projectiles)
 	void AddPhysicsObject(PhysicsObject* obj);
+	void AddPhysicsObjects(PhysicsObject* const* objs, size_t count);
 	void RemovePhysicsObject(PhysicsObject* obj);
+	void RemovePhysicsObjects(PhysicsObject* const* objs, size_t count);
 	void RemoveAllPhysicsObjects(); //Delete all physics entities etc and reset-physics environment for new scene to be initialized
 
 	//Add Constraints
+	// - The engine takes ownership of the constraint, deleting it when the scene is reset or either object is destroyed
 	void AddConstraint(Constraint* c) { m_Constraints.push_back(c); }
 	
 
@@ -97,6 +125,41 @@ public:
 
 	float GetDeltaTime()				{ return m_UpdateTimestep; }
 
+	//Toggles between the batched SSE contact solver and solving each manifold one contact at a time
+	bool GetBatchedContactSolver()			{ return m_UseBatchedContactSolver; }
+	void SetBatchedContactSolver(bool use)	{ m_UseBatchedContactSolver = use; }
+
+	PhysicsInterpolationMode GetInterpolationMode()				{ return m_InterpolationMode; }
+	void SetInterpolationMode(PhysicsInterpolationMode mode)	{ m_InterpolationMode = mode; }
+
+	//Fraction (0-1) of the way the current frame is between the last physics update and the next one
+	float GetInterpolationAlpha()		{ return min(m_UpdateAccum / m_UpdateTimestep, 1.0f); }
+
+	//Returns the world transform of the given object to use for rendering this frame, based on the current interpolation mode
+	Matrix4 GetRenderTransform(const PhysicsObject* obj);
+
+
+	//Overload Policy
+	// - Rather than trying (and failing) to catch up when physics takes longer than real time, the engine measures the
+	//   cost of each step and first drops the number of solver iterations, then if allowed will slow down simulated time
+	//   to keep the physics update within the given milliseconds-per-frame budget.
+	void SetFrameBudgetMs(float ms)		{ m_FrameBudgetMs = ms; }
+	float GetFrameBudgetMs()			{ return m_FrameBudgetMs; }
+
+	void SetTimeDilationEnabled(bool enabled) { m_TimeDilationEnabled = enabled; }
+	bool GetTimeDilationEnabled()		{ return m_TimeDilationEnabled; }
+
+	int GetSolverIterations()			{ return m_SolverIterations; }
+	float GetAvgStepCostMs()			{ return m_AvgStepCostMs; }
+	float GetLastFrameCostMs()			{ return m_LastFrameCostMs; }
+	int GetLastFrameStepCount()			{ return m_LastFrameSteps; }
+
+	//Ratio of simulated time to real time over recent frames (1.0 = real time, 0.5 = half speed)
+	float GetTimeDilation()				{ return m_TimeDilation; }
+
+	//Prints the current state of the overload policy to the status entries at the top left of the screen
+	void PrintOverloadStatus(const Vector4& colour);
+
 protected:
 	PhysicsEngine();
 	~PhysicsEngine();
@@ -120,11 +183,35 @@ protected:
 	//Solves all engine constraints (constraints and manifolds)
 	void SolveConstraints();
 
+	//Removes/Destroys any objects that were requested during the last physics update
+	void FlushPendingRemovals();
+
+	//Returns the object to the pool (or deletes it if it was created outside of the engine)
+	void FreePhysicsObject(PhysicsObject* obj);
+
+	//Deletes all constraints referencing any of the given objects, called before the objects are freed
+	void RemoveConstraintsOn(PhysicsObject* const* objs, size_t count);
+
+	//Adjusts solver iterations and time dilation based on how long the physics updates took this frame
+	void UpdateOverloadPolicy(float deltaTime, float simulatedTime);
+
 protected:
 	bool		m_IsPaused;
 	float		m_UpdateTimestep, m_UpdateAccum;
 	uint		m_DebugDrawFlags;
 
+	PhysicsInterpolationMode m_InterpolationMode;
+
+	//Overload Policy
+	GameTimer	m_StepTimer;
+	float		m_FrameBudgetMs;
+	bool		m_TimeDilationEnabled;
+	int			m_SolverIterations;
+	float		m_AvgStepCostMs;
+	float		m_LastFrameCostMs;
+	int			m_LastFrameSteps;
+	float		m_TimeDilation;
+
 	Vector3		m_Gravity;
 	float		m_DampingFactor;
 
@@ -132,7 +219,16 @@ protected:
 	std::vector<CollisionPair> m_BroadphaseCollisionPairs;
 
 	std::vector<PhysicsObject*> m_PhysicsObjects;
+	ObjectPool<PhysicsObject>	m_PhysicsObjectPool;
+
+	bool						m_IsUpdating;			// True while inside UpdatePhysics, any removals are deferred until it has finished
+	std::vector<PhysicsObject*> m_PendingRemovals;
+	std::vector<PhysicsObject*> m_PendingDestroys;
 
 	std::vector<Constraint*>	m_Constraints;			// Misc constraints between pairs of object
+	ConstraintRowBuffer			m_ConstraintRows;		// Packed jacobian rows built from m_Constraints each physics update
 	std::vector<Manifold*>		m_Manifolds;			// Contact constraints between pairs of objects
+
+	bool						m_UseBatchedContactSolver;
+	ContactSolver				m_ContactSolver;		// Packs all manifold contacts into SSE batches each physics update
 };
\ No newline at end of file
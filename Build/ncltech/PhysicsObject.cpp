@@ -12,10 +12,14 @@ PhysicsObject::PhysicsObject()
 	, m_AngularVelocity(0.0f, 0.0f, 0.0f)
 	, m_Torque(0.0f, 0.0f, 0.0f)
 	, m_InvInertia(Matrix3::ZeroMatrix)
+	, m_PrevPosition(0.0f, 0.0f, 0.0f)
+	, m_PrevOrientation(0.0f, 0.0f, 0.0f, 1.0f)
+	, m_PoseVersion(1)
 	, m_colShape(NULL)
 	, m_Friction(0.5f)
 	, m_Elasticity(0.9f)
 	, m_OnCollisionCallback(nullptr)
+	, m_EngineIdx(PHYSICSOBJECT_INVALID_IDX)
 {
 }
 
@@ -40,4 +44,43 @@ const Matrix4& PhysicsObject::GetWorldSpaceTransform() const
 	}
 
 	return m_wsTransform;
+}
+
+bool PhysicsObject::IsAtRest() const
+{
+	const Vector3 zero(0.0f, 0.0f, 0.0f);
+	return m_Position == m_PrevPosition
+		&& m_Orientation.x == m_PrevOrientation.x
+		&& m_Orientation.y == m_PrevOrientation.y
+		&& m_Orientation.z == m_PrevOrientation.z
+		&& m_Orientation.w == m_PrevOrientation.w
+		&& m_LinearVelocity == zero
+		&& m_AngularVelocity == zero;
+}
+
+Matrix4 PhysicsObject::GetInterpolatedWorldSpaceTransform(float alpha) const
+{
+	if (alpha >= 1.0f)
+		return GetWorldSpaceTransform();
+
+	Quaternion orientation = Quaternion::Interpolate(m_PrevOrientation, m_Orientation, alpha);
+	orientation.Normalise();
+
+	Matrix4 transform = orientation.ToMatrix4();
+	transform.SetPositionVector(m_PrevPosition + (m_Position - m_PrevPosition) * alpha);
+	return transform;
+}
+
+Matrix4 PhysicsObject::GetExtrapolatedWorldSpaceTransform(float time_ahead) const
+{
+	if (time_ahead <= 0.0f)
+		return GetWorldSpaceTransform();
+
+	//Same integration as PhysicsEngine::UpdatePhysicsObject, just without modifying any state
+	Quaternion orientation = m_Orientation + m_Orientation * (m_AngularVelocity * time_ahead * 0.5f);
+	orientation.Normalise();
+
+	Matrix4 transform = orientation.ToMatrix4();
+	transform.SetPositionVector(m_Position + m_LinearVelocity * time_ahead);
+	return transform;
 }
\ No newline at end of file
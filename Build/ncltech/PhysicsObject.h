@@ -16,8 +16,12 @@ entities - their position, orientation, mass, collision volume, and so on.
 #include <nclgl\Quaternion.h>
 #include <nclgl\Matrix3.h>
 #include "CollisionShape.h"
+#include "ObjectPool.h"
 #include <functional>
 
+//Engine index of a physics object that has not been added to (or has since been removed from) the physics engine
+#define PHYSICSOBJECT_INVALID_IDX 0xFFFFFFFF
+
 class PhysicsEngine;
 class PhysicsObject;
 class Object;
@@ -64,20 +68,43 @@ public:
 
 	inline Object*				GetAssociatedObject()		const	{ return m_Parent; }
 
+	//Returns true if the object is currently being simulated by the physics engine
+	inline bool					IsInPhysicsEngine()			const	{ return m_EngineIdx != PHYSICSOBJECT_INVALID_IDX; }
+
+	//Handle to this object within the physics engine's object pool (invalid if this object was not created by the engine)
+	// - Unlike a raw pointer, PhysicsEngine::GetPhysicsObject(handle) will safely return NULL once the object has been destroyed
+	inline const PoolHandle&	GetPoolHandle()				const	{ return m_PoolHandle; }
+
 	const Matrix4&				GetWorldSpaceTransform()    const;
 
+	//Builds the world transform blended between the previous and current physics step
+	// - alpha of 0.0 returns the previous step's pose and 1.0 returns the current pose
+	Matrix4						GetInterpolatedWorldSpaceTransform(float alpha) const;
+
+	//Builds the world transform predicted 'time_ahead' seconds past the current physics step using the current velocities
+	Matrix4						GetExtrapolatedWorldSpaceTransform(float time_ahead) const;
+
+	//Returns true if the object did not move during the last physics step and has no velocity
+	// - While at rest the interpolated/extrapolated transforms are identical to GetWorldSpaceTransform() and will not change
+	bool						IsAtRest() const;
+
+	//Incremented each time the object is teleported with SetPosition/SetOrientation
+	// - Combined with IsAtRest() this allows the scene to skip rebuilding the world transforms of stationary objects
+	uint						GetPoseVersion() const { return m_PoseVersion; }
+
 
 
 	//<--------- SETTERS ------------->
 	inline void SetElasticity(float elasticity)						{ m_Elasticity = elasticity; }
 	inline void SetFriction(float friction)							{ m_Friction = friction; }
 
-	inline void SetPosition(const Vector3& v)						{ m_Position = v;	m_wsTransformInvalidated = true; }
+	//Note: Setting the position/orientation directly is treated as a teleport, so the object will not be interpolated from it's old pose
+	inline void SetPosition(const Vector3& v)						{ m_Position = v; m_PrevPosition = v; m_wsTransformInvalidated = true; m_PoseVersion++; }
 	inline void SetLinearVelocity(const Vector3& v)					{ m_LinearVelocity = v; }
 	inline void SetForce(const Vector3& v)							{ m_Force = v; }
 	inline void SetInverseMass(const float& v)						{ m_InvMass = v; }
 
-	inline void SetOrientation(const Quaternion& v)					{ m_Orientation = v; m_wsTransformInvalidated = true; }
+	inline void SetOrientation(const Quaternion& v)					{ m_Orientation = v; m_PrevOrientation = v; m_wsTransformInvalidated = true; m_PoseVersion++; }
 	inline void SetAngularVelocity(const Vector3& v)				{ m_AngularVelocity = v; }
 	inline void SetTorque(const Vector3& v)							{ m_Torque = v; }
 	inline void SetInverseInertia(const Matrix3& v)					{ m_InvInertia = v; }
@@ -127,7 +154,17 @@ protected:
 	Vector3		m_Torque;
 	Matrix3     m_InvInertia;
 
+	//<--------INTERPOLATION---------->
+	//Pose at the start of the last physics step, used to smooth rendering between fixed timesteps
+	Vector3		m_PrevPosition;
+	Quaternion	m_PrevOrientation;
+	uint		m_PoseVersion;
+
 	//<----------COLLISION------------>
 	CollisionShape*			m_colShape;
 	FuncCollisionCallback	m_OnCollisionCallback;
+
+	//<-----------ENGINE-------------->
+	uint					m_EngineIdx;		//Index within the physics engine's object list, allowing O(1) removal
+	PoolHandle				m_PoolHandle;
 };
\ No newline at end of file
@@ -2,42 +2,108 @@
 #include "NCLDebug.h"
 #include <algorithm>
 
-uint RenderList::g_NumRenderLists = 0;
+std::vector<RenderList*> RenderList::g_RenderLists;
 
+//Number of bits sorted per radix pass (3 passes for 32 bit keys)
+#define RADIX_BITS 11
+#define RADIX_BUCKETS (1 << RADIX_BITS)
 
-bool RenderList::AllocateNewRenderList(RenderList** renderlist, bool supportsTransparency)
+//Converts a float into an unsigned integer with the same sort order, so it can be radix sorted
+static inline uint DepthSortKey(float depth)
+{
+	uint bits;
+	memcpy(&bits, &depth, sizeof(uint));
+
+	//Negative floats have all bits flipped (reversing their order), positive floats just the sign bit
+	return bits ^ ((bits & 0x80000000) ? 0xFFFFFFFF : 0x80000000);
+}
+
+//Stable LSD radix sort on the objects' camera distances, using scratch as the temporary buffer
+static void RadixSortByDepth(std::vector<RenderList_Object>& list, std::vector<RenderList_Object>& scratch)
 {
-	if (g_NumRenderLists >= 31)
+	const size_t size = list.size();
+	scratch.resize(size);
+
+	uint counts[RADIX_BUCKETS];
+	for (uint shift = 0; shift < 32; shift += RADIX_BITS)
 	{
-		NCLERROR("Attempting to create more than 32 renderlists!");
-		return false;
+		memset(counts, 0, sizeof(counts));
+		for (size_t i = 0; i < size; ++i)
+		{
+			counts[(DepthSortKey(list[i].cam_dist_sq) >> shift) & (RADIX_BUCKETS - 1)]++;
+		}
+
+		uint offset = 0;
+		for (uint b = 0; b < RADIX_BUCKETS; ++b)
+		{
+			uint count = counts[b];
+			counts[b] = offset;
+			offset += count;
+		}
+
+		for (size_t i = 0; i < size; ++i)
+		{
+			scratch[counts[(DepthSortKey(list[i].cam_dist_sq) >> shift) & (RADIX_BUCKETS - 1)]++] = list[i];
+		}
+		list.swap(scratch);
 	}
-	
+}
+
+
+bool RenderList::AllocateNewRenderList(RenderList** renderlist, bool supportsTransparency)
+{
 	*renderlist = new RenderList();
 	(*renderlist)->m_SupportsTransparancy = supportsTransparency;
 
-	g_NumRenderLists++;
-
 	return true;
 }
 
 RenderList::RenderList()
 	: m_SupportsTransparancy(false)
 	, m_CameraPos(0.0f, 0.0f, 0.0f)
-	, m_NumElementsChanged(0)
+	, m_ScreenSizeScale(0.0f)
+	, m_MinScreenSize(RENDERLIST_MIN_SCREEN_SIZE)
+	, m_Generation(1)
+	, m_ContentsVersion(0)
 {
-	m_BitMask = 0x1 << g_NumRenderLists;
+	g_RenderLists.push_back(this);
 }
 
 RenderList::~RenderList()
 {
 	RemoveAllObjects();
-	g_NumRenderLists--;
+
+	auto itr = std::find(g_RenderLists.begin(), g_RenderLists.end(), this);
+	if (itr != g_RenderLists.end())
+	{
+		*itr = g_RenderLists.back();
+		g_RenderLists.pop_back();
+	}
+}
+
+void RenderList::RemoveObjectFromAllLists(Object* obj)
+{
+	for (RenderList* list : g_RenderLists)
+	{
+		if (list->IsObjectListed(obj))
+		{
+			list->RemoveObject(obj);
+		}
+	}
+}
+
+void RenderList::ReindexList(const std::vector<RenderList_Object>& list, uint first)
+{
+	for (uint i = first; i < list.size(); ++i)
+	{
+		SetListIndex(list[i], i);
+	}
 }
 
 void RenderList::RenderOpaqueObjects(const std::function<void(Object*)>& per_object_func)
 {
 	for (auto node : m_RenderListOpaque) {
+		if (IsTooSmall(node)) continue;
 		per_object_func(node.target_obj);
 		node.target_obj->OnRenderObject();
 	}
@@ -48,15 +114,52 @@ void RenderList::RenderTransparentObjects(const std::function<void(Object*)>& pe
 	if (m_SupportsTransparancy)
 	{
 		for (auto node : m_RenderListTransparent) {
+			if (IsTooSmall(node)) continue;
 			per_object_func(node.target_obj);
 			node.target_obj->OnRenderObject();
 		}
 	}
 }
 
+void RenderList::RecordOpaqueObjects(RenderQueue* queue, uint pass)
+{
+	//The opaque list's distances are only kept up to date if SORT_OPAQUE_LIST is enabled
+	for (const RenderList_Object& node : m_RenderListOpaque) {
+		if (IsTooSmall(node)) continue;
+		float depth = (node.target_obj->m_WorldTransform.GetPositionVector() - m_CameraPos).LengthSquared();
+		queue->Record(node.target_obj, pass, depth, false);
+	}
+}
+
+void RenderList::RecordTransparentObjects(RenderQueue* queue, uint pass, bool back_to_front)
+{
+	if (m_SupportsTransparancy)
+	{
+		for (const RenderList_Object& node : m_RenderListTransparent) {
+			if (IsTooSmall(node)) continue;
+			queue->Record(node.target_obj, pass, -node.cam_dist_sq, back_to_front);
+		}
+	}
+}
+
+bool RenderList::HasChangedObjects() const
+{
+	auto any_changed = [](const std::vector<RenderList_Object>& list)
+	{
+		for (const RenderList_Object& carry_obj : list)
+		{
+			Object* obj = carry_obj.target_obj;
+			if (obj->m_WorldTransformChanged || obj->m_RenderChanged)
+				return true;
+		}
+		return false;
+	};
+
+	return any_changed(m_RenderListOpaque) || any_changed(m_RenderListTransparent);
+}
+
 void RenderList::UpdateCameraWorldPos(const Vector3& cameraPos)
 {
-	m_NumElementsChanged = 0;
 	m_CameraPos = cameraPos;
 
 
@@ -69,18 +172,33 @@ void RenderList::UpdateCameraWorldPos(const Vector3& cameraPos)
 #pragma omp parallel for
 		for (int i = 0; i < (int)list.size(); i++)
 		{
-			list[i].cam_dist_sq = (list[i].target_obj->m_WorldTransform.GetPositionVector() - m_CameraPos).LengthSquared() * mul;
+			RenderList_Object& node = list[i];
+			float dist_sq = (node.target_obj->m_WorldTransform.GetPositionVector() - m_CameraPos).LengthSquared();
+			node.cam_dist_sq = dist_sq * mul;
+
+			if (m_ScreenSizeScale > 0.0f)
+				UpdateScreenSize(node, dist_sq);
 		}
 	};
 
 #if SORT_OPAQUE_LIST
 	update_list(m_RenderListOpaque, 1.0f);
+#else
+	//Opaque distances are not needed for sorting, but are still needed to pick each object's level of detail
+	if (m_ScreenSizeScale > 0.0f)
+		update_list(m_RenderListOpaque, 1.0f);
 #endif
 
 	if (m_SupportsTransparancy)
 		update_list(m_RenderListTransparent, -1.0f);
 }
 
+void RenderList::SetScreenSizeParameters(float proj_scale, float min_screen_size)
+{
+	m_ScreenSizeScale = proj_scale;
+	m_MinScreenSize = min_screen_size;
+}
+
 void RenderList::SortLists()
 {
 	RenderList_Object swap_buffer;
@@ -88,7 +206,23 @@ void RenderList::SortLists()
 	auto sort_list = [&](std::vector<RenderList_Object>& list)
 	{
 		int i = 1, j = 0, size = (int)list.size();
-		for (; i < size; ++i)
+
+		//If the camera has changed significantly since last frame, an insertion sort could degrade to O(n^2)
+		int num_out_of_order = 0;
+		for (i = 1; i < size && num_out_of_order <= RADIX_SORT_THRESHOLD; ++i)
+		{
+			if (list[i - 1].cam_dist_sq > list[i].cam_dist_sq)
+				num_out_of_order++;
+		}
+
+		if (num_out_of_order > RADIX_SORT_THRESHOLD)
+		{
+			RadixSortByDepth(list, m_SortScratch);
+			ReindexList(list, 0);
+			return;
+		}
+
+		for (i = 1; i < size; ++i)
 		{
 			swap_buffer = list[i];
 			j = i - 1;
@@ -96,10 +230,15 @@ void RenderList::SortLists()
 			while (j >= 0 && list[j].cam_dist_sq > swap_buffer.cam_dist_sq)
 			{
 				list[j + 1] = list[j];
+				SetListIndex(list[j + 1], j + 1);
 				j--;
 			}
 
-			list[j + 1] = swap_buffer;
+			if (j + 1 != i)
+			{
+				list[j + 1] = swap_buffer;
+				SetListIndex(swap_buffer, j + 1);
+			}
 		}
 	};
 
@@ -115,17 +254,43 @@ void RenderList::RemoveExcessObjects(const Frustum& frustum)
 {
 	auto mark_objects_for_removal = [&](std::vector<RenderList_Object>& list)
 	{
-		//First iterate over each object in the list and mark it for removal (this can easily be parallised as it does not need any synchronisation)
+		//First gather the bounding spheres of all objects in the list into seperate arrays, so they can be culled in batches
 		const int size = (int)list.size();
+		m_CullX.resize(size);
+		m_CullY.resize(size);
+		m_CullZ.resize(size);
+		m_CullRadius.resize(size);
+		m_CullVisible.resize((size + 31) / 32);
 
 #pragma omp parallel for
 		for (int i = 0; i < size; ++i)
 		{
-			Object* obj = list[i].target_obj;
+			const Object* obj = list[i].target_obj;
+			const Matrix4& wt = obj->m_WorldTransform;
+			m_CullX[i] = wt[12];
+			m_CullY[i] = wt[13];
+			m_CullZ[i] = wt[14];
+			m_CullRadius[i] = obj->GetBoundingRadius();
+		}
+
+		//Cull spheres in blocks (multiples of 32 so each block writes to it's own mask entries), then mark any objects
+		// outside the frustum for removal (this can easily be parallised as it does not need any synchronisation)
+		const int num_blocks = (size + FRUSTUM_CULL_BLOCK_SIZE - 1) / FRUSTUM_CULL_BLOCK_SIZE;
+
+#pragma omp parallel for
+		for (int b = 0; b < num_blocks; ++b)
+		{
+			const int start = b * FRUSTUM_CULL_BLOCK_SIZE;
+			const int count = min(size - start, FRUSTUM_CULL_BLOCK_SIZE);
+			uint* visible = &m_CullVisible[start / 32];
+			frustum.InsideFrustumBatch(&m_CullX[start], &m_CullY[start], &m_CullZ[start], &m_CullRadius[start], count, visible);
 
-			if (!frustum.InsideFrustum(obj->m_WorldTransform.GetPositionVector(), obj->GetBoundingRadius()))
+			for (int i = 0; i < count; ++i)
 			{
-				obj->m_FrustumCullFlags &= ~m_BitMask;
+				if (!(visible[i / 32] & (1u << (i % 32))))
+				{
+					UnmarkObjectListed(list[start + i].target_obj);
+				}
 			}
 		}
 
@@ -133,18 +298,22 @@ void RenderList::RemoveExcessObjects(const Frustum& frustum)
 		int n_removed = 0;
 		for (int i = 0; i < size; ++i)
 		{
-			if (! (list[i].target_obj->m_FrustumCullFlags & m_BitMask) )
+			if (!IsObjectListed(list[i].target_obj))
 			{
 				n_removed++;
 			}
 			else if (n_removed > 0)
 			{
 				list[i - n_removed] = list[i];
+				SetListIndex(list[i], i - n_removed);
 			}
 		}
 
 		if (n_removed > 0)
+		{
 			list._Pop_back_n(n_removed);
+			m_ContentsVersion++;
+		}
 
 	};
 
@@ -163,113 +332,130 @@ void RenderList::InsertObject(Object* obj)
 		return; 
 	}
 
-	if (m_NumElementsChanged >= MAX_LIST_CHANGE_PER_FRAME)
-	{
-		//No more list changes this frame - all new elements will have to be added over future frames
-		return;
-	}
-	m_NumElementsChanged++;
-	obj->m_FrustumCullFlags |= m_BitMask;
-
-
-	auto target_list = &m_RenderListOpaque;
+	MarkObjectListed(obj);
 
 	RenderList_Object carry_obj;
 	carry_obj.target_obj = obj;
-		
-#if !SORT_OPAQUE_LIST
-	if (!isOpaque)
+	carry_obj.cam_dist_sq = (obj->m_WorldTransform.GetPositionVector() - m_CameraPos).LengthSquared();
+	carry_obj.screen_size = 0.0f;
+	if (m_ScreenSizeScale > 0.0f)
+		UpdateScreenSize(carry_obj, carry_obj.cam_dist_sq);
+
+	if (isOpaque)
+	{
+		SetListIndex(carry_obj, (uint)m_PendingOpaque.size());
+		m_PendingOpaque.push_back(carry_obj);
+	}
+	else
+	{
+		//To cheat the sorting system to always use the same sorting opperand, we just invert all transparent distances so negative far is less than neg near.
+		carry_obj.cam_dist_sq = -carry_obj.cam_dist_sq;
+		SetListIndex(carry_obj, (uint)m_PendingTransparent.size());
+		m_PendingTransparent.push_back(carry_obj);
+	}
+}
+
+void RenderList::FinalizeInsertions()
+{
+	auto merge_pending = [&](std::vector<RenderList_Object>& list, std::vector<RenderList_Object>& pending, bool sorted)
 	{
-#endif		
-		carry_obj.cam_dist_sq = (obj->m_WorldTransform.GetPositionVector() - m_CameraPos).LengthSquared();
+		if (pending.empty())
+			return;
 
-		if (!isOpaque)
-		{
-			//If the object is transparent, add it to the transparent render list
-			target_list = &m_RenderListTransparent;
+		m_ContentsVersion++;
 
-			//To cheat the sorting system to always use the same sorting opperand, we just invert all transparent distances so negative far is less than neg near.
-			carry_obj.cam_dist_sq = -carry_obj.cam_dist_sq;
+		if (!sorted)
+		{
+			const uint first = (uint)list.size();
+			list.insert(list.end(), pending.begin(), pending.end());
+			ReindexList(list, first);
 		}
-
-		//Find where the object should be inserted
-		auto loc = target_list->end();
-		for (auto itr = target_list->begin(); itr != target_list->end(); itr++)
+		else
 		{
-			if (itr->cam_dist_sq > carry_obj.cam_dist_sq)
+			//Sort the new objects on their own, then merge both sorted lists together in a single O(n) pass
+			if (pending.size() > RADIX_SORT_THRESHOLD)
+			{
+				RadixSortByDepth(pending, m_SortScratch);
+			}
+			else
 			{
-				loc = itr;
-				break;
+				std::stable_sort(pending.begin(), pending.end(), [](const RenderList_Object& a, const RenderList_Object& b)
+				{
+					return a.cam_dist_sq < b.cam_dist_sq;
+				});
 			}
+
+			m_SortScratch.resize(list.size() + pending.size());
+			std::merge(list.begin(), list.end(), pending.begin(), pending.end(), m_SortScratch.begin(), [](const RenderList_Object& a, const RenderList_Object& b)
+			{
+				return a.cam_dist_sq < b.cam_dist_sq;
+			});
+			list.swap(m_SortScratch);
+			ReindexList(list, 0);
 		}
-		target_list->insert(loc, carry_obj);
 
-#if !SORT_OPAQUE_LIST
-	}
-	else
-	{
-		m_RenderListOpaque.push_back(carry_obj);
-	}
+		pending.clear();
+	};
+
+#if SORT_OPAQUE_LIST
+	merge_pending(m_RenderListOpaque, m_PendingOpaque, true);
+#else
+	merge_pending(m_RenderListOpaque, m_PendingOpaque, false);
 #endif
+	merge_pending(m_RenderListTransparent, m_PendingTransparent, true);
 }
 
 void RenderList::RemoveObject(Object* obj)
 {
-	bool isOpaque = obj->IsOpaque();
-	if (!m_SupportsTransparancy && !isOpaque)
-	{
-		//This renderlist does not support transparent objects
+	if (!IsObjectListed(obj))
 		return;
-	}
 
-	
+	UnmarkObjectListed(obj);
+	m_ContentsVersion++;
 
-	auto target_list = isOpaque ? &m_RenderListOpaque : &m_RenderListTransparent;
-	uint new_size = target_list->size();
+	const uint idx = m_ListIndices[obj->m_RenderID];
+	auto remove_from_list = [&](std::vector<RenderList_Object>& list)
+	{
+		if (idx >= list.size() || list[idx].target_obj != obj)
+			return false;
+
+		//Swap and pop - this will leave the list slightly out of order, which is fixed up by the next SortLists
+		list[idx] = list.back();
+		SetListIndex(list[idx], idx);
+		list.pop_back();
+		return true;
+	};
 
-	bool found = false;
-	uint idx = 0;
-	for (uint i = 0; found == false && i < new_size; ++i)
+	//The index only says where the object is, not which list it is in. Check the list the object should be in first, though
+	// if the objects opacity has changed since it was inserted (or it is being called from within the object's destructor)
+	// it could still be in the other list
+	bool isOpaque = obj->IsOpaque();
+	bool found = remove_from_list(isOpaque ? m_RenderListOpaque : m_RenderListTransparent);
+	if (!found)
 	{
-		if ((*target_list)[i].target_obj == obj)
-		{
-			found = true;
-			idx = i;
-			break;
-		}
+		found = remove_from_list(isOpaque ? m_RenderListTransparent : m_RenderListOpaque);
 	}
 
-	if (found)
+	//Could also have been inserted this frame, and not yet merged into the list
+	if (!found && !remove_from_list(m_PendingOpaque))
 	{
-		new_size--; //As we want to remove an object from the end of the list
-
-		//Move all elements after the 'to be deleted element' forward, so we can safely pop the last element without losing anyone
-		for (uint i = idx; i < new_size; ++i)
-		{
-			(*target_list)[i] = (*target_list)[i+1];
-		}
-
-		target_list->pop_back();
+		remove_from_list(m_PendingTransparent);
 	}
 }
 
 void RenderList::RemoveAllObjects()
 {
-	auto unmark_objects = [&](std::vector<RenderList_Object>& list)
+	//Invalidate all existing stamps at once, only needing to physically clear the array when the generation wraps around
+	m_Generation++;
+	if (m_Generation == 0)
 	{
-		//First iterate over each object in the list and mark it for removal (this can easily be parallised as it does not need any synchronisation)
-		const int size = (int)list.size();
+		std::fill(m_MembershipStamps.begin(), m_MembershipStamps.end(), 0);
+		m_Generation = 1;
+	}
 
-#pragma omp parallel for
-		for (int i = 0; i < size; ++i)
-		{
-			Object* obj = list[i].target_obj;
-			obj->m_FrustumCullFlags &= ~m_BitMask;
-		}
-	};
-	unmark_objects(m_RenderListOpaque);
 	m_RenderListOpaque.clear();
-
-	unmark_objects(m_RenderListTransparent);
 	m_RenderListTransparent.clear();
+	m_PendingOpaque.clear();
+	m_PendingTransparent.clear();
+	m_ContentsVersion++;
 }
\ No newline at end of file
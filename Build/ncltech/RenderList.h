@@ -13,10 +13,14 @@ This results in a slightly more effecient method of handling render lists. It al
 list can be kept permenantly sorted, and only small changes per frame will be required resulting in
 a fast insertion sort method that plays heavily on this frame coherency.
 
-The drawback (other than not being implemented very well) is that in order to keep track of
-whether an object is already in the list or not a bitwise flag is set on the Object itself. This
-results in a hard-limit of 32 renderlists. As the constructor could exceed this value, a factory is
-used to create the renderlist, returning false if all renderlists have already been allocated previously.
+In order to keep track of whether an object is already in the list or not, each renderlist stores
+an array of generation stamps indexed by the Object's unique render ID. An object is in the list if
+it's stamp matches the list's current generation, so membership checks are O(1) and clearing the
+entire list only requires incrementing the generation. Alongside each stamp the list also stores the
+object's current position in the list, so a single object can be removed in O(1) by swapping it with
+the last element. As the arrays belong to the renderlists (not
+the objects) there is no limit on the number of renderlists, and multiple lists can be built in
+parallel without ever writing to the same memory.
 
 
 		(\_/)
@@ -28,6 +32,7 @@ used to create the renderlist, returning false if all renderlists have already b
 *//////////////////////////////////////////////////////////////////////////////
 #pragma once
 #include "Object.h"
+#include "RenderQueue.h"
 #include <nclgl\Frustum.h>
 #include <nclgl\common.h>
 #include <nclgl\Vector3.h>
@@ -35,15 +40,22 @@ used to create the renderlist, returning false if all renderlists have already b
 
 
 
-//Maximum number of elements added to the renderlist per frame 
-// - Will be added on future frames instead to share workload and prevent lock-ups
-#define MAX_LIST_CHANGE_PER_FRAME 300
+//Number of out-of-order elements above which SortLists performs a full radix sort instead of an insertion sort
+// - Insertion sort is fastest when the list is almost sorted (frame coherency), radix sort when the camera snaps to a new view
+#define RADIX_SORT_THRESHOLD 64
 
 //Sort opaque objects front to back to reduce over drawing - tie up between slow sorting or slow rendering, in the current
 //usage the sorting is almost always the bottlekneck. 
 // - Transparent objects however /always/ need to be sorted in order to correctly blend with background objects.
 #define SORT_OPAQUE_LIST FALSE 
 
+//Number of objects frustum culled per parallel task in RemoveExcessObjects (must be a multiple of 32)
+#define FRUSTUM_CULL_BLOCK_SIZE 1024
+
+//Default minimum height (as a fraction of the screen height) an object must cover before it is drawn, see SetScreenSizeParameters
+// - Roughly two pixels at 1080p
+#define RENDERLIST_MIN_SCREEN_SIZE 0.002f
+
 
 
 
@@ -51,6 +63,7 @@ used to create the renderlist, returning false if all renderlists have already b
 struct RenderList_Object
 {
 	float cam_dist_sq;
+	float screen_size;		//Approximate height of the object as a fraction of the screen height (only if enabled for the list)
 	Object* target_obj;
 };
 
@@ -60,46 +73,97 @@ public:
 	virtual ~RenderList();
 
 	//RenderList Factory
-	//  - Attempts to create new renderlist - returns false if max-renderlists (32) have already previously been allocated.
+	//  - Creates a new renderlist and registers it so deleted objects are automatically removed from it
 	static bool AllocateNewRenderList(RenderList** renderlist, bool supportsTransparency); 
 
 
 	//Updates all current objects 'distance' to camera
+	// - If screen size parameters have been set, this also selects each object's level of detail (see Object::OnUpdateLOD)
 	void UpdateCameraWorldPos(const Vector3& cameraPos); 
 
-	//Sort lists based on camera position using insertion sort. With frame coherency,
-	// the list should be 'almost' sorted each frame and only a few elements need to be swapped in this function.
+	//Enables level of detail selection and small object culling for lists viewed through a perspective projection
+	// - 'proj_scale' converts an objects bounding radius over it's distance into a fraction of the screen height (1 / tan(fov / 2))
+	// - Objects smaller than 'min_screen_size' are kept in the list, but skipped when rendering/recording draw commands
+	// - A proj_scale of zero disables both (default)
+	void SetScreenSizeParameters(float proj_scale, float min_screen_size = RENDERLIST_MIN_SCREEN_SIZE);
+
+	//Sort lists based on camera position. With frame coherency the list should be 'almost' sorted each frame, and only
+	// a few elements need to be swapped via insertion sort. If the camera moves suddenly a radix sort is used instead.
 	void SortLists(); 
 
 	//Removes all objects no longer inside the frustum
 	void RemoveExcessObjects(const Frustum& frustum); 
 
-	//Called when object moves inside the frustum (Inserts via insertion sort)
+	//Called when object moves inside the frustum
+	// - New objects are batched up and only sorted/merged into the list when 'FinalizeInsertions' is called
 	void InsertObject(Object* obj); 
 
+	//Sorts all objects inserted since the last call and merges them into the list in a single pass
+	void FinalizeInsertions();
+
 	//Misc. Removes a single object from the list, in general just call 'RemoveExcessObjects' and let it remove the object automatically
+	// - O(1) swap and pop, the next call to 'SortLists' will move the swapped object back into order
 	void RemoveObject(Object* obj); 
 
 	//Clears the entire list
 	void RemoveAllObjects(); 
 
+	//Removes the given object from every renderlist it is currently listed in (e.g. when the object is being despawned)
+	static void RemoveObjectFromAllLists(Object* obj);
+
 
 	//Iterate over each object in the list calling the provided function per-object.
 	void RenderOpaqueObjects(const std::function<void(Object*)>& per_object_func);
 	void RenderTransparentObjects(const std::function<void(Object*)>& per_object_func);
 
-	//Get the bitmask set per Object in the list
-	uint BitMask() { return m_BitMask; }
+	//Adds all objects in the list to the given queue, to be sorted by render state rather than just distance.
+	// - Transparent objects should be recorded back to front, unless blending is not required (e.g. shadow maps)
+	void RecordOpaqueObjects(RenderQueue* queue, uint pass);
+	void RecordTransparentObjects(RenderQueue* queue, uint pass, bool back_to_front = true);
+
+	//Incremented whenever objects are added to or removed from the list
+	uint GetContentsVersion() const			{ return m_ContentsVersion; }
+
+	//Returns true if any object in the list had it's world transform rebuilt, or was flagged with Object::InvalidateRender,
+	// before the last Scene::BuildWorldMatrices
+	// - Together with GetContentsVersion this allows the result of rendering the list to be cached (e.g. static shadow maps)
+	bool HasChangedObjects() const;
+
+	//Returns true if the given object is currently contained within this list
+	inline bool IsObjectListed(const Object* obj) const
+	{
+		return obj->m_RenderID < m_MembershipStamps.size() && m_MembershipStamps[obj->m_RenderID] == m_Generation;
+	}
+
+protected:
+	inline void UpdateScreenSize(RenderList_Object& node, float dist_sq);
+	inline bool IsTooSmall(const RenderList_Object& node) const		{ return m_ScreenSizeScale > 0.0f && node.screen_size < m_MinScreenSize; }
+
+	inline void MarkObjectListed(const Object* obj);
+	inline void SetListIndex(const RenderList_Object& node, uint idx)	{ m_ListIndices[node.target_obj->m_RenderID] = idx; }
+	void ReindexList(const std::vector<RenderList_Object>& list, uint first);
+	inline void UnmarkObjectListed(const Object* obj)
+	{
+		if (obj->m_RenderID < m_MembershipStamps.size())
+			m_MembershipStamps[obj->m_RenderID] = 0;
+	}
 
 protected:
-	//Keeps a list of the number of unique render lists as to enforce and maintain the hard limit on 32 renderlists.
-	static uint g_NumRenderLists; 
+	//All currently allocated renderlists
+	static std::vector<RenderList*> g_RenderLists;
 	
 	
-	uint m_NumElementsChanged;
+	//Generation stamp per object render ID, an object is in this list only if it's stamp matches the current generation
+	// - Zero is never a valid generation, so unused entries are never counted as listed
+	std::vector<uint> m_MembershipStamps;
+	uint m_Generation;
+
+	//Position of each listed object (by render ID) within whichever of the lists below it is currently in
+	// - Only valid while the object is listed, and updated whenever an object is moved within it's list
+	std::vector<uint> m_ListIndices;
 
-	//Bit mask for renderlist, uint leads to 32 booleans (1's or 0's) thus there is a hardlimit of 31 shadow maps along with the main camera render list. 
-	uint m_BitMask;				 
+	//Incremented on any change to the objects in the list
+	uint m_ContentsVersion;
 
 	//If false - all transparent objects will be ignored (maybe shadow render passes?)
 	bool m_SupportsTransparancy; 
@@ -107,14 +171,46 @@ protected:
 	//Last provided camera position for sorting/inserting new objects
 	Vector3 m_CameraPos;
 
+	//Level of detail / small object culling (disabled if the scale is zero)
+	float m_ScreenSizeScale;
+	float m_MinScreenSize;
+
 	//Sorted renderlists of visible objects
 	std::vector<RenderList_Object> m_RenderListOpaque;
 	std::vector<RenderList_Object> m_RenderListTransparent;
 
+	//Objects inserted this frame, waiting to be merged into the sorted lists
+	std::vector<RenderList_Object> m_PendingOpaque;
+	std::vector<RenderList_Object> m_PendingTransparent;
+	std::vector<RenderList_Object> m_SortScratch;
+
+	//Scratch SoA bounding spheres and visibility bitmask for batched frustum culling (kept per-list so lists can be culled in parallel)
+	std::vector<float> m_CullX, m_CullY, m_CullZ, m_CullRadius;
+	std::vector<uint>  m_CullVisible;
+
 private:
 	//Private Constructor - Allocate through 'AllocateNewRenderList' factory method
 	RenderList();
 
-	//No copying! - the deconstructor updates a global counter of active renderlists so deleting a copy would cause all future renderlist instances to overlap each other
+	//No copying! - the deconstructor removes the list from the global registry so deleting a copy would leave the original unregistered
 	RenderList(const RenderList& rl) {}
 };
+
+inline void RenderList::UpdateScreenSize(RenderList_Object& node, float dist_sq)
+{
+	//Clamped so the size doesn't explode once the camera is inside the object's bounds
+	const float radius = node.target_obj->m_BoundingRadius;
+	node.screen_size = radius * m_ScreenSizeScale / sqrt(max(dist_sq, max(radius * radius, 1e-6f)));
+	node.target_obj->OnUpdateLOD(node.screen_size);
+}
+
+inline void RenderList::MarkObjectListed(const Object* obj)
+{
+	if (obj->m_RenderID >= m_MembershipStamps.size())
+	{
+		//Grow in large steps, as new objects will be given sequential IDs
+		m_MembershipStamps.resize(max((size_t)obj->m_RenderID + 1, m_MembershipStamps.size() * 2), 0);
+		m_ListIndices.resize(m_MembershipStamps.size(), 0);
+	}
+	m_MembershipStamps[obj->m_RenderID] = m_Generation;
+}
@@ -0,0 +1,161 @@
+#include "RenderQueue.h"
+#include <cstring>
+
+//Converts a float into an unsigned integer with the same sort order
+static inline uint OrderedFloatBits(float value)
+{
+	uint bits;
+	memcpy(&bits, &value, sizeof(uint));
+	return bits ^ ((bits & 0x80000000) ? 0xFFFFFFFF : 0x80000000);
+}
+
+RenderQueue::RenderQueue()
+	: m_NumTextureChanges(0)
+	, m_NumMeshChanges(0)
+{
+}
+
+RenderQueue::~RenderQueue()
+{
+	m_Commands.clear();
+	m_SortScratch.clear();
+}
+
+void RenderQueue::Clear()
+{
+	m_Commands.clear();
+	m_NumTextureChanges = 0;
+	m_NumMeshChanges = 0;
+}
+
+uint64_t RenderQueue::BuildKey(uint pass, uint texture_id, uint mesh_id, float depth, bool back_to_front)
+{
+	//Keep the most significant bits of the depth, which still gives a relative precision of ~1/500000
+	uint64_t depth_bits = OrderedFloatBits(depth) >> (32 - RENDERQUEUE_DEPTH_BITS);
+	uint64_t key = (uint64_t)(pass & ((1 << RENDERQUEUE_PASS_BITS) - 1)) << (64 - RENDERQUEUE_PASS_BITS);
+
+	uint64_t texture_bits = texture_id & ((1 << RENDERQUEUE_TEXTURE_BITS) - 1);
+	uint64_t mesh_bits = mesh_id & ((1 << RENDERQUEUE_MESH_BITS) - 1);
+
+	if (back_to_front)
+	{
+		//[pass | inverted depth | texture | mesh]
+		depth_bits = ((1 << RENDERQUEUE_DEPTH_BITS) - 1) - depth_bits;
+		key |= depth_bits << (RENDERQUEUE_TEXTURE_BITS + RENDERQUEUE_MESH_BITS);
+		key |= texture_bits << RENDERQUEUE_MESH_BITS;
+		key |= mesh_bits;
+	}
+	else
+	{
+		//[pass | texture | mesh | depth]
+		key |= texture_bits << (RENDERQUEUE_MESH_BITS + RENDERQUEUE_DEPTH_BITS);
+		key |= mesh_bits << RENDERQUEUE_DEPTH_BITS;
+		key |= depth_bits;
+	}
+
+	return key;
+}
+
+uint RenderQueue::GetTextureID(uint texture)
+{
+	auto itr = m_TextureIDs.find(texture);
+	if (itr != m_TextureIDs.end())
+		return itr->second;
+
+	//Out of IDs - start again, this will only affect sorting quality (not correctness) for the current frame
+	if (m_TextureIDs.size() >= (1 << RENDERQUEUE_TEXTURE_BITS))
+		m_TextureIDs.clear();
+
+	uint id = (uint)m_TextureIDs.size();
+	m_TextureIDs[texture] = id;
+	return id;
+}
+
+uint RenderQueue::GetMeshID(const Mesh* mesh)
+{
+	if (mesh == NULL)
+		return RENDERQUEUE_CUSTOM_MESH_ID;
+
+	auto itr = m_MeshIDs.find(mesh);
+	if (itr != m_MeshIDs.end())
+		return itr->second;
+
+	if (m_MeshIDs.size() >= RENDERQUEUE_CUSTOM_MESH_ID)
+		m_MeshIDs.clear();
+
+	uint id = (uint)m_MeshIDs.size();
+	m_MeshIDs[mesh] = id;
+	return id;
+}
+
+void RenderQueue::Record(Object* obj, uint pass, float depth, bool back_to_front)
+{
+	RenderCommand cmd;
+	cmd.obj = obj;
+	cmd.meshID = (uint16_t)GetMeshID(obj->GetRenderMesh());
+	cmd.textureID = (uint16_t)GetTextureID(obj->GetRenderTexture());
+	cmd.key = BuildKey(pass, cmd.textureID, cmd.meshID, depth, back_to_front);
+	m_Commands.push_back(cmd);
+}
+
+void RenderQueue::Sort()
+{
+	const size_t size = m_Commands.size();
+	m_SortScratch.resize(size);
+
+	//Build histograms for all 8 radix digits in a single pass over the keys
+	uint counts[8][256];
+	memset(counts, 0, sizeof(counts));
+	for (size_t i = 0; i < size; ++i)
+	{
+		uint64_t key = m_Commands[i].key;
+		for (uint d = 0; d < 8; ++d)
+		{
+			counts[d][(key >> (d * 8)) & 0xFF]++;
+		}
+	}
+
+	//Stable LSD radix sort, skipping any digit that is the same for all commands (e.g. the pass is always constant)
+	for (uint d = 0; d < 8; ++d)
+	{
+		uint* digit_counts = counts[d];
+		if (size == 0 || digit_counts[(m_Commands[0].key >> (d * 8)) & 0xFF] == size)
+			continue;
+
+		uint offset = 0;
+		for (uint b = 0; b < 256; ++b)
+		{
+			uint count = digit_counts[b];
+			digit_counts[b] = offset;
+			offset += count;
+		}
+
+		for (size_t i = 0; i < size; ++i)
+		{
+			m_SortScratch[digit_counts[(m_Commands[i].key >> (d * 8)) & 0xFF]++] = m_Commands[i];
+		}
+		m_Commands.swap(m_SortScratch);
+	}
+
+	//Count the state changes needed to draw the queue in it's new order
+	m_NumTextureChanges = 0;
+	m_NumMeshChanges = 0;
+	for (size_t i = 0; i < size; ++i)
+	{
+		if (i == 0 || m_Commands[i].textureID != m_Commands[i - 1].textureID)
+			m_NumTextureChanges++;
+
+		if (i == 0 || m_Commands[i].meshID != m_Commands[i - 1].meshID)
+			m_NumMeshChanges++;
+	}
+}
+
+void RenderQueue::Submit(const std::function<void(Object*)>& per_object_func) const
+{
+	//Redundant texture/vertex array binds between consecutive commands are skipped inside Mesh::Draw
+	for (const RenderCommand& cmd : m_Commands)
+	{
+		per_object_func(cmd.obj);
+		cmd.obj->OnRenderObject();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,103 @@
+/******************************************************************************
+Class: RenderQueue
+Implements:
+Author: Pieran Marris <p.marris@newcastle.ac.uk>
+Description:
+Sorted list of draw commands, built from the contents of a RenderList each time
+it is rendered. Each command is given a 64 bit sort key made up of (from most to
+least significant): render pass, texture, mesh and finally depth. Sorting by
+these keys groups all objects using the same state together, so the number of
+texture/vertex array binds (which the Mesh class already skips if redundant) is
+kept to a minimum, while still drawing front to back within each group. There is
+no shader field, as every object within a pass is drawn with the pass's shader.
+
+Transparent objects must still be drawn back to front, so for these the depth is
+moved up to directly follow the render pass, with state only used to group
+objects at the same depth.
+
+Recording and sorting commands never touches OpenGL, so the queue can be built,
+sorted and the resulting number of state changes measured without a GL context.
+
+		(\_/)
+		( '_')
+	 /""""""""""""\=========     -----D
+	/"""""""""""""""""""""""\
+....\_@____@____@____@____@_/
+
+*//////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include "Object.h"
+#include <nclgl\common.h>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <cstdint>
+
+//Number of bits given to each field within the sort key
+#define RENDERQUEUE_PASS_BITS		4
+#define RENDERQUEUE_TEXTURE_BITS	16
+#define RENDERQUEUE_MESH_BITS		16
+#define RENDERQUEUE_DEPTH_BITS		28
+
+//Mesh ID given to objects that handle their own rendering, placing them after all mesh objects in the same pass/texture
+#define RENDERQUEUE_CUSTOM_MESH_ID	((1 << RENDERQUEUE_MESH_BITS) - 1)
+
+enum RenderPass
+{
+	RENDERPASS_SHADOW		= 0,
+	RENDERPASS_OPAQUE		= 1,
+	RENDERPASS_TRANSPARENT	= 2
+};
+
+struct RenderCommand
+{
+	uint64_t	key;
+	Object*		obj;
+	uint16_t	textureID;
+	uint16_t	meshID;
+};
+
+class RenderQueue
+{
+public:
+	RenderQueue();
+	~RenderQueue();
+
+	//Removes all commands (Mesh/Texture IDs are kept so keys remain consistent between frames)
+	void Clear();
+
+	//Adds a command to draw the given object
+	// - 'depth' can be any value that increases with distance from the camera (e.g. squared distance)
+	// - If back_to_front is set, depth takes priority over all state within the pass (required for transparent objects)
+	void Record(Object* obj, uint pass, float depth, bool back_to_front = false);
+
+	//Sorts all recorded commands by key (radix sort) and counts the resulting number of state changes
+	void Sort();
+
+	//Calls 'per_object_func' (for setting per object uniforms) followed by Object::OnRenderObject for each command in order
+	void Submit(const std::function<void(Object*)>& per_object_func) const;
+
+	const std::vector<RenderCommand>& GetCommands() const	{ return m_Commands; }
+
+	//Number of times the texture/mesh changes between consecutive commands after the last call to Sort
+	uint GetNumTextureChanges() const						{ return m_NumTextureChanges; }
+	uint GetNumMeshChanges() const							{ return m_NumMeshChanges; }
+
+	//Builds a sort key from the given (already compacted) fields
+	static uint64_t BuildKey(uint pass, uint texture_id, uint mesh_id, float depth, bool back_to_front);
+
+protected:
+	uint GetTextureID(uint texture);
+	uint GetMeshID(const Mesh* mesh);
+
+protected:
+	std::vector<RenderCommand>	m_Commands;
+	std::vector<RenderCommand>	m_SortScratch;
+
+	//Maps textures/meshes to small sequential IDs that fit into the sort key
+	std::unordered_map<uint, uint>			m_TextureIDs;
+	std::unordered_map<const Mesh*, uint>	m_MeshIDs;
+
+	uint m_NumTextureChanges;
+	uint m_NumMeshChanges;
+};
\ No newline at end of file
@@ -4,8 +4,21 @@
 #include "PhysicsEngine.h"
 #include <algorithm>
 
+//Objects no longer in the scene tree must also be taken out of the renderlists, as they will no longer be updated/culled
+static void RemoveFromRenderLists(Object* node)
+{
+	RenderList::RemoveObjectFromAllLists(node);
+
+	for (Object* child : node->GetChildren())
+	{
+		RemoveFromRenderLists(child);
+	}
+}
+
 Scene::Scene(const std::string& friendly_name)
 	: m_SceneName(friendly_name)
+	, m_TransformLevelsVersion(0)
+	, m_NumWorldMatricesUpdated(0)
 {	
 	m_RootGameObject = new Object("rootNode");
 	m_RootGameObject->m_Scene = this;
@@ -21,9 +34,82 @@ Scene::~Scene()
 	}
 }
 
+bool Scene::AreRequiredAssetsLoaded() const
+{
+	for (const AssetHandle<Asset>& asset : m_RequiredAssets)
+	{
+		if (!asset->IsDone())
+			return false;
+	}
+	return true;
+}
+
+void Scene::WaitForRequiredAssets()
+{
+	for (const AssetHandle<Asset>& asset : m_RequiredAssets)
+	{
+		AssetManager::Instance()->WaitFor(asset.Get());
+	}
+}
+
 void Scene::AddGameObject(Object* game_object)
 {
-	m_RootGameObject->AddChildObject(game_object);
+	AddGameObjects(&game_object, 1);
+}
+
+void Scene::AddGameObjects(Object* const* game_objects, size_t count)
+{
+	m_SpawnPhysicsObjects.clear();
+	m_RootGameObject->m_Children.reserve(m_RootGameObject->m_Children.size() + count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		m_RootGameObject->AddChildObject(game_objects[i]);
+		GatherPhysicsObjects(game_objects[i], m_SpawnPhysicsObjects);
+	}
+
+	//Re-add any physics objects that were previously removed from the simulation (objects already being simulated are ignored)
+	if (!m_SpawnPhysicsObjects.empty())
+	{
+		PhysicsEngine::Instance()->AddPhysicsObjects(&m_SpawnPhysicsObjects[0], m_SpawnPhysicsObjects.size());
+	}
+}
+
+void Scene::RemoveGameObject(Object* game_object)
+{
+	RemoveGameObjects(&game_object, 1);
+}
+
+void Scene::RemoveGameObjects(Object* const* game_objects, size_t count)
+{
+	m_SpawnPhysicsObjects.clear();
+	for (size_t i = 0; i < count; ++i)
+	{
+		Object* obj = game_objects[i];
+		if (obj->m_Parent != NULL)
+		{
+			obj->m_Parent->RemoveChildObject(obj);
+		}
+		GatherPhysicsObjects(obj, m_SpawnPhysicsObjects);
+		RemoveFromRenderLists(obj);
+	}
+
+	if (!m_SpawnPhysicsObjects.empty())
+	{
+		PhysicsEngine::Instance()->RemovePhysicsObjects(&m_SpawnPhysicsObjects[0], m_SpawnPhysicsObjects.size());
+	}
+}
+
+void Scene::GatherPhysicsObjects(Object* node, std::vector<PhysicsObject*>& out_objects)
+{
+	if (node->HasPhysics())
+	{
+		out_objects.push_back(node->Physics());
+	}
+
+	for (Object* child : node->m_Children)
+	{
+		GatherPhysicsObjects(child, out_objects);
+	}
 }
 
 Object* Scene::FindGameObject(const std::string& name)
@@ -40,6 +126,7 @@ void Scene::DeleteAllGameObjects()
 			delete child;
 		}
 		m_RootGameObject->m_Children.clear();
+		m_TransformLevelsVersion = 0;
 	}
 }
 
@@ -50,50 +137,132 @@ void Scene::OnUpdateScene(float dt)
 
 void Scene::BuildWorldMatrices()
 {
-	UpdateWorldMatrices(m_RootGameObject, Matrix4());
+	if (m_TransformLevelsVersion != Object::GetHierarchyVersion())
+	{
+		BuildTransformLevels();
+	}
+
+	//Each level only reads the world transforms of the level above, so all nodes within a level can be updated at once
+	int num_updated = 0;
+	for (std::vector<Object*>& level : m_TransformLevels)
+	{
+		const int num_nodes = (int)level.size();
+
+#pragma omp parallel for reduction(+:num_updated) if (num_nodes > SCENE_PARALLEL_TRANSFORM_THRESHOLD)
+		for (int i = 0; i < num_nodes; ++i)
+		{
+			if (UpdateWorldMatrix(level[i]))
+				num_updated++;
+		}
+	}
+	m_NumWorldMatricesUpdated = num_updated;
+
+	//Refit the culling hierarchy to the new object positions
+	m_BVH.Update(m_FlatObjects);
 }
 
-void Scene::UpdateWorldMatrices(Object* cNode, const Matrix4& parentWM)
+void Scene::BuildTransformLevels()
 {
-	if (cNode->HasPhysics())
-		cNode->m_WorldTransform = parentWM * cNode->Physics()->GetWorldSpaceTransform() * cNode->m_LocalTransform;
-	else
-		cNode->m_WorldTransform = parentWM * cNode->m_LocalTransform;
+	m_TransformLevelsVersion = Object::GetHierarchyVersion();
+
+	//Breadth first walk of the scene tree, reusing the existing level arrays to avoid re-allocating
+	m_FlatObjects.clear();
+	if (m_TransformLevels.empty())
+		m_TransformLevels.resize(1);
+
+	m_TransformLevels[0].clear();
+	m_TransformLevels[0].push_back(m_RootGameObject);
+	size_t num_levels = 1;
+
+	while (true)
+	{
+		if (m_TransformLevels.size() <= num_levels)
+			m_TransformLevels.resize(num_levels + 1);
+
+		const std::vector<Object*>& parents = m_TransformLevels[num_levels - 1];
+		std::vector<Object*>& level = m_TransformLevels[num_levels];
+		level.clear();
+		for (Object* parent : parents)
+		{
+			level.insert(level.end(), parent->m_Children.begin(), parent->m_Children.end());
+		}
+
+		if (level.empty())
+			break;
 
-	for (auto child : cNode->GetChildren()) {
-		UpdateWorldMatrices(child, cNode->m_WorldTransform);
+		//The root node only defines the bounds of the scene and is never rendered
+		m_FlatObjects.insert(m_FlatObjects.end(), level.begin(), level.end());
+		num_levels++;
 	}
+	m_TransformLevels.resize(num_levels);
 }
 
-void Scene::InsertToRenderList(RenderList* list, const Frustum& frustum)
+bool Scene::UpdateWorldMatrix(Object* node)
 {
-	InsertToRenderList(m_RootGameObject, list, frustum);
+	//Moving parents always drag their children with them
+	bool dirty = node->m_TransformDirty
+		|| (node->m_Parent != NULL && node->m_Parent->m_WorldTransformChanged);
+
+	PhysicsObject* phys = node->m_PhysicsObject;
+	if (phys != NULL)
+	{
+		//While moving the rendered pose changes every frame (interpolation), and it needs to be rebuilt once more
+		// after coming to rest to snap to the final pose. Static/resting objects can reuse their last transform.
+		const bool moving = !phys->IsAtRest();
+		if (moving || node->m_PhysicsWasMoving || phys->GetPoseVersion() != node->m_PhysicsPoseVersion)
+			dirty = true;
+
+		node->m_PhysicsWasMoving = moving;
+		node->m_PhysicsPoseVersion = phys->GetPoseVersion();
+	}
+
+	node->m_RenderChanged = node->m_RenderDirty;
+	node->m_RenderDirty = false;
+
+	node->m_WorldTransformChanged = dirty;
+	if (!dirty)
+		return false;
+
+	node->m_TransformDirty = false;
+	const Matrix4 parentWM = (node->m_Parent != NULL) ? node->m_Parent->m_WorldTransform : Matrix4();
+
+	if (phys != NULL)
+		node->m_WorldTransform = parentWM * PhysicsEngine::Instance()->GetRenderTransform(phys) * node->m_LocalTransform;
+	else
+		node->m_WorldTransform = parentWM * node->m_LocalTransform;
+
+	return true;
 }
 
-void Scene::InsertToRenderList(Object* node, RenderList* list, const Frustum& frustum)
+SceneBVHCullStats Scene::InsertToRenderList(RenderList* list, const Frustum& frustum)
 {
-	bool inside = frustum.InsideFrustum(node->m_WorldTransform.GetPositionVector(), node->m_BoundingRadius);
-
-	if (inside)
+	SceneBVHCullStats stats = m_BVH.ForEachVisible(frustum, [list](Object* obj)
 	{
 		//Check to see if the object is already listed or not
-		if (!(list->BitMask() & node->m_FrustumCullFlags))
+		if (!list->IsObjectListed(obj))
 		{
-			list->InsertObject(node);
+			list->InsertObject(obj);
 		}
-	}
+	});
 
-	//Iterate through all child nodes
-	for (auto child : node->GetChildren()) {
-		InsertToRenderList(child, list, frustum);
-	}
+	//Merge all newly visible objects into the sorted list at once
+	list->FinalizeInsertions();
+	return stats;
 }
 
 void Scene::UpdateNode(float dt, Object* cNode)
 {
 	cNode->OnUpdateObject(dt);
 
-	for (auto child : cNode->GetChildren()) {
+	//Iterated by index as objects may despawn themselves (or others) mid-update
+	// - Children are removed by swap and pop, so if the child just updated is no longer in it's slot, another
+	//   (not yet updated) child has been moved into it and the index must not advance
+	std::vector<Object*>& children = cNode->GetChildren();
+	for (size_t i = 0; i < children.size();) {
+		Object* child = children[i];
 		UpdateNode(dt, child);
+
+		if (i < children.size() && children[i] == child)
+			++i;
 	}
 }
@@ -39,6 +39,11 @@ and handle cleanup of Objects yourself.
 #include "TSingleton.h"
 #include "Object.h"
 #include "RenderList.h"
+#include "SceneBVH.h"
+#include "AssetManager.h"
+
+//Minimum number of objects in a single depth level of the scene tree before their world transforms are updated in parallel
+#define SCENE_PARALLEL_TRANSFORM_THRESHOLD 256
 
 
 class Scene
@@ -54,27 +59,69 @@ public:
 	void DeleteAllGameObjects(); //Easiest way of cleaning up the scene - unless you need to save some game objects after scene becomes innactive for some reason.
 
 	void AddGameObject(Object* game_object);
+
+	//Batched Spawn/Despawn
+	// - Removing an object does not delete it, but takes it (and all of it's children) out of the scene, physics engine
+	//   and any renderlists. This allows objects with a high turnover (e.g. projectiles) to be kept aside by the caller and
+	//   re-added later without any further allocations. Any constraints on a removed object are kept, but are not
+	//   solved until it is added back (see Constraint::IsActive).
+	// - The scene does not pool Objects itself, only their PhysicsObjects come from a pool (see PhysicsEngine::CreatePhysicsObject)
+	void AddGameObjects(Object* const* game_objects, size_t count);
+	void RemoveGameObject(Object* game_object);
+	void RemoveGameObjects(Object* const* game_objects, size_t count);
 	Object* FindGameObject(const std::string& name);
 
 	const std::string& GetSceneName() { return m_SceneName; }
 
+	//Adds an asset the scene needs before it can be initialized, e.g. from the scene's constructor. When switching
+	//to this scene, the SceneManager keeps the current scene running until they have all loaded (see AssetManager)
+	// - Assets that failed to load count as loaded too (the AssetManager reports the error), so check IsReady() before using them
+	void RequireAsset(Asset* asset)		{ m_RequiredAssets.push_back(AssetHandle<Asset>(asset)); }
+	bool AreRequiredAssetsLoaded() const;
+	void WaitForRequiredAssets();
+
 	//Sets maximum bounds of the scene - for use in shadowing
 	void  SetWorldRadius(float radius)	{ m_RootGameObject->SetBoundingRadius(radius); }
 
 
 	float GetWorldRadius()				{ return m_RootGameObject->GetBoundingRadius(); }
 
+	//Rebuilds the world transforms of all objects that have moved since the last call, and refits the culling hierarchy to match
+	// - Transforms are updated one depth level at a time, with each level split across threads
 	void BuildWorldMatrices();
-	void InsertToRenderList(RenderList* list, const Frustum& frustum);
 
+	//Number of world transforms that actually had to be recomputed during the last call to BuildWorldMatrices
+	int  GetNumWorldMatricesUpdated() const	{ return m_NumWorldMatricesUpdated; }
+
+	//Inserts all objects inside the given frustum into the renderlist, returning the number of nodes/objects that had to be tested
+	// - Thread safe, so renderlists for multiple views (e.g. shadow cascades) can be built in parallel
+	SceneBVHCullStats InsertToRenderList(RenderList* list, const Frustum& frustum);
+
+	const SceneBVH& GetBVH() const		{ return m_BVH; }
 
 protected:
 
-	void	UpdateWorldMatrices(Object* node, const Matrix4& parentWM);
-	void	InsertToRenderList(Object* node, RenderList* list, const Frustum& frustum);
+	void	BuildTransformLevels();
+	bool	UpdateWorldMatrix(Object* node);
 	void	UpdateNode(float dt, Object* cNode);
+	void	GatherPhysicsObjects(Object* node, std::vector<PhysicsObject*>& out_objects);
 
 protected:
 	std::string			m_SceneName;
 	Object*				m_RootGameObject;
+
+	std::vector<AssetHandle<Asset>> m_RequiredAssets;
+
+	//Scratch list of physics objects for batched spawning/despawning (kept to avoid re-allocating each time)
+	std::vector<PhysicsObject*> m_SpawnPhysicsObjects;
+
+	//Scene tree flattened into depth levels (level 0 is the root node), so each level only depends on the one before it
+	// - Only rebuilt when objects are added/removed from the tree (see Object::GetHierarchyVersion)
+	std::vector<std::vector<Object*>> m_TransformLevels;
+	uint					m_TransformLevelsVersion;
+	int						m_NumWorldMatricesUpdated;
+
+	//Flattened list of all objects in the scene tree (excluding the root), rebuilt along with the transform levels and used to refit the BVH
+	std::vector<Object*>	m_FlatObjects;
+	SceneBVH				m_BVH;
 };
\ No newline at end of file
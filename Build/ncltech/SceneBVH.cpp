@@ -0,0 +1,204 @@
+#include "SceneBVH.h"
+#include <algorithm>
+
+//Rebuild the tree once the summed surface area of all nodes has grown to this many times it's original value through refitting
+// - A rough indicator that objects have moved far enough from where they were built that nodes overlap significantly
+#define BVH_REBUILD_AREA_RATIO 2.0f
+
+static inline float SurfaceArea(const BoundingBox& bb)
+{
+	Vector3 d = bb.maxPoints - bb.minPoints;
+	return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+SceneBVH::SceneBVH()
+	: m_BuiltTotalArea(0.0f)
+	, m_TotalArea(0.0f)
+	, m_NumRebuilds(0)
+	, m_NumRefittedLastUpdate(0)
+	, m_MaxDepth(0)
+{
+}
+
+SceneBVH::~SceneBVH()
+{
+	m_Objects.clear();
+	m_Nodes.clear();
+}
+
+void SceneBVH::Update(const std::vector<Object*>& objects)
+{
+	m_NumRefittedLastUpdate = 0;
+
+	//Any change in the objects contained within the scene requires a full rebuild
+	if (objects != m_Objects)
+	{
+		m_Objects = objects;
+		Rebuild();
+		return;
+	}
+
+	//Find all objects that have moved (or changed size) since last frame
+	m_DirtyLeaves.clear();
+	for (size_t i = 0; i < m_Objects.size(); ++i)
+	{
+		const Object* obj = m_Objects[i];
+		Vector3 centre = obj->m_WorldTransform.GetPositionVector();
+		float radius = obj->m_BoundingRadius;
+
+		Vector4& cached = m_ObjectSpheres[i];
+		if (cached.x != centre.x || cached.y != centre.y || cached.z != centre.z || cached.w != radius)
+		{
+			cached = Vector4(centre.x, centre.y, centre.z, radius);
+
+			int leaf = m_ObjectLeaf[i];
+			if (!m_LeafDirtyFlags[leaf])
+			{
+				m_LeafDirtyFlags[leaf] = true;
+				m_DirtyLeaves.push_back(leaf);
+			}
+		}
+	}
+
+	//Refit each dirty leaf and walk up the tree until the parent bounds no longer change
+	for (int leaf : m_DirtyLeaves)
+	{
+		m_LeafDirtyFlags[leaf] = false;
+
+		int node_idx = leaf;
+		while (node_idx >= 0)
+		{
+			BoundingBox old_bounds = m_Nodes[node_idx].bounds;
+			RecomputeNodeBounds(node_idx);
+			m_NumRefittedLastUpdate++;
+
+			const BoundingBox& new_bounds = m_Nodes[node_idx].bounds;
+			m_TotalArea += SurfaceArea(new_bounds) - SurfaceArea(old_bounds);
+			if (node_idx != leaf
+				&& old_bounds.minPoints == new_bounds.minPoints
+				&& old_bounds.maxPoints == new_bounds.maxPoints)
+			{
+				break;
+			}
+
+			node_idx = m_Nodes[node_idx].parent;
+		}
+	}
+
+	//If the objects have spread out far enough, the tree built from their original positions will no longer be very effective
+	if (m_TotalArea > m_BuiltTotalArea * BVH_REBUILD_AREA_RATIO)
+	{
+		Rebuild();
+	}
+}
+
+void SceneBVH::Rebuild()
+{
+	m_NumRebuilds++;
+
+	const int num_objects = (int)m_Objects.size();
+	m_ObjectSpheres.resize(num_objects);
+	m_ObjectLeaf.resize(num_objects);
+	m_ObjectOrder.resize(num_objects);
+	m_Nodes.clear();
+	m_MaxDepth = 0;
+
+	for (int i = 0; i < num_objects; ++i)
+	{
+		const Object* obj = m_Objects[i];
+		Vector3 centre = obj->m_WorldTransform.GetPositionVector();
+		m_ObjectSpheres[i] = Vector4(centre.x, centre.y, centre.z, obj->m_BoundingRadius);
+		m_ObjectOrder[i] = i;
+	}
+
+	if (num_objects > 0)
+	{
+		m_Nodes.reserve((num_objects / BVH_MAX_LEAF_OBJECTS + 1) * 2);
+		BuildRecursive(-1, 0, num_objects, 0);
+	}
+
+	m_LeafDirtyFlags.assign(m_Nodes.size(), false);
+
+	m_TotalArea = 0.0f;
+	for (const SceneBVHNode& node : m_Nodes)
+	{
+		m_TotalArea += SurfaceArea(node.bounds);
+	}
+	m_BuiltTotalArea = max(m_TotalArea, 0.0001f);
+}
+
+int SceneBVH::BuildRecursive(int parent, int first, int count, int depth)
+{
+	int node_idx = (int)m_Nodes.size();
+	m_Nodes.push_back(SceneBVHNode());
+
+	{
+		SceneBVHNode& node = m_Nodes[node_idx];
+		node.parent = parent;
+		node.rightChild = 0;
+		node.first = first;
+		node.count = count;
+	}
+
+	if (count <= BVH_MAX_LEAF_OBJECTS)
+	{
+		m_MaxDepth = max(m_MaxDepth, depth);
+		for (int i = first; i < first + count; ++i)
+		{
+			m_ObjectLeaf[m_ObjectOrder[i]] = node_idx;
+		}
+	}
+	else
+	{
+		//Split along the longest axis of the object centres, at the median object
+		BoundingBox centre_bounds;
+		for (int i = first; i < first + count; ++i)
+		{
+			const Vector4& s = m_ObjectSpheres[m_ObjectOrder[i]];
+			centre_bounds.ExpandToFit(Vector3(s.x, s.y, s.z));
+		}
+
+		Vector3 size = centre_bounds.maxPoints - centre_bounds.minPoints;
+		int axis = (size.x > size.y && size.x > size.z) ? 0 : (size.y > size.z ? 1 : 2);
+
+		auto begin = m_ObjectOrder.begin() + first;
+		std::nth_element(begin, begin + count / 2, begin + count, [&](int a, int b)
+		{
+			const Vector4& sa = m_ObjectSpheres[a];
+			const Vector4& sb = m_ObjectSpheres[b];
+			return (axis == 0) ? (sa.x < sb.x) : ((axis == 1) ? (sa.y < sb.y) : (sa.z < sb.z));
+		});
+
+		BuildRecursive(node_idx, first, count / 2, depth + 1);
+		int right = BuildRecursive(node_idx, first + count / 2, count - count / 2, depth + 1);
+		m_Nodes[node_idx].rightChild = right;
+	}
+
+	RecomputeNodeBounds(node_idx);
+	return node_idx;
+}
+
+void SceneBVH::RecomputeNodeBounds(int node_idx)
+{
+	SceneBVHNode& node = m_Nodes[node_idx];
+	node.bounds = BoundingBox();
+
+	if (node.rightChild == 0)
+	{
+		for (int i = node.first; i < node.first + node.count; ++i)
+		{
+			const Vector4& s = m_ObjectSpheres[m_ObjectOrder[i]];
+			node.bounds.ExpandToFit(Vector3(s.x - s.w, s.y - s.w, s.z - s.w));
+			node.bounds.ExpandToFit(Vector3(s.x + s.w, s.y + s.w, s.z + s.w));
+		}
+	}
+	else
+	{
+		const BoundingBox& left = m_Nodes[node_idx + 1].bounds;
+		const BoundingBox& right = m_Nodes[node.rightChild].bounds;
+		node.bounds.ExpandToFit(left.minPoints);
+		node.bounds.ExpandToFit(left.maxPoints);
+		node.bounds.ExpandToFit(right.minPoints);
+		node.bounds.ExpandToFit(right.maxPoints);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,221 @@
+/******************************************************************************
+Class: SceneBVH
+Implements:
+Author: Pieran Marris <p.marris@newcastle.ac.uk>
+Description:
+Bounding volume hierarchy over the world-space bounding spheres of every Object in
+the scene, used to quickly find all objects inside a given view frustum.
+
+Rather than testing every object against all six planes for every renderlist (main
+camera + each shadow cascade), the frustum is tested against the boxes of the tree.
+Any node entirely outside a plane is skipped along with everything beneath it, and
+any plane that a node is entirely inside of is removed from the plane mask for all of
+it's children. Once no planes remain, the whole subtree is accepted without any
+further tests.
+
+The tree is only rebuilt when objects are added/removed from the scene (or objects
+have moved so much the tree has become inefficient). Otherwise each frame only the
+leaves of objects that have moved are refitted, along with their parent nodes up to
+the point the bounds stop changing.
+
+The tree has no graphics dependencies, so can be built and timed headlessly.
+
+		(\_/)
+		( '_')
+	 /""""""""""""\=========     -----D
+	/"""""""""""""""""""""""\
+....\_@____@____@____@____@_/
+
+*//////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include "Object.h"
+#include "BoundingBox.h"
+#include <nclgl\Frustum.h>
+#include <vector>
+
+//Maximum number of objects stored in a single leaf node
+#define BVH_MAX_LEAF_OBJECTS 4
+
+//All six frustum planes still need testing
+#define BVH_PLANEMASK_ALL 0x3F
+
+//Traversal stack entries kept on the call stack, deeper trees use a heap allocated stack instead
+// - Median splits keep the tree depth around log2(objects / BVH_MAX_LEAF_OBJECTS), so this is only exceeded by huge scenes
+#define BVH_LOCAL_STACK_SIZE 64
+
+struct SceneBVHNode
+{
+	BoundingBox bounds;
+	int parent;			//-1 for the root node
+	int rightChild;		//Left child always directly follows it's parent - 0 if this node is a leaf
+	int first;			//Range of m_ObjectOrder covered by this node (and all of it's children)
+	int count;
+};
+
+struct SceneBVHCullStats
+{
+	int nodesVisited;
+	int objectsTested;
+	int objectsAccepted;
+};
+
+class SceneBVH
+{
+public:
+	SceneBVH();
+	~SceneBVH();
+
+	//Updates the tree to match the given objects and their current world transforms
+	// - If the set of objects is unchanged since the last update, only the moved objects are refitted
+	void Update(const std::vector<Object*>& objects);
+
+	//Forces a full rebuild on the next update
+	void Invalidate()						{ m_Objects.clear(); }
+
+	//Calls 'func(Object*)' for every object whose bounding sphere intersects the given frustum
+	// - Thread safe as long as Update is not being called at the same time, so multiple frustums can be culled in parallel
+	template <typename Func>
+	SceneBVHCullStats ForEachVisible(const Frustum& frustum, const Func& func) const;
+
+	size_t GetNumNodes() const				{ return m_Nodes.size(); }
+	size_t GetNumObjects() const			{ return m_Objects.size(); }
+	int GetNumRebuilds() const				{ return m_NumRebuilds; }
+	int GetNumRefittedLastUpdate() const	{ return m_NumRefittedLastUpdate; }
+	int GetMaxDepth() const					{ return m_MaxDepth; }
+
+protected:
+	void Rebuild();
+	int  BuildRecursive(int parent, int first, int count, int depth);
+	void RecomputeNodeBounds(int node_idx);
+
+protected:
+	std::vector<Object*>		m_Objects;			//Objects the tree was built from
+	std::vector<Vector4>		m_ObjectSpheres;	//Cached world space sphere (xyz=centre, w=radius) of each object, used to detect movement
+	std::vector<int>			m_ObjectLeaf;		//Leaf node containing each object
+	std::vector<int>			m_ObjectOrder;		//Object indices, ordered so each node covers a contiguous range
+	std::vector<SceneBVHNode>	m_Nodes;
+
+	std::vector<int>			m_DirtyLeaves;		//Scratch list of leaves that need refitting
+	std::vector<bool>			m_LeafDirtyFlags;
+
+	float	m_BuiltTotalArea;		//Summed surface area of all nodes when built, used to detect when the tree has degraded
+	float	m_TotalArea;
+	int		m_NumRebuilds;
+	int		m_NumRefittedLastUpdate;
+	int		m_MaxDepth;				//Depth of the deepest leaf (root is 0), the traversal stack never needs more than m_MaxDepth + 1 entries
+};
+
+
+
+template <typename Func>
+SceneBVHCullStats SceneBVH::ForEachVisible(const Frustum& frustum, const Func& func) const
+{
+	SceneBVHCullStats stats;
+	memset(&stats, 0, sizeof(SceneBVHCullStats));
+
+	if (m_Nodes.empty())
+		return stats;
+
+	//Planes are copied out once, rather than accessed through the frustum for each node
+	Vector3 plane_normals[6];
+	float plane_dists[6];
+	Vector3 plane_abs_normals[6];
+	for (int p = 0; p < 6; ++p)
+	{
+		const Plane& plane = frustum.GetPlane(p);
+		plane_normals[p] = plane.GetNormal();
+		plane_dists[p] = plane.GetDistance();
+		plane_abs_normals[p] = Vector3(fabs(plane_normals[p].x), fabs(plane_normals[p].y), fabs(plane_normals[p].z));
+	}
+
+	//Stack based traversal, each entry stores the node index along with the planes it still needs testing against
+	// - Each node popped pushes at most two children, leaving at most one entry per level of the tree (plus one)
+	int local_stack[BVH_LOCAL_STACK_SIZE * 2];
+	std::vector<int> heap_stack;
+	int* stack = local_stack;
+	if (m_MaxDepth + 1 > BVH_LOCAL_STACK_SIZE)
+	{
+		heap_stack.resize((m_MaxDepth + 1) * 2);
+		stack = &heap_stack[0];
+	}
+
+	int stack_size = 1;
+	stack[0] = 0;
+	stack[1] = BVH_PLANEMASK_ALL;
+
+	while (stack_size > 0)
+	{
+		--stack_size;
+		const SceneBVHNode& node = m_Nodes[stack[stack_size * 2]];
+		int mask = stack[stack_size * 2 + 1];
+		stats.nodesVisited++;
+
+		//Test the node's box against all remaining planes
+		// - Entirely behind any plane and the whole subtree can be skipped
+		// - Entirely in front of a plane, and none of the children need to test against it
+		Vector3 centre = (node.bounds.minPoints + node.bounds.maxPoints) * 0.5f;
+		Vector3 extents = (node.bounds.maxPoints - node.bounds.minPoints) * 0.5f;
+
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; ++p)
+		{
+			if (!(mask & (1 << p)))
+				continue;
+
+			float dist = Vector3::Dot(centre, plane_normals[p]) + plane_dists[p];
+			float radius = Vector3::Dot(extents, plane_abs_normals[p]);
+
+			if (dist <= -radius)
+				outside = true;
+			else if (dist >= radius)
+				mask &= ~(1 << p);
+		}
+
+		if (outside)
+			continue;
+
+		if (mask == 0 || node.rightChild == 0)
+		{
+			//Either entirely inside the frustum (all objects accepted) or a leaf (each object's sphere tested individually)
+			for (int i = node.first; i < node.first + node.count; ++i)
+			{
+				int obj_idx = m_ObjectOrder[i];
+				bool inside = true;
+
+				if (mask != 0)
+				{
+					stats.objectsTested++;
+					const Vector4& sphere = m_ObjectSpheres[obj_idx];
+					for (int p = 0; p < 6 && inside; ++p)
+					{
+						if ((mask & (1 << p))
+							&& (sphere.x * plane_normals[p].x + sphere.y * plane_normals[p].y + sphere.z * plane_normals[p].z + plane_dists[p] <= -sphere.w))
+						{
+							inside = false;
+						}
+					}
+				}
+
+				if (inside)
+				{
+					stats.objectsAccepted++;
+					func(m_Objects[obj_idx]);
+				}
+			}
+		}
+		else
+		{
+			int node_idx = (int)(&node - &m_Nodes[0]);
+
+			stack[stack_size * 2] = node.rightChild;
+			stack[stack_size * 2 + 1] = mask;
+			stack_size++;
+
+			stack[stack_size * 2] = node_idx + 1;
+			stack[stack_size * 2 + 1] = mask;
+			stack_size++;
+		}
+	}
+
+	return stats;
+}
\ No newline at end of file
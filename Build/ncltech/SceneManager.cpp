@@ -5,6 +5,7 @@
 SceneManager::SceneManager() 
 	: SceneRenderer()
 	, m_SceneIdx(NULL)
+	, m_PendingSceneIdx(-1)
 {
 
 }
@@ -54,6 +55,23 @@ void SceneManager::JumpToScene(int idx)
 		return;
 	}
 
+	//Keep the current scene running while the new one's assets load, unless there isn't one to keep running
+	Scene* scene = m_AllScenes[idx];
+	if (m_Scene && !scene->AreRequiredAssetsLoaded())
+	{
+		m_PendingSceneIdx = idx;
+		Window::GetWindow().SetWindowTitle("NCLTech - [%d/%d] %s (Loading...)", idx + 1, m_AllScenes.size(), scene->GetSceneName().c_str());
+		return;
+	}
+
+	scene->WaitForRequiredAssets();
+	ActivateScene(idx);
+}
+
+void SceneManager::ActivateScene(int idx)
+{
+	m_PendingSceneIdx = -1;
+
 	//Clear up old scene
 	if (m_Scene)
 	{
@@ -77,6 +95,16 @@ void SceneManager::JumpToScene(int idx)
 	Window::GetWindow().SetWindowTitle("NCLTech - [%d/%d] %s", idx + 1, m_AllScenes.size(), m_Scene->GetSceneName().c_str());
 }
 
+void SceneManager::UpdateScene(float dt)
+{
+	AssetManager::Instance()->Update();
+
+	if (m_PendingSceneIdx >= 0 && m_AllScenes[m_PendingSceneIdx]->AreRequiredAssetsLoaded())
+		ActivateScene(m_PendingSceneIdx);
+
+	SceneRenderer::UpdateScene(dt);
+}
+
 void SceneManager::JumpToScene(const std::string& friendly_name)
 {
 	bool found = false;
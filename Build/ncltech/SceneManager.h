@@ -11,6 +11,8 @@ shown to the user.
 
 Scenes can be switched between by using one of the JumpToScene methods. This will
 call <scene>->OnInitializeScene() and <oldscene>->OnCleanupScene() respectively.
+If the new scene is still waiting on assets it needs (see Scene::RequireAsset), the
+old scene keeps running until they have loaded, and the switch happens then.
 
 This class is a singleton, so is unique and can be accessed globally.
 
@@ -44,6 +46,9 @@ public:
 	//Jump to scene name
 	void JumpToScene(const std::string& friendly_name);
 
+	//Uploads any loaded assets, and finishes switching scene if the new one's assets are ready
+	virtual void UpdateScene(float dt) override;
+
 
 
 
@@ -61,7 +66,11 @@ protected:
 	SceneManager();
 	virtual ~SceneManager();
 
+	//Cleans up the current scene and initializes the given one
+	void ActivateScene(int idx);
+
 protected:
 	uint				m_SceneIdx;
+	int					m_PendingSceneIdx;	//Scene waiting on it's assets to load before being switched to (or -1)
 	std::vector<Scene*> m_AllScenes;
 };
\ No newline at end of file
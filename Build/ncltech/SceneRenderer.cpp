@@ -3,7 +3,9 @@
 #include "NCLDebug.h"
 #include "CommonMeshes.h"
 #include "ScreenPicker.h"
+#include "AssetManager.h"
 #include "BoundingBox.h"
+#include <nclgl\ResourceRegistry.h>
  
 void SceneRenderer::InitializeOGLContext(Window& parent)
 {
@@ -26,11 +28,18 @@ SceneRenderer::SceneRenderer()
 	, m_InvLightDirection(0.5f, 1.0f, -0.8f)
 	, m_SpecularIntensity(64.0f)
 	, m_GammaCorrection(1.0f / 2.2f)
+	, m_ShaderColNorm(NULL)
+	, m_ShaderColNormInstanced(NULL)
+	, m_NumDrawCalls(0)
+	, m_NumInstancedDrawCalls(0)
+	, m_NumShadowMapsRendered(0)
 {
 	m_InvLightDirection.Normalise();
+	memset(&m_FrameCullStats, 0, sizeof(SceneBVHCullStats));
 
 	m_ScreenTex[0] = NULL;
 	m_ShadowTex[0] = NULL;
+	InvalidateShadowCascades();
 
 	//We do not have an OGLContext at this point so nothing can be loaded properly, see InitializeOGLContext for all shader/resource loading
 	if (!RenderList::AllocateNewRenderList(&m_FrameRenderList, true))
@@ -38,6 +47,9 @@ SceneRenderer::SceneRenderer()
 		NCLERROR("Unable to allocate scene render list! - Try using less shadow maps");
 	}
 
+	//The main view selects each object's level of detail, and skips drawing anything too small to be seen
+	m_FrameRenderList->SetScreenSizeParameters(1.0f / tan(PROJ_FOV * PI_OVER_360));
+
 	//Initialize the shadow render lists
 	for (uint i = 0; i < m_ShadowMapNum; ++i)
 	{
@@ -69,6 +81,7 @@ SceneRenderer::~SceneRenderer()
 	if (m_ShaderColNorm)
 	{
 		delete m_ShaderColNorm;
+		delete m_ShaderColNormInstanced;
 		delete m_ShaderLightDir;
 		delete m_ShaderCombineLighting;
 		delete m_ShaderPresentToWindow;
@@ -97,9 +110,14 @@ SceneRenderer::~SceneRenderer()
 		m_Scene = NULL;
 	}
 
+	m_InstanceBuffer.Release();
 	ScreenPicker::Release();
 	NCLDebug::ReleaseShaders();
 	CommonMeshes::ReleaseMeshes();
+	AssetManager::Release();
+
+	//Any unused textures/meshes kept around in case they were needed again have to go before the OpenGL context does
+	ResourceRegistry::ReleaseAll();
 }
 
 bool SceneRenderer::InitialiseGL()
@@ -109,6 +127,7 @@ bool SceneRenderer::InitialiseGL()
 	m_Camera = new Camera();
 
 	BuildFBOs();
+	m_InstanceBuffer.Initialize();
 
 	NCLDebug::LoadShaders();
 
@@ -166,6 +185,14 @@ void SceneRenderer::SetShadowMapNum(uint num) {
 	}
 }
 
+void SceneRenderer::InvalidateShadowCascades()
+{
+	for (uint i = 0; i < SHADOWMAP_MAX; ++i)
+	{
+		m_ShadowMapDirty[i] = true;
+	}
+}
+
 void SceneRenderer::SetShadowMapSize(uint size) {
 	if (!m_ShadowMapsInvalidated)
 		m_ShadowMapsInvalidated = (size != m_ShadowMapSize);
@@ -183,6 +210,9 @@ void SceneRenderer::RenderScene()
 	
 	//Reset all varying data
 	Mesh::Reset();
+	m_InstanceBuffer.BeginFrame();
+	m_NumDrawCalls = 0;
+	m_NumInstancedDrawCalls = 0;
 	textureMatrix.ToIdentity();
 	modelMatrix.ToIdentity();
 	viewMatrix = m_Camera->BuildViewMatrix();
@@ -214,7 +244,7 @@ void SceneRenderer::RenderScene()
 	m_FrameRenderList->UpdateCameraWorldPos(m_Camera->GetPosition());
 	m_FrameRenderList->RemoveExcessObjects(m_FrameFrustum);
 	m_FrameRenderList->SortLists();
-	m_Scene->InsertToRenderList(m_FrameRenderList, m_FrameFrustum);
+	m_FrameCullStats = m_Scene->InsertToRenderList(m_FrameRenderList, m_FrameFrustum);
 
 
 	//Use Scene Render List for Picking
@@ -247,6 +277,7 @@ void SceneRenderer::RenderScene()
 	//Finally draw any non-anti aliasing HUD elements
 	NCLDebug::DrawDebubHUD();
 	NCLDebug::ClearDebugLists();
+	m_InstanceBuffer.EndFrame();
 
 	//Finally swap buffers and get ready to repeat the whole process
 	SwapBuffers();
@@ -270,12 +301,17 @@ void SceneRenderer::UpdateScene(float dt)
 
 void SceneRenderer::RenderShadowMaps()
 {
+	m_NumShadowMapsRendered = 0;
 	if (m_Scene != NULL)
 	{
 		const float proj_range = PROJ_FAR - PROJ_NEAR;
 		Matrix4 view = Matrix4::BuildViewMatrix(Vector3(0.0f, 0.0f, 0.0f), m_InvLightDirection);
+		Matrix4 invView = Matrix4::Inverse(view);
 		Matrix4 invCamProjView = Matrix4::Inverse(projMatrix * viewMatrix);
 
+		//If nothing in the scene has moved, the contents of any shadow map with an unchanged projection will also be unchanged
+		const bool scene_changed = m_Scene->GetNumWorldMatricesUpdated() > 0;
+		const float world_radius = m_Scene->GetWorldRadius();
 
 		auto compute_depth = [&](float x)
 		{
@@ -296,37 +332,70 @@ void SceneRenderer::RenderShadowMaps()
 			float near_depth = compute_depth(factor_n);
 			float far_depth = compute_depth(factor_f);
 
-			//Build Bounding Box around frustum section
-			BoundingBox bb;
-			bb.ExpandToFit(invCamProjView * Vector3(-1.0f, -1.0f, near_depth));
-			bb.ExpandToFit(invCamProjView * Vector3(-1.0f, 1.0f, near_depth));
-			bb.ExpandToFit(invCamProjView * Vector3(1.0f, -1.0f, near_depth));
-			bb.ExpandToFit(invCamProjView * Vector3(1.0f, 1.0f, near_depth));
-			bb.ExpandToFit(invCamProjView * Vector3(-1.0f, -1.0f, far_depth));
-			bb.ExpandToFit(invCamProjView * Vector3(-1.0f, 1.0f, far_depth));
-			bb.ExpandToFit(invCamProjView * Vector3(1.0f, -1.0f, far_depth));
-			bb.ExpandToFit(invCamProjView * Vector3(1.0f, 1.0f, far_depth));
-
-
-			//Rotate bounding box so it's orientated in the lights direction
-			Vector3 centre = (bb.maxPoints + bb.minPoints) * 0.5f;
-			Matrix4 localView = view* Matrix4::Translation(-centre);
+			//Build Bounding Sphere around frustum section
+			// - Unlike a bounding box, the size of the sphere does not change as the camera rotates
+			Vector3 corners[8] = {
+				invCamProjView * Vector3(-1.0f, -1.0f, near_depth),
+				invCamProjView * Vector3(-1.0f, 1.0f, near_depth),
+				invCamProjView * Vector3(1.0f, -1.0f, near_depth),
+				invCamProjView * Vector3(1.0f, 1.0f, near_depth),
+				invCamProjView * Vector3(-1.0f, -1.0f, far_depth),
+				invCamProjView * Vector3(-1.0f, 1.0f, far_depth),
+				invCamProjView * Vector3(1.0f, -1.0f, far_depth),
+				invCamProjView * Vector3(1.0f, 1.0f, far_depth)
+			};
 
-			bb = bb.Transform(localView);
-			bb.minPoints.z = min(bb.minPoints.z, -m_Scene->GetWorldRadius());
-			bb.maxPoints.z = max(bb.maxPoints.z, m_Scene->GetWorldRadius());
+			Vector3 centre = Vector3(0.0f, 0.0f, 0.0f);
+			for (int j = 0; j < 8; ++j) centre = centre + corners[j];
+			centre = centre * 0.125f;
+
+			float radius = 0.0f;
+			for (int j = 0; j < 8; ++j) radius = max(radius, (corners[j] - centre).LengthSquared());
+			radius = ceil(sqrt(radius) * SHADOWMAP_RADIUS_STEPS) / SHADOWMAP_RADIUS_STEPS; //Hide floating point error between frames
+
+			//Snap the centre to whole shadow map texels in light space, so the projection only ever moves in texel sized steps
+			// - This stops shadow edges shimmering as the camera moves, and keeps the projection identical between most frames
+			const float texel_size = (2.0f * radius) / float(m_ShadowMapSize);
+			Vector3 light_centre = view * centre;
+			light_centre.x = floor(light_centre.x / texel_size) * texel_size;
+			light_centre.y = floor(light_centre.y / texel_size) * texel_size;
+
+			//Depth range covers the entire world (so off-screen objects can still cast shadows), and is independant of the
+			// cascade's position so it also remains constant
+			// - If the cascade reaches outside the world, the range is extended in whole multiples of the cascade radius so
+			//   it still only changes once the camera has moved a significant distance
+			Matrix4 localView = Matrix4::Translation(Vector3(-light_centre.x, -light_centre.y, 0.0f)) * view;
+			float min_z = min(floor(light_centre.z / radius - 1.0f) * radius, -world_radius);
+			float max_z = max(ceil(light_centre.z / radius + 1.0f) * radius, world_radius);
 
 			//Build Light Projection		
-			m_ShadowProj[i] = Matrix4::Orthographic(bb.maxPoints.z, bb.minPoints.z, bb.minPoints.x, bb.maxPoints.x, bb.maxPoints.y, bb.minPoints.y);
-			m_ShadowProjView[i] = m_ShadowProj[i] * localView ;
+			Matrix4 proj = Matrix4::Orthographic(max_z, min_z, -radius, radius, radius, -radius);
+			Matrix4 projView = proj * localView;
+
+			const bool proj_changed = (memcmp(&projView, &m_ShadowProjView[i], sizeof(Matrix4)) != 0);
+			m_ShadowProj[i] = proj;
+			m_ShadowProjView[i] = projView;
 
 			//Construct Shadow RenderList 
-			Vector3 top_mid = centre + view * Vector3(0.0f, 0.0f, bb.maxPoints.z);
-			Frustum f; f.FromMatrix(m_ShadowProjView[i]);
-			m_ShadowRenderLists[i]->UpdateCameraWorldPos(top_mid);
-			m_ShadowRenderLists[i]->RemoveExcessObjects(f);
-			m_ShadowRenderLists[i]->SortLists();
-			m_Scene->InsertToRenderList(m_ShadowRenderLists[i], f);
+			RenderList* list = m_ShadowRenderLists[i];
+			if (proj_changed || scene_changed)
+			{
+				Vector3 top_mid = invView * Vector3(light_centre.x, light_centre.y, max_z);
+				Frustum f; f.FromMatrix(projView);
+				list->UpdateCameraWorldPos(top_mid);
+				list->RemoveExcessObjects(f);
+				list->SortLists();
+				m_Scene->InsertToRenderList(list, f);
+			}
+
+			//Only re-render shadow maps that will look different to last time
+			if (proj_changed
+				|| list->GetContentsVersion() != m_ShadowListVersion[i]
+				|| list->HasChangedObjects())
+			{
+				m_ShadowMapDirty[i] = true;
+			}
+			m_ShadowListVersion[i] = list->GetContentsVersion();
 		}
 
 
@@ -338,6 +407,12 @@ void SceneRenderer::RenderShadowMaps()
 		Matrix4 identity = Matrix4();
 		for (uint i = 0; i < m_ShadowMapNum; ++i)
 		{
+			if (!m_ShadowMapDirty[i])
+				continue;
+
+			m_ShadowMapDirty[i] = false;
+			m_NumShadowMapsRendered++;
+
 			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_ShadowTex[i], 0);		
 			glClear(GL_DEPTH_BUFFER_BIT);
 			
@@ -350,13 +425,59 @@ void SceneRenderer::RenderShadowMaps()
 			{
 				glUniformMatrix4fv(uniloc_modelMatrix, 1, false, (float*)&obj->m_WorldTransform);
 			};
-			m_ShadowRenderLists[i]->RenderOpaqueObjects(per_obj_render);
-			m_ShadowRenderLists[i]->RenderTransparentObjects(per_obj_render);
+
+			//Draw order doesn't matter when only writing depth, so all objects are sorted purely by state
+			m_ShadowRenderQueue.Clear();
+			m_ShadowRenderLists[i]->RecordOpaqueObjects(&m_ShadowRenderQueue, RENDERPASS_SHADOW);
+			m_ShadowRenderLists[i]->RecordTransparentObjects(&m_ShadowRenderQueue, RENDERPASS_SHADOW, false);
+			m_ShadowRenderQueue.Sort();
+			DrawRenderQueue(m_ShadowRenderQueue, identity, m_ShadowProjView[i], per_obj_render);
 		}		
 	}
 
 }
 
+void SceneRenderer::DrawRenderQueue(const RenderQueue& queue, const Matrix4& view, const Matrix4& proj, const std::function<void(Object*)>& per_object_func)
+{
+	//Pack all groups of objects sharing the same mesh/texture directly into the instance buffer
+	const std::vector<RenderCommand>& commands = queue.GetCommands();
+	uint max_instances = (uint)commands.size();
+	size_t buffer_offset;
+	InstanceData* instances = m_InstanceBuffer.Map(&max_instances, &buffer_offset);
+	uint num_instances = m_InstanceBatcher.Build(commands, instances, max_instances);
+	m_InstanceBuffer.Unmap(num_instances);		//Only what was actually packed is uploaded/reserved, the rest is left for later passes
+
+	//Draw all objects that could not be instanced as normal
+	for (Object* obj : m_InstanceBatcher.GetSingleObjects())
+	{
+		per_object_func(obj);
+		obj->OnRenderObject();
+	}
+	m_NumDrawCalls += (uint)m_InstanceBatcher.GetSingleObjects().size();
+
+	const std::vector<InstanceBatch>& batches = m_InstanceBatcher.GetBatches();
+	if (!batches.empty())
+	{
+		Shader* prev_shader = currentShader;
+		SetCurrentShader(m_ShaderColNormInstanced);
+		glUniformMatrix4fv(glGetUniformLocation(currentShader->GetProgram(), "viewMatrix"), 1, false, (float*)&view);
+		glUniformMatrix4fv(glGetUniformLocation(currentShader->GetProgram(), "projMatrix"), 1, false, (float*)&proj);
+
+		for (const InstanceBatch& batch : batches)
+		{
+			//Temporarily swap the mesh's texture, as other objects may be using the mesh with it's default texture
+			GLuint mesh_texture = batch.mesh->GetTexture();
+			batch.mesh->SetTexture(batch.texture);
+			batch.mesh->DrawInstanced(batch.numInstances, m_InstanceBuffer.GetBuffer(), buffer_offset + batch.firstInstance * sizeof(InstanceData), sizeof(InstanceData));
+			batch.mesh->SetTexture(mesh_texture);
+		}
+		m_NumDrawCalls += (uint)batches.size();
+		m_NumInstancedDrawCalls += (uint)batches.size();
+
+		SetCurrentShader(prev_shader);
+	}
+}
+
 void SceneRenderer::BuildFBOs()
 {
 	//Util Function
@@ -426,6 +547,7 @@ void SceneRenderer::BuildFBOs()
 			if (!m_ShadowTex[i]) glGenTextures(1, &m_ShadowTex[i]);
 			build_texture(m_ShadowTex[i], GL_DEPTH_COMPONENT32, m_ShadowMapSize, m_ShadowMapSize, true, true);
 		}
+		InvalidateShadowCascades();
 		
 		if (!m_ShadowFBO) glGenFramebuffers(1, &m_ShadowFBO);
 		glBindFramebuffer(GL_FRAMEBUFFER, m_ShadowFBO);
@@ -455,6 +577,14 @@ bool SceneRenderer::ShadersLoad()
 		return false;
 	}
 
+	m_ShaderColNormInstanced = new Shader(
+		SHADERDIR"SceneRenderer/TechVertexInstanced.glsl",
+		SHADERDIR"SceneRenderer/TechFragDeferred.glsl");
+	if (!m_ShaderColNormInstanced->LinkProgram()){
+		SHADERERROR("Instanced Deferred Render");
+		return false;
+	}
+
 	m_ShaderLightDir = new Shader(
 		SHADERDIR"Common/EmptyVertex.glsl",
 		SHADERDIR"SceneRenderer/TechFragDeferredDirLight.glsl",
@@ -511,6 +641,10 @@ void SceneRenderer::ShadersSetDefaults()
 	UpdateShaderMatrices();
 	glUniform1i(glGetUniformLocation(currentShader->GetProgram(), "diffuseTex"), 0);
 
+	SetCurrentShader(m_ShaderColNormInstanced);
+	UpdateShaderMatrices();
+	glUniform1i(glGetUniformLocation(currentShader->GetProgram(), "diffuseTex"), 0);
+
 
 	SetCurrentShader(m_ShaderLightDir);
 	glUniform1i(glGetUniformLocation(currentShader->GetProgram(), "depthTex"), 5);
@@ -577,7 +711,10 @@ void SceneRenderer::DeferredRenderOpaqueObjects()
 
 	GLint uniloc_modelMatrix = glGetUniformLocation(currentShader->GetProgram(), "modelMatrix");
 	GLint uniloc_nodeColour = glGetUniformLocation(currentShader->GetProgram(), "nodeColour");
-	m_FrameRenderList->RenderOpaqueObjects([&](Object* obj)
+	m_OpaqueRenderQueue.Clear();
+	m_FrameRenderList->RecordOpaqueObjects(&m_OpaqueRenderQueue, RENDERPASS_OPAQUE);
+	m_OpaqueRenderQueue.Sort();
+	DrawRenderQueue(m_OpaqueRenderQueue, viewMatrix, projMatrix, [&](Object* obj)
 	{
 		glUniformMatrix4fv(uniloc_modelMatrix, 1, false, (float*)&obj->m_WorldTransform);
 		if (uniloc_nodeColour > -1) glUniform4fv(uniloc_nodeColour, 1, (float*)&obj->GetColour());
@@ -637,7 +774,10 @@ void SceneRenderer::ForwardRenderTransparentObjects()
 
 	GLint uniloc_modelMatrix = glGetUniformLocation(currentShader->GetProgram(), "modelMatrix");
 	GLint uniloc_nodeColour = glGetUniformLocation(currentShader->GetProgram(), "nodeColour");
-	m_FrameRenderList->RenderTransparentObjects([&](Object* obj)
+	m_TransparentRenderQueue.Clear();
+	m_FrameRenderList->RecordTransparentObjects(&m_TransparentRenderQueue, RENDERPASS_TRANSPARENT);
+	m_TransparentRenderQueue.Sort();
+	m_TransparentRenderQueue.Submit([&](Object* obj)
 	{
 		glUniformMatrix4fv(uniloc_modelMatrix, 1, false, (float*)&obj->m_WorldTransform);
 		if (uniloc_nodeColour > -1) glUniform4fv(uniloc_nodeColour, 1, (float*)&obj->GetColour());
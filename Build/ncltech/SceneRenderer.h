@@ -74,6 +74,7 @@ Extra Features:
 #include <nclgl\OGLRenderer.h>
 #include <nclgl\common.h>
 #include "Scene.h"
+#include "InstanceBuffer.h"
 #include "RenderList.h"
 #include "TSingleton.h"
 
@@ -89,6 +90,7 @@ enum ScreenTextures //..or GBuffer
 };
 
 #define SHADOWMAP_MAX 16	//Hard limit defined in shader
+#define SHADOWMAP_RADIUS_STEPS 16.0f	//Cascade radii are rounded up to multiples of 1/16m so they stay constant between frames
 
 #define PROJ_FAR				80.0f			//Can see for 80m - setting this too far really hurts shadow quality as they attempt to cover the entirety of the view frustum
 #define PROJ_NEAR				0.01f			//Nearest object @ 1cm
@@ -138,10 +140,27 @@ public:
 	inline uint GetShadowMapNum()								{ return m_ShadowMapNum; }
 	void SetShadowMapNum(uint num);
 
+	//Shadow maps are only re-rendered when their projection changes or an object inside them changes, this forces all of them to be
+	// re-rendered next frame (e.g. if an object's mesh has been changed without it moving)
+	void InvalidateShadowCascades();
+
+	//Get the number of shadow maps that had to be re-rendered last frame
+	inline uint GetNumShadowMapsRendered()						{ return m_NumShadowMapsRendered; }
+
 	//Get/Set Super sampling ammount (default: 4x)
 	inline float GetSuperSamplingScalar()						{ return m_NumSuperSamples; }
 	inline void  SetSuperSamplingScalar(float scalar)			{ m_NumSuperSamples = scalar; }
 
+	//Get the number of BVH nodes/objects tested while culling the main camera view last frame
+	inline const SceneBVHCullStats& GetFrameCullStats()			{ return m_FrameCullStats; }
+
+	//Get the sorted draw commands used to render the opaque objects in the main camera view last frame
+	inline const RenderQueue& GetOpaqueRenderQueue()			{ return m_OpaqueRenderQueue; }
+
+	//Get the total number of draw calls (and how many of those were instanced) across all passes last frame
+	inline uint GetNumDrawCalls()								{ return m_NumDrawCalls; }
+	inline uint GetNumInstancedDrawCalls()						{ return m_NumInstancedDrawCalls; }
+
 
 protected:
 	//Class-Only Functions
@@ -160,6 +179,10 @@ protected:
 
 	void RenderShadowMaps();
 
+	//Draws all commands in the (sorted) queue, using one instanced draw call per group of objects sharing a mesh/texture
+	// - Uniforms must already be set on m_ShaderColNorm, and the given view/proj matrices are copied to the instancing shader
+	void DrawRenderQueue(const RenderQueue& queue, const Matrix4& view, const Matrix4& proj, const std::function<void(Object*)>& per_object_func);
+
 protected:
 	//Current Scene
 	Scene*				m_Scene;
@@ -168,6 +191,7 @@ protected:
 	Shader*				m_ShaderShadow;
 	Shader*				m_ShaderForwardLighting;
 	Shader*				m_ShaderColNorm; 
+	Shader*				m_ShaderColNormInstanced;
 	Shader*				m_ShaderLightDir;
 	Shader*				m_ShaderCombineLighting;
 	Shader*				m_ShaderPresentToWindow;
@@ -176,6 +200,18 @@ protected:
 	Camera*				m_Camera;
 	Frustum				m_FrameFrustum;
 	RenderList*			m_FrameRenderList;
+	SceneBVHCullStats	m_FrameCullStats;
+
+	//Draw commands sorted by render state, rebuilt from the renderlists each frame
+	RenderQueue			m_OpaqueRenderQueue;
+	RenderQueue			m_TransparentRenderQueue;
+	RenderQueue			m_ShadowRenderQueue;
+
+	//Instanced rendering of objects sharing the same mesh
+	InstanceBatcher		m_InstanceBatcher;
+	InstanceBuffer		m_InstanceBuffer;
+	uint				m_NumInstancedDrawCalls;
+	uint				m_NumDrawCalls;
 
 	//Render FBO
 	GLuint				m_ScreenTexWidth, m_ScreenTexHeight;
@@ -191,6 +227,9 @@ protected:
 	Matrix4				m_ShadowProj[SHADOWMAP_MAX];
 	Matrix4				m_ShadowProjView[SHADOWMAP_MAX];
 	RenderList*			m_ShadowRenderLists[SHADOWMAP_MAX];
+	bool				m_ShadowMapDirty[SHADOWMAP_MAX];			//Shadow map needs to be re-rendered
+	uint				m_ShadowListVersion[SHADOWMAP_MAX];		//RenderList contents version when the shadow map was last rendered
+	uint				m_NumShadowMapsRendered;
 
 	//Render Paramaters
 	float				m_GammaCorrection; //Monitor Default: 1.0 / 2.2 (Where 2.2 here is the gamma of the monitor which we need to invert before showing)
@@ -49,20 +49,20 @@ void ScreenPicker::RegisterObject(Object* obj)
 
 void ScreenPicker::UnregisterObject(Object* obj)
 {
-	auto loc = std::find(m_AllRegisteredObjects.begin(), m_AllRegisteredObjects.end(), obj);
+	//Screen picker indices start at 1, with 0 meaning the object isn't registered
+	uint idx = obj->m_ScreenPickerIdx;
+	if (idx == 0 || idx > m_AllRegisteredObjects.size() || m_AllRegisteredObjects[idx - 1] != obj)
+		return;
 
-	if (loc != m_AllRegisteredObjects.end())
-	{
-		obj->m_ScreenPickerIdx = 0;
-		m_AllRegisteredObjects.erase(loc);
-	}
+	//Swap and pop - only the object moved into the empty slot needs it's index updating
+	Object* last = m_AllRegisteredObjects.back();
+	m_AllRegisteredObjects[idx - 1] = last;
+	last->m_ScreenPickerIdx = idx;
+	m_AllRegisteredObjects.pop_back();
+	obj->m_ScreenPickerIdx = 0;
 
-	//Iterate through all remaining objects and update their indices
-#pragma omp parallel for
-	for (int i = 0; i < (int)m_AllRegisteredObjects.size(); ++i)
-	{
-		m_AllRegisteredObjects[i]->m_ScreenPickerIdx = i + 1;
-	}
+	if (m_CurrentlyHoverObject == obj) m_CurrentlyHoverObject = NULL;
+	if (m_CurrentlyHeldObject == obj) m_CurrentlyHeldObject = NULL;
 }
 
 void ScreenPicker::UpdateFBO(int screen_width, int screen_height)
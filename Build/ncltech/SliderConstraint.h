@@ -0,0 +1,145 @@
+
+#pragma once
+
+#include "Constraint.h"
+#include "NCLDebug.h"
+
+//Locks all relative rotation between objA and objB and only allows objB to translate along a single axis fixed to objA
+// - Optionally limits the travel along the axis and drives it with a motor (e.g. pistons, vehicle suspension, lifts)
+class SliderConstraint : public Constraint
+{
+public:
+	SliderConstraint(PhysicsObject* objA, PhysicsObject* objB, const Vector3& globalAxis)
+		: limitsEnabled(false)
+		, limitMin(0.0f)
+		, limitMax(0.0f)
+		, motorEnabled(false)
+		, motorSpeed(0.0f)
+		, motorMaxForce(0.0f)
+	{
+		this->objA = objA;
+		this->objB = objB;
+
+		Matrix3 invRotA = Matrix3::Transpose(objA->GetOrientation().ToMatrix3());
+		Matrix3 invRotB = Matrix3::Transpose(objB->GetOrientation().ToMatrix3());
+
+		Vector3 axis = globalAxis;
+		axis.Normalise();
+
+		//The slider origin is taken as objB's starting position
+		localOnA = invRotA * (objB->GetPosition() - objA->GetPosition());
+		localAxisA = invRotA * axis;
+
+		//Store the world axes in each objects local space, so we can detect any relative rotation from the starting pose
+		const Vector3 world_axes[3] = { Vector3(1.0f, 0.0f, 0.0f), Vector3(0.0f, 1.0f, 0.0f), Vector3(0.0f, 0.0f, 1.0f) };
+		for (int i = 0; i < 3; ++i)
+		{
+			localBasisA[i] = invRotA * world_axes[i];
+			localBasisB[i] = invRotB * world_axes[i];
+		}
+	}
+
+	//Limits the distance objB can travel along the axis from it's starting position
+	void SetLimits(bool enabled, float min_dist = 0.0f, float max_dist = 0.0f)
+	{
+		limitsEnabled = enabled;
+		limitMin = min_dist;
+		limitMax = max_dist;
+	}
+
+	//Drives objB along the slider axis at the given speed (meters per second)
+	void SetMotor(bool enabled, float speed = 0.0f, float max_force = 0.0f)
+	{
+		motorEnabled = enabled;
+		motorSpeed = speed;
+		motorMaxForce = max_force;
+	}
+
+	virtual void BuildJacobianRows(float dt, ConstraintRowBuffer& rows) override
+	{
+		Matrix3 rotA = objA->GetOrientation().ToMatrix3();
+		Matrix3 rotB = objB->GetOrientation().ToMatrix3();
+
+		Vector3 r1 = rotA * localOnA;
+		Vector3 ab = objB->GetPosition() - (objA->GetPosition() + r1);
+		Vector3 axis = rotA * localAxisA;
+
+		//As objB is free to move along the axis, the lever arm on objA is to objB's current position, not the slider origin
+		Vector3 r1_ab = r1 + ab;
+		Vector3 r2 = Vector3(0.0f, 0.0f, 0.0f);
+
+
+		//Positional constraint - No movement perpendicular to the slider axis
+		Vector3 t1, t2;
+		ComputeTangentBasis(axis, t1, t2);
+
+		AddLinearRow(rows, objA, objB, r1_ab, r2, t1, Vector3::Dot(ab, t1), dt);
+		AddLinearRow(rows, objA, objB, r1_ab, r2, t2, Vector3::Dot(ab, t2), dt);
+
+
+		//Rotational constraint - No relative rotation at all
+		// - Half the sum of the cross products between each pair of basis vectors gives the (small angle) rotation between the two frames
+		Vector3 misalignment = Vector3(0.0f, 0.0f, 0.0f);
+		for (int i = 0; i < 3; ++i)
+		{
+			misalignment += Vector3::Cross(rotA * localBasisA[i], rotB * localBasisB[i]);
+		}
+		misalignment = misalignment * 0.5f;
+
+		AddAngularRow(rows, objA, objB, Vector3(1.0f, 0.0f, 0.0f), misalignment.x, dt);
+		AddAngularRow(rows, objA, objB, Vector3(0.0f, 1.0f, 0.0f), misalignment.y, dt);
+		AddAngularRow(rows, objA, objB, Vector3(0.0f, 0.0f, 1.0f), misalignment.z, dt);
+
+
+		//Limits
+		// - Only added when violated, and can only ever push objB back within the limits
+		if (limitsEnabled)
+		{
+			float travel = Vector3::Dot(ab, axis);
+			if (travel < limitMin)
+			{
+				AddLinearRow(rows, objA, objB, r1_ab, r2, axis, travel - limitMin, dt);
+				rows.back().impulseSumMin = 0.0f;
+			}
+			else if (travel > limitMax)
+			{
+				AddLinearRow(rows, objA, objB, r1_ab, r2, -axis, limitMax - travel, dt);
+				rows.back().impulseSumMin = 0.0f;
+			}
+		}
+
+
+		//Motor
+		if (motorEnabled)
+		{
+			AddLinearRow(rows, objA, objB, r1_ab, r2, axis, 0.0f, dt);
+			rows.back().b = -motorSpeed;
+			rows.back().impulseSumMin = -motorMaxForce * dt;
+			rows.back().impulseSumMax = motorMaxForce * dt;
+		}
+	}
+
+	virtual void DebugDraw() const override
+	{
+		Vector3 globalOnA = objA->GetOrientation().ToMatrix3() * localOnA + objA->GetPosition();
+		Vector3 axis = objA->GetOrientation().ToMatrix3() * localAxisA;
+
+		if (limitsEnabled)
+			NCLDebug::DrawThickLine(globalOnA + axis * limitMin, globalOnA + axis * limitMax, 0.02f, Vector4(0.0f, 0.0f, 0.0f, 1.0f));
+		else
+			NCLDebug::DrawThickLine(globalOnA - axis, globalOnA + axis, 0.02f, Vector4(0.0f, 0.0f, 0.0f, 1.0f));
+
+		NCLDebug::DrawPointNDT(objB->GetPosition(), 0.05f, Vector4(1.0f, 0.8f, 1.0f, 1.0f));
+	}
+
+protected:
+	Vector3 localOnA, localAxisA;
+	Vector3 localBasisA[3], localBasisB[3];
+
+	bool	limitsEnabled;
+	float	limitMin, limitMax;
+
+	bool	motorEnabled;
+	float	motorSpeed;
+	float	motorMaxForce;
+};
\ No newline at end of file